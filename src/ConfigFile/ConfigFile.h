@@ -56,7 +56,7 @@ class ConfigFile {
 				return array ? std::make_optional(toml_array_to_vector<T>(array)) : std::nullopt;
 			}
 			default:
-				throw std::exception();
+				return std::nullopt;
 		}
 		assert(false);
 		return std::nullopt;  // For compiler when NDEBUG present
@@ -1,5 +1,6 @@
 #include "BinarySearchOptimizer.h"
 #include "RaceRunner/RaceRunner.h"
+#include "RaceRunner/RacetimeCache.h"
 #include <limits> 
 #include <algorithm> 
 
@@ -7,16 +8,29 @@ BinarySearchOptimizer::BinarySearchOptimizer(
     const SolarCar& car, const Weather& weather, const Route& route, const RaceSchedule& schedule)
     : car(car), weather(weather), route(route), schedule(schedule) {}
 
-std::optional<Optimizer::OptimizationOutput> BinarySearchOptimizer::optimize_race() const {
+std::optional<Optimizer::OptimizationOutput> BinarySearchOptimizer::optimize_race(
+    Clock::time_point deadline, const ProgressCallback& progress_callback) const {
     double low = minimum_speed;
     double high = maximum_speed;
     OptimizationOutput best_output{};
     best_output.racetime = std::numeric_limits<double>::max();
     bool found_speed = false;
 
-    while (high - low > precision) {
+    // A race still running at the deadline is abandoned, and says nothing about which half to keep
+    const auto out_of_time = [deadline](const RaceRunner::RaceProgress& /*progress*/) { return is_past(deadline); };
+
+    while (high - low > precision && !is_past(deadline)) {
         double mid = (low + high) / 2;
-        auto race_time = RaceRunner::calculate_racetime(car, route, weather, schedule, mid);
+        // Which half to keep depends on whether mid finishes at all, not on whether it beats the best so far, so races
+        // are only abandoned once they cannot finish (or the deadline passes), never for being slow
+        const auto result = RaceRunner::calculate_racetime(racetime_cache, car, route, weather, schedule, mid,
+            std::numeric_limits<double>::infinity(), out_of_time);
+        best_output.evaluations++;
+        best_output.segments_skipped += result.segments_skipped;
+        const auto& race_time = result.racetime;
+        if (result.pruned && is_past(deadline)) {
+            break;
+        }
 
         if (race_time.has_value()) {
             
@@ -24,6 +38,9 @@ std::optional<Optimizer::OptimizationOutput> BinarySearchOptimizer::optimize_rac
             if (race_time.value() < best_output.racetime) {
                 best_output.speed = mid;
                 best_output.racetime = race_time.value();
+                if (progress_callback) {
+                    progress_callback(best_output);
+                }
             }
             low = mid; 
         } else {
@@ -14,7 +14,9 @@ class BinarySearchOptimizer : public Optimizer {
 	explicit BinarySearchOptimizer(
 		const SolarCar& car, const Weather& weather, const Route& route, const RaceSchedule& schedule);
 
-	std::optional<Optimizer::OptimizationOutput> optimize_race() const override;
+	using Optimizer::optimize_race;
+	std::optional<Optimizer::OptimizationOutput> optimize_race(
+		Clock::time_point deadline, const ProgressCallback& progress_callback) const override;
 
    private:
 	const SolarCar& car;
@@ -0,0 +1,118 @@
+#include "BrentOptimizer.h"
+
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <optional>
+
+#include "RaceRunner/RaceRunner.h"
+#include "RaceRunner/RacetimeCache.h"
+#include "Tools/BrentMinimize.h"
+
+BrentOptimizer::BrentOptimizer(
+	const SolarCar& car, const Weather& weather, const Route& route, const RaceSchedule& schedule)
+	: car(car), weather(weather), route(route), schedule(schedule) {}
+
+std::optional<double> BrentOptimizer::evaluate(Search& search, double speed) const {
+	const auto cached = search.evaluations.find(speed);
+	if (cached != search.evaluations.end()) {
+		return cached->second;
+	}
+	if (is_past(search.deadline)) {
+		return std::nullopt;
+	}
+
+	const auto out_of_time = [&search](const RaceRunner::RaceProgress& /*progress*/) {
+		return is_past(search.deadline);
+	};
+	const auto result = RaceRunner::calculate_racetime(
+		racetime_cache, car, route, weather, schedule, speed, std::numeric_limits<double>::infinity(), out_of_time);
+	if (result.pruned && is_past(search.deadline)) {
+		// Ran out of time part way through: the speed might still finish, so do not remember it as infeasible
+		return std::nullopt;
+	}
+
+	const auto& race_time = result.racetime;
+	search.evaluations.emplace(speed, race_time);
+	if (race_time.has_value() && race_time.value() < search.best_racetime) {
+		search.best_racetime = race_time.value();
+		if (search.progress_callback) {
+			search.progress_callback(OptimizationOutput{
+				.racetime = race_time.value(),
+				.speed = speed,
+				.evaluations = search.evaluations.size(),
+			});
+		}
+	}
+	return race_time;
+}
+
+std::optional<Optimizer::OptimizationOutput> BrentOptimizer::optimize_race(
+	Clock::time_point deadline, const ProgressCallback& progress_callback) const {
+	Search search{.evaluations = {}, .deadline = deadline, .progress_callback = progress_callback};
+	auto& evaluations = search.evaluations;
+
+	// Phase 1a: probe coarse-to-fine (fastest first within each level) until some speed finishes the race. Too slow
+	// runs out of schedule and too fast runs out of energy, so the feasible speeds form a band somewhere in between.
+	// Each probe is a whole number of spacings below the maximum, and halving the spacing is exact, so the speeds a
+	// level shares with the coarser ones hit the evaluations exactly and are not simulated again.
+	std::optional<double> feasible_speed;
+	for (double spacing = maximum_speed - minimum_speed;
+		 spacing >= minimum_probe_spacing && !feasible_speed && !is_past(deadline); spacing /= 2) {
+		for (size_t k = 0; maximum_speed - static_cast<double>(k) * spacing >= minimum_speed; ++k) {
+			const double speed = maximum_speed - static_cast<double>(k) * spacing;
+			if (evaluations.contains(speed)) {
+				continue;
+			}
+			if (evaluate(search, speed).has_value()) {
+				feasible_speed = speed;
+				break;
+			}
+		}
+	}
+	if (!feasible_speed.has_value()) {
+		return std::nullopt;
+	}
+
+	// Phase 1b: bisect towards the closest infeasible speed above it to find the fastest feasible speed
+	double fastest_feasible = feasible_speed.value();
+	const auto faster = evaluations.upper_bound(fastest_feasible);
+	if (faster != evaluations.end()) {
+		double infeasible = faster->first;
+		while (infeasible - fastest_feasible > precision) {
+			const double mid = (fastest_feasible + infeasible) / 2;
+			if (evaluate(search, mid).has_value()) {
+				fastest_feasible = mid;
+			} else {
+				infeasible = mid;
+			}
+		}
+	}
+
+	// Phase 2: minimize racetime over the bracket ending at the fastest feasible speed. The bracket starts at the
+	// closest speed we already know to be slower (or the minimum speed).
+	const auto slower = evaluations.find(feasible_speed.value());
+	const double slowest = slower == evaluations.begin() ? minimum_speed : std::prev(slower)->first;
+	if (fastest_feasible - slowest > precision) {
+		brent_minimize(
+			[&](double speed) {
+				return evaluate(search, speed).value_or(std::numeric_limits<double>::max());
+			},
+			slowest, fastest_feasible, precision);
+	}
+
+	// Take the best speed simulated in either phase; ties go to the slower speed
+	std::optional<OptimizationOutput> best_output;
+	for (const auto& [speed, race_time] : evaluations) {
+		if (race_time.has_value() && (!best_output.has_value() || race_time.value() < best_output->racetime)) {
+			best_output = OptimizationOutput{
+				.racetime = race_time.value(),
+				.speed = speed,
+			};
+		}
+	}
+	if (best_output.has_value()) {
+		best_output->evaluations = evaluations.size();
+	}
+	return best_output;
+}
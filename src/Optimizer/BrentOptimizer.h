@@ -0,0 +1,69 @@
+#ifndef MINISIM_BRENTOPTIMIZER_H
+#define MINISIM_BRENTOPTIMIZER_H
+
+#include <limits>
+#include <map>
+#include <optional>
+
+#include "Optimizer.h"
+#include "RaceConfig/RaceSchedule/RaceSchedule.h"
+#include "RaceConfig/Route/Route.h"
+#include "RaceConfig/Weather/Weather.h"
+#include "SolarCar/SolarCar.h"
+
+/// Finds the constant speed with the lowest racetime in a few dozen simulations.
+///
+/// The search runs in two phases:
+///
+/// 1. Bracketing: probe the speed range coarse-to-fine until a speed finishes the race (too slow runs out of schedule,
+///    too fast runs out of energy), then bisect on feasibility to find the fastest speed that still finishes. Speeds
+///    above it return std::nullopt, so it is the right edge of the interval worth minimizing over. The probes stop at
+///    minimum_probe_spacing: if no speed that far apart finishes, the race is taken to be infeasible, after at most
+///    65 simulations.
+/// 2. Refinement: run Brent's method (parabolic interpolation with a golden-section fallback) between the closest
+///    slower probe and the fastest feasible speed. Infeasible speeds inside the interval are treated as an infinitely
+///    long race.
+///
+/// The best speed seen in either phase is returned, so an optimum sitting right on the feasibility boundary (the
+/// common case, since going faster only ever saves time) is still found exactly.
+class BrentOptimizer : public Optimizer {
+   public:
+	explicit BrentOptimizer(
+		const SolarCar& car, const Weather& weather, const Route& route, const RaceSchedule& schedule);
+
+	using Optimizer::optimize_race;
+	std::optional<Optimizer::OptimizationOutput> optimize_race(
+		Clock::time_point deadline, const ProgressCallback& progress_callback) const override;
+
+   private:
+	const SolarCar& car;
+	const Weather& weather;
+	const Route& route;
+	const RaceSchedule& schedule;
+	/// The minimum speed we want to go at.
+	static constexpr double minimum_speed = 5;  // mps
+	/// The maximum speed we're allowed to go at.
+	static constexpr double maximum_speed = 50;  // mps
+	/// The precision we're searching until, in both phases.
+	static constexpr double precision = 0.01;  // mps
+	/// The finest spacing the bracketing probes go down to, before giving up on finding a speed that finishes.
+	static constexpr double minimum_probe_spacing = 0.5;  // mps
+
+	/// The state of one optimize_race call.
+	struct Search {
+		/// Every speed simulated so far, so no speed is simulated twice.
+		std::map<double, std::optional<double>> evaluations;
+		/// When to stop simulating.
+		Clock::time_point deadline;
+		/// Told about every improving racetime.
+		const ProgressCallback& progress_callback;
+		/// (seconds) The best racetime reported so far.
+		double best_racetime = std::numeric_limits<double>::infinity();
+	};
+
+	/// Simulates the race at @p speed, reusing a previous result if there is one. Once the deadline has passed, new
+	/// speeds are no longer simulated and count as not finishing.
+	std::optional<double> evaluate(Search& search, double speed) const;
+};
+
+#endif  // MINISIM_BRENTOPTIMIZER_H
@@ -0,0 +1,198 @@
+#include "DynamicProgrammingOptimizer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "RaceRunner/RaceRunner.h"
+#include "Tools/ThreadPool.h"
+
+namespace {
+	/// A partial race that reached a state of charge bin.
+	struct Label {
+		RaceRunner::RaceProgress progress;
+		bool reachable = false;
+	};
+
+	/// How a label was reached: the bin it came from in the previous layer, and the speed driven in between.
+	struct BackPointer {
+		uint16_t parent_bin;
+		uint8_t speed_idx;
+	};
+
+	/// The best way found so far to cross the finish.
+	struct Finish {
+		RaceRunner::RaceProgress progress;
+		size_t block;
+		BackPointer back_pointer;
+	};
+
+	/// @returns Whether @p lhs is a strictly better partial race than @p rhs: less time, or as fast with more energy.
+	bool is_better(const RaceRunner::RaceProgress& lhs, const RaceRunner::RaceProgress& rhs) {
+		if (lhs.total_time != rhs.total_time) {
+			return lhs.total_time < rhs.total_time;
+		}
+		return lhs.energy_remaining > rhs.energy_remaining;
+	}
+}  // namespace
+
+DynamicProgrammingOptimizer::DynamicProgrammingOptimizer(const SolarCar& car, const Weather& weather,
+	const Route& route, const RaceSchedule& schedule, size_t num_threads)
+	: car(car), weather(weather), route(route), schedule(schedule), num_threads(num_threads) {}
+
+std::vector<size_t> DynamicProgrammingOptimizer::split_into_blocks() const {
+	// Stretch the blocks if one back-pointer per block and bin would not fit in the memory budget
+	const size_t max_blocks = std::max<size_t>(1, max_table_bytes / (num_soc_bins * sizeof(BackPointer)));
+	const double length = std::max(block_length, route.get_total_distance() / static_cast<double>(max_blocks));
+	return route.split_into_blocks(length);
+}
+
+size_t DynamicProgrammingOptimizer::soc_bin(double energy_remaining) const {
+	const double state_of_charge = std::clamp(car.battery.state_of_charge(energy_remaining), 0.0, 1.0);
+	return std::min(num_soc_bins - 1, static_cast<size_t>(state_of_charge * num_soc_bins));
+}
+
+std::optional<Optimizer::OptimizationOutput> DynamicProgrammingOptimizer::optimize_race(
+	Clock::time_point deadline, const ProgressCallback& progress_callback) const {
+	static_assert(num_soc_bins <= std::numeric_limits<uint16_t>::max());
+
+	const size_t num_segments = route.get_num_segments();
+	const std::vector<size_t> block_starts = split_into_blocks();
+	const size_t num_blocks = block_starts.size() - 1;
+
+	// One full-route profile per candidate speed, already capped at the speed limits, so that every transition can
+	// hand RaceRunner a read-only profile.
+	std::vector<double> speeds;
+	for (double speed = minimum_speed; speed <= maximum_speed; speed += speed_step) {
+		speeds.push_back(speed);
+	}
+	const size_t num_speeds = speeds.size();
+	if (num_speeds > std::numeric_limits<uint8_t>::max()) {
+		throw std::exception();
+	}
+
+	std::vector<std::vector<double>> capped_profiles(num_speeds, std::vector<double>(num_segments));
+	for (size_t s = 0; s < num_speeds; ++s) {
+		for (size_t i = 0; i < num_segments; ++i) {
+			capped_profiles[s][i] = std::min(speeds[s], route.get_segment(i).speed_limit);
+		}
+	}
+
+	std::vector<Label> layer(num_soc_bins);
+	std::vector<Label> next_layer(num_soc_bins);
+	std::vector<BackPointer> back_pointers(num_blocks * num_soc_bins);
+	std::vector<std::optional<RaceRunner::RaceProgress>> candidates(num_soc_bins * num_speeds);
+	std::optional<Finish> best_finish;
+	size_t evaluations = 0;
+
+	const RaceRunner::RaceProgress start = RaceRunner::start_race(car, schedule);
+	layer[soc_bin(start.energy_remaining)] = Label{.progress = start, .reachable = true};
+
+	// Walk the back-pointers from a finish to recover the speed of every block
+	const auto to_output = [&](const Finish& finish) -> std::optional<OptimizationOutput> {
+		std::vector<size_t> block_speeds(num_blocks, finish.back_pointer.speed_idx);
+		size_t bin = finish.back_pointer.parent_bin;
+		for (size_t block = finish.block; block-- > 0;) {
+			const BackPointer& back_pointer = back_pointers[block * num_soc_bins + bin];
+			block_speeds[block] = back_pointer.speed_idx;
+			bin = back_pointer.parent_bin;
+		}
+
+		OptimizationOutput output{
+			.racetime = 0,
+			.speed = 0,
+			.evaluations = evaluations + 1,
+			.speed_profile = std::vector<double>(num_segments),
+		};
+		double driving_time = 0;
+		for (size_t block = 0; block < num_blocks; ++block) {
+			for (size_t i = block_starts[block]; i < block_starts[block + 1]; ++i) {
+				output.speed_profile[i] = capped_profiles[block_speeds[block]][i];
+				driving_time += route.get_segment(i).distance / output.speed_profile[i];
+			}
+		}
+		output.speed = route.get_total_distance() / driving_time;
+
+		// Every label was an exact simulation, so this only double-checks the chain we reconstructed
+		const auto racetime = RaceRunner::calculate_racetime(car, route, weather, schedule, output.speed_profile);
+		if (!racetime.has_value()) {
+			return std::nullopt;
+		}
+		output.racetime = racetime.value();
+		return output;
+	};
+
+	ThreadPool pool(num_threads);
+	for (size_t block = 0; block < num_blocks && !is_past(deadline); ++block) {
+		const size_t block_end = block_starts[block + 1];
+
+		// Simulate every (bin, speed) transition of this stage in parallel...
+		pool.parallel_for(candidates.size(), [&](size_t i) {
+			const Label& label = layer[i / num_speeds];
+			if (!label.reachable || is_past(deadline)) {
+				candidates[i].reset();
+				return;
+			}
+			// Resume from the label's snapshot rather than simulating the route up to this block again
+			RaceRunner::RaceState state(car, route, weather, schedule);
+			state.restore(label.progress);
+			const bool made_it = state.run_until(block_end, capped_profiles[i % num_speeds]);
+			candidates[i] = made_it ? std::make_optional(state.snapshot()) : std::nullopt;
+		});
+		if (is_past(deadline)) {
+			// Some transitions of this stage were never simulated, so keep only what earlier stages found
+			break;
+		}
+
+		// ...then merge them in a fixed order so the result does not depend on the thread count
+		const std::optional<Finish> previous_finish = best_finish;
+		std::fill(next_layer.begin(), next_layer.end(), Label{});
+		for (size_t i = 0; i < candidates.size(); ++i) {
+			if (!layer[i / num_speeds].reachable) {
+				continue;
+			}
+			++evaluations;
+			if (!candidates[i].has_value()) {
+				continue;
+			}
+
+			const RaceRunner::RaceProgress& progress = candidates[i].value();
+			const BackPointer back_pointer{
+				.parent_bin = static_cast<uint16_t>(i / num_speeds),
+				.speed_idx = static_cast<uint8_t>(i % num_speeds),
+			};
+
+			if (progress.finished) {
+				if (!best_finish.has_value() || is_better(progress, best_finish->progress)) {
+					best_finish = Finish{.progress = progress, .block = block, .back_pointer = back_pointer};
+				}
+				continue;
+			}
+
+			const size_t bin = soc_bin(progress.energy_remaining);
+			if (!next_layer[bin].reachable || is_better(progress, next_layer[bin].progress)) {
+				next_layer[bin] = Label{.progress = progress, .reachable = true};
+				back_pointers[block * num_soc_bins + bin] = back_pointer;
+			}
+		}
+
+		std::swap(layer, next_layer);
+
+		if (progress_callback && best_finish.has_value() &&
+			(!previous_finish.has_value() || is_better(best_finish->progress, previous_finish->progress))) {
+			const std::optional<OptimizationOutput> output = to_output(best_finish.value());
+			if (output.has_value()) {
+				progress_callback(output.value());
+			}
+		}
+	}
+
+	if (!best_finish.has_value()) {
+		return std::nullopt;
+	}
+	return to_output(best_finish.value());
+}
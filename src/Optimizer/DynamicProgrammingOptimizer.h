@@ -0,0 +1,61 @@
+#ifndef MINISIM_DYNAMICPROGRAMMINGOPTIMIZER_H
+#define MINISIM_DYNAMICPROGRAMMINGOPTIMIZER_H
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "Optimizer.h"
+#include "RaceConfig/RaceSchedule/RaceSchedule.h"
+#include "RaceConfig/Route/Route.h"
+#include "RaceConfig/Weather/Weather.h"
+#include "SolarCar/SolarCar.h"
+
+/// Finds a per-segment speed profile with dynamic programming over the state of charge.
+///
+/// The route is split into blocks of consecutive segments (never spanning a control stop), and every block is driven at
+/// one of a fixed set of candidate speeds, capped at each segment's speed limit. The DP runs block by block: the state
+/// is the battery's state of charge, discretized into bins, and each bin keeps the single partial race that reached it
+/// with the least racetime (ties go to more energy). Every transition is an exact simulation of the block starting from
+/// that partial race, so the day windows, control stops and charging all come from RaceRunner.
+///
+/// Only two layers of partial races are kept in memory at once; the full table only stores a small back-pointer per
+/// block and bin, and the block length is stretched if that table would outgrow max_table_bytes.
+class DynamicProgrammingOptimizer : public Optimizer {
+   public:
+	/// @param [in] num_threads The number of threads each DP stage is spread over. 0 means every hardware thread.
+	explicit DynamicProgrammingOptimizer(const SolarCar& car, const Weather& weather, const Route& route,
+		const RaceSchedule& schedule, size_t num_threads = 1);
+
+	using Optimizer::optimize_race;
+	std::optional<Optimizer::OptimizationOutput> optimize_race(
+		Clock::time_point deadline, const ProgressCallback& progress_callback) const override;
+
+   private:
+	const SolarCar& car;
+	const Weather& weather;
+	const Route& route;
+	const RaceSchedule& schedule;
+	/// The number of threads each DP stage is spread over.
+	size_t num_threads;
+	/// The minimum speed we want to go at.
+	static constexpr double minimum_speed = 5;  // mps
+	/// The maximum speed we're allowed to go at.
+	static constexpr double maximum_speed = 50;  // mps
+	/// The spacing between candidate block speeds.
+	static constexpr double speed_step = 1;  // mps
+	/// The number of bins the state of charge [0, 1] is split into.
+	static constexpr size_t num_soc_bins = 64;
+	/// The distance after which a block is closed.
+	static constexpr double block_length = 20000;  // m
+	/// The most memory the back-pointer table may use.
+	static constexpr size_t max_table_bytes = size_t{64} << 20U;
+
+	/// @returns The first segment of every block, followed by the number of segments in the route.
+	std::vector<size_t> split_into_blocks() const;
+
+	/// @returns The state of charge bin that @p energy_remaining falls into.
+	size_t soc_bin(double energy_remaining) const;
+};
+
+#endif  // MINISIM_DYNAMICPROGRAMMINGOPTIMIZER_H
@@ -0,0 +1,173 @@
+#include "EnsembleOptimizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "RaceRunner/RaceRunner.h"
+#include "Tools/CounterRandom.h"
+#include "Tools/ThreadPool.h"
+
+EnsembleOptimizer::EnsembleOptimizer(const SolarCar& car, const Weather& weather, const Route& route,
+	const RaceSchedule& schedule, RiskMetric risk_metric, size_t num_threads, size_t ensemble_size, uint64_t seed,
+	const ForecastError& forecast_error)
+	: car(car), route(route), schedule(schedule), risk_metric(risk_metric), num_threads(num_threads) {
+	// Every member draws its own four numbers of the stream, so any member can be rebuilt on its own
+	constexpr uint64_t draws_per_member = 4;
+	ensemble.reserve(ensemble_size);
+	for (uint64_t member = 0; member < ensemble_size; ++member) {
+		const auto draw = [&](uint64_t field) {
+			return counter_random_normal(seed, member * draws_per_member + field);
+		};
+		ensemble.push_back(weather.with_perturbation(WeatherPerturbation{
+			.irradiance_scale = std::max(0.0, 1 + forecast_error.irradiance * draw(0)),
+			.wind_north_south_offset = forecast_error.wind * draw(1),
+			.wind_east_west_offset = forecast_error.wind * draw(2),
+			.air_density_scale = std::max(0.0, 1 + forecast_error.air_density * draw(3)),
+		}));
+	}
+}
+
+Optimizer::EnsembleRisk EnsembleOptimizer::to_risk(std::span<const std::optional<double>> racetimes) {
+	std::vector<double> sorted_racetimes;
+	sorted_racetimes.reserve(racetimes.size());
+	double total_racetime = 0;
+	size_t num_finished = 0;
+	for (const std::optional<double>& racetime : racetimes) {
+		sorted_racetimes.push_back(racetime.value_or(std::numeric_limits<double>::infinity()));
+		if (racetime.has_value()) {
+			total_racetime += racetime.value();
+			++num_finished;
+		}
+	}
+	std::sort(sorted_racetimes.begin(), sorted_racetimes.end());
+
+	// The nearest-rank percentile: the smallest racetime at least 90% of the members finish within
+	const auto p90_rank = static_cast<size_t>(std::ceil(0.9 * static_cast<double>(racetimes.size())));
+	const auto num_members = static_cast<double>(racetimes.size());
+	return EnsembleRisk{
+		.mean_racetime = num_finished == 0 ? std::numeric_limits<double>::infinity()
+										   : total_racetime / static_cast<double>(num_finished),
+		.p90_racetime = sorted_racetimes[std::max<size_t>(p90_rank, 1) - 1],
+		.finish_probability = static_cast<double>(num_finished) / num_members,
+		.ensemble_size = racetimes.size(),
+	};
+}
+
+double EnsembleOptimizer::metric_racetime(const EnsembleRisk& risk) const {
+	switch (risk_metric) {
+		case RiskMetric::MEAN_RACETIME:
+			return risk.finish_probability == 1 ? risk.mean_racetime : std::numeric_limits<double>::infinity();
+		case RiskMetric::P90_RACETIME:
+			return risk.p90_racetime;
+		case RiskMetric::FINISH_PROBABILITY:
+		default:
+			return risk.mean_racetime;
+	}
+}
+
+bool EnsembleOptimizer::is_better(const EnsembleRisk& lhs, const EnsembleRisk& rhs) const {
+	if (risk_metric == RiskMetric::FINISH_PROBABILITY && lhs.finish_probability != rhs.finish_probability) {
+		return lhs.finish_probability > rhs.finish_probability;
+	}
+	return metric_racetime(lhs) < metric_racetime(rhs);
+}
+
+std::optional<Optimizer::OptimizationOutput> EnsembleOptimizer::optimize_race(
+	Clock::time_point deadline, const ProgressCallback& progress_callback) const {
+	if (ensemble.empty()) {
+		return std::nullopt;
+	}
+
+	// A sweep with members left unsimulated at the deadline says nothing, and is thrown away
+	ThreadPool pool(num_threads);
+	std::atomic<size_t> evaluations = 0;
+	const auto sweep = [&](const std::vector<double>& speeds) -> std::optional<std::vector<EnsembleRisk>> {
+		// racetimes[member][candidate], filled in by the member's own task
+		std::vector<std::vector<std::optional<double>>> racetimes(ensemble.size());
+		std::atomic<bool> finished_in_time = true;
+		pool.parallel_for(ensemble.size(), [&](size_t member) {
+			if (is_past(deadline)) {
+				finished_in_time = false;
+				return;
+			}
+			racetimes[member] = RaceRunner::calculate_racetime_batch(car, route, ensemble[member], schedule, speeds);
+			evaluations += speeds.size();
+		});
+		if (!finished_in_time) {
+			return std::nullopt;
+		}
+
+		std::vector<EnsembleRisk> risks;
+		std::vector<std::optional<double>> candidate_racetimes(ensemble.size());
+		for (size_t candidate = 0; candidate < speeds.size(); ++candidate) {
+			for (size_t member = 0; member < ensemble.size(); ++member) {
+				candidate_racetimes[member] = racetimes[member][candidate];
+			}
+			risks.push_back(to_risk(candidate_racetimes));
+		}
+		return risks;
+	};
+
+	std::optional<OptimizationOutput> best_output;
+	// Keeps the candidate if it qualifies and beats the best so far; ties keep the speed considered first
+	const auto consider = [&](const std::vector<double>& speeds, const std::vector<EnsembleRisk>& risks) {
+		bool improved = false;
+		for (size_t candidate = 0; candidate < speeds.size(); ++candidate) {
+			const EnsembleRisk& risk = risks[candidate];
+			if (!std::isfinite(metric_racetime(risk))) {
+				continue;
+			}
+			if (!best_output.has_value() || is_better(risk, best_output->ensemble_risk.value())) {
+				best_output = OptimizationOutput{
+					.racetime = metric_racetime(risk),
+					.speed = speeds[candidate],
+					.ensemble_risk = risk,
+				};
+				improved = true;
+			}
+		}
+		if (improved && progress_callback) {
+			best_output->evaluations = evaluations.load();
+			progress_callback(best_output.value());
+		}
+	};
+
+	// First sweep: the whole speed range
+	std::vector<double> coarse_speeds;
+	for (double speed = minimum_speed; speed <= maximum_speed; speed += coarse_speed_step) {
+		coarse_speeds.push_back(speed);
+	}
+	const std::optional<std::vector<EnsembleRisk>> coarse_risks = sweep(coarse_speeds);
+	if (!coarse_risks.has_value()) {
+		return std::nullopt;
+	}
+	consider(coarse_speeds, coarse_risks.value());
+	if (!best_output.has_value()) {
+		return std::nullopt;
+	}
+
+	// Second sweep: in between the coarse neighbours of the best coarse speed
+	std::vector<double> fine_speeds;
+	const double best_coarse_speed = best_output->speed;
+	for (double offset = fine_speed_step - coarse_speed_step; offset < coarse_speed_step - fine_speed_step / 2;
+		 offset += fine_speed_step) {
+		const double speed = best_coarse_speed + offset;
+		if (std::abs(offset) > fine_speed_step / 2 && speed >= minimum_speed && speed <= maximum_speed) {
+			fine_speeds.push_back(speed);
+		}
+	}
+	const std::optional<std::vector<EnsembleRisk>> fine_risks = sweep(fine_speeds);
+	if (fine_risks.has_value()) {
+		consider(fine_speeds, fine_risks.value());
+	}
+
+	best_output->evaluations = evaluations.load();
+	return best_output;
+}
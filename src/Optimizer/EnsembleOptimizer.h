@@ -0,0 +1,96 @@
+#ifndef MINISIM_ENSEMBLEOPTIMIZER_H
+#define MINISIM_ENSEMBLEOPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "Optimizer.h"
+#include "RaceConfig/RaceSchedule/RaceSchedule.h"
+#include "RaceConfig/Route/Route.h"
+#include "RaceConfig/Weather/Weather.h"
+#include "SolarCar/SolarCar.h"
+
+/// The standard deviations of the forecast errors an ensemble is drawn with.
+struct ForecastError {
+	/// (relative) The standard deviation of the irradiance error.
+	double irradiance = 0.15;
+	/// (m/s) The standard deviation of the error of each wind component.
+	double wind = 2;
+	/// (relative) The standard deviation of the air density error.
+	double air_density = 0.02;
+};
+
+/// Finds the constant speed that is most robust to forecast error, by racing every candidate speed over a Monte Carlo
+/// ensemble of perturbed forecasts and optimizing a risk metric of the racetimes.
+///
+/// Every ensemble member is the forecast with its irradiance and air density scaled, and its wind shifted, by amounts
+/// drawn from normal distributions. The draws come from a counter-based random number generator keyed on the seed and
+/// the member, so the ensemble is reproducible and independent of the thread count. Members share the forecast's
+/// splines (see Weather::with_perturbation), so even thousands of them take next to no memory.
+///
+/// The speeds are searched coarse to fine: a sweep over the whole speed range, then a finer sweep around the best
+/// coarse speed. Every sweep runs all its speeds on each member in lock-step (RaceRunner::calculate_racetime_batch),
+/// with the members spread over the threads.
+class EnsembleOptimizer : public Optimizer {
+   public:
+	/// What makes one speed more robust than another.
+	enum class RiskMetric {
+		/// The least mean racetime, over speeds that finish in every member.
+		MEAN_RACETIME,
+		/// The least racetime that 90% of the members finish within.
+		P90_RACETIME,
+		/// The most members finished in; ties go to the least mean racetime.
+		FINISH_PROBABILITY,
+	};
+
+	/// @param [in] risk_metric The metric to optimize.
+	/// @param [in] num_threads The number of threads the ensemble members are spread over. 0 means every hardware
+	/// thread.
+	/// @param [in] ensemble_size The number of perturbed forecasts.
+	/// @param [in] seed Picks the ensemble: the same seed always gives the same perturbations.
+	/// @param [in] forecast_error How far the members stray from the forecast. No error at all makes every member the
+	/// forecast itself.
+	explicit EnsembleOptimizer(const SolarCar& car, const Weather& weather, const Route& route,
+		const RaceSchedule& schedule, RiskMetric risk_metric, size_t num_threads = 1,
+		size_t ensemble_size = default_ensemble_size, uint64_t seed = 0, const ForecastError& forecast_error = {});
+
+	using Optimizer::optimize_race;
+	std::optional<Optimizer::OptimizationOutput> optimize_race(
+		Clock::time_point deadline, const ProgressCallback& progress_callback) const override;
+
+	/// The number of perturbed forecasts, unless told otherwise.
+	static constexpr size_t default_ensemble_size = 64;
+
+   private:
+	const SolarCar& car;
+	const Route& route;
+	const RaceSchedule& schedule;
+	RiskMetric risk_metric;
+	/// The number of threads the ensemble members are spread over.
+	size_t num_threads;
+	/// The perturbed forecasts.
+	std::vector<Weather> ensemble;
+	/// The minimum speed we want to go at.
+	static constexpr double minimum_speed = 5;  // mps
+	/// The maximum speed we're allowed to go at.
+	static constexpr double maximum_speed = 50;  // mps
+	/// The spacing of the speeds in the first sweep.
+	static constexpr double coarse_speed_step = 1;  // mps
+	/// The spacing of the speeds in the second sweep, around the best of the first.
+	static constexpr double fine_speed_step = 0.1;  // mps
+
+	/// @returns How a speed fares, given its racetime in every member.
+	static EnsembleRisk to_risk(std::span<const std::optional<double>> racetimes);
+
+	/// @returns Whether @p lhs is more robust than @p rhs under the risk metric.
+	bool is_better(const EnsembleRisk& lhs, const EnsembleRisk& rhs) const;
+
+	/// @returns The value of the risk metric as a racetime: the P90 racetime for P90_RACETIME, and the mean racetime
+	/// otherwise. Infinity if the speed does not qualify.
+	double metric_racetime(const EnsembleRisk& risk) const;
+};
+
+#endif  // MINISIM_ENSEMBLEOPTIMIZER_H
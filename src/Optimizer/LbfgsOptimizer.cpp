@@ -0,0 +1,132 @@
+#include "LbfgsOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "BrentOptimizer.h"
+#include "RaceRunner/RaceRunner.h"
+#include "Tools/LbfgsMinimize.h"
+
+namespace {
+	/// @returns The logistic function of @p x, which maps any number into (0, 1).
+	double logistic(double x) {
+		return 1 / (1 + std::exp(-x));
+	}
+}  // namespace
+
+LbfgsOptimizer::LbfgsOptimizer(
+	const SolarCar& car, const Weather& weather, const Route& route, const RaceSchedule& schedule)
+	: car(car), weather(weather), route(route), schedule(schedule) {}
+
+std::vector<double> LbfgsOptimizer::to_speed_profile(
+	std::span<const double> variables, std::span<const size_t> block_starts) const {
+	std::vector<double> speed_profile(route.get_num_segments());
+	for (size_t block = 0; block + 1 < block_starts.size(); ++block) {
+		const double speed = minimum_speed + (maximum_speed - minimum_speed) * logistic(variables[block]);
+		for (size_t i = block_starts[block]; i < block_starts[block + 1]; ++i) {
+			speed_profile[i] = std::min(speed, route.get_segment(i).speed_limit);
+		}
+	}
+	return speed_profile;
+}
+
+std::optional<Optimizer::OptimizationOutput> LbfgsOptimizer::optimize_race(
+	Clock::time_point deadline, const ProgressCallback& progress_callback) const {
+	// Start from the best constant speed. It ignores the speed limits, so it is capped at them like every profile
+	// before it is anything to compare against
+	BrentOptimizer brent(car, weather, route, schedule);
+	brent.set_racetime_cache(racetime_cache);
+	const std::optional<OptimizationOutput> constant_speed = brent.optimize_race(deadline, nullptr);
+	if (!constant_speed.has_value()) {
+		return std::nullopt;
+	}
+	size_t evaluations = constant_speed->evaluations;
+
+	const std::vector<size_t> block_starts = route.split_into_blocks(block_length);
+	const size_t num_blocks = block_starts.size() - 1;
+	const double energy_reserve = reserve_fraction * car.battery.get_capacity();
+
+	// Search over the logistic's input, so every point is a speed within [minimum_speed, maximum_speed]
+	const double start_fraction = std::clamp(
+		(constant_speed->speed - minimum_speed) / (maximum_speed - minimum_speed), 1e-6, 1 - 1e-6);
+	std::vector<double> variables(num_blocks, std::log(start_fraction / (1 - start_fraction)));
+
+	std::optional<OptimizationOutput> best_output;
+	// Keeps @p speed_profile if it finishes faster than the best so far
+	const auto try_profile = [&](std::vector<double> speed_profile) {
+		const auto racetime = RaceRunner::calculate_racetime(car, route, weather, schedule, speed_profile);
+		++evaluations;
+		if (!racetime.has_value()) {
+			return false;
+		}
+		if (best_output.has_value() && racetime.value() >= best_output->racetime) {
+			return true;
+		}
+		double driving_time = 0;
+		for (size_t i = 0; i < speed_profile.size(); ++i) {
+			driving_time += route.get_segment(i).distance / speed_profile[i];
+		}
+		best_output = OptimizationOutput{
+			.racetime = racetime.value(),
+			.speed = route.get_total_distance() / driving_time,
+			.evaluations = evaluations,
+			.speed_profile = std::move(speed_profile),
+		};
+		if (progress_callback) {
+			progress_callback(best_output.value());
+		}
+		return true;
+	};
+	try_profile(to_speed_profile(variables, block_starts));
+
+	double penalty_weight = initial_penalty_weight;
+	const auto objective_function = [&](std::span<const double> point, std::span<double> gradient) {
+		if (is_past(deadline)) {
+			// Looks undefined everywhere, so the line search gives up and L-BFGS stops at its last point
+			return std::numeric_limits<double>::infinity();
+		}
+		++evaluations;
+		const std::vector<double> speed_profile = to_speed_profile(point, block_starts);
+		const RaceRunner::RacetimeGradient racetime = RaceRunner::calculate_racetime_gradient(
+			car, route, weather, schedule, speed_profile, energy_reserve, penalty_weight);
+		if (!std::isfinite(racetime.objective)) {
+			return std::numeric_limits<double>::infinity();
+		}
+
+		// Chain through the speed limit cap and the logistic to every block's variable
+		for (size_t block = 0; block < num_blocks; ++block) {
+			const double fraction = logistic(point[block]);
+			const double speed = minimum_speed + (maximum_speed - minimum_speed) * fraction;
+			const double speed_slope = (maximum_speed - minimum_speed) * fraction * (1 - fraction);
+			gradient[block] = 0;
+			for (size_t i = block_starts[block]; i < block_starts[block + 1]; ++i) {
+				if (speed < route.get_segment(i).speed_limit) {
+					gradient[block] += racetime.gradient[i] * speed_slope;
+				}
+			}
+		}
+		return racetime.objective;
+	};
+
+	for (size_t round = 0; round < max_rounds && !is_past(deadline); ++round, penalty_weight *= penalty_growth) {
+		lbfgs_minimize(objective_function, variables, history, tolerance, max_iterations);
+
+		// The penalty only discourages a flat battery, so check the profile for real
+		if (!try_profile(to_speed_profile(variables, block_starts))) {
+			continue;
+		}
+		// A steeper penalty would only make the profile more conservative
+		break;
+	}
+
+	if (!best_output.has_value()) {
+		return std::nullopt;
+	}
+	best_output->evaluations = evaluations;
+	return best_output;
+}
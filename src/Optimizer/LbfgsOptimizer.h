@@ -0,0 +1,65 @@
+#ifndef MINISIM_LBFGSOPTIMIZER_H
+#define MINISIM_LBFGSOPTIMIZER_H
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "Optimizer.h"
+#include "RaceConfig/RaceSchedule/RaceSchedule.h"
+#include "RaceConfig/Route/Route.h"
+#include "RaceConfig/Weather/Weather.h"
+#include "SolarCar/SolarCar.h"
+
+/// Finds a per-block speed profile by gradient descent (L-BFGS) on the racetime.
+///
+/// The route is split into blocks like the DP optimizer does, and each block gets a continuous speed, capped at each
+/// segment's speed limit. Running out of energy is turned into a smooth penalty on the battery dropping below a small
+/// reserve, so the racetime has a gradient everywhere; RaceRunner::calculate_racetime_gradient gives it exactly, for
+/// every block at once, in about the time of a few simulations.
+///
+/// The search starts from the best constant speed (found by the Brent optimizer) and descends with L-BFGS. Since the
+/// penalty only discourages a flat battery rather than ruling it out, every result is checked with an exact
+/// simulation; if the battery still runs flat, the penalty is made steeper and the search continues from there. The
+/// best constant speed, capped at the speed limits like every profile, is returned if no profile beats it.
+class LbfgsOptimizer : public Optimizer {
+   public:
+	explicit LbfgsOptimizer(
+		const SolarCar& car, const Weather& weather, const Route& route, const RaceSchedule& schedule);
+
+	using Optimizer::optimize_race;
+	std::optional<Optimizer::OptimizationOutput> optimize_race(
+		Clock::time_point deadline, const ProgressCallback& progress_callback) const override;
+
+   private:
+	const SolarCar& car;
+	const Weather& weather;
+	const Route& route;
+	const RaceSchedule& schedule;
+	/// The minimum speed we want to go at.
+	static constexpr double minimum_speed = 5;  // mps
+	/// The maximum speed we're allowed to go at.
+	static constexpr double maximum_speed = 50;  // mps
+	/// The distance after which a block is closed.
+	static constexpr double block_length = 20000;  // m
+	/// The fraction of the battery's capacity the penalty tries to keep in reserve.
+	static constexpr double reserve_fraction = 0.01;
+	/// (seconds per Wh^2) The weight of the energy penalty in the first round.
+	static constexpr double initial_penalty_weight = 1e-2;
+	/// How much steeper the penalty gets every round.
+	static constexpr double penalty_growth = 10;
+	/// The most rounds of steepening the penalty.
+	static constexpr size_t max_rounds = 6;
+	/// The number of recent steps L-BFGS keeps to approximate the curvature.
+	static constexpr size_t history = 8;
+	/// The most L-BFGS iterations per round.
+	static constexpr size_t max_iterations = 200;
+	/// (relative) A round stops once an iteration improves the penalized racetime by less than this.
+	static constexpr double tolerance = 1e-9;
+
+	/// @returns The speed to drive each segment at, given the (unbounded) search variable of each block.
+	std::vector<double> to_speed_profile(std::span<const double> variables, std::span<const size_t> block_starts) const;
+};
+
+#endif  // MINISIM_LBFGSOPTIMIZER_H
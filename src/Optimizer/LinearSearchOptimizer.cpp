@@ -1,33 +1,96 @@
 #include "LinearSearchOptimizer.h"
-#include "src/RaceRunner/RaceRunner.h"  
+
+#include <atomic>
+#include <cstddef>
 #include <limits>
+#include <mutex>
 #include <optional>
-#include <iostream>
+#include <vector>
+
+#include "RaceRunner/RaceRunner.h"
+#include "RaceRunner/RacetimeCache.h"
+#include "Tools/ThreadPool.h"
+
+LinearSearchOptimizer::LinearSearchOptimizer(const SolarCar& car, const Weather& weather, const Route& route,
+	const RaceSchedule& schedule, size_t num_threads)
+	: car(car), weather(weather), route(route), schedule(schedule), num_threads(num_threads) {}
 
-LinearSearchOptimizer::LinearSearchOptimizer(
-    const SolarCar& car, const Weather& weather, const Route& route, const RaceSchedule& schedule)
-    : car(car), weather(weather), route(route), schedule(schedule) {}
+std::optional<Optimizer::OptimizationOutput> LinearSearchOptimizer::optimize_race(
+	Clock::time_point deadline, const ProgressCallback& progress_callback) const {
+	// Generate the candidates exactly the way a serial sweep would (by repeatedly adding the step), so the speeds we
+	// test are bit-for-bit the same regardless of the thread count.
+	std::vector<double> speeds;
+	for (double speed = minimum_speed; speed <= maximum_speed; speed += speed_step) {
+		speeds.push_back(speed);
+	}
 
-std::optional<Optimizer::OptimizationOutput> LinearSearchOptimizer::optimize_race() const {
-    double best_speed = minimum_speed;
-    double best_time = std::numeric_limits<double>::max();  
-    OptimizationOutput best_output{};  // Initialize with default constructor
+	// Races still running at the deadline are abandoned along with the ones that cannot beat the bound
+	const RaceRunner::PruneCallback out_of_time =
+		deadline == Clock::time_point::max()
+			? RaceRunner::PruneCallback()
+			: [deadline](const RaceRunner::RaceProgress& /*progress*/) { return is_past(deadline); };
 
-    for (double speed = best_speed; speed <= maximum_speed; speed += speed_step) {
-        std::optional<double> race_time = RaceRunner::calculate_racetime(car, route, weather, schedule, speed);
+	// Sweep from the fastest speed down, so the first finisher gives a tight bound and most of the slower candidates
+	// are abandoned before they start. A candidate is only abandoned if it could not have beaten a racetime we already
+	// have, so the bound (and the order candidates happen to finish in) never changes the answer.
+	std::vector<std::optional<double>> race_times(speeds.size());
+	std::atomic<double> best_bound = std::numeric_limits<double>::infinity();
+	std::atomic<size_t> segments_skipped = 0;
+	std::atomic<size_t> evaluations = 0;
+	std::mutex progress_mutex;
+	double reported_racetime = std::numeric_limits<double>::infinity();
+	ThreadPool pool(num_threads);
+	pool.parallel_for(speeds.size(), [&](size_t task) {
+		if (is_past(deadline)) {
+			return;
+		}
+		const size_t i = speeds.size() - 1 - task;
+		const RaceRunner::BoundedRacetime result = RaceRunner::calculate_racetime(
+			racetime_cache, car, route, weather, schedule, speeds[i], best_bound.load(), out_of_time);
+		race_times[i] = result.racetime;
+		segments_skipped += result.segments_skipped;
+		++evaluations;
 
-        if (!race_time.has_value()) {
-            continue;
-        }
+		if (result.racetime.has_value()) {
+			double bound = best_bound.load();
+			while (result.racetime.value() < bound &&
+				   !best_bound.compare_exchange_weak(bound, result.racetime.value())) {
+			}
 
-        if (race_time.value() < best_time) {
-            best_time = race_time.value();
-            best_speed = speed;
+			if (progress_callback) {
+				const std::lock_guard<std::mutex> lock(progress_mutex);
+				if (result.racetime.value() < reported_racetime) {
+					reported_racetime = result.racetime.value();
+					progress_callback(OptimizationOutput{
+						.racetime = result.racetime.value(),
+						.speed = speeds[i],
+						.evaluations = evaluations.load(),
+						.segments_skipped = segments_skipped.load(),
+					});
+				}
+			}
+		}
+	});
 
-            best_output.speed = speed;
-            best_output.racetime = race_time.value();
-        }
-    }
+	// Reduce in candidate order so that ties always go to the slowest speed, as they would in a serial sweep.
+	std::optional<OptimizationOutput> best_output;
+	double best_time = std::numeric_limits<double>::max();
+	for (size_t i = 0; i < speeds.size(); ++i) {
+		if (!race_times[i].has_value()) {
+			continue;
+		}
+		if (race_times[i].value() < best_time) {
+			best_time = race_times[i].value();
+			best_output = OptimizationOutput{
+				.racetime = race_times[i].value(),
+				.speed = speeds[i],
+			};
+		}
+	}
+	if (best_output.has_value()) {
+		best_output->evaluations = evaluations.load();
+		best_output->segments_skipped = segments_skipped.load();
+	}
 
-    return best_output;
+	return best_output;
 }
@@ -1,6 +1,7 @@
 #ifndef MINISIM_LINEARSEARCHOPTIMIZER_H
 #define MINISIM_LINEARSEARCHOPTIMIZER_H
 
+#include <cstddef>
 #include <optional>
 
 #include "Optimizer.h"
@@ -11,16 +12,21 @@
 
 class LinearSearchOptimizer : public Optimizer {
    public:
-	explicit LinearSearchOptimizer(
-		const SolarCar& car, const Weather& weather, const Route& route, const RaceSchedule& schedule);
+	/// @param [in] num_threads The number of threads to evaluate candidate speeds on. 0 means every hardware thread.
+	explicit LinearSearchOptimizer(const SolarCar& car, const Weather& weather, const Route& route,
+		const RaceSchedule& schedule, size_t num_threads = 1);
 
-	std::optional<Optimizer::OptimizationOutput> optimize_race() const override;
+	using Optimizer::optimize_race;
+	std::optional<Optimizer::OptimizationOutput> optimize_race(
+		Clock::time_point deadline, const ProgressCallback& progress_callback) const override;
 
    private:
 	const SolarCar& car;
 	const Weather& weather;
 	const Route& route;
 	const RaceSchedule& schedule;
+	/// The number of threads the candidate speeds are spread over.
+	size_t num_threads;
 	/// The minimum speed we want to go at.
 	static constexpr double minimum_speed = 5;  // mps
 	/// The maximum speed we're allowed to go at.
@@ -1,21 +1,37 @@
 #include "Optimizer.h"
 
+#include <cstddef>
 #include <exception>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string_view>
 
 #include "BinarySearchOptimizer.h"
+#include "BrentOptimizer.h"
+#include "DynamicProgrammingOptimizer.h"
+#include "EnsembleOptimizer.h"
+#include "LbfgsOptimizer.h"
 #include "LinearSearchOptimizer.h"
+#include "ParetoOptimizer.h"
 #include "RaceConfig/RaceSchedule/RaceSchedule.h"
 #include "RaceConfig/Route/Route.h"
 #include "RaceConfig/Weather/Weather.h"
 #include "SolarCar/SolarCar.h"
+#include "SurrogateOptimizer.h"
 
 namespace {
 	enum class OptimizerType {
 		LinearSearchOptimizer,
 		BinarySearchOptimizer,
+		BrentOptimizer,
+		DynamicProgrammingOptimizer,
+		LbfgsOptimizer,
+		EnsembleMeanOptimizer,
+		EnsembleP90Optimizer,
+		EnsembleFinishOptimizer,
+		ParetoOptimizer,
+		SurrogateOptimizer,
 	};
 
 	OptimizerType get_optimizer_type(const std::string_view name) {
@@ -25,23 +41,99 @@ namespace {
 		if (name == "binary") {
 			return OptimizerType::BinarySearchOptimizer;
 		}
+		if (name == "brent") {
+			return OptimizerType::BrentOptimizer;
+		}
+		if (name == "dp") {
+			return OptimizerType::DynamicProgrammingOptimizer;
+		}
+		if (name == "lbfgs") {
+			return OptimizerType::LbfgsOptimizer;
+		}
+		if (name == "ensemble-mean") {
+			return OptimizerType::EnsembleMeanOptimizer;
+		}
+		if (name == "ensemble-p90") {
+			return OptimizerType::EnsembleP90Optimizer;
+		}
+		if (name == "ensemble-finish") {
+			return OptimizerType::EnsembleFinishOptimizer;
+		}
+		if (name == "pareto") {
+			return OptimizerType::ParetoOptimizer;
+		}
+		if (name == "surrogate") {
+			return OptimizerType::SurrogateOptimizer;
+		}
 		std::cerr << "Invalid Optimizer Type: " << name << "\n";
 		throw std::exception();
 	}
 }  // namespace
 
+std::optional<Optimizer::OptimizationOutput> Optimizer::optimize_race() const {
+	return optimize_race(Clock::time_point::max(), nullptr);
+}
+
+void Optimizer::set_racetime_cache(RaceRunner::RacetimeCache* cache) {
+	racetime_cache = cache;
+}
+
+bool Optimizer::is_past(Clock::time_point deadline) {
+	return deadline != Clock::time_point::max() && Clock::now() >= deadline;
+}
+
 std::unique_ptr<const Optimizer> Optimizer::create_optimizer(const std::string_view optimizer_type,
-	const SolarCar& solarcar, const Weather& weather, const Route& route, const RaceSchedule& schedule) {
+	const SolarCar& solarcar, const Weather& weather, const Route& route, const RaceSchedule& schedule,
+	const size_t num_threads, RaceRunner::RacetimeCache* racetime_cache) {
 	const auto type = get_optimizer_type(optimizer_type);
 
+	std::unique_ptr<Optimizer> optimizer;
 	switch (type) {
 		case OptimizerType::LinearSearchOptimizer: {
-			return std::make_unique<LinearSearchOptimizer>(solarcar, weather, route, schedule);
+			optimizer = std::make_unique<LinearSearchOptimizer>(solarcar, weather, route, schedule, num_threads);
+			break;
 		}
 		case OptimizerType::BinarySearchOptimizer: {
-			return std::make_unique<BinarySearchOptimizer>(solarcar, weather, route, schedule);
+			optimizer = std::make_unique<BinarySearchOptimizer>(solarcar, weather, route, schedule);
+			break;
+		}
+		case OptimizerType::BrentOptimizer: {
+			optimizer = std::make_unique<BrentOptimizer>(solarcar, weather, route, schedule);
+			break;
+		}
+		case OptimizerType::DynamicProgrammingOptimizer: {
+			optimizer = std::make_unique<DynamicProgrammingOptimizer>(solarcar, weather, route, schedule, num_threads);
+			break;
+		}
+		case OptimizerType::LbfgsOptimizer: {
+			optimizer = std::make_unique<LbfgsOptimizer>(solarcar, weather, route, schedule);
+			break;
+		}
+		case OptimizerType::EnsembleMeanOptimizer: {
+			optimizer = std::make_unique<EnsembleOptimizer>(
+				solarcar, weather, route, schedule, EnsembleOptimizer::RiskMetric::MEAN_RACETIME, num_threads);
+			break;
+		}
+		case OptimizerType::EnsembleP90Optimizer: {
+			optimizer = std::make_unique<EnsembleOptimizer>(
+				solarcar, weather, route, schedule, EnsembleOptimizer::RiskMetric::P90_RACETIME, num_threads);
+			break;
+		}
+		case OptimizerType::EnsembleFinishOptimizer: {
+			optimizer = std::make_unique<EnsembleOptimizer>(
+				solarcar, weather, route, schedule, EnsembleOptimizer::RiskMetric::FINISH_PROBABILITY, num_threads);
+			break;
+		}
+		case OptimizerType::ParetoOptimizer: {
+			optimizer = std::make_unique<ParetoOptimizer>(solarcar, weather, route, schedule, num_threads);
+			break;
+		}
+		case OptimizerType::SurrogateOptimizer: {
+			optimizer = std::make_unique<SurrogateOptimizer>(solarcar, weather, route, schedule);
+			break;
 		}
 	}
-	assert(false);
-	return nullptr;
+	assert(optimizer != nullptr);
+	optimizer->set_racetime_cache(racetime_cache);
+	return optimizer;
 }
@@ -1,15 +1,23 @@
 #ifndef MINISIM_OPTIMIZER_H
 #define MINISIM_OPTIMIZER_H
 
+#include <chrono>
+#include <cstddef>
+#include <functional>
 #include <memory>
 #include <optional>
 #include <string_view>
+#include <vector>
 
 #include "RaceConfig/RaceSchedule/RaceSchedule.h"
 #include "RaceConfig/Route/Route.h"
 #include "RaceConfig/Weather/Weather.h"
 #include "SolarCar/SolarCar.h"
 
+namespace RaceRunner {
+	class RacetimeCache;
+}  // namespace RaceRunner
+
 class Optimizer {
    public:
 	Optimizer() = default;
@@ -21,14 +29,66 @@ class Optimizer {
 	Optimizer& operator=(Optimizer&&) = default;
 	Optimizer& operator=(const Optimizer&) = default;
 
+	/// How a solution fares over an ensemble of perturbed weather forecasts.
+	struct EnsembleRisk {
+		/// (seconds) The mean racetime of the forecasts the car finishes in.
+		double mean_racetime;
+		/// (seconds) The racetime the car finishes within in 90% of the forecasts, or infinity if it does not finish in
+		/// that many.
+		double p90_racetime;
+		/// The fraction of the forecasts the car finishes in.
+		double finish_probability;
+		/// The number of forecasts in the ensemble.
+		size_t ensemble_size;
+	};
+
 	struct OptimizationOutput {
 		double racetime;
+		/// (m/s) The speed to race at. For a speed profile, this is the average speed over the route.
 		double speed;
+		/// The number of race simulations (calls to RaceRunner::calculate_racetime) the optimizer ran. Optimizers that
+		/// simulate the route piece by piece count every partial simulation.
+		size_t evaluations = 0;
+		/// The number of route segments the optimizer did not have to simulate, because a race was abandoned as soon
+		/// as it could no longer beat the best racetime found (or could no longer finish).
+		size_t segments_skipped = 0;
+		/// (m/s) The speed to drive each route segment at, indexed by segment. Empty if the whole race is driven at
+		/// @p speed.
+		std::vector<double> speed_profile = {};
+		/// How @p speed fares over the forecast ensemble, for optimizers that search one.
+		std::optional<EnsembleRisk> ensemble_risk = std::nullopt;
+		/// (fraction of capacity) The lowest the battery gets during the race, for optimizers that track it.
+		std::optional<double> minimum_state_of_charge = std::nullopt;
+		/// (fraction of capacity) The charge left in the battery at the finish, for optimizers that track it.
+		std::optional<double> final_state_of_charge = std::nullopt;
+		/// For multi-objective optimizers, every solution found that no other beats on all objectives at once,
+		/// fastest first. This solution is one of them.
+		std::vector<OptimizationOutput> pareto_front = {};
 	};
 
+	/// The clock deadlines are measured on.
+	using Clock = std::chrono::steady_clock;
+
+	/// Called with every solution that beats the best one found so far, as soon as it is found. Never called from two
+	/// threads at once.
+	using ProgressCallback = std::function<void(const OptimizationOutput& solution)>;
+
 	/// Using a heuristic, optimizes the entire race.
 	/// @returns The optimized output result.
-	virtual std::optional<OptimizationOutput> optimize_race() const = 0;
+	std::optional<OptimizationOutput> optimize_race() const;
+
+	/// Optimizes the entire race like optimize_race(), but gives up at @p deadline and returns the best solution found
+	/// by then. Simulations still running at the deadline are abandoned, so this returns shortly after it.
+	///
+	/// @param [in] deadline When to stop searching. Clock::time_point::max() searches to completion.
+	/// @param [in] progress_callback Told about every improving solution as it is found. May be empty.
+	/// @returns The best solution found before @p deadline, or std::nullopt if none was found in time.
+	virtual std::optional<OptimizationOutput> optimize_race(
+		Clock::time_point deadline, const ProgressCallback& progress_callback) const = 0;
+
+	/// @brief Looks constant speed races up in @p cache before simulating them, and remembers them there. The cache
+	/// must be for the same car, weather, route and schedule, and outlive the optimizer. nullptr simulates every race.
+	void set_racetime_cache(RaceRunner::RacetimeCache* cache);
 
 	// Factory Methods
 	/// Creates an Optimizer from a Config File.
@@ -38,10 +98,21 @@ class Optimizer {
 	/// @param [in] weather The weather forecast for the race.
 	/// @param [in] route The route we're racinga long.
 	/// @param [in] schedule The schedule that we're racing with.
+	/// @param [in] num_threads The number of threads the optimizer may use. 0 means every hardware thread. Optimizers
+	/// that are inherently serial ignore this.
+	/// @param [in] racetime_cache Where to look up constant speed races, as in set_racetime_cache. May be nullptr.
 	///
 	/// @returns The created optimizer.
 	static std::unique_ptr<const Optimizer> create_optimizer(std::string_view optimizer_type, const SolarCar& solarcar,
-		const Weather& weather, const Route& route, const RaceSchedule& schedule);
+		const Weather& weather, const Route& route, const RaceSchedule& schedule, size_t num_threads = 1,
+		RaceRunner::RacetimeCache* racetime_cache = nullptr);
+
+   protected:
+	/// @returns Whether @p deadline has passed. Never true for Clock::time_point::max(), without reading the clock.
+	static bool is_past(Clock::time_point deadline);
+
+	/// The cache constant speed races go through, or nullptr to simulate every one.
+	RaceRunner::RacetimeCache* racetime_cache = nullptr;
 };
 
 #endif  // MINISIM_OPTIMIZER_H
@@ -0,0 +1,343 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "BinarySearchOptimizer.h"
+#include "BrentOptimizer.h"
+#include "DynamicProgrammingOptimizer.h"
+#include "EnsembleOptimizer.h"
+#include "LbfgsOptimizer.h"
+#include "LinearSearchOptimizer.h"
+#include "ParetoOptimizer.h"
+#include "RaceRunner/RaceRunner.h"
+#include "RaceRunner/RacetimeCache.h"
+#include "SurrogateOptimizer.h"
+#include "Tools/RootDirectory.h"
+
+using Catch::Matchers::WithinAbs;
+using Catch::Matchers::WithinRel;
+
+namespace {
+	const std::string root_directory = get_root_directory();
+	const std::string route_file = root_directory + "/data/Route/route.csv";
+	const std::string weather_file = root_directory + "/data/Weather/Australia/August/2007.csv";
+	const std::string schedule_file = root_directory + "/data/Schedule/August/Schedule2007.toml";
+	const std::string weather_stations_file = root_directory + "/data/Stations/australia_stations.csv";
+	const std::string car_file = root_directory + "/data/Cars/mini-car.toml";
+
+	/// @returns The first @p num_days days of the schedule in schedule_file.
+	RaceSchedule get_first_days(size_t num_days) {
+		std::ifstream stream(schedule_file);
+		std::stringstream contents;
+		contents << stream.rdbuf();
+		const std::string toml = contents.str();
+		size_t end = 0;
+		for (size_t day = 0; day <= num_days && end != std::string::npos; ++day) {
+			end = toml.find("[[schedule]]", end + 1);
+		}
+		return RaceSchedule(ConfigFile::from_toml(toml.substr(0, end)).value());
+	}
+
+	struct Bisection {
+		std::optional<double> speed;
+		std::optional<double> racetime;
+		size_t evaluations = 0;
+		size_t num_pruned = 0;
+	};
+
+	/// Bisects like BinarySearchOptimizer, but on races that are always simulated to the end.
+	Bisection bisect(const SolarCar& car, const Route& route, const Weather& weather, const RaceSchedule& schedule) {
+		Bisection bisection;
+		double low = 5;
+		double high = 50;
+		while (high - low > 0.1) {
+			const double mid = (low + high) / 2;
+			const std::optional<double> racetime = RaceRunner::calculate_racetime(car, route, weather, schedule, mid);
+			const auto bounded = RaceRunner::calculate_racetime(
+				car, route, weather, schedule, mid, std::numeric_limits<double>::infinity());
+			REQUIRE(bounded.racetime == racetime);
+			bisection.evaluations++;
+			bisection.num_pruned += bounded.pruned ? 1 : 0;
+			if (racetime.has_value()) {
+				bisection.speed = mid;
+				bisection.racetime = racetime;
+				low = mid;
+			} else {
+				high = mid;
+			}
+		}
+		return bisection;
+	}
+}  // namespace
+
+TEST_CASE("BinarySearchOptimizer: pruned races steer the bisection like unpruned ones", "[BinarySearchOptimizer]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+
+	SECTION("A schedule the car can finish") {
+		const RaceSchedule schedule = get_first_days(7);
+		const Bisection expected = bisect(car, route, weather, schedule);
+		REQUIRE(expected.speed.has_value());
+
+		const auto output = BinarySearchOptimizer(car, weather, route, schedule).optimize_race();
+		REQUIRE(output.has_value());
+		REQUIRE(output->speed == expected.speed.value());
+		REQUIRE(output->racetime == expected.racetime.value());
+		REQUIRE(output->evaluations == expected.evaluations);
+	}
+
+	SECTION("A schedule too short to finish, so races are pruned partway through the bisection") {
+		const RaceSchedule schedule = get_first_days(6);
+		const Bisection expected = bisect(car, route, weather, schedule);
+		REQUIRE(expected.num_pruned > 0);
+		REQUIRE_FALSE(expected.speed.has_value());
+
+		REQUIRE_FALSE(BinarySearchOptimizer(car, weather, route, schedule).optimize_race().has_value());
+	}
+}
+
+TEST_CASE("LbfgsOptimizer: the profile beats the best constant speed capped at the speed limits", "[LbfgsOptimizer]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+
+	const auto constant_speed = BrentOptimizer(car, weather, route, schedule).optimize_race();
+	REQUIRE(constant_speed.has_value());
+	std::vector<double> capped_profile(route.get_num_segments());
+	for (size_t i = 0; i < capped_profile.size(); ++i) {
+		capped_profile[i] = std::min(constant_speed->speed, route.get_segment(i).speed_limit);
+	}
+	const auto baseline = RaceRunner::calculate_racetime(car, route, weather, schedule, capped_profile);
+	REQUIRE(baseline.has_value());
+
+	const auto output = LbfgsOptimizer(car, weather, route, schedule).optimize_race();
+	REQUIRE(output.has_value());
+	REQUIRE(output->speed_profile.size() == route.get_num_segments());
+	REQUIRE(output->racetime < baseline.value());
+	// The profile must be what was raced
+	REQUIRE(RaceRunner::calculate_racetime(car, route, weather, schedule, output->speed_profile) == output->racetime);
+}
+
+TEST_CASE("DynamicProgrammingOptimizer: the profile is no worse than the best of its constant speeds",
+	"[DynamicProgrammingOptimizer]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+
+	// Every candidate speed of the DP, held for the whole race and capped at the speed limits like its blocks are
+	std::optional<double> baseline;
+	for (double speed = 5; speed <= 50; speed += 1) {
+		std::vector<double> capped_profile(route.get_num_segments());
+		for (size_t i = 0; i < capped_profile.size(); ++i) {
+			capped_profile[i] = std::min(speed, route.get_segment(i).speed_limit);
+		}
+		const auto racetime = RaceRunner::calculate_racetime(car, route, weather, schedule, capped_profile);
+		if (racetime.has_value() && (!baseline.has_value() || racetime.value() < baseline.value())) {
+			baseline = racetime;
+		}
+	}
+	REQUIRE(baseline.has_value());
+
+	const auto output = DynamicProgrammingOptimizer(car, weather, route, schedule).optimize_race();
+	REQUIRE(output.has_value());
+	REQUIRE(output->speed_profile.size() == route.get_num_segments());
+	REQUIRE(output->racetime <= baseline.value());
+	// The profile must be what was raced
+	REQUIRE(RaceRunner::calculate_racetime(car, route, weather, schedule, output->speed_profile) == output->racetime);
+}
+
+TEST_CASE("BrentOptimizer: finds the linear search's optimum", "[BrentOptimizer]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+
+	const auto linear = LinearSearchOptimizer(car, weather, route, schedule).optimize_race();
+	REQUIRE(linear.has_value());
+	const auto output = BrentOptimizer(car, weather, route, schedule).optimize_race();
+	REQUIRE(output.has_value());
+	// The linear search only tries every 0.1 m/s, so Brent's optimum lies between its optimum and the next speed it
+	// tried, give or take Brent's precision of 0.01 m/s, and races no slower
+	REQUIRE(output->speed >= linear->speed - 0.01);
+	REQUIRE(output->speed <= linear->speed + 0.1 + 0.01);
+	REQUIRE(output->racetime <= linear->racetime);
+	REQUIRE(output->evaluations < linear->evaluations / 4);
+	REQUIRE(RaceRunner::calculate_racetime(car, route, weather, schedule, output->speed) == output->racetime);
+}
+
+TEST_CASE("BrentOptimizer: gives up on a schedule no speed finishes in a few dozen races", "[BrentOptimizer]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	// The race takes into its fifth day at any speed
+	const RaceSchedule schedule = get_first_days(4);
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	REQUIRE_FALSE(LinearSearchOptimizer(car, weather, route, schedule).optimize_race().has_value());
+
+	// Counts the races simulated, as an in-memory cache never hits on speeds it has not seen
+	RaceRunner::RacetimeCache cache(0);
+	BrentOptimizer optimizer(car, weather, route, schedule);
+	optimizer.set_racetime_cache(&cache);
+	REQUIRE_FALSE(optimizer.optimize_race().has_value());
+	REQUIRE(cache.get_hits() == 0);
+	REQUIRE(cache.get_misses() > 0);
+	REQUIRE(cache.get_misses() <= 65);
+}
+
+TEST_CASE("ParetoOptimizer: the front is non-dominated, fastest first, and led by the linear search's optimum",
+	"[ParetoOptimizer]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+
+	const auto output = ParetoOptimizer(car, weather, route, schedule).optimize_race();
+	REQUIRE(output.has_value());
+	const std::vector<Optimizer::OptimizationOutput>& front = output->pareto_front;
+	REQUIRE(front.size() > 1);
+
+	const auto dominates = [](const Optimizer::OptimizationOutput& lhs, const Optimizer::OptimizationOutput& rhs) {
+		const double lhs_minimum = lhs.minimum_state_of_charge.value();
+		const double rhs_minimum = rhs.minimum_state_of_charge.value();
+		const double lhs_final = lhs.final_state_of_charge.value();
+		const double rhs_final = rhs.final_state_of_charge.value();
+		return lhs.racetime <= rhs.racetime && lhs_minimum >= rhs_minimum && lhs_final >= rhs_final &&
+			   (lhs.racetime < rhs.racetime || lhs_minimum > rhs_minimum || lhs_final > rhs_final);
+	};
+	for (size_t i = 0; i < front.size(); ++i) {
+		for (size_t j = 0; j < front.size(); ++j) {
+			REQUIRE_FALSE(dominates(front[i], front[j]));
+		}
+		if (i > 0) {
+			REQUIRE(front[i - 1].racetime <= front[i].racetime);
+		}
+	}
+
+	const auto linear = LinearSearchOptimizer(car, weather, route, schedule).optimize_race();
+	REQUIRE(linear.has_value());
+	REQUIRE(output->racetime == linear->racetime);
+	REQUIRE(output->speed == linear->speed);
+	REQUIRE(front.front().racetime == linear->racetime);
+}
+
+TEST_CASE("SurrogateOptimizer: stays within its evaluation cap and finds the linear search's optimum",
+	"[SurrogateOptimizer]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	// The most races the optimizer simulates
+	constexpr size_t max_evaluations = 60;
+	// (seconds) The expected improvement the optimizer stops searching below
+	constexpr double improvement_tolerance = 1;
+
+	SECTION("A schedule the car can finish") {
+		const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+		const auto linear = LinearSearchOptimizer(car, weather, route, schedule).optimize_race();
+		REQUIRE(linear.has_value());
+
+		// Counts the races simulated, as an in-memory cache never hits on speeds it has not seen
+		RaceRunner::RacetimeCache cache(0);
+		SurrogateOptimizer optimizer(car, weather, route, schedule);
+		optimizer.set_racetime_cache(&cache);
+		const auto output = optimizer.optimize_race();
+		REQUIRE(output.has_value());
+		REQUIRE(cache.get_misses() <= max_evaluations);
+		REQUIRE(output->evaluations == cache.get_misses() + cache.get_hits());
+		REQUIRE(output->racetime <= linear->racetime + improvement_tolerance);
+		REQUIRE(RaceRunner::calculate_racetime(car, route, weather, schedule, output->speed) == output->racetime);
+	}
+
+	SECTION("A schedule no speed finishes, where the models never find a racetime to improve on") {
+		const RaceSchedule schedule = get_first_days(4);
+		RaceRunner::RacetimeCache cache(0);
+		SurrogateOptimizer optimizer(car, weather, route, schedule);
+		optimizer.set_racetime_cache(&cache);
+		REQUIRE_FALSE(optimizer.optimize_race().has_value());
+		REQUIRE(cache.get_misses() > 0);
+		REQUIRE(cache.get_misses() <= max_evaluations);
+	}
+}
+
+TEST_CASE("EnsembleOptimizer: the ensemble's risk is reproducible and consistent", "[EnsembleOptimizer]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	constexpr size_t ensemble_size = 16;
+	constexpr uint64_t seed = 2007;
+
+	SECTION("The same seed gives bit-identical risks, on any number of threads") {
+		for (const auto risk_metric : {EnsembleOptimizer::RiskMetric::MEAN_RACETIME,
+				 EnsembleOptimizer::RiskMetric::P90_RACETIME, EnsembleOptimizer::RiskMetric::FINISH_PROBABILITY}) {
+			const auto output =
+				EnsembleOptimizer(car, weather, route, schedule, risk_metric, 1, ensemble_size, seed).optimize_race();
+			const auto repeated =
+				EnsembleOptimizer(car, weather, route, schedule, risk_metric, 3, ensemble_size, seed).optimize_race();
+			REQUIRE(output.has_value());
+			REQUIRE(repeated.has_value());
+			const Optimizer::EnsembleRisk& risk = output->ensemble_risk.value();
+			const Optimizer::EnsembleRisk& repeated_risk = repeated->ensemble_risk.value();
+			REQUIRE(repeated->speed == output->speed);
+			REQUIRE(repeated->racetime == output->racetime);
+			REQUIRE(repeated_risk.mean_racetime == risk.mean_racetime);
+			REQUIRE(repeated_risk.p90_racetime == risk.p90_racetime);
+			REQUIRE(repeated_risk.finish_probability == risk.finish_probability);
+			REQUIRE(risk.ensemble_size == ensemble_size);
+
+			// The slowest 10% of the members are at least as slow as the average one
+			REQUIRE(risk.p90_racetime >= risk.mean_racetime);
+		}
+	}
+
+	SECTION("An ensemble without any forecast error is the forecast itself") {
+		const auto linear = LinearSearchOptimizer(car, weather, route, schedule).optimize_race();
+		REQUIRE(linear.has_value());
+		const ForecastError no_error{.irradiance = 0, .wind = 0, .air_density = 0};
+		const auto output = EnsembleOptimizer(car, weather, route, schedule,
+			EnsembleOptimizer::RiskMetric::MEAN_RACETIME, 1, ensemble_size, seed, no_error)
+								.optimize_race();
+		REQUIRE(output.has_value());
+		const Optimizer::EnsembleRisk& risk = output->ensemble_risk.value();
+		REQUIRE(risk.finish_probability == 1);
+		// Every member races exactly like the forecast, so only the sum of the mean rounds
+		REQUIRE(risk.p90_racetime == linear->racetime);
+		REQUIRE_THAT(risk.mean_racetime, WithinRel(linear->racetime, 1e-12));
+		// The fine sweep's speeds are offsets from a coarse speed, rather than steps from the minimum speed
+		REQUIRE_THAT(output->speed, WithinAbs(linear->speed, 1e-9));
+	}
+}
+
+TEST_CASE("LinearSearchOptimizer: any number of threads finds exactly the serial optimum", "[LinearSearchOptimizer]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+
+	const auto serial = LinearSearchOptimizer(car, weather, route, schedule, 1).optimize_race();
+	REQUIRE(serial.has_value());
+	for (const size_t num_threads : {2, 3, 4, 8}) {
+		const auto parallel = LinearSearchOptimizer(car, weather, route, schedule, num_threads).optimize_race();
+		REQUIRE(parallel.has_value());
+		REQUIRE(parallel->speed == serial->speed);
+		REQUIRE(parallel->racetime == serial->racetime);
+	}
+}
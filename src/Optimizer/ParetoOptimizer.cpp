@@ -0,0 +1,85 @@
+#include "ParetoOptimizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "RaceRunner/RaceRunner.h"
+#include "Tools/ThreadPool.h"
+
+ParetoOptimizer::ParetoOptimizer(const SolarCar& car, const Weather& weather, const Route& route,
+	const RaceSchedule& schedule, size_t num_threads)
+	: car(car), weather(weather), route(route), schedule(schedule), num_threads(num_threads) {}
+
+bool ParetoOptimizer::dominates(const OptimizationOutput& lhs, const OptimizationOutput& rhs) {
+	const double lhs_minimum = lhs.minimum_state_of_charge.value();
+	const double rhs_minimum = rhs.minimum_state_of_charge.value();
+	const double lhs_final = lhs.final_state_of_charge.value();
+	const double rhs_final = rhs.final_state_of_charge.value();
+	return lhs.racetime <= rhs.racetime && lhs_minimum >= rhs_minimum && lhs_final >= rhs_final &&
+		   (lhs.racetime < rhs.racetime || lhs_minimum > rhs_minimum || lhs_final > rhs_final);
+}
+
+std::optional<Optimizer::OptimizationOutput> ParetoOptimizer::optimize_race(
+	Clock::time_point deadline, const ProgressCallback& progress_callback) const {
+	// The same candidates as the linear search, so its answer is always on the front
+	std::vector<double> speeds;
+	for (double speed = minimum_speed; speed <= maximum_speed; speed += speed_step) {
+		speeds.push_back(speed);
+	}
+
+	// The Pareto front of the races finished so far. Being non-dominated does not depend on the order races are added
+	// in, so the final front is the same whatever order the threads finish in.
+	std::vector<OptimizationOutput> front;
+	std::mutex front_mutex;
+	std::atomic<size_t> evaluations = 0;
+	double best_racetime = std::numeric_limits<double>::infinity();
+	ThreadPool pool(num_threads);
+	pool.parallel_for(speeds.size(), [&](size_t i) {
+		if (is_past(deadline)) {
+			return;
+		}
+		const auto summary = RaceRunner::calculate_race_summary(car, route, weather, schedule, speeds[i]);
+		++evaluations;
+		if (!summary.has_value()) {
+			return;
+		}
+
+		OptimizationOutput candidate{
+			.racetime = summary->racetime,
+			.speed = speeds[i],
+			.minimum_state_of_charge = summary->minimum_state_of_charge,
+			.final_state_of_charge = summary->final_state_of_charge,
+		};
+		const std::lock_guard<std::mutex> lock(front_mutex);
+		if (std::any_of(front.begin(), front.end(),
+				[&](const OptimizationOutput& member) { return dominates(member, candidate); })) {
+			return;
+		}
+		std::erase_if(front, [&](const OptimizationOutput& member) { return dominates(candidate, member); });
+		front.push_back(candidate);
+
+		if (progress_callback && candidate.racetime < best_racetime) {
+			best_racetime = candidate.racetime;
+			candidate.evaluations = evaluations.load();
+			progress_callback(candidate);
+		}
+	});
+
+	if (front.empty()) {
+		return std::nullopt;
+	}
+	// Fastest first; ties go to the slowest speed, as in the linear search
+	std::sort(front.begin(), front.end(), [](const OptimizationOutput& lhs, const OptimizationOutput& rhs) {
+		return lhs.racetime != rhs.racetime ? lhs.racetime < rhs.racetime : lhs.speed < rhs.speed;
+	});
+
+	OptimizationOutput best_output = front.front();
+	best_output.evaluations = evaluations.load();
+	best_output.pareto_front = std::move(front);
+	return best_output;
+}
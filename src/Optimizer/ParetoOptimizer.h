@@ -0,0 +1,49 @@
+#ifndef MINISIM_PARETOOPTIMIZER_H
+#define MINISIM_PARETOOPTIMIZER_H
+
+#include <cstddef>
+#include <optional>
+
+#include "Optimizer.h"
+#include "RaceConfig/RaceSchedule/RaceSchedule.h"
+#include "RaceConfig/Route/Route.h"
+#include "RaceConfig/Weather/Weather.h"
+#include "SolarCar/SolarCar.h"
+
+/// Finds the trade-off between racetime and the charge left in the battery, over constant speeds.
+///
+/// Sweeps the same candidate speeds as the linear search optimizer, in parallel, and keeps the Pareto front of
+/// (racetime, minimum state of charge, final state of charge): every speed that no other speed beats on all three at
+/// once. The front is updated as each race finishes, so a dominated race is dropped straight away and the front never
+/// holds more than the races that are still worth comparing against.
+///
+/// The fastest race on the front is returned, with the whole front in OptimizationOutput::pareto_front.
+class ParetoOptimizer : public Optimizer {
+   public:
+	/// @param [in] num_threads The number of threads to evaluate candidate speeds on. 0 means every hardware thread.
+	explicit ParetoOptimizer(const SolarCar& car, const Weather& weather, const Route& route,
+		const RaceSchedule& schedule, size_t num_threads = 1);
+
+	using Optimizer::optimize_race;
+	std::optional<Optimizer::OptimizationOutput> optimize_race(
+		Clock::time_point deadline, const ProgressCallback& progress_callback) const override;
+
+   private:
+	const SolarCar& car;
+	const Weather& weather;
+	const Route& route;
+	const RaceSchedule& schedule;
+	/// The number of threads the candidate speeds are spread over.
+	size_t num_threads;
+	/// The minimum speed we want to go at.
+	static constexpr double minimum_speed = 5;  // mps
+	/// The maximum speed we're allowed to go at.
+	static constexpr double maximum_speed = 50;  // mps
+	/// The precision we're searching at.
+	static constexpr double speed_step = 0.1;
+
+	/// @returns Whether @p lhs is at least as good as @p rhs on every objective, and better on at least one.
+	static bool dominates(const OptimizationOutput& lhs, const OptimizationOutput& rhs);
+};
+
+#endif  // MINISIM_PARETOOPTIMIZER_H
@@ -0,0 +1,190 @@
+#include "SurrogateOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <numbers>
+#include <optional>
+#include <vector>
+
+#include "RaceRunner/RaceRunner.h"
+#include "RaceRunner/RacetimeCache.h"
+#include "alglib/ap.h"
+#include "alglib/interpolation.h"
+
+namespace {
+	/// @returns A thin plate spline RBF through (@p speeds [i], @p values [i]).
+	alglib::rbfmodel fit_rbf(const std::vector<double>& speeds, const std::vector<double>& values) {
+		alglib::real_2d_array points;
+		points.setlength(static_cast<alglib::ae_int_t>(speeds.size()), 2);
+		for (size_t i = 0; i < speeds.size(); ++i) {
+			points(static_cast<alglib::ae_int_t>(i), 0) = speeds[i];
+			points(static_cast<alglib::ae_int_t>(i), 1) = values[i];
+		}
+		alglib::rbfmodel model;
+		alglib::rbfcreate(1, 1, model);
+		alglib::rbfsetpoints(model, points);
+		alglib::rbfsetalgothinplatespline(model, 0.0);
+		alglib::rbfreport report;
+		alglib::rbfbuildmodel(model, report);
+		return model;
+	}
+
+	/// @returns The expected amount by which a normally distributed racetime with mean @p mean and standard deviation
+	/// @p deviation beats @p best_racetime.
+	double expected_improvement(double mean, double deviation, double best_racetime) {
+		if (deviation <= 0) {
+			return std::max(best_racetime - mean, 0.0);
+		}
+		const double z = (best_racetime - mean) / deviation;
+		const double cumulative = 0.5 * std::erfc(-z / std::numbers::sqrt2);
+		const double density = std::exp(-0.5 * z * z) / std::sqrt(2 * std::numbers::pi);
+		return (best_racetime - mean) * cumulative + deviation * density;
+	}
+}  // namespace
+
+SurrogateOptimizer::SurrogateOptimizer(
+	const SolarCar& car, const Weather& weather, const Route& route, const RaceSchedule& schedule)
+	: car(car), weather(weather), route(route), schedule(schedule) {}
+
+bool SurrogateOptimizer::evaluate(Search& search, double speed) const {
+	if (is_past(search.deadline)) {
+		return false;
+	}
+
+	const auto out_of_time = [&search](const RaceRunner::RaceProgress& /*progress*/) {
+		return is_past(search.deadline);
+	};
+	const auto result = RaceRunner::calculate_racetime(
+		racetime_cache, car, route, weather, schedule, speed, std::numeric_limits<double>::infinity(), out_of_time);
+	if (result.pruned && is_past(search.deadline)) {
+		// Ran out of time part way through: the speed might still finish, so do not remember it as infeasible
+		return false;
+	}
+
+	const auto& race_time = result.racetime;
+	search.evaluations.emplace(speed, race_time);
+	if (race_time.has_value() && race_time.value() < search.best_racetime) {
+		search.best_racetime = race_time.value();
+		search.best_speed = speed;
+		if (search.progress_callback) {
+			search.progress_callback(OptimizationOutput{
+				.racetime = race_time.value(),
+				.speed = speed,
+				.evaluations = search.evaluations.size(),
+			});
+		}
+	}
+	return true;
+}
+
+std::optional<double> SurrogateOptimizer::next_speed(const Search& search) const {
+	std::vector<double> speeds;
+	std::vector<double> feasibility;
+	std::vector<double> feasible_speeds;
+	std::vector<double> racetimes;
+	for (const auto& [speed, race_time] : search.evaluations) {
+		speeds.push_back(speed);
+		feasibility.push_back(race_time.has_value() ? 1 : -1);
+		if (race_time.has_value()) {
+			feasible_speeds.push_back(speed);
+			racetimes.push_back(race_time.value());
+		}
+	}
+	// Linear in between simulated speeds, so a classifier that is sure on both sides of an interval stays sure across
+	// it: an RBF through the same labels overshoots, and sends the search to speeds known to be hopeless
+	alglib::real_1d_array speeds_array;
+	alglib::real_1d_array feasibility_array;
+	speeds_array.setcontent(static_cast<alglib::ae_int_t>(speeds.size()), speeds.data());
+	feasibility_array.setcontent(static_cast<alglib::ae_int_t>(feasibility.size()), feasibility.data());
+	alglib::spline1dinterpolant classifier;
+	alglib::spline1dbuildlinear(speeds_array, feasibility_array, classifier);
+
+	// The racetime surrogate, and a linear spline through the same racetimes as a second opinion. Where the two
+	// disagree the racetime is uncertain; at simulated speeds they agree exactly. Both need two speeds that finished
+	std::optional<alglib::rbfmodel> surrogate;
+	alglib::spline1dinterpolant second_opinion;
+	if (feasible_speeds.size() >= 2) {
+		surrogate = fit_rbf(feasible_speeds, racetimes);
+		alglib::real_1d_array feasible_speeds_array;
+		alglib::real_1d_array racetimes_array;
+		feasible_speeds_array.setcontent(static_cast<alglib::ae_int_t>(feasible_speeds.size()), feasible_speeds.data());
+		racetimes_array.setcontent(static_cast<alglib::ae_int_t>(racetimes.size()), racetimes.data());
+		alglib::spline1dbuildlinear(feasible_speeds_array, racetimes_array, second_opinion);
+	}
+
+	std::optional<double> best_candidate;
+	double best_acquisition = 0;
+	const auto num_candidates = static_cast<size_t>(std::round((maximum_speed - minimum_speed) / precision));
+	for (size_t i = 0; i <= num_candidates; ++i) {
+		const double speed = minimum_speed + static_cast<double>(i) * precision;
+
+		// The distance to the closest simulated speed
+		const auto above = search.evaluations.lower_bound(speed);
+		double distance = std::numeric_limits<double>::infinity();
+		if (above != search.evaluations.end()) {
+			distance = above->first - speed;
+		}
+		if (above != search.evaluations.begin()) {
+			distance = std::min(distance, speed - std::prev(above)->first);
+		}
+		if (distance < precision / 2) {
+			continue;
+		}
+
+		const double finish_probability = std::clamp((alglib::spline1dcalc(classifier, speed) + 1) / 2, 0.0, 1.0);
+		double acquisition = 0;
+		if (!search.best_speed.has_value()) {
+			// Nothing finished yet, so the classifier knows nothing: split the widest gap between simulated speeds
+			acquisition = distance;
+		} else {
+			// With one racetime known, the uncertainty grows with the distance from it by a racetime per speed range
+			double mean = search.best_racetime;
+			double deviation = distance * search.best_racetime / (maximum_speed - minimum_speed);
+			if (surrogate.has_value()) {
+				mean = alglib::rbfcalc1(surrogate.value(), speed);
+				deviation = std::abs(mean - alglib::spline1dcalc(second_opinion, speed));
+			}
+			acquisition = finish_probability * expected_improvement(mean, deviation, search.best_racetime);
+		}
+		if (acquisition > best_acquisition) {
+			best_acquisition = acquisition;
+			best_candidate = speed;
+		}
+	}
+
+	if (search.best_speed.has_value() && best_acquisition < improvement_tolerance) {
+		return std::nullopt;
+	}
+	return best_candidate;
+}
+
+std::optional<Optimizer::OptimizationOutput> SurrogateOptimizer::optimize_race(
+	Clock::time_point deadline, const ProgressCallback& progress_callback) const {
+	Search search{.evaluations = {}, .deadline = deadline, .progress_callback = progress_callback};
+
+	const double spacing = (maximum_speed - minimum_speed) / static_cast<double>(initial_samples - 1);
+	for (size_t i = 0; i < initial_samples; ++i) {
+		if (!evaluate(search, minimum_speed + static_cast<double>(i) * spacing)) {
+			break;
+		}
+	}
+
+	while (search.evaluations.size() < max_evaluations && !is_past(deadline)) {
+		const std::optional<double> speed = next_speed(search);
+		if (!speed.has_value() || !evaluate(search, speed.value())) {
+			break;
+		}
+	}
+
+	if (!search.best_speed.has_value()) {
+		return std::nullopt;
+	}
+	return OptimizationOutput{
+		.racetime = search.best_racetime,
+		.speed = search.best_speed.value(),
+		.evaluations = search.evaluations.size(),
+	};
+}
@@ -0,0 +1,38 @@
+#include "CompiledRoute.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+CompiledRoute::CompiledRoute(std::span<const RouteSegment> segments) {
+	const size_t num_segments = segments.size();
+	distance.reserve(num_segments);
+	cos_heading.reserve(num_segments);
+	sin_heading.reserve(num_segments);
+	gravity.reserve(num_segments);
+	gravity_times_sine_road_incline_angle.reserve(num_segments);
+	weather_station.reserve(num_segments);
+	end_flags.reserve(num_segments);
+
+	for (const RouteSegment& segment : segments) {
+		distance.push_back(segment.distance);
+		cos_heading.push_back(std::cos(segment.heading));
+		sin_heading.push_back(std::sin(segment.heading));
+		gravity.push_back(segment.gravity);
+		gravity_times_sine_road_incline_angle.push_back(segment.gravity_times_sine_road_incline_angle);
+		weather_station.push_back(segment.weather_station);
+
+		uint8_t flags = 0;
+		if (segment.end_condition == SegmentEndCondition::CONTROL_STOP) {
+			flags |= ENDS_IN_CONTROL_STOP;
+		} else if (segment.end_condition == SegmentEndCondition::END_OF_RACE) {
+			flags |= ENDS_RACE;
+		}
+		end_flags.push_back(flags);
+	}
+}
+
+size_t CompiledRoute::size() const {
+	return distance.size();
+}
@@ -0,0 +1,46 @@
+#ifndef MINISIM_COMPILEDROUTE_H
+#define MINISIM_COMPILEDROUTE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "RouteSegment.h"
+
+/// @brief The fields of a route's segments that the race loop reads, one contiguous array per field.
+///
+/// A RouteSegment carries coordinates, elevation, grade and angles the race loop never looks at. Streaming through
+/// these arrays instead reads only the bytes it needs, in order, and the heading comes with its cosine and sine
+/// already worked out.
+struct CompiledRoute {
+	/// Bits of end_flags.
+	enum EndFlag : uint8_t {
+		/// The segment ends in a control stop.
+		ENDS_IN_CONTROL_STOP = 1U << 0U,
+		/// The segment ends the race.
+		ENDS_RACE = 1U << 1U,
+	};
+
+	CompiledRoute() = default;
+	explicit CompiledRoute(std::span<const RouteSegment> segments);
+
+	size_t size() const;
+
+	/// (m) The distance of each segment.
+	std::vector<double> distance;
+	/// The cosine of each segment's heading.
+	std::vector<double> cos_heading;
+	/// The sine of each segment's heading.
+	std::vector<double> sin_heading;
+	/// (m/s^2) The acceleration due to gravity on each segment.
+	std::vector<double> gravity;
+	/// (m/s^2) The acceleration due to gravity times the sine of each segment's incline.
+	std::vector<double> gravity_times_sine_road_incline_angle;
+	/// The weighted average weather station of each segment.
+	std::vector<double> weather_station;
+	/// The EndFlag bits of each segment.
+	std::vector<uint8_t> end_flags;
+};
+
+#endif  // MINISIM_COMPILEDROUTE_H
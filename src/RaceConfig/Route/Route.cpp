@@ -1,5 +1,9 @@
 #include "Route.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numbers>
 #include <numeric>
 #include <ranges>
 #include <span>
@@ -98,6 +102,7 @@ Route::Route(std::string_view route_file, WeatherStations weather_stations)
 		total_distance += segment.distance;
 		segments.push_back(segment);
 	}
+	compiled = CompiledRoute(segments);
 }
 
 RouteSegment Route::get_segment(size_t index) const {
@@ -116,6 +121,10 @@ std::span<const RouteSegment> Route::get_segments_span() const {
 	return segments;
 }
 
+const CompiledRoute& Route::get_compiled() const {
+	return compiled;
+}
+
 size_t Route::get_num_segments() const {
 	return segments.size();
 }
@@ -142,3 +151,139 @@ double Route::get_distance_between(size_t index1, size_t index2) const {
 	return std::accumulate(
 		range.begin(), range.end(), 0.0, [this](double sum, size_t index) { return sum + segments[index].distance; });
 }
+
+std::vector<size_t> Route::split_into_blocks(double block_length) const {
+	const size_t num_segments = segments.size();
+
+	std::vector<size_t> block_starts = {0};
+	double distance = 0;
+	for (size_t i = 0; i < num_segments; ++i) {
+		const RouteSegment& segment = segments[i];
+		distance += segment.distance;
+		const bool last_segment = i + 1 == num_segments;
+		if (!last_segment && (distance >= block_length || segment.end_condition == SegmentEndCondition::CONTROL_STOP)) {
+			block_starts.push_back(i + 1);
+			distance = 0;
+		}
+	}
+	block_starts.push_back(num_segments);
+	return block_starts;
+}
+
+namespace {
+	/// @returns Whether a run of merged segments must end after @p segment.
+	bool ends_run(const RouteSegment& segment) {
+		switch (segment.end_condition) {
+			case SegmentEndCondition::CONTROL_STOP:
+			case SegmentEndCondition::END_OF_RACE:
+			case SegmentEndCondition::FINISH_LINE:
+			case SegmentEndCondition::SPEED_LIMIT_CHANGE:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	/// @returns (radians) The smallest angle between headings @p lhs and @p rhs.
+	double heading_difference(double lhs, double rhs) {
+		const double difference = std::fmod(std::abs(lhs - rhs), 2 * std::numbers::pi);
+		return std::min(difference, 2 * std::numbers::pi - difference);
+	}
+
+	/// @returns One segment equivalent to driving @p run.
+	RouteSegment merge(std::span<const RouteSegment> run) {
+		assert(!run.empty());
+		const RouteSegment& first = run.front();
+		const RouteSegment& last = run.back();
+
+		double distance = 0;
+		double heading_x = 0;
+		double heading_y = 0;
+		double elevation = 0;
+		double weather_station = 0;
+		double gravity = 0;
+		double gravity_times_sine = 0;
+		for (const RouteSegment& segment : run) {
+			distance += segment.distance;
+			heading_x += segment.distance * std::cos(segment.heading);
+			heading_y += segment.distance * std::sin(segment.heading);
+			elevation += segment.distance * segment.elevation;
+			weather_station += segment.distance * segment.weather_station;
+			gravity += segment.distance * segment.gravity;
+			gravity_times_sine += segment.distance * segment.gravity_times_sine_road_incline_angle;
+		}
+		if (distance <= 0) {
+			return last;
+		}
+		gravity /= distance;
+		gravity_times_sine /= distance;
+
+		// The average of gravity times the sine of the incline, rather than of the incline, keeps the work against
+		// gravity over the run exact
+		const double sine_road_incline_angle = gravity_times_sine / gravity;
+		const double road_incline_angle = std::asin(sine_road_incline_angle);
+		return RouteSegment{
+			.coordinate_start = first.coordinate_start,
+			.coordinate_end = last.coordinate_end,
+			.end_condition = last.end_condition,
+			.type = last.type,
+			.speed_limit = last.speed_limit,
+			.weather_station = weather_station / distance,
+			.distance = distance,
+			.heading = std::atan2(heading_y, heading_x),
+			.elevation = elevation / distance,
+			.grade = std::tan(road_incline_angle),
+			// The route file has the incline in degrees
+			.road_incline_angle = rad_to_deg(road_incline_angle),
+			.sine_road_incline_angle = sine_road_incline_angle,
+			.gravity = gravity,
+			.gravity_times_sine_road_incline_angle = gravity_times_sine,
+		};
+	}
+}  // namespace
+
+Route Route::coarsen(const CoarseningTolerance& tolerance) const {
+	Route coarse;
+	coarse.weather_stations = weather_stations;
+	coarse.total_distance = total_distance;
+
+	size_t run_start = 0;
+	double run_length = 0;
+	for (size_t i = 0; i < segments.size(); ++i) {
+		const RouteSegment& segment = segments[i];
+		const RouteSegment& anchor = segments[run_start];
+		const bool similar = heading_difference(segment.heading, anchor.heading) <= tolerance.heading &&
+							 std::abs(segment.grade - anchor.grade) <= tolerance.grade &&
+							 std::abs(segment.weather_station - anchor.weather_station) <= tolerance.weather_station &&
+							 segment.speed_limit == anchor.speed_limit && segment.type == anchor.type &&
+							 run_length + segment.distance <= tolerance.length;
+		if (i > run_start && (!similar || ends_run(segments[i - 1]))) {
+			coarse.segments.push_back(merge(std::span(segments).subspan(run_start, i - run_start)));
+			coarse.source_segments.push_back(run_start);
+			run_start = i;
+			run_length = 0;
+		}
+		run_length += segment.distance;
+	}
+	if (run_start < segments.size()) {
+		coarse.segments.push_back(merge(std::span(segments).subspan(run_start)));
+		coarse.source_segments.push_back(run_start);
+	}
+	coarse.source_segments.push_back(segments.size());
+	coarse.compiled = CompiledRoute(coarse.segments);
+	return coarse;
+}
+
+std::span<const size_t> Route::get_source_segments() const {
+	return source_segments;
+}
+
+std::vector<double> Route::to_source_profile(std::span<const double> speed_profile) const {
+	assert(speed_profile.size() == segments.size() && !source_segments.empty());
+	std::vector<double> source_profile;
+	source_profile.reserve(source_segments.back());
+	for (size_t i = 0; i < segments.size(); ++i) {
+		source_profile.insert(source_profile.end(), source_segments[i + 1] - source_segments[i], speed_profile[i]);
+	}
+	return source_profile;
+}
@@ -6,7 +6,9 @@
 #include <string_view>
 #include <vector>
 
+#include "CompiledRoute.h"
 #include "RaceConfig/WeatherStations/WeatherStations.h"
+#include "RouteConstants.h"
 #include "RouteSegment.h"
 
 /// @brief A wrapper class for a Route the car is taking.
@@ -23,17 +25,64 @@ class Route {
 	/// @return The distance between two segments, excluding the last segment
 	double get_distance_between(size_t index1, size_t index2) const;
 
+	/// @brief Splits the route into blocks of consecutive segments, e.g. to drive each block at its own speed. A block
+	/// is closed once it covers @p block_length, and always right after a control stop.
+	///
+	/// @param [in] block_length (m) The distance after which a block is closed.
+	/// @returns The first segment of every block, followed by the number of segments in the route.
+	std::vector<size_t> split_into_blocks(double block_length) const;
+
+	/// How different consecutive segments may be and still be merged by coarsen. Every segment of a merged run is
+	/// compared with the run's first segment, so differences do not add up along the run.
+	struct CoarseningTolerance {
+		/// (radians) The largest heading difference.
+		double heading = route::clustering::maximum_heading_delta;
+		/// The largest grade difference (out of 1).
+		double grade = route::clustering::maximum_grade_delta;
+		/// The largest difference in the weighted weather station index.
+		double weather_station = route::clustering::maximum_weather_station_delta;
+		/// (m) The longest merged segment.
+		double length = route::clustering::maximum_cluster_length_meters;
+	};
+
+	/// @brief Builds a coarser version of the route, with runs of consecutive segments of similar heading, grade and
+	/// weather station merged into one equivalent segment each, e.g. to search for a strategy on a route with far
+	/// fewer segments and verify it on this one.
+	///
+	/// A merged segment has the run's total distance, and the distance weighted average of its heading (as a
+	/// direction), grade, elevation, weather station and gravity. The work against gravity over the run is kept
+	/// exactly. Runs never span a control stop, the finish, the end of the race, a change of speed limit or a change
+	/// of segment type, so every one of those still ends a segment of the coarse route.
+	///
+	/// @param [in] tolerance How different merged segments may be.
+	/// @returns The coarse route. Its get_source_segments() maps its segments back to this route's.
+	Route coarsen(const CoarseningTolerance& tolerance) const;
+
+	/// @returns For a route built by coarsen, the index of the first segment of the source route that each segment
+	/// was merged from, followed by the number of segments in the source route. Empty for a route read from a file.
+	std::span<const size_t> get_source_segments() const;
+
+	/// @brief Maps a speed profile over the segments of a route built by coarsen onto the segments of its source
+	/// route, every merged segment's speed being driven over the segments it was merged from.
+	std::vector<double> to_source_profile(std::span<const double> speed_profile) const;
+
 	WeatherStations weather_stations;
 
 	/// @return A pointer to a const version of segments
 	const std::vector<RouteSegment>* get_segments() const;
 	std::span<const RouteSegment> get_segments_span() const;
+	/// @return The segments as the race loop reads them, built once with the route.
+	const CompiledRoute& get_compiled() const;
 
 	static std::vector<GeographicalCoordinate> parse_weather_stations(std::string_view weatherStationsFile);
 
    private:
 	std::vector<RouteSegment> segments;
+	/// See get_compiled.
+	CompiledRoute compiled;
 	double total_distance = 0;
+	/// See get_source_segments.
+	std::vector<size_t> source_segments;
 };
 
 #endif  // MINISIM_ROUTE_H
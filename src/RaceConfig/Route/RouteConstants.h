@@ -45,6 +45,7 @@ namespace route {
 	namespace clustering {
 		static constexpr double maximum_grade_delta = 0.01;
 		static constexpr double maximum_heading_delta = deg_to_rad(5);
+		static constexpr double maximum_weather_station_delta = 0.01;
 		static constexpr int maximum_cluster_length_meters = 50000;
 	}  // namespace clustering
 }  // namespace route
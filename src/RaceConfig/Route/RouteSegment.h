@@ -74,11 +74,11 @@ struct RouteSegment {
 	SegmentEndCondition end_condition;
 	/// The type of the segment.
 	SegmentType type;
-	/// The speed limit of the segment in km/h.
+	/// The speed limit of the segment (in m/s).
 	double speed_limit;
 	/// The weighted average weather group id
 	double weather_station;
-	/// The haversine distance of the segment (in kilometers).
+	/// The haversine distance of the segment (in meters).
 	double distance;
 	/// The heading of the segment (in radians).
 	double heading;
@@ -1,15 +1,25 @@
 #include "Weather.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
 #include <exception>
 #include <filesystem>
 #include <fstream>
+#include <ios>
+#include <memory>
+#include <optional>
 #include <set>
 #include <span>
 #include <string>
+#include <system_error>
+#include <utility>
 #include <vector>
 
 #include "RaceConfig/RaceConfigConstants.h"
+#include "Tools/ThreadPool.h"
 #include "Tools/TimeTools.h"
+#include "WeatherCache.h"
 #include "alglib/ap.h"
 #include "alglib/interpolation.h"
 #include "csv/csv.h"
@@ -19,161 +29,208 @@ using namespace race_config::weather;
 Weather::Weather(std::string_view weather_file, const WeatherStations& weather_stations)
 	: Weather(std::array<const std::string, 1>{std::string(weather_file.data())}, weather_stations) {}
 
-Weather::Weather(std::span<const std::string> weather_files, const WeatherStations& weather_stations)
+Weather::Weather(
+	std::span<const std::string> weather_files, const WeatherStations& weather_stations, size_t num_threads)
 	: num_weather_groups(weather_stations.size()) {
-	for (const auto& file : weather_files) {
-		std::string cache_location = file + ".cache";
-
-		// check if the cache file exists
-		if (std::filesystem::exists(cache_location)) {
-			// if it does, load the cache file
-			SplineAndStartTime spline_and_start_time;
-
-			std::fstream cache_file(cache_location);
-			alglib::spline2dunserialize(cache_file, spline_and_start_time.weather_spline);
-
-			std::fstream start_time_file(file);
-			// first line is just the header
-			std::string line;
-			std::getline(start_time_file, line);
-			char junk;
-			start_time_file >> spline_and_start_time.start_time >> junk >> spline_and_start_time.start_time;
-			weather_splines.push_back(std::move(spline_and_start_time));
-			continue;
-		}
-
-		// process for reading csv and building splines
-		io::CSVReader<WEATHER_FILE_NUMBER_OF_COLUMNS> csv(file);
-		csv.read_header(io::ignore_extra_column,
-			CN_WEATHER_STATION.data(),     // 0
-			CN_UNIX_PERIOD.data(),         // 1
-			CN_DHI.data(),                 // 2
-			CN_DNI.data(),                 // 3
-			CN_GHI.data(),                 // 4
-			CN_WIND_VELOCITY_NS.data(),    // 5
-			CN_WIND_VELOCITY_EW.data(),    // 6
-			CN_AIR_TEMPERATURE_2M.data(),  // 7
-			CN_SURFACE_PRESSURE.data(),    // 8
-			CN_AIR_DENSITY.data()          // 9
-		);
-
-		std::vector<double> weather_station_vec, time_vec, dhi_vec, dni_vec, ghi_vec, wind_vel_ns_vec, wind_vel_ew_vec,
-			air_temp_vec, pressure_vec, air_density_vec;
-		double weather_station, time, dhi, dni, ghi, wind_vel_ns, wind_vel_ew, air_temp, pressure, air_density;
-
-		int number_of_rows = 0;
-		while (csv.read_row(weather_station,  // 0
-			time,                             // 1
-			dhi,                              // 2
-			dni,                              // 3
-			ghi,                              // 4
-			wind_vel_ns,                      // 5
-			wind_vel_ew,                      // 6
-			air_temp,                         // 7
-			pressure,                         // 8
-			air_density                       // 9
-			)) {
-			weather_station_vec.push_back(weather_station);
-			time_vec.push_back(time);
-			dhi_vec.push_back(dhi);
-			dni_vec.push_back(dni);
-			ghi_vec.push_back(ghi);
-			wind_vel_ns_vec.push_back(wind_vel_ns);
-			wind_vel_ew_vec.push_back(wind_vel_ew);
-			air_temp_vec.push_back(air_temp);
-			pressure_vec.push_back(pressure);
-			air_density_vec.push_back(air_density);
-			number_of_rows++;
-		}
-
-		// We define a vector-valued spline with two inputs (time and weather station) and 9 outputs (the weather data).
-		// The abscissa and ordinate arrays are the coordinates of the grid points.
-		// The abscissa array represents the time values.
-		// The ordinate array represents the weather station values.
+	// Every file is loaded into its own slot, and equal start times keep the order the files were given in, so the
+	// grids come out the same however the files are spread over the threads
+	std::vector<GridAndStartTime> grids(weather_files.size());
+	const size_t pool_size = std::min(ThreadPool::resolve_thread_count(num_threads), weather_files.size());
+	ThreadPool pool(std::max<size_t>(pool_size, 1));
+	pool.parallel_for(weather_files.size(),
+		[&](size_t file_idx) { grids[file_idx] = load_grid(weather_files[file_idx], num_weather_groups); });
+
+	std::stable_sort(grids.begin(), grids.end(),
+		[](const GridAndStartTime& lhs, const GridAndStartTime& rhs) { return lhs.start_time < rhs.start_time; });
+	weather_grids = std::make_shared<const std::vector<GridAndStartTime>>(std::move(grids));
+}
 
-		const int abscissas_dim = static_cast<int>(weather_station_vec.size()) / num_weather_groups;
-		const int spline_vector_dim = WEATHER_FILE_NUMBER_OF_COLUMNS - 2;
+Weather::GridAndStartTime Weather::load_grid(const std::string& file, int num_weather_groups) {
+	std::optional<std::pair<double, WeatherGrid>> cached = WeatherCache::load(file, num_weather_groups);
+	if (cached.has_value()) {
+		return {.start_time = cached->first, .weather_grid = std::move(cached->second)};
+	}
 
-		const int number_of_values_per_weather_group = number_of_rows / num_weather_groups;
+	// The file is read in one go, which gives an upper bound on the number of rows to size the columns with: each row
+	// comes after a line break
+	std::ifstream stream(file, std::ios::binary);
+	std::error_code error;
+	const auto file_size = std::filesystem::file_size(file, error);
+	if (!stream || error) {
+		throw std::exception();
+	}
+	std::vector<char> contents(file_size);
+	stream.read(contents.data(), static_cast<std::streamsize>(contents.size()));
+	const auto max_rows = static_cast<size_t>(std::count(contents.begin(), contents.end(), '\n'));
+
+	// process for reading csv and building splines
+	io::CSVReader<WEATHER_FILE_NUMBER_OF_COLUMNS> csv(file, contents.data(), contents.data() + contents.size());
+	csv.read_header(io::ignore_extra_column,
+		CN_WEATHER_STATION.data(),     // 0
+		CN_UNIX_PERIOD.data(),         // 1
+		CN_DHI.data(),                 // 2
+		CN_DNI.data(),                 // 3
+		CN_GHI.data(),                 // 4
+		CN_WIND_VELOCITY_NS.data(),    // 5
+		CN_WIND_VELOCITY_EW.data(),    // 6
+		CN_AIR_TEMPERATURE_2M.data(),  // 7
+		CN_SURFACE_PRESSURE.data(),    // 8
+		CN_AIR_DENSITY.data()          // 9
+	);
+
+	// The weather values are read straight into the spline's function values, at the index of their row and channel.
+	// Every buffer has room for one row more than there can be, for the read that finds the end of the file
+	const int spline_vector_dim = WEATHER_FILE_NUMBER_OF_COLUMNS - 2;
+	std::vector<double> weather_station_vec(max_rows + 1);
+	std::vector<double> time_vec(max_rows + 1);
+	alglib::real_1d_array function_values_array;
+	function_values_array.setlength(static_cast<alglib::ae_int_t>((max_rows + 1) * spline_vector_dim));
+	double* const function_values = function_values_array.getcontent();
+
+	int number_of_rows = 0;
+	while (true) {
+		double* const row_values = function_values + static_cast<ptrdiff_t>(number_of_rows) * spline_vector_dim;
+		if (!csv.read_row(weather_station_vec[number_of_rows],  // 0
+				time_vec[number_of_rows],                         // 1
+				row_values[CO_DHI],                               // 2
+				row_values[CO_DNI],                               // 3
+				row_values[CO_GHI],                               // 4
+				row_values[CO_WIND_VELOCITY_NS],                  // 5
+				row_values[CO_WIND_VELOCITY_EW],                  // 6
+				row_values[CO_AIR_TEMPERATURE_2M],                // 7
+				row_values[CO_SURFACE_PRESSURE],                  // 8
+				row_values[CO_AIR_DENSITY]                        // 9
+				)) {
+			break;
+		}
+		number_of_rows++;
+	}
 
-		alglib::real_1d_array abscissas_array;
-		alglib::real_1d_array ordinates_array;
-		alglib::real_1d_array function_values_array;
-		abscissas_array.setlength(abscissas_dim);
+	// We define a vector-valued spline with two inputs (time and weather station) and 9 outputs (the weather data).
+	// The abscissa and ordinate arrays are the coordinates of the grid points.
+	// The abscissa array represents the time values.
+	// The ordinate array represents the weather station values.
 
-		ordinates_array.setlength(num_weather_groups);
-		function_values_array.setlength(abscissas_dim * num_weather_groups * spline_vector_dim);
+	const int number_of_values_per_weather_group = number_of_rows / num_weather_groups;
 
-		for (int i = 0; i < number_of_values_per_weather_group; ++i) {
-			abscissas_array[i] = time_vec[i];
-		}
+	alglib::real_1d_array abscissas_array;
+	alglib::real_1d_array ordinates_array;
+	abscissas_array.setcontent(number_of_values_per_weather_group, time_vec.data());
+	ordinates_array.setlength(num_weather_groups);
+	for (int i = 0; i < num_weather_groups; ++i) {
+		ordinates_array[i] = weather_station_vec[i * number_of_values_per_weather_group];
+	}
 
-		for (int i = 0; i < num_weather_groups; ++i) {
-			ordinates_array[i] = weather_station_vec[i * number_of_values_per_weather_group];
-		}
+	alglib::spline2dinterpolant weather_spline;
+	try {
+		alglib::spline2dbuildbilinearv(abscissas_array, number_of_values_per_weather_group, ordinates_array,
+			num_weather_groups, function_values_array, spline_vector_dim, weather_spline);
+	} catch (alglib::ap_error& error) {
+		throw std::exception();
+	}
 
-		for (int i = 0; i < abscissas_dim * num_weather_groups; ++i) {
-			function_values_array[i * spline_vector_dim + CO_DHI] = dhi_vec[i];                       // 1
-			function_values_array[i * spline_vector_dim + CO_DNI] = dni_vec[i];                       // 2
-			function_values_array[i * spline_vector_dim + CO_GHI] = ghi_vec[i];                       // 3
-			function_values_array[i * spline_vector_dim + CO_WIND_VELOCITY_NS] = wind_vel_ns_vec[i];  // 4
-			function_values_array[i * spline_vector_dim + CO_WIND_VELOCITY_EW] = wind_vel_ew_vec[i];  // 5
-			function_values_array[i * spline_vector_dim + CO_AIR_TEMPERATURE_2M] = air_temp_vec[i];   // 6
-			function_values_array[i * spline_vector_dim + CO_SURFACE_PRESSURE] = pressure_vec[i];     // 7
-			function_values_array[i * spline_vector_dim + CO_AIR_DENSITY] = air_density_vec[i];       // 8
-		}
+	GridAndStartTime grid_and_start_time{
+		.start_time = time_vec[0],
+		.weather_grid = WeatherGrid(weather_spline),
+	};
+	WeatherCache::save(file, grid_and_start_time.start_time, grid_and_start_time.weather_grid);
+	return grid_and_start_time;
+}
 
-		SplineAndStartTime spline_and_start_time{
-			.start_time = time_vec[0],
-			.weather_spline = {},
-		};
+Weather Weather::with_perturbation(const WeatherPerturbation& new_perturbation) const {
+	Weather perturbed = *this;
+	perturbed.perturbation = new_perturbation;
+	perturbed.is_perturbed = true;
+	return perturbed;
+}
 
-		try {
-			alglib::spline2dbuildbilinearv(abscissas_array, abscissas_dim, ordinates_array, num_weather_groups,
-				function_values_array, spline_vector_dim, spline_and_start_time.weather_spline);
-		} catch (alglib::ap_error& error) {
-			throw std::exception();
-		}
+Weather Weather::with_timelines(
+	double start_time, double end_time, double resolution, WeatherTimelines::Integration integration) const {
+	// Sampled without any perturbation, which is applied after the lookup like it is after the splines
+	Weather source = *this;
+	source.timelines = nullptr;
+	source.perturbation = {};
+	source.is_perturbed = false;
+
+	Weather resampled = *this;
+	resampled.timelines =
+		std::make_shared<const WeatherTimelines>(source, start_time, end_time, resolution, integration);
+	return resampled;
+}
 
-		// save the spline to a cache file
-		std::fstream cache_file(cache_location, std::ios::out);
-		alglib::spline2dserialize(spline_and_start_time.weather_spline, cache_file);
+const WeatherTimelines* Weather::get_timelines() const {
+	return timelines.get();
+}
 
-		alglib::spline2dbuildbilinearv(abscissas_array, abscissas_dim, ordinates_array, num_weather_groups,
-			function_values_array, spline_vector_dim, spline_and_start_time.weather_spline);
+std::optional<double> Weather::get_irradiance_integral(
+	double weather_station, double start_time, double end_time, double increment) const {
+	double integral = 0;
+	if (!timelines || !timelines->get_irradiance_integral(weather_station, start_time, end_time, increment, integral)) {
+		return std::nullopt;
+	}
+	return is_perturbed ? integral * perturbation.irradiance_scale : integral;
+}
 
-		weather_splines.push_back(std::move(spline_and_start_time));
+std::vector<double> Weather::get_weather_station_knots() const {
+	std::set<double> stations;
+	for (const auto& grid : *weather_grids) {
+		const std::span<const double> grid_stations = grid.weather_grid.get_stations();
+		stations.insert(grid_stations.begin(), grid_stations.end());
 	}
+	return {stations.begin(), stations.end()};
+}
 
-	std::sort(weather_splines.begin(), weather_splines.end(),
-		[](const SplineAndStartTime& lhs, const SplineAndStartTime& rhs) { return lhs.start_time < rhs.start_time; });
+std::pair<double, double> Weather::get_time_range() const {
+	if (weather_grids->empty()) {
+		throw std::exception();
+	}
+	return {weather_grids->front().start_time, weather_grids->back().weather_grid.get_times().back()};
 }
 
-WeatherDataPoint Weather::get_weather_at(double weather_station, double time) const {
-	// get the last element of weather_splines such that the start time is less than or equal to the time
-	auto weather_spline = std::upper_bound(weather_splines.begin(), weather_splines.end(), time,
-		[](double time, const SplineAndStartTime& spline_and_start_time) {
-			return time < spline_and_start_time.start_time;
-		});
+const Weather::GridAndStartTime& Weather::get_grid_at(double time) const {
+	// get the last element of weather_grids such that the start time is less than or equal to the time
+	auto weather_grid = std::upper_bound(weather_grids->begin(), weather_grids->end(), time,
+		[](double time, const GridAndStartTime& grid_and_start_time) { return time < grid_and_start_time.start_time; });
 
-	if (weather_spline == weather_splines.begin()) {
+	if (weather_grid == weather_grids->begin()) {
 		throw std::exception();
 	}
-	weather_spline = std::prev(weather_spline);
-
-	const alglib::spline2dinterpolant& weather_spline_interpolant = weather_spline->weather_spline;
+	return *std::prev(weather_grid);
+}
 
-	alglib::real_1d_array weather_data;
-	alglib::spline2dcalcv(weather_spline_interpolant, time, weather_station, weather_data);
+WeatherDataPoint Weather::get_weather_at(double weather_station, double time) const {
+	WeatherTimelines::Sample sample;
+	if (!timelines || !timelines->get_sample_at(weather_station, time, sample)) {
+		WeatherGrid::Sample weather_data;
+		get_grid_at(time).weather_grid.get_sample_at(weather_station, time, weather_data);
+
+		sample[WeatherTimelines::GHI] = weather_data[WeatherGrid::GHI];
+		sample[WeatherTimelines::WIND_NORTH_SOUTH] = weather_data[WeatherGrid::WIND_NORTH_SOUTH];
+		sample[WeatherTimelines::WIND_EAST_WEST] = weather_data[WeatherGrid::WIND_EAST_WEST];
+		sample[WeatherTimelines::AIR_TEMPERATURE] = weather_data[WeatherGrid::AIR_TEMPERATURE];
+		sample[WeatherTimelines::SURFACE_PRESSURE] = weather_data[WeatherGrid::SURFACE_PRESSURE];
+		sample[WeatherTimelines::AIR_DENSITY] = weather_data[WeatherGrid::AIR_DENSITY];
+	}
 
-	const double ghi = weather_data[CO_GHI];
-	const double wind_ns = weather_data[CO_WIND_VELOCITY_NS];
-	const double wind_ew = weather_data[CO_WIND_VELOCITY_EW];
-	const double air_temp = weather_data[CO_AIR_TEMPERATURE_2M];
-	const double pressure = weather_data[CO_SURFACE_PRESSURE];
-	const double air_density = weather_data[CO_AIR_DENSITY];
+	const double ghi = sample[WeatherTimelines::GHI];
+	const double wind_ns = sample[WeatherTimelines::WIND_NORTH_SOUTH];
+	const double wind_ew = sample[WeatherTimelines::WIND_EAST_WEST];
+	const double air_temp = sample[WeatherTimelines::AIR_TEMPERATURE];
+	const double pressure = sample[WeatherTimelines::SURFACE_PRESSURE];
+	const double air_density = sample[WeatherTimelines::AIR_DENSITY];
 	constexpr double reciprocal_speed_of_sound = 0.0029154519; // s / m
 
+	if (is_perturbed) {
+		return {
+			.wind = VelocityVector::from_cartesian_components(wind_ns + perturbation.wind_north_south_offset,
+				wind_ew + perturbation.wind_east_west_offset),
+			.irradiance = ghi * perturbation.irradiance_scale,
+			.air_temp = air_temp,
+			.pressure = pressure,
+			.air_density = air_density * perturbation.air_density_scale,
+			.reciprocal_speed_of_sound = reciprocal_speed_of_sound,
+		};
+	}
 
 	return {
 		.wind = VelocityVector::from_cartesian_components(wind_ns, wind_ew),
@@ -185,8 +242,46 @@ WeatherDataPoint Weather::get_weather_at(double weather_station, double time) co
 	};
 }
 
+void Weather::get_weather_at_batch(std::span<const double> weather_stations, std::span<const double> times,
+	std::span<WeatherDataPoint> weather) const {
+	assert(weather_stations.size() == times.size() && weather.size() == times.size());
+	for (size_t i = 0; i < times.size(); ++i) {
+		weather[i] = get_weather_at(weather_stations[i], times[i]);
+	}
+}
+
 WeatherDataPoint Weather::get_weather_during(double weather_station, double start_time, double end_time) const {
 	const WeatherDataPoint start_data = get_weather_at(weather_station, start_time);
 	const WeatherDataPoint end_data = get_weather_at(weather_station, end_time);
 	return WeatherDataPoint::average(start_data, end_data);
 }
+
+WeatherDataPoint Weather::get_weather_rate_at(double weather_station, double time) const {
+	// The slope of whatever get_weather_at interpolates, so that the derivatives match the values they go with
+	WeatherTimelines::Sample rates;
+	if (!timelines || !timelines->get_rate_at(weather_station, time, rates)) {
+		// The grid's first coordinate is time, so its time derivative is the rate of change of each channel
+		WeatherGrid::Sample grid_rates;
+		get_grid_at(time).weather_grid.get_rate_at(weather_station, time, grid_rates);
+
+		rates[WeatherTimelines::GHI] = grid_rates[WeatherGrid::GHI];
+		rates[WeatherTimelines::WIND_NORTH_SOUTH] = grid_rates[WeatherGrid::WIND_NORTH_SOUTH];
+		rates[WeatherTimelines::WIND_EAST_WEST] = grid_rates[WeatherGrid::WIND_EAST_WEST];
+		rates[WeatherTimelines::AIR_TEMPERATURE] = grid_rates[WeatherGrid::AIR_TEMPERATURE];
+		rates[WeatherTimelines::SURFACE_PRESSURE] = grid_rates[WeatherGrid::SURFACE_PRESSURE];
+		rates[WeatherTimelines::AIR_DENSITY] = grid_rates[WeatherGrid::AIR_DENSITY];
+	}
+
+	// Offsets do not change with time, but scales scale the rate too
+	const double irradiance_scale = is_perturbed ? perturbation.irradiance_scale : 1;
+	const double air_density_scale = is_perturbed ? perturbation.air_density_scale : 1;
+	return {
+		.wind = VelocityVector::from_cartesian_components(
+			rates[WeatherTimelines::WIND_NORTH_SOUTH], rates[WeatherTimelines::WIND_EAST_WEST]),
+		.irradiance = rates[WeatherTimelines::GHI] * irradiance_scale,
+		.air_temp = rates[WeatherTimelines::AIR_TEMPERATURE],
+		.pressure = rates[WeatherTimelines::SURFACE_PRESSURE],
+		.air_density = rates[WeatherTimelines::AIR_DENSITY] * air_density_scale,
+		.reciprocal_speed_of_sound = 0,
+	};
+}
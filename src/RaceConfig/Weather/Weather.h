@@ -1,18 +1,28 @@
 #ifndef MINISIM_WEATHER_H
 #define MINISIM_WEATHER_H
 
+#include <cstddef>
+#include <memory>
+#include <optional>
 #include <span>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "RaceConfig/WeatherStations/WeatherStations.h"
+#include "Tools/Dual.h"
 #include "WeatherConstants.h"
 #include "WeatherDataPoint.h"
-#include "alglib/interpolation.h"
+#include "WeatherGrid.h"
+#include "WeatherPerturbation.h"
+#include "WeatherTimelines.h"
 
 /// This class encapsulates all weather data and construction of splines (which predict data in between our known
 /// discrete data points
+///
+/// Copies share the splines, so a copy (or a perturbed copy, see with_perturbation) costs a few bytes.
 class Weather {
    public:
 	Weather() = default;
@@ -23,7 +33,37 @@ class Weather {
 	Weather(std::string_view weather_file, const WeatherStations& weather_station);
 
 	/// @brief Construct a new Weather object from multiple weather files and merge them together
-	Weather(std::span<const std::string> weather_files, const WeatherStations& weather_station_coordinates);
+	/// @param num_threads the number of threads the files are loaded on at once, 0 for every hardware thread. The
+	/// forecast is the same whatever the number.
+	Weather(std::span<const std::string> weather_files, const WeatherStations& weather_station_coordinates,
+		size_t num_threads = 0);
+
+	/// @brief Creates a copy of this forecast with @p perturbation applied to every weather data point, e.g. to
+	/// model forecast error. The copy shares the splines with this forecast rather than copying them.
+	/// @param perturbation how to change the forecast, replacing any perturbation this forecast already has
+	/// @return Weather the perturbed forecast
+	Weather with_perturbation(const WeatherPerturbation& perturbation) const;
+
+	/// @brief Creates a copy of this forecast that looks the weather up in WeatherTimelines sampled every
+	/// @p resolution seconds from @p start_time through to @p end_time, and in the splines outside of them. The
+	/// timelines are shared by every copy of the result, perturbed ones included.
+	/// @param start_time (epoch seconds) the first sample, inside the forecast
+	/// @param end_time (epoch seconds) the time the last sample must reach
+	/// @param resolution (seconds) the time between samples
+	/// @param integration how get_irradiance_integral integrates the timelines
+	/// @return Weather the forecast with timelines
+	Weather with_timelines(double start_time, double end_time, double resolution,
+		WeatherTimelines::Integration integration = WeatherTimelines::Integration::STEPPED) const;
+
+	/// @return the timelines this forecast looks the weather up in, if any
+	const WeatherTimelines* get_timelines() const;
+
+	/// @return the weather stations the forecast is given at, in increasing order. In between them, the weather is
+	/// linear in the (fractional) weather station.
+	std::vector<double> get_weather_station_knots() const;
+
+	/// @return (epoch seconds) the first and last time the forecast has data for
+	std::pair<double, double> get_time_range() const;
 
 	/// @brief get the weather data point at the given weather group and time
 	/// @param weather_station the weather group as a decimal
@@ -31,6 +71,13 @@ class Weather {
 	/// @return WeatherDataPoint the weather data point at the given weather group and time
 	WeatherDataPoint get_weather_at(double weather_station, double time) const;
 
+	/// @brief get_weather_at for many weather groups and times at once, without allocating anything
+	/// @param weather_stations the weather group of every query, as a decimal
+	/// @param times the time of every query
+	/// @param weather [out] the weather data point of every query, in the same order
+	void get_weather_at_batch(std::span<const double> weather_stations, std::span<const double> times,
+		std::span<WeatherDataPoint> weather) const;
+
 	/// @brief get the weather data point at the given weather group and time segment
 	/// @param weather_station the weather group as a decimal
 	/// @param start_time the start time
@@ -38,16 +85,91 @@ class Weather {
 	/// @return WeatherDataPoint the weather data point at the given weather group and time segment
 	WeatherDataPoint get_weather_during(double weather_station, double start_time, double end_time) const;
 
+	/// @brief integrate the irradiance at the given weather group over a time window in a couple of lookups, the way
+	/// the timelines were made to (see WeatherTimelines::get_irradiance_integral)
+	/// @param weather_station the weather group as a decimal
+	/// @param start_time the start time
+	/// @param end_time the end time
+	/// @param increment (seconds) the length of the steps, if the timelines integrate in steps
+	/// @return (W s / m^2) the integral, or std::nullopt if this forecast has no timelines that can look it up
+	std::optional<double> get_irradiance_integral(
+		double weather_station, double start_time, double end_time, double increment) const;
+
+	/// @brief get_weather_at for a time that carries derivatives (e.g. a dual number), so that the weather carries the
+	/// derivatives along too.
+	///
+	/// The weather is interpolated linearly in time, so its value and slope at the current time give its derivatives
+	/// exactly (away from the data points themselves, where the slope changes).
+	template <typename Scalar>
+	BasicWeatherDataPoint<Scalar> get_weather_at(
+		double weather_station, const std::type_identity_t<Scalar>& time) const;
+
+	/// @brief get_weather_during for times that carry derivatives (e.g. dual numbers).
+	template <typename Scalar>
+	BasicWeatherDataPoint<Scalar> get_weather_during(double weather_station,
+		const std::type_identity_t<Scalar>& start_time, const std::type_identity_t<Scalar>& end_time) const;
+
    private:
-	struct SplineAndStartTime {
+	/// @brief get the rate of change over time of every weather value at the given weather group and time
+	/// @return WeatherDataPoint holding, in every field, the derivative of that field with respect to time (per second)
+	WeatherDataPoint get_weather_rate_at(double weather_station, double time) const;
+
+	/// the bilinear spline of one weather file, as the grid it interpolates
+	struct GridAndStartTime {
 		double start_time;
-		alglib::spline2dinterpolant weather_spline;
+		WeatherGrid weather_grid;
 	};
-	/// spline interpolant for all weather data
-	std::vector<SplineAndStartTime> weather_splines;
+
+	/// @brief loads the grid of one weather file from its cache, or else from the file, caching it
+	static GridAndStartTime load_grid(const std::string& weather_file, int num_weather_groups);
+
+	/// @returns the grid covering @p time.
+	const GridAndStartTime& get_grid_at(double time) const;
+	/// the grids of every weather file, in order of start time, shared between copies
+	std::shared_ptr<const std::vector<GridAndStartTime>> weather_grids =
+		std::make_shared<const std::vector<GridAndStartTime>>();
 
 	/// the number of weather groups
 	int num_weather_groups;
+
+	/// the resampled forecast, if with_timelines made this forecast; shared between copies
+	std::shared_ptr<const WeatherTimelines> timelines;
+
+	/// the change applied to every weather data point, if is_perturbed
+	WeatherPerturbation perturbation;
+	bool is_perturbed = false;
 };
 
+template <typename Scalar>
+BasicWeatherDataPoint<Scalar> Weather::get_weather_at(
+	double weather_station, const std::type_identity_t<Scalar>& time) const {
+	if constexpr (std::is_same_v<Scalar, double>) {
+		// No derivatives to carry, so the rates would only be multiplied by zero
+		return get_weather_at(weather_station, time);
+	}
+	const double time_value = value_of(time);
+	const WeatherDataPoint value = get_weather_at(weather_station, time_value);
+	const WeatherDataPoint rate = get_weather_rate_at(weather_station, time_value);
+	// Zero, but carrying the derivatives of time
+	const Scalar time_offset = time - time_value;
+
+	return {
+		.wind = BasicVelocityVector<Scalar>::from_cartesian_components(
+			value.wind.get_north_south() + rate.wind.get_north_south() * time_offset,
+			value.wind.get_east_west() + rate.wind.get_east_west() * time_offset),
+		.irradiance = value.irradiance + rate.irradiance * time_offset,
+		.air_temp = value.air_temp + rate.air_temp * time_offset,
+		.pressure = value.pressure + rate.pressure * time_offset,
+		.air_density = value.air_density + rate.air_density * time_offset,
+		.reciprocal_speed_of_sound = value.reciprocal_speed_of_sound,
+	};
+}
+
+template <typename Scalar>
+BasicWeatherDataPoint<Scalar> Weather::get_weather_during(double weather_station,
+	const std::type_identity_t<Scalar>& start_time, const std::type_identity_t<Scalar>& end_time) const {
+	return BasicWeatherDataPoint<Scalar>::average(
+		get_weather_at<Scalar>(weather_station, start_time), get_weather_at<Scalar>(weather_station, end_time));
+}
+
 #endif  // MINISIM_WEATHER_H
@@ -0,0 +1,227 @@
+#include "WeatherCache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <ios>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "Tools/Hashing.h"
+#include "WeatherGrid.h"
+
+namespace {
+	/// The first bytes of every cache file.
+	constexpr uint64_t magic = 0x4d53494d57544852;  // "MSIMWTHR"
+
+	/// The start of every cache file. It is followed by the grid's time knots, its weather station knots and its
+	/// values (see WeatherGrid::get_values), all as doubles.
+	struct Header {
+		uint64_t magic;
+		uint64_t version;
+		/// (bytes) The size of the weather file the cache was made from.
+		uint64_t source_size;
+		/// The modification time of the weather file, in the filesystem clock's ticks.
+		int64_t source_modification_time;
+		/// The content hash of the weather file.
+		uint64_t source_hash;
+		/// (epoch seconds) The time the forecast starts at.
+		double start_time;
+		uint64_t num_times;
+		uint64_t num_stations;
+		uint64_t num_channels;
+	};
+
+	/// What identifies a version of a weather file without reading it.
+	struct Source {
+		uint64_t size;
+		int64_t modification_time;
+	};
+
+	/// @returns The size and modification time of @p weather_file, or std::nullopt if it cannot be read.
+	std::optional<Source> get_source(const std::string& weather_file) {
+		std::error_code error;
+		const uint64_t size = std::filesystem::file_size(weather_file, error);
+		if (error) {
+			return std::nullopt;
+		}
+		const auto modification_time = std::filesystem::last_write_time(weather_file, error);
+		if (error) {
+			return std::nullopt;
+		}
+		return Source{.size = size, .modification_time = modification_time.time_since_epoch().count()};
+	}
+
+	uint64_t hash_source(const std::string& weather_file) {
+		uint64_t hash = hashing::fnv_offset_basis;
+		hashing::hash_file(hash, weather_file);
+		return hash;
+	}
+
+	/// @returns The cache file of @p weather_file. Not <weather file>.cache, where older versions kept an alglib
+	/// serialized spline: builds from before and after can then share a data directory without reading each other's
+	/// caches.
+	std::string get_cache_file(const std::string& weather_file) {
+		return weather_file + ".grid.cache";
+	}
+
+	/// @brief Writes the cache of @p weather_file, the version of it in @p source, whose contents hash to
+	/// @p source_hash.
+	void write_cache(const std::string& weather_file, const Source& source, uint64_t source_hash, double start_time,
+		const WeatherGrid& weather_grid) {
+		const std::span<const double> times = weather_grid.get_times();
+		const std::span<const double> stations = weather_grid.get_stations();
+		const std::span<const double> values = weather_grid.get_values();
+		const Header header{
+			.magic = magic,
+			.version = WeatherCache::version,
+			.source_size = source.size,
+			.source_modification_time = source.modification_time,
+			.source_hash = source_hash,
+			.start_time = start_time,
+			.num_times = times.size(),
+			.num_stations = stations.size(),
+			.num_channels = WeatherGrid::NUM_CHANNELS,
+		};
+
+		// Written next to the cache, under a name no other save uses, and renamed over it: no process ever maps a half
+		// written cache, and processes that have the old one mapped keep reading it
+		const std::string cache_file = get_cache_file(weather_file);
+		static std::atomic<uint64_t> num_saves = 0;
+		const std::string temporary_file =
+			cache_file + "." + std::to_string(getpid()) + "." + std::to_string(num_saves++) + ".tmp";
+		std::error_code error;
+		{
+			std::ofstream stream(temporary_file, std::ios::binary | std::ios::trunc);
+			stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			for (const std::span<const double> array : {times, stations, values}) {
+				stream.write(
+					reinterpret_cast<const char*>(array.data()), static_cast<std::streamsize>(array.size_bytes()));
+			}
+			if (!stream.flush()) {
+				stream.close();
+				std::filesystem::remove(temporary_file, error);
+				return;
+			}
+		}
+		std::filesystem::rename(temporary_file, cache_file, error);
+		if (error) {
+			std::filesystem::remove(temporary_file, error);
+		}
+	}
+
+	/// A whole file mapped read-only into memory, shared with every process that maps it. Unmapped when destroyed.
+	class MappedFile {
+	   public:
+		/// @returns The file at @p path mapped, or nullptr if it is missing, empty or cannot be mapped.
+		static std::shared_ptr<const MappedFile> open(const std::string& path) {
+			const int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (descriptor < 0) {
+				return nullptr;
+			}
+			struct stat status {};
+			if (fstat(descriptor, &status) != 0 || status.st_size <= 0) {
+				close(descriptor);
+				return nullptr;
+			}
+			const auto size = static_cast<size_t>(status.st_size);
+			void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, descriptor, 0);
+			// The mapping stays valid once the descriptor is closed
+			close(descriptor);
+			if (data == MAP_FAILED) {
+				return nullptr;
+			}
+			return std::shared_ptr<const MappedFile>(new MappedFile(data, size));
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile() {
+			munmap(data, size);
+		}
+
+		std::span<const char> get_bytes() const {
+			return {static_cast<const char*>(data), size};
+		}
+
+	   private:
+		MappedFile(void* data, size_t size) : data(data), size(size) {}
+
+		void* data;
+		size_t size;
+	};
+}  // namespace
+
+std::optional<std::pair<double, WeatherGrid>> WeatherCache::load(
+	const std::string& weather_file, size_t num_weather_stations) {
+	const std::optional<Source> source = get_source(weather_file);
+	const std::shared_ptr<const MappedFile> cache = MappedFile::open(get_cache_file(weather_file));
+	if (!source.has_value() || cache == nullptr) {
+		return std::nullopt;
+	}
+
+	const std::span<const char> bytes = cache->get_bytes();
+	Header header{};
+	if (bytes.size() < sizeof(header)) {
+		return std::nullopt;
+	}
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	// The number of times is checked by division, so a corrupt header cannot overflow the number of values
+	const size_t max_doubles = (bytes.size() - sizeof(header)) / sizeof(double);
+	if (header.magic != magic || header.version != version || header.source_size != source->size ||
+		header.num_channels != WeatherGrid::NUM_CHANNELS || header.num_stations != num_weather_stations ||
+		header.num_stations == 0 || header.num_times > max_doubles / (header.num_stations * header.num_channels)) {
+		return std::nullopt;
+	}
+	const size_t num_values = header.num_times * header.num_stations * WeatherGrid::NUM_CHANNELS;
+	if (bytes.size() != sizeof(header) + (header.num_times + header.num_stations + num_values) * sizeof(double)) {
+		return std::nullopt;
+	}
+
+	const bool is_touched = header.source_modification_time != source->modification_time;
+	if (is_touched && header.source_hash != hash_source(weather_file)) {
+		return std::nullopt;
+	}
+
+	// The mapping is page aligned and the header is a whole number of doubles, so every double is aligned
+	const auto* doubles = reinterpret_cast<const double*>(bytes.data() + sizeof(header));
+	const std::span<const double> times(doubles, header.num_times);
+	const std::span<const double> stations(times.data() + times.size(), header.num_stations);
+	const std::span<const double> values(stations.data() + stations.size(), num_values);
+	std::optional<std::pair<double, WeatherGrid>> cached;
+	try {
+		cached.emplace(header.start_time, WeatherGrid(times, stations, values, cache));
+	} catch (const std::exception&) {
+		return std::nullopt;
+	}
+
+	if (is_touched) {
+		// Record the new modification time, so the weather file is not hashed again on every load. The contents
+		// hashed the same as before, so the hash is reused rather than worked out a second time
+		write_cache(weather_file, source.value(), header.source_hash, cached->first, cached->second);
+	}
+	return cached;
+}
+
+void WeatherCache::save(const std::string& weather_file, double start_time, const WeatherGrid& weather_grid) {
+	const std::optional<Source> source = get_source(weather_file);
+	if (!source.has_value()) {
+		return;
+	}
+	write_cache(weather_file, source.value(), hash_source(weather_file), start_time, weather_grid);
+}
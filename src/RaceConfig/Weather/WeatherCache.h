@@ -0,0 +1,44 @@
+#ifndef MINISIM_WEATHERCACHE_H
+#define MINISIM_WEATHERCACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "WeatherGrid.h"
+
+/// @brief Keeps the forecast grid of a weather file in a binary file next to it, <weather file>.grid.cache, so the CSV
+/// only has to be parsed once.
+///
+/// The cache starts with a header naming the size, modification time and content hash of the weather file it was
+/// made from, the time the forecast starts at and the grid's dimensions, followed by the grid's knots and values as
+/// raw doubles. A cache is read by mapping it read-only: the grid is interpolated straight out of the mapping, which
+/// every process that loads the same weather shares.
+///
+/// A cache made from a weather file of another size, or by another version, is ignored. One with another
+/// modification time is only used if the weather file's contents still hash the same, e.g. after a fresh checkout.
+class WeatherCache {
+   public:
+	/// @brief Loads the cache of @p weather_file, if there is an up to date one.
+	///
+	/// @param weather_file The path to the weather file.
+	/// @param num_weather_stations The number of weather stations the forecast must be given at.
+	///
+	/// @returns (epoch seconds) The time the forecast starts at, and its grid; or std::nullopt if the cache is
+	/// missing, out of date or unreadable.
+	static std::optional<std::pair<double, WeatherGrid>> load(
+		const std::string& weather_file, size_t num_weather_stations);
+
+	/// @brief Caches the forecast grid of @p weather_file, replacing any earlier cache. Processes that have the earlier
+	/// cache loaded keep reading it. Failing to write the cache is not an error: the next load parses the CSV again.
+	///
+	/// @param start_time (epoch seconds) The time the forecast starts at.
+	static void save(const std::string& weather_file, double start_time, const WeatherGrid& weather_grid);
+
+	/// Bump this whenever the layout of the cache, or the way the grid is made from the weather file, changes.
+	static constexpr uint64_t version = 1;
+};
+
+#endif  // MINISIM_WEATHERCACHE_H
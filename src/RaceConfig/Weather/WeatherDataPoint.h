@@ -3,16 +3,32 @@
 
 #include "SolarCar/Aerobody/VelocityVector.h"
 
-struct WeatherDataPoint {
-	VelocityVector wind;
-	double irradiance;
-	double air_temp;
-	double pressure;
-	double air_density;
-	double reciprocal_speed_of_sound;
+/// @tparam Scalar The number type: double, or a dual number to carry derivatives along.
+template <typename Scalar>
+struct BasicWeatherDataPoint {
+	BasicVelocityVector<Scalar> wind;
+	Scalar irradiance;
+	Scalar air_temp;
+	Scalar pressure;
+	Scalar air_density;
+	Scalar reciprocal_speed_of_sound;
 
 	// define an average operator
-	static WeatherDataPoint average(const WeatherDataPoint& rhs, const WeatherDataPoint& lhs);
+	static BasicWeatherDataPoint average(const BasicWeatherDataPoint& rhs, const BasicWeatherDataPoint& lhs) {
+		return BasicWeatherDataPoint{
+			.wind = BasicVelocityVector<Scalar>::from_cartesian_components(  //
+				(rhs.wind.get_north_south() + lhs.wind.get_north_south()) / 2,  //
+				(rhs.wind.get_east_west() + lhs.wind.get_east_west()) / 2       //
+				),
+			.irradiance = (rhs.irradiance + lhs.irradiance) / 2,
+			.air_temp = (rhs.air_temp + lhs.air_temp) / 2,
+			.pressure = (rhs.pressure + lhs.pressure) / 2,
+			.air_density = (rhs.air_density + lhs.air_density) / 2,
+			.reciprocal_speed_of_sound = (rhs.reciprocal_speed_of_sound + lhs.reciprocal_speed_of_sound) / 2,
+		};
+	}
 };
 
-#endif  // MINISIM_WEATHERDATAPOINT_H
\ No newline at end of file
+using WeatherDataPoint = BasicWeatherDataPoint<double>;
+
+#endif  // MINISIM_WEATHERDATAPOINT_H
@@ -0,0 +1,132 @@
+#include "WeatherGrid.h"
+
+#include <cmath>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "alglib/interpolation.h"
+
+namespace {
+	/// The type alglib marks bilinear splines with.
+	constexpr alglib::ae_int_t bilinear_spline_type = -1;
+}  // namespace
+
+WeatherGrid::WeatherGrid(const alglib::spline2dinterpolant& spline) {
+	const alglib_impl::spline2dinterpolant* grid = spline.c_ptr();
+	if (grid->stype != bilinear_spline_type || grid->hasmissingcells || grid->n < 2 || grid->m < 2 ||
+		grid->d < NUM_CHANNELS) {
+		throw std::exception();
+	}
+	const auto num_times = static_cast<size_t>(grid->n);
+	const auto num_stations = static_cast<size_t>(grid->m);
+	const auto num_spline_channels = static_cast<size_t>(grid->d);
+	times.assign({grid->x.ptr.p_double, num_times});
+	stations.assign({grid->y.ptr.p_double, num_stations});
+
+	auto copied_values = std::make_shared<std::vector<double>>(num_stations * num_times * NUM_CHANNELS);
+	for (size_t point = 0; point < num_stations * num_times; ++point) {
+		for (size_t channel = 0; channel < NUM_CHANNELS; ++channel) {
+			(*copied_values)[point * NUM_CHANNELS + channel] =
+				grid->f.ptr.p_double[point * num_spline_channels + channel];
+		}
+	}
+	values = *copied_values;
+	storage = std::move(copied_values);
+}
+
+WeatherGrid::WeatherGrid(std::span<const double> times, std::span<const double> stations,
+	std::span<const double> values, std::shared_ptr<const void> storage)
+	: storage(std::move(storage)), values(values) {
+	this->times.assign(times);
+	this->stations.assign(stations);
+	if (values.size() != stations.size() * times.size() * NUM_CHANNELS) {
+		throw std::exception();
+	}
+}
+
+void WeatherGrid::Axis::assign(std::span<const double> grid_knots) {
+	if (grid_knots.size() < 2) {
+		throw std::exception();
+	}
+	knots.assign(grid_knots.begin(), grid_knots.end());
+	inverse_widths.resize(knots.size() - 1);
+	for (size_t i = 0; i + 1 < knots.size(); ++i) {
+		if (!(knots[i] < knots[i + 1])) {
+			throw std::exception();
+		}
+		inverse_widths[i] = 1.0 / (knots[i + 1] - knots[i]);
+	}
+	inverse_step = static_cast<double>(knots.size() - 1) / (knots.back() - knots.front());
+}
+
+size_t WeatherGrid::Axis::find_cell(double value) const {
+	const size_t last_cell = knots.size() - 2;
+	// The right cell on a uniform axis, and close to it otherwise. Written so that NaN goes to the first cell
+	const double position = std::ceil((value - knots[0]) * inverse_step) - 1;
+	size_t cell = 0;
+	if (position > 0) {
+		cell = position < static_cast<double>(last_cell) ? static_cast<size_t>(position) : last_cell;
+	}
+
+	while (cell > 0 && knots[cell] >= value) {
+		--cell;
+	}
+	while (cell < last_cell && knots[cell + 1] < value) {
+		++cell;
+	}
+	return cell;
+}
+
+void WeatherGrid::get_sample_at(double weather_station, double time, Sample& sample) const {
+	const size_t time_idx = times.find_cell(time);
+	const size_t station_idx = stations.find_cell(weather_station);
+	const double t = (time - times.knots[time_idx]) * times.inverse_widths[time_idx];
+	const double u = (weather_station - stations.knots[station_idx]) * stations.inverse_widths[station_idx];
+
+	// The corners of the cell, and their weights in the same order and grouping as the spline's
+	const size_t num_times = times.knots.size();
+	const double* lower = &values[(station_idx * num_times + time_idx) * NUM_CHANNELS];
+	const double* upper = lower + num_times * NUM_CHANNELS;
+	const double lower_before = (1 - t) * (1 - u);
+	const double lower_after = t * (1 - u);
+	const double upper_after = t * u;
+	const double upper_before = (1 - t) * u;
+	for (size_t channel = 0; channel < NUM_CHANNELS; ++channel) {
+		sample[channel] = lower_before * lower[channel] + lower_after * lower[channel + NUM_CHANNELS] +
+						  upper_after * upper[channel + NUM_CHANNELS] + upper_before * upper[channel];
+	}
+}
+
+void WeatherGrid::get_rate_at(double weather_station, double time, Sample& rates) const {
+	const size_t time_idx = times.find_cell(time);
+	const size_t station_idx = stations.find_cell(weather_station);
+	const double dt = times.inverse_widths[time_idx];
+	// spline2ddiffvi divides by the width of the cell here, rather than multiplying by its inverse
+	const double u = (weather_station - stations.knots[station_idx]) /
+					 (stations.knots[station_idx + 1] - stations.knots[station_idx]);
+
+	const size_t num_times = times.knots.size();
+	const double* lower = &values[(station_idx * num_times + time_idx) * NUM_CHANNELS];
+	const double* upper = lower + num_times * NUM_CHANNELS;
+	for (size_t channel = 0; channel < NUM_CHANNELS; ++channel) {
+		rates[channel] = (-(1 - u) * lower[channel] + (1 - u) * lower[channel + NUM_CHANNELS] +
+							 u * upper[channel + NUM_CHANNELS] - u * upper[channel]) *
+						 dt;
+	}
+}
+
+std::span<const double> WeatherGrid::get_times() const {
+	return times.knots;
+}
+
+std::span<const double> WeatherGrid::get_stations() const {
+	return stations.knots;
+}
+
+std::span<const double> WeatherGrid::get_values() const {
+	return values;
+}
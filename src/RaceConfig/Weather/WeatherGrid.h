@@ -0,0 +1,97 @@
+#ifndef MINISIM_WEATHERGRID_H
+#define MINISIM_WEATHERGRID_H
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "alglib/interpolation.h"
+
+/// The grid of a bilinear forecast spline, copied out into one contiguous array so it can be interpolated natively.
+///
+/// alglib's spline2dcalcv allocates its result on every call and binary searches both axes for the cell. Here the
+/// cell is worked out from the position on the axis, which is exact straight away on a uniform axis (the forecast's
+/// time axis is), and the channels of every grid point sit next to each other so all of them are interpolated in one
+/// loop that vectorizes. The results are exactly those of spline2dcalcv.
+class WeatherGrid {
+   public:
+	/// The weather values at every grid point, in the order of the forecast spline's channels.
+	enum Channel {
+		DHI,
+		DNI,
+		GHI,
+		WIND_NORTH_SOUTH,
+		WIND_EAST_WEST,
+		AIR_TEMPERATURE,
+		SURFACE_PRESSURE,
+		AIR_DENSITY,
+		NUM_CHANNELS,
+	};
+	using Sample = std::array<double, NUM_CHANNELS>;
+
+	WeatherGrid() = default;
+
+	/// @brief Copies out the grid of @p spline, a bilinear spline over time and weather station with at least
+	/// NUM_CHANNELS channels; any channels past those are left out.
+	///
+	/// @throws std::exception if @p spline is not such a spline.
+	explicit WeatherGrid(const alglib::spline2dinterpolant& spline);
+
+	/// @brief A grid over the values in @p values, laid out like get_values, which are not copied: @p storage must keep
+	/// them alive. Used to interpolate a grid in a memory mapped file.
+	///
+	/// @throws std::exception if either axis has fewer than 2 knots or is not strictly increasing, or if @p values does
+	/// not have NUM_CHANNELS values for every grid point.
+	WeatherGrid(std::span<const double> times, std::span<const double> stations, std::span<const double> values,
+		std::shared_ptr<const void> storage);
+
+	/// @brief Interpolates every channel at a fractional @p weather_station and @p time, extrapolating from the cells
+	/// at the edges outside the grid, like the spline does.
+	///
+	/// @param [out] sample The weather channels.
+	void get_sample_at(double weather_station, double time, Sample& sample) const;
+
+	/// @brief Differentiates every channel with respect to time at a fractional @p weather_station and @p time,
+	/// exactly as spline2ddiffvi does.
+	///
+	/// @param [out] rates (per second) The rate of change of each weather channel.
+	void get_rate_at(double weather_station, double time, Sample& rates) const;
+
+	/// @returns (epoch seconds) The times of the grid points, in increasing order.
+	std::span<const double> get_times() const;
+
+	/// @returns The weather stations of the grid points, in increasing order.
+	std::span<const double> get_stations() const;
+
+	/// @returns Every channel at every grid point: station-major, then time, then channel.
+	std::span<const double> get_values() const;
+
+   private:
+	/// One axis of the grid.
+	struct Axis {
+		/// The grid points along the axis, in increasing order.
+		std::vector<double> knots;
+		/// One over the length of every cell, exactly as the spline works it out.
+		std::vector<double> inverse_widths;
+		/// One over the average length of a cell, to find the cell a value is in.
+		double inverse_step;
+
+		/// @brief Sets up the axis through @p grid_knots, which must be at least 2 and strictly increasing.
+		void assign(std::span<const double> grid_knots);
+
+		/// @returns The index of the cell @p value is in, the last one whose start is below it: the same one the
+		/// spline's binary search finds.
+		size_t find_cell(double value) const;
+	};
+
+	Axis times;
+	Axis stations;
+	/// Keeps values alive: the vector they were copied into, or the file they are mapped from.
+	std::shared_ptr<const void> storage;
+	/// Every channel at every grid point: station-major, then time, then channel.
+	std::span<const double> values;
+};
+
+#endif  // MINISIM_WEATHERGRID_H
@@ -0,0 +1,16 @@
+#ifndef MINISIM_WEATHERPERTURBATION_H
+#define MINISIM_WEATHERPERTURBATION_H
+
+/// A change to a weather forecast, applied to every weather data point. The defaults change nothing.
+struct WeatherPerturbation {
+	/// the factor the irradiance is multiplied by
+	double irradiance_scale = 1;
+	/// (m/s) the wind added to the north-south component
+	double wind_north_south_offset = 0;
+	/// (m/s) the wind added to the east-west component
+	double wind_east_west_offset = 0;
+	/// the factor the air density is multiplied by
+	double air_density_scale = 1;
+};
+
+#endif  // MINISIM_WEATHERPERTURBATION_H
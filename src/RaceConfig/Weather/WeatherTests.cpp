@@ -0,0 +1,461 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/matchers/catch_matchers_floating_point.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "RaceConfig/WeatherStations/WeatherStations.h"
+#include "Tools/Dual.h"
+#include "Weather.h"
+#include "WeatherCache.h"
+#include "WeatherDataPoint.h"
+#include "WeatherGrid.h"
+#include "WeatherPerturbation.h"
+#include "WeatherTimelines.h"
+#include "alglib/ap.h"
+#include "alglib/interpolation.h"
+
+using Catch::Matchers::WithinAbs;
+
+namespace {
+	/// The number of channels of the splines the tests build: one more than the grid keeps, as the weather file's do.
+	constexpr size_t num_spline_channels = WeatherGrid::NUM_CHANNELS + 1;
+
+	/// @returns A bilinear spline through random values on a uniform time axis from @p start_time and a non-uniform
+	/// weather station axis.
+	alglib::spline2dinterpolant make_spline(double start_time, size_t num_times, std::mt19937_64& random) {
+		const std::vector<double> stations = {1, 2, 3.5, 7, 8};
+		std::uniform_real_distribution<double> value(-100, 1100);
+
+		alglib::real_1d_array times_array;
+		times_array.setlength(static_cast<alglib::ae_int_t>(num_times));
+		for (size_t i = 0; i < num_times; ++i) {
+			times_array[static_cast<alglib::ae_int_t>(i)] = start_time + 1800 * static_cast<double>(i);
+		}
+		alglib::real_1d_array stations_array;
+		stations_array.setcontent(static_cast<alglib::ae_int_t>(stations.size()), stations.data());
+		alglib::real_1d_array values_array;
+		values_array.setlength(static_cast<alglib::ae_int_t>(stations.size() * num_times * num_spline_channels));
+		for (alglib::ae_int_t i = 0; i < values_array.length(); ++i) {
+			values_array[i] = value(random);
+		}
+
+		alglib::spline2dinterpolant spline;
+		alglib::spline2dbuildbilinearv(times_array, static_cast<alglib::ae_int_t>(num_times), stations_array,
+			static_cast<alglib::ae_int_t>(stations.size()), values_array,
+			static_cast<alglib::ae_int_t>(num_spline_channels), spline);
+		return spline;
+	}
+
+	/// @brief Writes a forecast of random weather for weather stations 1 to @p num_stations, every half hour from
+	/// @p start_time, to @p path, laid out like the weather files in data/Weather.
+	void write_weather_file(const std::filesystem::path& path, double start_time, size_t num_stations,
+		size_t num_times, std::mt19937_64& random) {
+		std::uniform_real_distribution<double> irradiance(0, 1000);
+		std::uniform_real_distribution<double> wind(-5, 5);
+		std::uniform_real_distribution<double> air_temp(10, 30);
+		std::uniform_real_distribution<double> pressure(1000, 1020);
+		std::uniform_real_distribution<double> air_density(1.1, 1.2);
+
+		std::ofstream stream(path);
+		stream.precision(10);
+		stream << "weather_group,period_time_unix,dhi,dni,ghi,wind_velocity_10m_ns,wind_velocity_10m_ew,air_temp_2m,"
+				  "surface_pressure,air_density\n";
+		for (size_t station = 1; station <= num_stations; ++station) {
+			for (size_t i = 0; i < num_times; ++i) {
+				stream << station << ',' << start_time + 1800 * static_cast<double>(i) << ',' << irradiance(random)
+					   << ',' << irradiance(random) << ',' << irradiance(random) << ',' << wind(random) << ','
+					   << wind(random) << ',' << air_temp(random) << ',' << pressure(random) << ','
+					   << air_density(random) << '\n';
+			}
+		}
+	}
+
+	/// @returns @p num_stations weather stations, for a forecast from write_weather_file.
+	WeatherStations make_weather_stations(size_t num_stations) {
+		return WeatherStations(
+			std::vector<GeographicalCoordinate>(num_stations, {.latitude = -12.420, .longitude = 130.878}));
+	}
+
+	/// Checks that @p result and @p expected are exactly the same weather.
+	void require_same_weather(const WeatherDataPoint& result, const WeatherDataPoint& expected) {
+		REQUIRE(result.wind.get_north_south() == expected.wind.get_north_south());
+		REQUIRE(result.wind.get_east_west() == expected.wind.get_east_west());
+		REQUIRE(result.irradiance == expected.irradiance);
+		REQUIRE(result.air_temp == expected.air_temp);
+		REQUIRE(result.pressure == expected.pressure);
+		REQUIRE(result.air_density == expected.air_density);
+		REQUIRE(result.reciprocal_speed_of_sound == expected.reciprocal_speed_of_sound);
+	}
+
+	/// @brief Replaces the last digit of @p path with another one, keeping the file the same size.
+	void change_last_digit(const std::filesystem::path& path) {
+		std::string contents;
+		{
+			std::ifstream stream(path, std::ios::binary);
+			contents.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+		}
+		const size_t digit = contents.find_last_of("0123456789");
+		REQUIRE(digit != std::string::npos);
+		contents[digit] = contents[digit] == '1' ? '2' : '1';
+		std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+		stream << contents;
+	}
+
+	/// Moves the modification time of @p path an hour on, as a checkout or a copy would.
+	void touch(const std::filesystem::path& path) {
+		std::filesystem::last_write_time(path, std::filesystem::last_write_time(path) + std::chrono::hours(1));
+	}
+
+	/// Checks that @p grid gives exactly what @p spline gives at @p weather_station and @p time.
+	void require_same_as_spline(
+		const WeatherGrid& grid, const alglib::spline2dinterpolant& spline, double weather_station, double time) {
+		WeatherGrid::Sample sample{};
+		grid.get_sample_at(weather_station, time, sample);
+		WeatherGrid::Sample rates{};
+		grid.get_rate_at(weather_station, time, rates);
+
+		alglib::real_1d_array expected;
+		alglib::spline2dcalcv(spline, time, weather_station, expected);
+		for (size_t channel = 0; channel < WeatherGrid::NUM_CHANNELS; ++channel) {
+			const auto spline_channel = static_cast<alglib::ae_int_t>(channel);
+			REQUIRE(sample[channel] == expected[spline_channel]);
+
+			double value = 0;
+			double rate = 0;
+			double station_rate = 0;
+			alglib::spline2ddiffvi(spline, time, weather_station, spline_channel, value, rate, station_rate);
+			REQUIRE(rates[channel] == rate);
+		}
+	}
+}  // namespace
+
+TEST_CASE("WeatherGrid: interpolates exactly like the spline", "[Weather]") {
+	std::mt19937_64 random(20070821);
+	constexpr double start_time = 1187654400;
+	constexpr size_t num_times = 49;
+	const alglib::spline2dinterpolant spline = make_spline(start_time, num_times, random);
+	const WeatherGrid grid(spline);
+	const std::vector<double> stations(grid.get_stations().begin(), grid.get_stations().end());
+	const std::vector<double> times(grid.get_times().begin(), grid.get_times().end());
+	REQUIRE(times.size() == num_times);
+	REQUIRE(stations.size() == 5);
+	REQUIRE(grid.get_values().size() == num_times * stations.size() * WeatherGrid::NUM_CHANNELS);
+
+	SECTION("At random points inside the grid") {
+		std::uniform_real_distribution<double> station(stations.front(), stations.back());
+		std::uniform_real_distribution<double> time(times.front(), times.back());
+		for (size_t i = 0; i < 2000; ++i) {
+			require_same_as_spline(grid, spline, station(random), time(random));
+		}
+	}
+
+	SECTION("At random points outside the grid, where the edge cells are extrapolated") {
+		std::uniform_real_distribution<double> station(-5, 15);
+		std::uniform_real_distribution<double> time(times.front() - 86400, times.back() + 86400);
+		for (size_t i = 0; i < 2000; ++i) {
+			const double query_station = station(random);
+			const double query_time = time(random);
+			if (query_station < stations.front() || query_station > stations.back() || query_time < times.front() ||
+				query_time > times.back()) {
+				require_same_as_spline(grid, spline, query_station, query_time);
+			}
+		}
+	}
+
+	SECTION("Exactly on the knots and halfway between them") {
+		for (const double station : stations) {
+			for (const double time : times) {
+				require_same_as_spline(grid, spline, station, time);
+			}
+		}
+		for (size_t i = 0; i + 1 < stations.size(); ++i) {
+			for (size_t j = 0; j + 1 < times.size(); ++j) {
+				require_same_as_spline(grid, spline, stations[i], 0.5 * (times[j] + times[j + 1]));
+				require_same_as_spline(grid, spline, 0.5 * (stations[i] + stations[i + 1]), times[j]);
+			}
+		}
+	}
+}
+
+TEST_CASE("Weather: get_weather_at_batch gives what get_weather_at gives", "[Weather]") {
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "minisim_weather_batch_test";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+	std::mt19937_64 random(20070822);
+	constexpr size_t num_stations = 6;
+	constexpr double start_time = 1187654400;
+	const std::string weather_file = (directory / "weather.csv").string();
+	write_weather_file(weather_file, start_time, num_stations, 96, random);
+	const Weather weather(weather_file, make_weather_stations(num_stations));
+
+	const auto [first_time, last_time] = weather.get_time_range();
+	REQUIRE(first_time == start_time);
+	std::uniform_real_distribution<double> station(1, num_stations);
+	std::uniform_real_distribution<double> time(first_time, last_time);
+	std::vector<double> stations;
+	std::vector<double> times;
+	for (size_t i = 0; i < 1000; ++i) {
+		stations.push_back(station(random));
+		times.push_back(time(random));
+	}
+	// Weather data points have no default, so the batch starts out with the weather anywhere
+	std::vector<WeatherDataPoint> batch(times.size(), weather.get_weather_at(1, first_time));
+	weather.get_weather_at_batch(stations, times, batch);
+	for (size_t i = 0; i < times.size(); ++i) {
+		require_same_weather(batch[i], weather.get_weather_at(stations[i], times[i]));
+	}
+	std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Weather: the derivatives of the weather are the slope of the timelines it is looked up in", "[Weather]") {
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "minisim_weather_rate_test";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+	std::mt19937_64 random(20070823);
+	constexpr size_t num_stations = 6;
+	constexpr double start_time = 1187654400;
+	const std::string weather_file = (directory / "weather.csv").string();
+	write_weather_file(weather_file, start_time, num_stations, 96, random);
+	const Weather weather(weather_file, make_weather_stations(num_stations));
+
+	// A resolution that does not divide the forecast's time step, so the timelines cut corners off the forecast
+	constexpr double resolution = 700;
+	const auto [first_time, last_time] = weather.get_time_range();
+	const Weather resampled = weather.with_timelines(first_time, last_time, resolution)
+								  .with_perturbation({.irradiance_scale = 0.8, .air_density_scale = 1.1});
+	std::uniform_real_distribution<double> station(1, num_stations);
+	std::uniform_int_distribution<size_t> sample(0, static_cast<size_t>((last_time - first_time) / resolution) - 1);
+	for (size_t i = 0; i < 200; ++i) {
+		// Halfway between two samples, so that a step either way stays on the same slope
+		const double weather_station = station(random);
+		const double time = first_time + (static_cast<double>(sample(random)) + 0.5) * resolution;
+		const auto result = resampled.get_weather_at<Dual<1>>(weather_station, Dual<1>::variable(time, 0));
+		const WeatherDataPoint before = resampled.get_weather_at(weather_station, time - resolution / 4);
+		const WeatherDataPoint after = resampled.get_weather_at(weather_station, time + resolution / 4);
+		const auto slope = [](double before, double after) { return (after - before) / (resolution / 2); };
+
+		REQUIRE_THAT(result.irradiance.derivatives[0], WithinAbs(slope(before.irradiance, after.irradiance), 1e-9));
+		REQUIRE_THAT(result.wind.get_north_south().derivatives[0],
+			WithinAbs(slope(before.wind.get_north_south(), after.wind.get_north_south()), 1e-9));
+		REQUIRE_THAT(result.wind.get_east_west().derivatives[0],
+			WithinAbs(slope(before.wind.get_east_west(), after.wind.get_east_west()), 1e-9));
+		REQUIRE_THAT(result.air_temp.derivatives[0], WithinAbs(slope(before.air_temp, after.air_temp), 1e-9));
+		REQUIRE_THAT(result.pressure.derivatives[0], WithinAbs(slope(before.pressure, after.pressure), 1e-9));
+		REQUIRE_THAT(
+			result.air_density.derivatives[0], WithinAbs(slope(before.air_density, after.air_density), 1e-9));
+	}
+	std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("WeatherCache: a cache only loads for the weather file it was made from", "[Weather]") {
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "minisim_weather_cache_test";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+	std::mt19937_64 random(20070823);
+	constexpr double start_time = 1187654400;
+	constexpr size_t num_times = 48;
+	const WeatherGrid grid(make_spline(start_time, num_times, random));
+	const size_t num_stations = grid.get_stations().size();
+	const std::filesystem::path weather_file = directory / "weather.csv";
+	const std::filesystem::path cache_file = directory / "weather.csv.grid.cache";
+	write_weather_file(weather_file, start_time, num_stations, num_times, random);
+
+	REQUIRE_FALSE(WeatherCache::load(weather_file.string(), num_stations).has_value());
+	WeatherCache::save(weather_file.string(), start_time, grid);
+	REQUIRE(std::filesystem::exists(cache_file));
+
+	SECTION("The grid loads back exactly as it was saved") {
+		const std::optional<std::pair<double, WeatherGrid>> cached =
+			WeatherCache::load(weather_file.string(), num_stations);
+		REQUIRE(cached.has_value());
+		REQUIRE(cached->first == start_time);
+		const WeatherGrid& loaded = cached->second;
+		REQUIRE(std::ranges::equal(loaded.get_times(), grid.get_times()));
+		REQUIRE(std::ranges::equal(loaded.get_stations(), grid.get_stations()));
+		REQUIRE(std::ranges::equal(loaded.get_values(), grid.get_values()));
+
+		std::uniform_real_distribution<double> station(0, 9);
+		std::uniform_real_distribution<double> time(start_time - 3600, start_time + 1800 * num_times + 3600);
+		for (size_t i = 0; i < 200; ++i) {
+			const double query_station = station(random);
+			const double query_time = time(random);
+			WeatherGrid::Sample expected{};
+			grid.get_sample_at(query_station, query_time, expected);
+			WeatherGrid::Sample result{};
+			loaded.get_sample_at(query_station, query_time, result);
+			REQUIRE(result == expected);
+		}
+	}
+
+	SECTION("Not for another number of weather stations") {
+		REQUIRE_FALSE(WeatherCache::load(weather_file.string(), num_stations - 1).has_value());
+		REQUIRE(WeatherCache::load(weather_file.string(), num_stations).has_value());
+	}
+
+	SECTION("Still once the weather file is touched without changing, which is recorded") {
+		touch(weather_file);
+		const auto touched_time = std::filesystem::last_write_time(weather_file);
+		REQUIRE(WeatherCache::load(weather_file.string(), num_stations).has_value());
+		// The load saved the cache again for the new modification time, so from now on the weather file is not hashed:
+		// a change that keeps its size and modification time goes unnoticed
+		change_last_digit(weather_file);
+		std::filesystem::last_write_time(weather_file, touched_time);
+		REQUIRE(WeatherCache::load(weather_file.string(), num_stations).has_value());
+	}
+
+	SECTION("Not once the cache is truncated") {
+		const auto size = std::filesystem::file_size(cache_file);
+		std::filesystem::resize_file(cache_file, size - sizeof(double));
+		REQUIRE_FALSE(WeatherCache::load(weather_file.string(), num_stations).has_value());
+		std::filesystem::resize_file(cache_file, 16);
+		REQUIRE_FALSE(WeatherCache::load(weather_file.string(), num_stations).has_value());
+		std::filesystem::resize_file(cache_file, 0);
+		REQUIRE_FALSE(WeatherCache::load(weather_file.string(), num_stations).has_value());
+	}
+
+	SECTION("Not once the weather file changes size") {
+		std::ofstream(weather_file, std::ios::app) << "6,1187654400,0,0,0,0,0,20,1010,1.1\n";
+		REQUIRE_FALSE(WeatherCache::load(weather_file.string(), num_stations).has_value());
+	}
+
+	SECTION("Not once the weather file is touched with other contents of the same size") {
+		const auto size = std::filesystem::file_size(weather_file);
+		change_last_digit(weather_file);
+		touch(weather_file);
+		REQUIRE(std::filesystem::file_size(weather_file) == size);
+		REQUIRE_FALSE(WeatherCache::load(weather_file.string(), num_stations).has_value());
+	}
+
+	std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("WeatherCache: the cache of older versions is left alone", "[Weather]") {
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "minisim_weather_old_cache_test";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+	std::mt19937_64 random(20070827);
+	constexpr size_t num_stations = 3;
+	const std::filesystem::path weather_file = directory / "weather.csv";
+	// Where older versions kept their alglib serialized spline, which they would fail to read a grid from
+	const std::filesystem::path old_cache_file = directory / "weather.csv.cache";
+	write_weather_file(weather_file, 1187654400, num_stations, 24, random);
+	const std::string old_cache = "an older version's cache";
+	std::ofstream(old_cache_file) << old_cache;
+
+	const Weather weather(weather_file.string(), make_weather_stations(num_stations));
+	REQUIRE(std::filesystem::exists(directory / "weather.csv.grid.cache"));
+	REQUIRE(WeatherCache::load(weather_file.string(), num_stations).has_value());
+	std::ifstream stream(old_cache_file);
+	const std::string contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	REQUIRE(contents == old_cache);
+
+	std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Weather: a weather file is parsed again once it changes", "[Weather]") {
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "minisim_weather_reload_test";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+	std::mt19937_64 random(20070824);
+	constexpr size_t num_stations = 4;
+	constexpr double start_time = 1187654400;
+	const WeatherStations weather_stations = make_weather_stations(num_stations);
+	const std::filesystem::path weather_file = directory / "weather.csv";
+	const std::filesystem::path cache_file = directory / "weather.csv.grid.cache";
+
+	write_weather_file(weather_file, start_time, num_stations, 48, random);
+	const Weather parsed(weather_file.string(), weather_stations);
+	REQUIRE(std::filesystem::exists(cache_file));
+	const Weather cached(weather_file.string(), weather_stations);
+
+	// The same times, with other weather, in a file of the same size
+	change_last_digit(weather_file);
+	touch(weather_file);
+	const Weather changed(weather_file.string(), weather_stations);
+	std::filesystem::remove(cache_file);
+	const Weather reparsed(weather_file.string(), weather_stations);
+
+	std::uniform_real_distribution<double> station(1, num_stations);
+	std::uniform_real_distribution<double> time(start_time, start_time + 1800 * 47);
+	for (size_t i = 0; i < 200; ++i) {
+		const double query_station = station(random);
+		const double query_time = time(random);
+		require_same_weather(cached.get_weather_at(query_station, query_time),
+			parsed.get_weather_at(query_station, query_time));
+		require_same_weather(changed.get_weather_at(query_station, query_time),
+			reparsed.get_weather_at(query_station, query_time));
+	}
+	// The last digit is the last station's air density at the last time
+	REQUIRE(changed.get_weather_at(num_stations, start_time + 1800 * 47).air_density !=
+			parsed.get_weather_at(num_stations, start_time + 1800 * 47).air_density);
+
+	std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("Weather: a forecast of many files is the same on any number of threads", "[Weather]") {
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "minisim_weather_threads_test";
+	std::filesystem::remove_all(directory);
+	constexpr size_t num_stations = 5;
+	constexpr size_t num_times = 24;
+	constexpr double first_day = 1187654400;
+	const WeatherStations weather_stations = make_weather_stations(num_stations);
+	// Days out of order, and two files starting on the same day, of which the one given last is used
+	const std::vector<size_t> days = {3, 0, 5, 2, 1, 4, 2};
+
+	// Writes the same files into a directory of their own, so every load parses them rather than reading the caches
+	// the others made
+	const auto write_files = [&](const std::string& name) {
+		std::filesystem::create_directories(directory / name);
+		std::mt19937_64 random(20070825);
+		std::vector<std::string> weather_files;
+		for (size_t i = 0; i < days.size(); ++i) {
+			const std::filesystem::path weather_file = directory / name / ("weather" + std::to_string(i) + ".csv");
+			write_weather_file(weather_file, first_day + 86400 * static_cast<double>(days[i]), num_stations,
+				num_times, random);
+			weather_files.push_back(weather_file.string());
+		}
+		return weather_files;
+	};
+	const std::vector<std::string> serial_files = write_files("serial");
+	const std::vector<std::string> parallel_files = write_files("parallel");
+	const Weather serial(serial_files, weather_stations, 1);
+	const Weather parallel(parallel_files, weather_stations, 4);
+	// Loaded again from the caches the serial load made
+	const Weather cached(serial_files, weather_stations, 4);
+	// The file given last for day 2
+	const Weather last_of_day_2(serial_files.back(), weather_stations);
+
+	REQUIRE(parallel.get_time_range() == serial.get_time_range());
+	REQUIRE(cached.get_time_range() == serial.get_time_range());
+	REQUIRE(serial.get_time_range().first == first_day);
+	REQUIRE(parallel.get_weather_station_knots() == serial.get_weather_station_knots());
+
+	std::mt19937_64 random(20070826);
+	std::uniform_real_distribution<double> station(1, num_stations);
+	std::uniform_real_distribution<double> day(0, 6);
+	std::uniform_real_distribution<double> time_of_day(0, 1800 * (num_times - 1));
+	for (size_t i = 0; i < 1000; ++i) {
+		const double query_station = station(random);
+		const double query_time = first_day + 86400 * std::floor(day(random)) + time_of_day(random);
+		const WeatherDataPoint expected = serial.get_weather_at(query_station, query_time);
+		require_same_weather(parallel.get_weather_at(query_station, query_time), expected);
+		require_same_weather(cached.get_weather_at(query_station, query_time), expected);
+		if (query_time >= first_day + 2 * 86400 && query_time < first_day + 3 * 86400) {
+			require_same_weather(last_of_day_2.get_weather_at(query_station, query_time), expected);
+		}
+	}
+
+	std::filesystem::remove_all(directory);
+}
@@ -0,0 +1,220 @@
+#include "WeatherTimelines.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include "Weather.h"
+#include "WeatherDataPoint.h"
+
+namespace {
+	/// @returns The channels of @p data_point, in WeatherTimelines order.
+	WeatherTimelines::Sample to_sample(const WeatherDataPoint& data_point) {
+		return {
+			data_point.irradiance,
+			data_point.wind.get_north_south(),
+			data_point.wind.get_east_west(),
+			data_point.air_temp,
+			data_point.pressure,
+			data_point.air_density,
+		};
+	}
+}  // namespace
+
+WeatherTimelines::WeatherTimelines(
+	const Weather& weather, double start_time, double end_time, double resolution, Integration integration)
+	: start_time(start_time),
+	  resolution(resolution),
+	  inverse_resolution(1 / resolution),
+	  integration(integration),
+	  num_samples(static_cast<size_t>(std::ceil((end_time - start_time) / resolution)) + 1),
+	  stations(weather.get_weather_station_knots()) {
+	assert(resolution > 0 && end_time >= start_time && !stations.empty());
+
+	samples.reserve(stations.size() * num_samples * NUM_CHANNELS);
+	irradiance_sums.reserve(stations.size() * (num_samples + 1));
+	for (const double station : stations) {
+		double irradiance_sum = 0;
+		irradiance_sums.push_back(irradiance_sum);
+		for (size_t i = 0; i < num_samples; ++i) {
+			const double time = start_time + static_cast<double>(i) * resolution;
+			const Sample sample = to_sample(weather.get_weather_at(station, time));
+			samples.insert(samples.end(), sample.begin(), sample.end());
+			irradiance_sum += sample[GHI];
+			irradiance_sums.push_back(irradiance_sum);
+		}
+	}
+
+	// Halfway between samples is where resampling cuts the most off the forecast, and halfway between stations is where
+	// the blend would show if the forecast were not linear in the station
+	std::vector<double> check_stations = stations;
+	for (size_t k = 0; k + 1 < stations.size(); ++k) {
+		check_stations.push_back((stations[k] + stations[k + 1]) / 2);
+	}
+	for (const double station : check_stations) {
+		for (size_t i = 0; i + 1 < num_samples; ++i) {
+			const double time = start_time + (static_cast<double>(i) + 0.5) * resolution;
+			const Sample expected = to_sample(weather.get_weather_at(station, time));
+			Sample sample;
+			get_sample_at(station, time, sample);
+			for (size_t channel = 0; channel < NUM_CHANNELS; ++channel) {
+				const double deviation = std::abs(sample[channel] - expected[channel]);
+				// Written so that a NaN is kept, rather than hidden by the next comparison
+				if (!(deviation <= max_deviation[channel])) {
+					max_deviation[channel] = deviation;
+				}
+			}
+		}
+	}
+}
+
+bool WeatherTimelines::get_sample_at(double weather_station, double time, Sample& sample) const {
+	const double position = (time - start_time) * inverse_resolution;
+	// Written so that NaN is outside too
+	if (!(position >= 0 && position <= static_cast<double>(num_samples - 1)) ||
+		!(weather_station >= stations.front() && weather_station <= stations.back())) {
+		return false;
+	}
+
+	// The two samples around the time, and the two stations around the weather station
+	const size_t sample_idx = std::min(static_cast<size_t>(position), num_samples > 1 ? num_samples - 2 : 0);
+	const double time_weight = position - static_cast<double>(sample_idx);
+	const size_t next_sample = num_samples > 1 ? NUM_CHANNELS : 0;
+
+	double station_weight = 0;
+	const size_t station_idx = find_station(weather_station, station_weight);
+	const size_t next_station = stations.size() > 1 ? num_samples * NUM_CHANNELS : 0;
+
+	const double* lower = &samples[(station_idx * num_samples + sample_idx) * NUM_CHANNELS];
+	const double* upper = lower + next_station;
+	for (size_t channel = 0; channel < NUM_CHANNELS; ++channel) {
+		const double lower_value = lower[channel] + time_weight * (lower[channel + next_sample] - lower[channel]);
+		const double upper_value = upper[channel] + time_weight * (upper[channel + next_sample] - upper[channel]);
+		sample[channel] = lower_value + station_weight * (upper_value - lower_value);
+	}
+	return true;
+}
+
+bool WeatherTimelines::get_rate_at(double weather_station, double time, Sample& rates) const {
+	const double position = (time - start_time) * inverse_resolution;
+	// Written so that NaN is outside too
+	if (!(position >= 0 && position <= static_cast<double>(num_samples - 1)) ||
+		!(weather_station >= stations.front() && weather_station <= stations.back())) {
+		return false;
+	}
+
+	// The same samples and stations get_sample_at blends; a single sample has no slope
+	const size_t sample_idx = std::min(static_cast<size_t>(position), num_samples > 1 ? num_samples - 2 : 0);
+	const size_t next_sample = num_samples > 1 ? NUM_CHANNELS : 0;
+
+	double station_weight = 0;
+	const size_t station_idx = find_station(weather_station, station_weight);
+	const size_t next_station = stations.size() > 1 ? num_samples * NUM_CHANNELS : 0;
+
+	const double* lower = &samples[(station_idx * num_samples + sample_idx) * NUM_CHANNELS];
+	const double* upper = lower + next_station;
+	for (size_t channel = 0; channel < NUM_CHANNELS; ++channel) {
+		const double lower_slope = lower[channel + next_sample] - lower[channel];
+		const double upper_slope = upper[channel + next_sample] - upper[channel];
+		rates[channel] = (lower_slope + station_weight * (upper_slope - lower_slope)) * inverse_resolution;
+	}
+	return true;
+}
+
+bool WeatherTimelines::get_irradiance_integral(
+	double weather_station, double start_time, double end_time, double increment, double& integral) const {
+	const double start_position = (start_time - this->start_time) * inverse_resolution;
+	const double end_position = (end_time - this->start_time) * inverse_resolution;
+	// Written so that NaN is outside too
+	if (num_samples < 2 || !(start_position >= 0 && end_position <= static_cast<double>(num_samples - 1)) ||
+		!(weather_station >= stations.front() && weather_station <= stations.back())) {
+		return false;
+	}
+	if (end_time <= start_time) {
+		integral = 0;
+		return true;
+	}
+
+	const size_t last_sample = num_samples - 1;
+	const size_t start_idx = std::min(static_cast<size_t>(start_position), last_sample - 1);
+	const double start_weight = start_position - static_cast<double>(start_idx);
+	size_t num_steps = 0;
+	if (integration == Integration::STEPPED) {
+		// Every step starts as far past a sample as the first one does, so the irradiance at the start of every step
+		// is the same blend of two running sums of samples
+		num_steps = static_cast<size_t>(std::ceil((end_time - start_time) / increment));
+		if (increment != resolution || start_idx + num_steps + (start_weight > 0 ? 1 : 0) > last_sample) {
+			return false;
+		}
+	}
+
+	const auto integrate = [&](size_t station_idx) {
+		const double* ghi = &samples[station_idx * num_samples * NUM_CHANNELS + GHI];
+		const double* sums = &irradiance_sums[station_idx * (num_samples + 1)];
+		const auto ghi_at = [&](size_t idx, double weight) {
+			const double value = ghi[idx * NUM_CHANNELS];
+			return weight > 0 ? value + weight * (ghi[(idx + 1) * NUM_CHANNELS] - value) : value;
+		};
+
+		if (integration == Integration::STEPPED) {
+			const size_t end_idx = start_idx + num_steps;
+			double sum = (1 - start_weight) * (sums[end_idx + 1] - sums[start_idx]);
+			if (start_weight > 0) {
+				sum += start_weight * (sums[end_idx + 2] - sums[start_idx + 1]);
+			}
+			// Trapezoids count the irradiance at both ends of the window half as much
+			return resolution * (sum - (ghi_at(start_idx, start_weight) + ghi_at(end_idx, start_weight)) / 2);
+		}
+
+		// The integral from the first sample to a position: trapezoids up to the sample before it, then one more up
+		// to it
+		const auto integral_to = [&](double position) {
+			const size_t idx = std::min(static_cast<size_t>(position), last_sample - 1);
+			const double weight = position - static_cast<double>(idx);
+			return resolution * (sums[idx + 1] - (ghi[0] + ghi_at(idx, 0)) / 2 +
+									weight * (ghi_at(idx, 0) + ghi_at(idx, weight)) / 2);
+		};
+		return integral_to(end_position) - integral_to(start_position);
+	};
+
+	double station_weight = 0;
+	const size_t station_idx = find_station(weather_station, station_weight);
+	const double lower = integrate(station_idx);
+	integral = station_weight > 0 ? lower + station_weight * (integrate(station_idx + 1) - lower) : lower;
+	return true;
+}
+
+size_t WeatherTimelines::get_memory_use() const {
+	return (samples.size() + irradiance_sums.size() + stations.size()) * sizeof(double);
+}
+
+size_t WeatherTimelines::get_num_stations() const {
+	return stations.size();
+}
+
+size_t WeatherTimelines::get_num_samples() const {
+	return num_samples;
+}
+
+double WeatherTimelines::get_resolution() const {
+	return resolution;
+}
+
+const WeatherTimelines::Sample& WeatherTimelines::get_max_deviation() const {
+	return max_deviation;
+}
+
+size_t WeatherTimelines::find_station(double weather_station, double& station_weight) const {
+	const auto above = std::upper_bound(stations.begin(), stations.end(), weather_station);
+	const size_t station_idx = std::min(static_cast<size_t>(std::distance(stations.begin(), above)) - 1,
+		stations.size() > 1 ? stations.size() - 2 : 0);
+	station_weight = 0;
+	if (stations.size() > 1) {
+		station_weight =
+			(weather_station - stations[station_idx]) / (stations[station_idx + 1] - stations[station_idx]);
+	}
+	return station_idx;
+}
@@ -0,0 +1,115 @@
+#ifndef MINISIM_WEATHERTIMELINES_H
+#define MINISIM_WEATHERTIMELINES_H
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+class Weather;
+
+/// The weather of a forecast resampled into one uniformly spaced time series per weather station, so that looking it
+/// up is an index and a few linear interpolations over contiguous memory rather than a 2D spline evaluation.
+///
+/// The forecast spline is bilinear in time and weather station, so in between two of the stations it is given at, the
+/// weather is exactly a linear blend of the two stations' time series. Only those stations are sampled, and a lookup
+/// at a fractional station blends the two around it. Resampling in time is exact when the resolution divides the
+/// forecast's own time step and the timelines start on one of its data points; otherwise the timelines cut corners
+/// off the forecast, by at most get_max_deviation().
+///
+/// Every station's irradiance samples are also summed up as they go, so that the irradiance collected over any time
+/// window, e.g. while static charging, takes two lookups and a subtraction.
+class WeatherTimelines {
+   public:
+	/// The weather values kept for every sample, in the order they are stored.
+	enum Channel {
+		GHI,
+		WIND_NORTH_SOUTH,
+		WIND_EAST_WEST,
+		AIR_TEMPERATURE,
+		SURFACE_PRESSURE,
+		AIR_DENSITY,
+		NUM_CHANNELS,
+	};
+	using Sample = std::array<double, NUM_CHANNELS>;
+
+	/// How get_irradiance_integral integrates the irradiance over a time window.
+	enum class Integration {
+		/// Like static charging always has: the average of the irradiance at both ends of every increment from the
+		/// start of the window, the last increment running past the end of the window if need be. Only the increment
+		/// the timelines are sampled at can be looked up.
+		STEPPED,
+		/// The exact integral of the timelines over the window, whatever the increment.
+		EXACT,
+	};
+
+	/// @brief Samples @p weather every @p resolution seconds from @p start_time through to @p end_time (rounded up to
+	/// a whole sample), at every weather station the forecast is given at.
+	///
+	/// @param weather The forecast to sample, without any perturbation: Weather applies that after the lookup.
+	/// @param start_time (epoch seconds) The first sample, inside the forecast.
+	/// @param end_time (epoch seconds) The time the last sample must reach.
+	/// @param resolution (seconds, > 0) The time between samples.
+	/// @param integration How get_irradiance_integral integrates.
+	WeatherTimelines(const Weather& weather, double start_time, double end_time, double resolution,
+		Integration integration = Integration::STEPPED);
+
+	/// @brief Looks up the weather at a fractional @p weather_station and @p time.
+	///
+	/// @param [out] sample The weather channels, if covered.
+	/// @returns false, leaving @p sample alone, if @p weather_station or @p time is outside the timelines.
+	bool get_sample_at(double weather_station, double time, Sample& sample) const;
+
+	/// @brief Looks up the rate of change over time of the weather at a fractional @p weather_station and @p time: the
+	/// slope of the sample interval @p time is in, the later one at a sample itself.
+	///
+	/// @param [out] rates (per second) The rate of change of each weather channel, if covered.
+	/// @returns false, leaving @p rates alone, if @p weather_station or @p time is outside the timelines.
+	bool get_rate_at(double weather_station, double time, Sample& rates) const;
+
+	/// @brief Integrates the irradiance at a fractional @p weather_station from @p start_time to @p end_time, in
+	/// @p increment steps or exactly (see Integration).
+	///
+	/// @param increment (seconds) The length of the steps, if integrating in steps.
+	/// @param [out] integral (W s / m^2) The integral, if it can be looked up.
+	/// @returns false, leaving @p integral alone, if the window is outside the timelines or the steps are not the
+	/// resolution of the timelines.
+	bool get_irradiance_integral(
+		double weather_station, double start_time, double end_time, double increment, double& integral) const;
+
+	/// @returns (bytes) The memory the samples take up.
+	size_t get_memory_use() const;
+
+	/// @returns The number of weather stations sampled.
+	size_t get_num_stations() const;
+
+	/// @returns The number of samples in each station's timeline.
+	size_t get_num_samples() const;
+
+	/// @returns (seconds) The time between samples.
+	double get_resolution() const;
+
+	/// @returns The largest difference from the forecast spline of each channel, measured halfway between every two
+	/// samples, at the sampled stations and halfway between them.
+	const Sample& get_max_deviation() const;
+
+   private:
+	/// @returns The index of the sampled station at or below @p weather_station, short of the last one.
+	/// @param [out] station_weight How far @p weather_station is from that station to the next one, from 0 to 1.
+	size_t find_station(double weather_station, double& station_weight) const;
+
+	/// (epoch seconds) The time of the first sample.
+	double start_time;
+	double resolution;
+	double inverse_resolution;
+	Integration integration;
+	size_t num_samples;
+	/// The weather stations sampled, in increasing order.
+	std::vector<double> stations;
+	/// Every channel of every sample of every station: station-major, then time, then channel.
+	std::vector<double> samples;
+	/// For every station, the sum of the irradiance of its samples before each sample (and of all of them, last).
+	std::vector<double> irradiance_sums;
+	Sample max_deviation = {};
+};
+
+#endif  // MINISIM_WEATHERTIMELINES_H
@@ -0,0 +1,38 @@
+#include "RaceEvents.h"
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace RaceRunner {
+	namespace {
+		/// @returns Whether @p lhs happens after @p rhs, which puts the earliest event on top of a std heap.
+		bool happens_after(const RaceEvent& lhs, const RaceEvent& rhs) {
+			if (lhs.time != rhs.time) {
+				return lhs.time > rhs.time;
+			}
+			return lhs.type > rhs.type;
+		}
+	}  // namespace
+
+	void RaceEventQueue::push(const RaceEvent& event) {
+		events.push_back(event);
+		std::push_heap(events.begin(), events.end(), happens_after);
+	}
+
+	RaceEvent RaceEventQueue::pop() {
+		assert(!events.empty());
+		std::pop_heap(events.begin(), events.end(), happens_after);
+		const RaceEvent event = events.back();
+		events.pop_back();
+		return event;
+	}
+
+	bool RaceEventQueue::empty() const {
+		return events.empty();
+	}
+
+	double RaceEventQueue::next_time() const {
+		return events.empty() ? std::numeric_limits<double>::infinity() : events.front().time;
+	}
+}  // namespace RaceRunner
@@ -0,0 +1,54 @@
+#ifndef MINISIM_RACEEVENTS_H
+#define MINISIM_RACEEVENTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace RaceRunner {
+	/// The things that happen to a race at a set clock time, rather than at the end of a route segment. Events that
+	/// fall on the same time happen in this order.
+	enum class RaceEventType : uint8_t {
+		/// The racing window of the day closes. The car finishes the segment it is on, then rests.
+		RACE_DAY_END,
+		/// The resting car starts static charging.
+		CHARGING_START,
+		/// The resting car stops static charging, and collects everything since the last CHARGING_START.
+		CHARGING_END,
+		/// The racing window of the day opens, and the car drives on.
+		RACE_DAY_START,
+	};
+
+	struct RaceEvent {
+		/// (epoch seconds) When the event happens.
+		double time;
+		RaceEventType type;
+		/// The index of the schedule day the event belongs to.
+		size_t day;
+	};
+
+	/// @brief The events still to come in a race, earliest first.
+	///
+	/// A race loop only has to compare its clock with next_time() between segments; whatever the schedule does
+	/// happens when it pops the events that have come due.
+	class RaceEventQueue {
+	   public:
+		void push(const RaceEvent& event);
+
+		/// @brief Removes and returns the next event.
+		///
+		/// @requires !empty().
+		RaceEvent pop();
+
+		bool empty() const;
+
+		/// @returns (epoch seconds) The time of the next event, or infinity if there is none.
+		double next_time() const;
+
+	   private:
+		/// A binary min-heap on (time, type).
+		std::vector<RaceEvent> events;
+	};
+}  // namespace RaceRunner
+
+#endif  // MINISIM_RACEEVENTS_H
@@ -1,115 +1,732 @@
 #include "RaceRunner.h"
-#include "RaceSegmentRunner/RaceSegmentRunner.h"
-#include "Tools/Conversions.h"
-#include <vector>
-#include <optional>
+
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <optional>
+#include <span>
+#include <vector>
 
-using namespace std;
+#include "RaceEvents.h"
+#include "RaceTrace.h"
+#include "Tools/Conversions.h"
+#include "Tools/Dual.h"
+
+namespace {
+	/// (seconds) How long the car is held at every control stop.
+	constexpr double control_stop_duration = 1800;
+
+	/// Relative slack on the early-abort bounds. The lower bound on the remaining time sums the segments in a
+	/// different order than the race loop does, so the two can disagree in the last few bits.
+	constexpr double bound_tolerance = 1e-9;
+
+	/// How a call to drive() ended.
+	enum class DriveResult {
+		/// The car reached the end segment, or the finish.
+		REACHED,
+		/// The car ran out of energy or schedule.
+		FAILED,
+		/// The caller asked to stop before the car got there.
+		STOPPED,
+	};
+
+	/// @brief The schedule side of a race: a small state machine, in which the car is either racing or resting,
+	/// driven by a queue of RaceEvents.
+	///
+	/// Everything the car does between two racing windows is a run of events, and every charging window it rests
+	/// through is collected in one closed-form static charging gain. The race loop only has to compare its clock with
+	/// get_due_time() between segments. While the car is racing, the only event queued is the end of the day's racing
+	/// window, and the car is always racing again by the time it drives on, so a clock can be set up afresh from the
+	/// RaceProgress whenever a race loop picks a race up. That end is only queued once it comes due, so setting a clock
+	/// up allocates nothing, however often a race is picked up.
+	class RaceClock {
+	   public:
+		RaceClock(const SolarCar& car, const Route& route, const Weather& weather, const RaceSchedule& schedule,
+			RaceRunner::RaceProgress& progress)
+			: car(car), route(route), weather(weather), schedule(schedule), progress(progress) {
+			if (progress.day < schedule.size()) {
+				due_time = schedule[progress.day].race_end_time;
+			} else {
+				// Out of schedule, which catch_up reports as soon as it is asked
+				racing = false;
+				due_time = -std::numeric_limits<double>::infinity();
+			}
+		}
+
+		/// @returns (epoch seconds) The time from which catch_up() has to be called before the car drives on.
+		double get_due_time() const {
+			return due_time;
+		}
+
+		/// @brief Works through every event that is due before the car can drive on.
+		///
+		/// @returns false if the race ran out of schedule.
+		bool catch_up() {
+			if (racing && events.empty()) {
+				push_race_day_end();
+			}
+			while (!racing || progress.current_time >= events.next_time()) {
+				if (events.empty()) {
+					return false;  // Race not completed within the schedule
+				}
+				handle(events.pop());
+			}
+			due_time = events.next_time();
+			return true;
+		}
+
+	   private:
+		void handle(const RaceRunner::RaceEvent& event) {
+			using RaceRunner::RaceEventType;
+			switch (event.type) {
+				case RaceEventType::RACE_DAY_END: {
+					racing = false;
+					const SingleDaySchedule& today = schedule[event.day];
+					events.push({today.evening_charging_start_time, RaceEventType::CHARGING_START, event.day});
+					events.push({today.evening_charging_end_time, RaceEventType::CHARGING_END, event.day});
+
+					++progress.day;
+					if (progress.day < schedule.size()) {
+						const SingleDaySchedule& tomorrow = schedule[progress.day];
+						events.push(
+							{tomorrow.morning_charging_start_time, RaceEventType::CHARGING_START, progress.day});
+						events.push({tomorrow.morning_charging_end_time, RaceEventType::CHARGING_END, progress.day});
+						events.push({tomorrow.race_start_time, RaceEventType::RACE_DAY_START, progress.day});
+					}
+					break;
+				}
+				case RaceEventType::CHARGING_START: {
+					charging_start_time = event.time;
+					break;
+				}
+				case RaceEventType::CHARGING_END: {
+					progress.energy_remaining += RaceRunner::calculate_static_charging_gain(car, weather,
+						route.get_compiled().weather_station[progress.segment_idx], charging_start_time, event.time);
+					break;
+				}
+				case RaceEventType::RACE_DAY_START: {
+					racing = true;
+					progress.current_time = event.time;
+					push_race_day_end();
+					break;
+				}
+			}
+		}
+
+		void push_race_day_end() {
+			events.push({schedule[progress.day].race_end_time, RaceRunner::RaceEventType::RACE_DAY_END, progress.day});
+		}
+
+		const SolarCar& car;
+		const Route& route;
+		const Weather& weather;
+		const RaceSchedule& schedule;
+		RaceRunner::RaceProgress& progress;
+
+		RaceRunner::RaceEventQueue events;
+		bool racing = true;
+		/// (epoch seconds) The start of the charging window the car is resting in.
+		double charging_start_time = 0;
+		/// (epoch seconds) See get_due_time().
+		double due_time;
+	};
+
+	/// How much of a race drive() records.
+	enum class Tracing {
+		/// Nothing: no tracing is compiled in at all.
+		OFF,
+		/// The columns of RaceTrace::Detail::PROGRESS, which the race works out anyway.
+		PROGRESS,
+		/// Every column, for which the race also has to work out where the power went.
+		FULL,
+	};
+
+	/// @brief drive_segment for segment @p segment_idx of a compiled route, with exactly the same result.
+	///
+	/// @param [out] record The net power if the segment can be driven, and with Tracing::FULL the weather and where
+	/// the power went. Left alone with Tracing::OFF.
+	///
+	/// Kept out of line: inlined into a traced race loop, it leaves the loop short of registers, which costs the race
+	/// more than the call does.
+	template <Tracing tracing>
+	[[gnu::noinline]] std::optional<double> drive_segment(const CarKernel& kernel, const SolarCar& car,
+		const Weather& weather, const CompiledRoute& route, size_t segment_idx, double speed, double& current_time,
+		double& energy_remaining, RaceRunner::TraceRecord& record) {
+		const double time_required = route.distance[segment_idx] / speed;
+
+		const WeatherDataPoint weather_data =
+			weather.get_weather_during(route.weather_station[segment_idx], current_time, current_time + time_required);
+
+		const double state_of_charge = car.battery.state_of_charge(energy_remaining);
+		std::optional<double> segment_net_power;
+		if constexpr (tracing == Tracing::FULL) {
+			RaceSegmentRunner::PowerBreakdown breakdown{};
+			segment_net_power =
+				kernel.calculate_power_net(route, segment_idx, weather_data, state_of_charge, speed, breakdown);
+			record.power_in = breakdown.power_in;
+			record.power_out = breakdown.power_out;
+			record.power_loss = breakdown.power_loss;
+			record.aero_force = breakdown.aero_force;
+			record.rolling_force = breakdown.rolling_force;
+			record.grade_force = breakdown.grade_force;
+			record.irradiance = weather_data.irradiance;
+			record.wind_north_south = weather_data.wind.get_north_south();
+			record.wind_east_west = weather_data.wind.get_east_west();
+			record.air_temperature = weather_data.air_temp;
+			record.air_density = weather_data.air_density;
+		} else {
+			segment_net_power =
+				kernel.calculate_power_net<double>(route, segment_idx, weather_data, state_of_charge, speed);
+		}
+		if (!segment_net_power.has_value()) {
+			return std::nullopt;
+		}
+		if constexpr (tracing != Tracing::OFF) {
+			record.power_net = segment_net_power.value();
+		}
+
+		energy_remaining += segment_net_power.value() * (time_required / 3600.0);
+		current_time += time_required;
+		return time_required;
+	}
+
+	/// @brief Never stops a race early.
+	bool never_stop(const RaceRunner::RaceProgress& /*progress*/) {
+		return false;
+	}
+
+	/// @brief The race loop shared by every entry point. @p speed_of maps a segment index to the speed to drive it at.
+	/// @p should_stop is asked before every segment whether to give up on the race. Unless @p tracing is Tracing::OFF,
+	/// every segment driven is recorded into @p trace, which must keep the columns @p tracing works out.
+	template <Tracing tracing = Tracing::OFF, typename SpeedOf, typename ShouldStop>
+	DriveResult drive(const CarKernel& kernel, const SolarCar& car, const Route& route, const Weather& weather,
+		const RaceSchedule& schedule, const SpeedOf& speed_of, const ShouldStop& should_stop, size_t end_segment,
+		RaceRunner::RaceProgress& progress, RaceRunner::RaceTrace* trace = nullptr) {
+		const CompiledRoute& compiled = route.get_compiled();
+		const size_t num_segments = compiled.size();
+
+		if (progress.failed) {
+			return DriveResult::FAILED;
+		}
+
+		RaceClock clock(car, route, weather, schedule, progress);
+		while (!progress.finished && progress.segment_idx < end_segment) {
+			if (progress.current_time >= clock.get_due_time() && !clock.catch_up()) {
+				progress.failed = true;
+				return DriveResult::FAILED;
+			}
+			if (should_stop(progress)) {
+				return DriveResult::STOPPED;
+			}
+
+			const size_t segment_idx = progress.segment_idx;
+			const double speed = speed_of(segment_idx);
+			RaceRunner::TraceRecord record;
+			const std::optional<double> time_required = drive_segment<tracing>(kernel, car, weather, compiled,
+				segment_idx, speed, progress.current_time, progress.energy_remaining, record);
+
+			if (!time_required.has_value() || progress.energy_remaining < 0) {
+				progress.failed = true;
+				return DriveResult::FAILED;
+			}
+
+			progress.total_time += time_required.value();
+			progress.minimum_energy_remaining = std::min(progress.minimum_energy_remaining, progress.energy_remaining);
+			if constexpr (tracing != Tracing::OFF) {
+				record.segment = static_cast<double>(segment_idx);
+				record.day = static_cast<double>(progress.day);
+				record.time = progress.current_time;
+				record.total_time = progress.total_time;
+				record.speed = speed;
+				record.energy_remaining = progress.energy_remaining;
+				if constexpr (tracing == Tracing::FULL) {
+					record.state_of_charge = car.battery.state_of_charge(progress.energy_remaining);
+				}
+				trace->record(record);
+			}
+
+			const uint8_t end_flags = compiled.end_flags[segment_idx];
+			if ((end_flags & CompiledRoute::ENDS_IN_CONTROL_STOP) != 0) {
+				progress.energy_remaining += RaceRunner::calculate_static_charging_gain(car, weather,
+					compiled.weather_station[segment_idx], progress.current_time,
+					progress.current_time + control_stop_duration);
+				progress.current_time += control_stop_duration;
+				progress.total_time += control_stop_duration;
+			} else if ((end_flags & CompiledRoute::ENDS_RACE) != 0) {
+				progress.finished = true;
+				return DriveResult::REACHED;
+			}
+
+			++progress.segment_idx;
+			if (progress.segment_idx >= num_segments) {
+				progress.finished = true;
+			}
+		}
+
+		return DriveResult::REACHED;
+	}
+}  // namespace
 
 double RaceRunner::calculate_static_charging_gain(
-    const SolarCar& car, const Weather& weather, double weather_station, double start_time, double end_time) {
-
-        //car is not moving
-
-        const double increment = 300;
-        double solar_car_energy = 0;
-
-        for (double time = start_time; time < end_time; time += increment) {
-            solar_car_energy += car.array.power_in(weather.get_weather_during(weather_station, time, time+increment).irradiance);
-        }
-
-
-        return solar_car_energy * (3.0/36.0);
+	const SolarCar& car, const Weather& weather, double weather_station, double start_time, double end_time) {
+	// The power the array takes in is proportional to the irradiance, so the energy is what it takes in from the
+	// irradiance integrated over the window, in hours
+	if (const std::optional<double> irradiance_integral =
+			weather.get_irradiance_integral(weather_station, start_time, end_time, static_charging_increment)) {
+		return car.array.power_in(irradiance_integral.value() / 3600.0);
+	}
+	return calculate_static_charging_gain<double>(car, weather, weather_station, start_time, end_time);
 }
 
+RaceRunner::RaceProgress RaceRunner::start_race(const SolarCar& car, const RaceSchedule& schedule) {
+	RaceProgress progress;
+	progress.energy_remaining = car.battery.get_capacity();
+	progress.minimum_energy_remaining = progress.energy_remaining;
+	if (schedule.size() > 0) {
+		progress.current_time = schedule[0].race_start_time;
+	}
+	return progress;
+}
 
-std::optional<double> RaceRunner::calculate_racetime( 
-        const SolarCar& car, const Route& route, const Weather& weather, const RaceSchedule& schedule, double speed) {
-
-    RaceSegmentRunner RSR = RaceSegmentRunner(car);
-
-    double total_time = 0;
-    double energy_remaining = car.battery.get_capacity(); 
-    double stateOfCharge = car.battery.state_of_charge(energy_remaining); 
-    size_t segment_idx = 0;
-    size_t num_segments = route.get_num_segments();
-
-    for (size_t day = 0; day < schedule.size(); ++day) {
-        const SingleDaySchedule& daily_schedule = schedule[day];
-
-        double morningChargeStart = daily_schedule.morning_charging_start_time;
-        double morningChargeEnd = daily_schedule.morning_charging_end_time;
-        double eveningChargeStart = daily_schedule.evening_charging_start_time;
-        double eveningChargeEnd = daily_schedule.evening_charging_end_time;
-
-        double raceStartTime = daily_schedule.race_start_time;
-        double raceEndTime = daily_schedule.race_end_time;
-
-        if (day > 0) {
-            double weather_station = route.get_segment(segment_idx).weather_station;
-            double morning_charge_gain = calculate_static_charging_gain(
-                car, weather, weather_station, morningChargeStart, morningChargeEnd
-            );
-            energy_remaining += morning_charge_gain;
-        }
-
-        double current_time = raceStartTime;
-
-        while (current_time < raceEndTime && segment_idx < num_segments) {
-            const RouteSegment & segment = route.get_segment(segment_idx);
-            double time_required = segment.distance / speed;
+bool RaceRunner::drive_segments(const SolarCar& car, const Route& route, const Weather& weather,
+	const RaceSchedule& schedule, std::span<const double> speed_profile, size_t end_segment, RaceProgress& progress) {
+	assert(end_segment <= speed_profile.size());
+	const CarKernel kernel(car);
+	return drive(kernel, car, route, weather, schedule,
+			   [speed_profile](size_t segment_idx) { return speed_profile[segment_idx]; }, never_stop, end_segment,
+			   progress) == DriveResult::REACHED;
+}
 
-            WeatherDataPoint weather_data = weather.get_weather_during(segment.weather_station, current_time, current_time + time_required);
+std::optional<double> RaceRunner::calculate_racetime(
+	const SolarCar& car, const Route& route, const Weather& weather, const RaceSchedule& schedule, double speed) {
+	const CarKernel kernel(car);
+	RaceProgress progress = start_race(car, schedule);
 
-            stateOfCharge = car.battery.state_of_charge(energy_remaining);
-            std::optional<double> segment_net_power = RSR.calculate_power_net(
-                segment, weather_data, stateOfCharge, speed 
-            ); 
+	if (drive(kernel, car, route, weather, schedule, [speed](size_t) { return speed; }, never_stop,
+			route.get_num_segments(), progress) != DriveResult::REACHED) {
+		return std::nullopt;
+	}
+	return progress.total_time;
+}
 
-            if (!segment_net_power.has_value()) {
-                return std::nullopt;
-            }
+std::optional<RaceRunner::RaceSummary> RaceRunner::calculate_race_summary(
+	const SolarCar& car, const Route& route, const Weather& weather, const RaceSchedule& schedule, double speed) {
+	const CarKernel kernel(car);
+	RaceProgress progress = start_race(car, schedule);
+
+	if (drive(kernel, car, route, weather, schedule, [speed](size_t) { return speed; }, never_stop,
+			route.get_num_segments(), progress) != DriveResult::REACHED) {
+		return std::nullopt;
+	}
+	return RaceSummary{
+		.racetime = progress.total_time,
+		.minimum_state_of_charge = car.battery.state_of_charge(progress.minimum_energy_remaining),
+		.final_state_of_charge = car.battery.state_of_charge(progress.energy_remaining),
+	};
+}
 
-            energy_remaining += segment_net_power.value() * seconds_to_hours(time_required);//this is joules rn
-            //seconds to hours unde tools
-            // seconds_to_days( seconds);
+RaceRunner::CoarseningError RaceRunner::calculate_coarsening_error(const SolarCar& car, const Route& route,
+	const Route& coarse_route, const Weather& weather, const RaceSchedule& schedule, double speed) {
+	const std::span<const size_t> source_segments = coarse_route.get_source_segments();
+	assert(source_segments.size() == coarse_route.get_num_segments() + 1 &&
+		   source_segments.back() == route.get_num_segments());
+	const std::vector<double> speed_profile(route.get_num_segments(), speed);
+	const std::vector<double> coarse_speed_profile(coarse_route.get_num_segments(), speed);
+
+	CoarseningError error{.energy = 0, .time = 0, .same_outcome = true};
+	RaceProgress progress = start_race(car, schedule);
+	RaceProgress coarse_progress = progress;
+	for (size_t i = 0; i < coarse_route.get_num_segments(); ++i) {
+		const bool made_it =
+			drive_segments(car, route, weather, schedule, speed_profile, source_segments[i + 1], progress);
+		const bool coarse_made_it =
+			drive_segments(car, coarse_route, weather, schedule, coarse_speed_profile, i + 1, coarse_progress);
+		if (!made_it || !coarse_made_it) {
+			// A race that runs out of schedule can fail a few segments earlier on one route: race both to the end
+			const bool finishes =
+				drive_segments(car, route, weather, schedule, speed_profile, route.get_num_segments(), progress);
+			const bool coarse_finishes = drive_segments(car, coarse_route, weather, schedule, coarse_speed_profile,
+				coarse_route.get_num_segments(), coarse_progress);
+			error.same_outcome = finishes == coarse_finishes;
+			break;
+		}
+		// A longer segment can carry the car further past the end of a race day, so for a few segments one race may
+		// already have charged overnight and the other not. Those points compare different days, not the routes
+		if (progress.day == coarse_progress.day) {
+			error.energy =
+				std::max(error.energy, std::abs(progress.energy_remaining - coarse_progress.energy_remaining));
+			error.time = std::max(error.time, std::abs(progress.total_time - coarse_progress.total_time));
+		}
+		if (progress.finished || coarse_progress.finished) {
+			error.same_outcome = progress.finished == coarse_progress.finished;
+			break;
+		}
+	}
+	return error;
+}
 
-            if (energy_remaining < 0) {
-                return std::nullopt;
-            }
+std::vector<std::optional<double>> RaceRunner::calculate_racetime_batch(const SolarCar& car, const Route& route,
+	const Weather& weather, const RaceSchedule& schedule, std::span<const double> speeds) {
+	std::vector<std::optional<double>> racetimes(speeds.size());
+
+	// The races still going, packed at the front of every array. A race that ends is swapped with the last one.
+	std::vector<size_t> lane_race(speeds.size());
+	std::vector<double> lane_speed(speeds.begin(), speeds.end());
+	std::vector<RaceProgress> lane_progress(speeds.size(), start_race(car, schedule));
+	std::vector<double> time_required(speeds.size());
+	std::vector<double> state_of_charge(speeds.size());
+	std::vector<double> net_power(speeds.size());
+	std::vector<WeatherDataPoint> weather_data;
+	weather_data.reserve(speeds.size());
+	for (size_t race = 0; race < speeds.size(); ++race) {
+		lane_race[race] = race;
+	}
+	size_t num_lanes = speeds.size();
+
+	const auto end_lane = [&](size_t lane, std::optional<double> racetime) {
+		racetimes[lane_race[lane]] = racetime;
+		--num_lanes;
+		lane_race[lane] = lane_race[num_lanes];
+		lane_speed[lane] = lane_speed[num_lanes];
+		lane_progress[lane] = lane_progress[num_lanes];
+		time_required[lane] = time_required[num_lanes];
+		net_power[lane] = net_power[num_lanes];
+	};
+
+	const CarKernel kernel(car);
+	const CompiledRoute& compiled = route.get_compiled();
+	const std::span<const RouteSegment> segments = route.get_segments_span();
+	for (size_t segment_idx = 0; segment_idx < segments.size() && num_lanes > 0; ++segment_idx) {
+		const RouteSegment& segment = segments[segment_idx];
+
+		// Each race moves on to its next day on its own, before it drives this segment
+		weather_data.clear();
+		for (size_t lane = 0; lane < num_lanes;) {
+			RaceProgress& progress = lane_progress[lane];
+			progress.segment_idx = segment_idx;
+			bool in_schedule = progress.day < schedule.size();
+			if (in_schedule && progress.current_time >= schedule[progress.day].race_end_time) {
+				in_schedule = RaceClock(car, route, weather, schedule, progress).catch_up();
+			}
+			if (!in_schedule) {
+				end_lane(lane, std::nullopt);
+				continue;
+			}
+
+			time_required[lane] = segment.distance / lane_speed[lane];
+			weather_data.push_back(weather.get_weather_during(
+				segment.weather_station, progress.current_time, progress.current_time + time_required[lane]));
+			state_of_charge[lane] = car.battery.state_of_charge(progress.energy_remaining);
+			++lane;
+		}
+
+		kernel.calculate_power_net_batch(compiled, segment_idx, weather_data,
+			std::span(state_of_charge).first(num_lanes), std::span(lane_speed).first(num_lanes),
+			std::span(net_power).first(num_lanes));
+
+		for (size_t lane = 0; lane < num_lanes;) {
+			RaceProgress& progress = lane_progress[lane];
+			if (std::isnan(net_power[lane])) {
+				end_lane(lane, std::nullopt);
+				continue;
+			}
+
+			progress.energy_remaining += net_power[lane] * seconds_to_hours(time_required[lane]);
+			if (progress.energy_remaining < 0) {
+				end_lane(lane, std::nullopt);
+				continue;
+			}
+
+			progress.current_time += time_required[lane];
+			progress.total_time += time_required[lane];
+
+			if (segment.end_condition == SegmentEndCondition::CONTROL_STOP) {
+				progress.energy_remaining += calculate_static_charging_gain(car, weather, segment.weather_station,
+					progress.current_time, progress.current_time + control_stop_duration);
+				progress.current_time += control_stop_duration;
+				progress.total_time += control_stop_duration;
+			} else if (segment.end_condition == SegmentEndCondition::END_OF_RACE) {
+				end_lane(lane, progress.total_time);
+				continue;
+			}
+			++lane;
+		}
+	}
+
+	// Whoever is left drove off the end of the route
+	for (size_t lane = 0; lane < num_lanes; ++lane) {
+		racetimes[lane_race[lane]] = lane_progress[lane].total_time;
+	}
+	return racetimes;
+}
 
-            current_time += time_required;
-            total_time += time_required;
+RaceRunner::BoundedRacetime RaceRunner::calculate_racetime(const SolarCar& car, const Route& route,
+	const Weather& weather, const RaceSchedule& schedule, double speed, double racetime_bound,
+	const PruneCallback& should_prune) {
+	const CompiledRoute& compiled = route.get_compiled();
+
+	// Tally everything between the start and the segment that ends the race
+	size_t num_race_segments = compiled.size();
+	double remaining_distance = 0;
+	size_t remaining_control_stops = 0;
+	double longest_segment = 0;
+	for (size_t i = 0; i < compiled.size(); ++i) {
+		remaining_distance += compiled.distance[i];
+		longest_segment = std::max(longest_segment, compiled.distance[i]);
+		if ((compiled.end_flags[i] & CompiledRoute::ENDS_IN_CONTROL_STOP) != 0) {
+			++remaining_control_stops;
+		} else if ((compiled.end_flags[i] & CompiledRoute::ENDS_RACE) != 0) {
+			num_race_segments = i + 1;
+			break;
+		}
+	}
+
+	// (seconds) The racing time in all the days after each day
+	std::vector<double> racing_time_after(schedule.size(), 0);
+	for (size_t day = schedule.size(); day-- > 1;) {
+		racing_time_after[day - 1] = racing_time_after[day] + schedule[day].race_end_time - schedule[day].race_start_time;
+	}
+	// The last segment of a day may start right before the race window closes, and end in a control stop
+	const double overrun_per_day = longest_segment / speed + control_stop_duration;
+
+	size_t counted_segments = 0;
+	const auto should_stop = [&](const RaceProgress& progress) {
+		for (; counted_segments < progress.segment_idx; ++counted_segments) {
+			remaining_distance -= compiled.distance[counted_segments];
+			if ((compiled.end_flags[counted_segments] & CompiledRoute::ENDS_IN_CONTROL_STOP) != 0) {
+				--remaining_control_stops;
+			}
+		}
+
+		// Even with no nights in the way, the rest of the race takes at least this long
+		const double time_needed =
+			remaining_distance / speed + static_cast<double>(remaining_control_stops) * control_stop_duration;
+		if (progress.total_time + time_needed > racetime_bound * (1 + bound_tolerance)) {
+			return true;
+		}
+
+		// ...and it has to fit in what is left of the schedule
+		const double time_available = schedule[progress.day].race_end_time - progress.current_time +
+									  racing_time_after[progress.day] +
+									  static_cast<double>(schedule.size() - progress.day) * overrun_per_day;
+		if (time_needed > time_available * (1 + bound_tolerance)) {
+			return true;
+		}
+
+		return should_prune && should_prune(progress);
+	};
+
+	const CarKernel kernel(car);
+	RaceProgress progress = start_race(car, schedule);
+	const DriveResult result = drive(kernel, car, route, weather, schedule, [speed](size_t) { return speed; },
+		should_stop, route.get_num_segments(), progress);
+
+	switch (result) {
+		case DriveResult::REACHED:
+			return BoundedRacetime{.racetime = progress.total_time};
+		case DriveResult::STOPPED:
+			return BoundedRacetime{
+				.racetime = std::nullopt,
+				.pruned = true,
+				.segments_skipped = num_race_segments - progress.segment_idx,
+			};
+		case DriveResult::FAILED:
+		default:
+			return BoundedRacetime{.racetime = std::nullopt};
+	}
+}
 
-            if (segment.end_condition == 0) {
-                double checkpoint_time = 1800;
-                energy_remaining += calculate_static_charging_gain(
-                    car, weather, segment.weather_station, current_time, current_time + checkpoint_time
-                );
-                current_time += checkpoint_time;
-                total_time += checkpoint_time;
-            } else if (segment.end_condition == 1) {
-                return total_time;  // Race completed
-            }
+std::optional<double> RaceRunner::calculate_racetime(const SolarCar& car, const Route& route, const Weather& weather,
+	const RaceSchedule& schedule, std::span<const double> speed_profile) {
+	if (speed_profile.size() != route.get_num_segments()) {
+		throw std::exception();
+	}
+
+	RaceProgress progress = start_race(car, schedule);
+	if (!drive_segments(car, route, weather, schedule, speed_profile, route.get_num_segments(), progress)) {
+		return std::nullopt;
+	}
+	return progress.total_time;
+}
 
-            segment_idx++;
-        }
+std::optional<double> RaceRunner::trace_race(const SolarCar& car, const Route& route, const Weather& weather,
+	const RaceSchedule& schedule, std::span<const double> speed_profile, RaceTrace& trace) {
+	if (speed_profile.size() != route.get_num_segments()) {
+		throw std::exception();
+	}
+
+	const CarKernel kernel(car);
+	RaceProgress progress = start_race(car, schedule);
+	const auto speed_of = [speed_profile](size_t segment_idx) { return speed_profile[segment_idx]; };
+	const DriveResult result = trace.get_detail() == RaceTrace::Detail::FULL
+								   ? drive<Tracing::FULL>(kernel, car, route, weather, schedule, speed_of, never_stop,
+										 route.get_num_segments(), progress, &trace)
+								   : drive<Tracing::PROGRESS>(kernel, car, route, weather, schedule, speed_of,
+										 never_stop, route.get_num_segments(), progress, &trace);
+	if (result != DriveResult::REACHED) {
+		return std::nullopt;
+	}
+	return progress.total_time;
+}
 
-        if (segment_idx >= num_segments) {
-            return total_time;  // Race completed
-        }
+RaceRunner::RacetimeGradient RaceRunner::calculate_racetime_gradient(const SolarCar& car, const Route& route,
+	const Weather& weather, const RaceSchedule& schedule, std::span<const double> speed_profile, double energy_reserve,
+	double penalty_weight) {
+	if (speed_profile.size() != route.get_num_segments()) {
+		throw std::exception();
+	}
+
+	// Each segment is simulated with the clock, the battery and the speed before it as the independent variables
+	using Scalar = Dual<3>;
+	constexpr size_t clock = 0;
+	constexpr size_t battery = 1;
+	constexpr size_t speed = 2;
+
+	/// How one segment (and the control stop after it) depends on the state before it.
+	struct SegmentDerivatives {
+		Scalar time_required;
+		/// The energy right after driving, before any control stop charging
+		Scalar energy_driven;
+		Scalar current_time;
+		Scalar energy_remaining;
+		/// Whether a new race day started right before the segment, which resets the clock
+		bool day_started;
+	};
+
+	const size_t num_segments = route.get_num_segments();
+	RacetimeGradient result{
+		.objective = std::numeric_limits<double>::infinity(),
+		.minimum_energy = car.battery.get_capacity(),
+		.gradient = std::vector<double>(num_segments),
+	};
+
+	const CarKernel kernel(car);
+	const CompiledRoute& compiled = route.get_compiled();
+	RaceProgress progress = start_race(car, schedule);
+	std::vector<SegmentDerivatives> segments;
+	segments.reserve(num_segments);
+	double penalty = 0;
+
+	while (!progress.finished) {
+		bool in_schedule = progress.day < schedule.size();
+		bool day_started = false;
+		if (in_schedule && progress.current_time >= schedule[progress.day].race_end_time) {
+			in_schedule = RaceClock(car, route, weather, schedule, progress).catch_up();
+			day_started = true;
+		}
+		if (!in_schedule) {
+			return result;
+		}
+
+		const RouteSegment& segment = route.get_segment(progress.segment_idx);
+		Scalar current_time = Scalar::variable(progress.current_time, clock);
+		Scalar energy_remaining = Scalar::variable(progress.energy_remaining, battery);
+		const std::optional<Scalar> time_required = drive_segment(kernel, car, weather, compiled, progress.segment_idx,
+			Scalar::variable(speed_profile[progress.segment_idx], speed), current_time, energy_remaining);
+		if (!time_required.has_value()) {
+			return result;
+		}
+
+		const Scalar energy_driven = energy_remaining;
+		const double shortfall = energy_reserve - energy_driven.value;
+		if (shortfall > 0) {
+			penalty += penalty_weight * shortfall * shortfall;
+		}
+		result.minimum_energy = std::min(result.minimum_energy, energy_driven.value);
+		progress.total_time += time_required->value;
+
+		if (segment.end_condition == SegmentEndCondition::CONTROL_STOP) {
+			energy_remaining += calculate_static_charging_gain<Scalar>(
+				car, weather, segment.weather_station, current_time, current_time + control_stop_duration);
+			current_time += control_stop_duration;
+			progress.total_time += control_stop_duration;
+		} else if (segment.end_condition == SegmentEndCondition::END_OF_RACE) {
+			progress.finished = true;
+		}
+
+		progress.current_time = current_time.value;
+		progress.energy_remaining = energy_remaining.value;
+		segments.push_back(SegmentDerivatives{
+			.time_required = time_required.value(),
+			.energy_driven = energy_driven,
+			.current_time = current_time,
+			.energy_remaining = energy_remaining,
+			.day_started = day_started,
+		});
+
+		++progress.segment_idx;
+		if (progress.segment_idx >= num_segments) {
+			progress.finished = true;
+		}
+	}
+
+	// Sweep backwards, carrying the derivatives of the rest of the objective with respect to the clock and the battery
+	double clock_adjoint = 0;
+	double battery_adjoint = 0;
+	for (size_t i = segments.size(); i-- > 0;) {
+		const SegmentDerivatives& derivatives = segments[i];
+		const double shortfall = energy_reserve - derivatives.energy_driven.value;
+		const double penalty_slope = shortfall > 0 ? -2 * penalty_weight * shortfall : 0;
+
+		std::array<double, 3> adjoints{};
+		for (size_t variable = 0; variable < adjoints.size(); ++variable) {
+			adjoints[variable] = derivatives.time_required.derivatives[variable] +
+								 penalty_slope * derivatives.energy_driven.derivatives[variable] +
+								 clock_adjoint * derivatives.current_time.derivatives[variable] +
+								 battery_adjoint * derivatives.energy_remaining.derivatives[variable];
+		}
+		result.gradient[i] = adjoints[speed];
+		// Overnight charging adds a fixed amount of energy, but the next day always starts at the same time
+		clock_adjoint = derivatives.day_started ? 0 : adjoints[clock];
+		battery_adjoint = adjoints[battery];
+	}
+
+	result.objective = progress.total_time + penalty;
+	return result;
+}
 
-        double evening_charge_gain = calculate_static_charging_gain(
-            car, weather, route.get_segment(segment_idx).weather_station, eveningChargeStart, eveningChargeEnd
-        );
-        energy_remaining += evening_charge_gain;
-    }
+RaceRunner::RaceState::RaceState(
+	const SolarCar& car, const Route& route, const Weather& weather, const RaceSchedule& schedule)
+	: car(car), route(route), weather(weather), schedule(schedule), kernel(car), progress(start_race(car, schedule)) {}
 
-    return std::nullopt;  // Race not completed within the schedule
+RaceRunner::RaceProgress RaceRunner::RaceState::snapshot() const {
+	return progress;
 }
 
+void RaceRunner::RaceState::restore(const RaceProgress& snapshot) {
+	progress = snapshot;
+}
 
+bool RaceRunner::RaceState::step_segment(double speed) {
+	return drive(kernel, car, route, weather, schedule, [speed](size_t) { return speed; }, never_stop,
+			   progress.segment_idx + 1, progress) == DriveResult::REACHED;
+}
 
+bool RaceRunner::RaceState::run_until_day_end(double speed) {
+	// The first segment starts the next day if today's racing window has already closed
+	if (!step_segment(speed)) {
+		return false;
+	}
+
+	const size_t today = progress.day;
+	while (!progress.finished && !progress.failed && progress.current_time < schedule[today].race_end_time) {
+		step_segment(speed);
+	}
+	return !progress.failed;
+}
 
+bool RaceRunner::RaceState::run_until(size_t end_segment, std::span<const double> speed_profile) {
+	assert(end_segment <= speed_profile.size());
+	return drive(kernel, car, route, weather, schedule,
+			   [speed_profile](size_t segment_idx) { return speed_profile[segment_idx]; }, never_stop, end_segment,
+			   progress) == DriveResult::REACHED;
+}
 
+const RaceRunner::RaceProgress& RaceRunner::RaceState::get_progress() const {
+	return progress;
+}
@@ -1,14 +1,26 @@
 #ifndef MINISIM_RACERUNNER_H
 #define MINISIM_RACERUNNER_H
 
+#include <cstddef>
+#include <functional>
 #include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
 
 #include "RaceConfig/RaceSchedule/RaceSchedule.h"
 #include "RaceConfig/Route/Route.h"
 #include "RaceConfig/Weather/Weather.h"
+#include "RaceSegmentRunner/CarKernel.h"
+#include "SolarCar/CarModels.h"
 #include "SolarCar/SolarCar.h"
 
 namespace RaceRunner {
+	class RaceTrace;
+
+	/// (seconds) The time step static charging is calculated in.
+	constexpr double static_charging_increment = 300;
+
 	/// @brief Calculates the Watt-hours of energy gained while static charging. This means the energy gained while not
 	/// moving and simply charging.
 	///
@@ -26,9 +38,84 @@ namespace RaceRunner {
 	/// @param [in] start_time The time to start static charging calculation.
 	/// @param [in] end_time The time to end static charging calculation.
 	/// @returns (Wh) the total energy gained by static charging.
+	///
+	/// If @p weather has timelines that can integrate the irradiance over the window, this is two lookups rather than
+	/// a weather lookup every increment; the timelines decide whether that is in increments or exact.
 	double calculate_static_charging_gain(
 		const SolarCar& car, const Weather& weather, double weather_station, double start_time, double end_time);
 
+	/// @brief calculate_static_charging_gain for times that carry derivatives (e.g. dual numbers).
+	template <typename Scalar>
+	Scalar calculate_static_charging_gain(const SolarCar& car, const Weather& weather, double weather_station,
+		const std::type_identity_t<Scalar>& start_time, const std::type_identity_t<Scalar>& end_time) {
+		// car is not moving
+		const double increment = static_charging_increment;
+		Scalar solar_car_energy = 0;
+
+		for (Scalar time = start_time; time < end_time; time += increment) {
+			solar_car_energy +=
+				car.array.power_in<Scalar>(
+				weather.get_weather_during<Scalar>(weather_station, time, time + increment).irradiance);
+		}
+
+		return solar_car_energy * (3.0 / 36.0);
+	}
+
+	/// @brief Drives a single route segment at @p speed, without any of the day or control stop bookkeeping around it.
+	///
+	/// This is the step every race loop is built from. It is templated on the scalar type so that it can also run on
+	/// dual numbers, to get the exact derivatives of the clock and the battery with respect to the speed and the state
+	/// before the segment, and on the car, so that it drives any CarModel through its kernel.
+	///
+	/// @param [in, out] current_time (epoch seconds) The clock time, moved on by the time the segment takes.
+	/// @param [in, out] energy_remaining (Wh) The energy in the battery, updated with the net energy of the segment.
+	/// This may go negative; it is up to the caller to decide what that means.
+	/// @returns (seconds) The time the segment took, or std::nullopt if driving it at @p speed is physically
+	/// impossible.
+	template <typename Scalar, CarModel Car>
+	std::optional<Scalar> drive_segment(const BasicCarKernel<Car>& kernel, const Car& car, const Weather& weather,
+		const CompiledRoute& route, size_t segment_idx, const Scalar& speed, Scalar& current_time,
+		Scalar& energy_remaining) {
+		const Scalar time_required = route.distance[segment_idx] / speed;
+
+		const BasicWeatherDataPoint<Scalar> weather_data = weather.get_weather_during<Scalar>(
+			route.weather_station[segment_idx], current_time, current_time + time_required);
+
+		const Scalar state_of_charge = car.battery.template state_of_charge<Scalar>(energy_remaining);
+		const std::optional<Scalar> segment_net_power =
+			kernel.template calculate_power_net<Scalar>(route, segment_idx, weather_data, state_of_charge, speed);
+
+		if (!segment_net_power.has_value()) {
+			return std::nullopt;
+		}
+
+		// seconds_to_hours, for any scalar type
+		energy_remaining += segment_net_power.value() * (time_required / 3600.0);
+		current_time += time_required;
+		return time_required;
+	}
+
+	/// @brief Where a race stands in between two route segments. This is everything needed to pick the simulation
+	/// back up from that point.
+	struct RaceProgress {
+		/// (seconds) The time spent racing so far: driving plus control stops, but not nights.
+		double total_time = 0;
+		/// (epoch seconds) The current clock time.
+		double current_time = 0;
+		/// (Wh) The energy left in the battery.
+		double energy_remaining = 0;
+		/// (Wh) The least energy that has been left in the battery so far, right after driving a segment.
+		double minimum_energy_remaining = 0;
+		/// The index of the next route segment to drive.
+		size_t segment_idx = 0;
+		/// The index of the current schedule day.
+		size_t day = 0;
+		/// Whether the car has crossed the finish.
+		bool finished = false;
+		/// Whether the car ran out of energy or schedule before the finish.
+		bool failed = false;
+	};
+
 	/// @brief Calculates the total racetime of a race with the given parameters, traveling at a constant speed.
 	///
 	/// Each Race Day is divided into up to four stages:
@@ -58,6 +145,201 @@ namespace RaceRunner {
 	/// the car runs out of energy before finishing the race, returns std::nullopt.
 	std::optional<double> calculate_racetime(
 		const SolarCar& car, const Route& route, const Weather& weather, const RaceSchedule& schedule, double speed);
+
+	/// @brief What a finished race looks like.
+	struct RaceSummary {
+		/// (seconds) The total racetime.
+		double racetime;
+		/// (fraction of capacity) The lowest the battery got during the race, right after driving a segment.
+		double minimum_state_of_charge;
+		/// (fraction of capacity) The charge left in the battery at the finish. The simulation does not cap charging at
+		/// the capacity, so this can be over 1 after a slow race.
+		double final_state_of_charge;
+	};
+
+	/// @brief Races at a constant speed like calculate_racetime, and also reports how low the battery got.
+	///
+	/// @returns The racetime and states of charge, or std::nullopt if the car does not finish.
+	std::optional<RaceSummary> calculate_race_summary(
+		const SolarCar& car, const Route& route, const Weather& weather, const RaceSchedule& schedule, double speed);
+
+	/// @brief How far a race on a coarse route (see Route::coarsen) drifts from the same race on its source route.
+	struct CoarseningError {
+		/// (Wh) The largest difference in the energy left in the battery.
+		double energy;
+		/// (seconds) The largest difference in the time spent racing.
+		double time;
+		/// Whether the car finishes on both routes or on neither.
+		bool same_outcome;
+	};
+
+	/// @brief Races at a constant speed on @p coarse_route and on the route it was built from, and compares the two
+	/// races at the end of every segment of the coarse route, which is also the end of a segment of the source route.
+	///
+	/// @param [in] route The source route.
+	/// @param [in] coarse_route A route built by route.coarsen().
+	/// @returns The worst differences over the points both races reach.
+	CoarseningError calculate_coarsening_error(const SolarCar& car, const Route& route, const Route& coarse_route,
+		const Weather& weather, const RaceSchedule& schedule, double speed);
+
+	/// @brief Calculates the racetimes of many constant speed races at once, one per entry of @p speeds.
+	///
+	/// Every race follows exactly the same framework as calculate_racetime, and gets exactly the same result. The races
+	/// advance over the route in lock-step: each segment is read once for all of them, their state is kept as
+	/// structure-of-arrays, and the per-segment physics runs over all the races still going with
+	/// CarKernel::calculate_power_net_batch. Every race still handles its own day boundaries and control stops.
+	///
+	/// @param [in] speeds (m/s) The (positive) speed of every race.
+	/// @returns (seconds) The racetime of every race, in the order of @p speeds, or std::nullopt for those where the
+	/// car does not finish.
+	std::vector<std::optional<double>> calculate_racetime_batch(const SolarCar& car, const Route& route,
+		const Weather& weather, const RaceSchedule& schedule, std::span<const double> speeds);
+
+	/// @brief Asked before every segment whether to give up on the race; returning true abandons it.
+	using PruneCallback = std::function<bool(const RaceProgress& progress)>;
+
+	/// @brief The result of a race simulation that may have been abandoned part way through.
+	struct BoundedRacetime {
+		/// (seconds) The total racetime, or std::nullopt if the car did not finish or the race was abandoned.
+		std::optional<double> racetime;
+		/// Whether the race was abandoned before the car finished or ran out of energy.
+		bool pruned = false;
+		/// The number of route segments that were never simulated because the race was abandoned.
+		size_t segments_skipped = 0;
+	};
+
+	/// @brief Calculates the racetime at a constant speed like calculate_racetime, but gives up as soon as the race
+	/// can no longer finish in under @p racetime_bound, or can no longer finish at all.
+	///
+	/// Before every segment, the rest of the race is bounded from below by driving the remaining distance at @p speed
+	/// and sitting out the remaining control stops. The race is abandoned if that bound, added to the time so far,
+	/// exceeds @p racetime_bound, or if it does not fit in the racing time left in the schedule. Both bounds are
+	/// admissible, so a race is only abandoned if it would have been slower than @p racetime_bound, or not finished.
+	///
+	/// @param [in] racetime_bound (seconds) The racetime to beat, e.g. the best found so far. Races that tie it are
+	/// still simulated to the end.
+	/// @param [in] should_prune An optional extra test for giving up, asked after the bounds above.
+	/// @returns The racetime if the car finished, and otherwise whether (and how early) the race was abandoned.
+	BoundedRacetime calculate_racetime(const SolarCar& car, const Route& route, const Weather& weather,
+		const RaceSchedule& schedule, double speed, double racetime_bound, const PruneCallback& should_prune = nullptr);
+
+	/// @brief Calculates the total racetime of a race with the given parameters, driving every segment at its own speed.
+	///
+	/// Follows exactly the same framework as the constant speed calculate_racetime.
+	///
+	/// @param [in] speed_profile (m/s) The speed to drive each segment of @p route at, indexed by segment. Must have
+	/// one (positive) speed per route segment.
+	/// @returns (seconds) The total time it takes to complete the given Route, including control stops. If
+	/// the car runs out of energy before finishing the race, returns std::nullopt.
+	std::optional<double> calculate_racetime(const SolarCar& car, const Route& route, const Weather& weather,
+		const RaceSchedule& schedule, std::span<const double> speed_profile);
+
+	/// @brief Races @p speed_profile like calculate_racetime, and records the state of the race after every segment
+	/// into @p trace.
+	///
+	/// The other race loops are compiled without any tracing, so they do not pay for it. Where the power went is only
+	/// worked out if @p trace keeps it (RaceTrace::Detail::FULL).
+	///
+	/// @param [in, out] trace The trace to record into. It is left open, so several races can go into one trace.
+	/// @returns (seconds) The total racetime, or std::nullopt if the car did not finish.
+	std::optional<double> trace_race(const SolarCar& car, const Route& route, const Weather& weather,
+		const RaceSchedule& schedule, std::span<const double> speed_profile, RaceTrace& trace);
+
+	/// @brief A speed profile's penalized racetime, with its exact gradient.
+	struct RacetimeGradient {
+		/// (seconds) The racetime plus the energy penalty, or +infinity if the profile cannot be driven at all.
+		double objective = 0;
+		/// (Wh) The least energy left in the battery right after driving any segment.
+		double minimum_energy = 0;
+		/// (seconds per m/s) The derivative of @p objective with respect to the speed of each segment.
+		std::vector<double> gradient;
+	};
+
+	/// @brief Calculates a smooth stand-in for the racetime of a speed profile, and its gradient, for gradient-based
+	/// optimizers.
+	///
+	/// The race follows the same framework as calculate_racetime, with one difference: running the battery down does
+	/// not end the race. Instead, every segment that leaves less than @p energy_reserve in the battery adds
+	/// @p penalty_weight * shortfall^2 to the racetime. Races that end with no shortfall have exactly the racetime
+	/// calculate_racetime gives them.
+	///
+	/// Every segment (and the control stop after it) is simulated on dual numbers, giving the exact derivatives of the
+	/// clock and the battery after it with respect to the clock, the battery and the speed before it. A backward sweep
+	/// over the route then chains them together, so the whole gradient costs about as much as a few simulations. The
+	/// day each segment falls on is held fixed: the gradient is that of the piece of the racetime the profile is in.
+	///
+	/// @param [in] speed_profile (m/s) The speed to drive each segment of @p route at, indexed by segment.
+	/// @param [in] energy_reserve (Wh) The energy the battery should never drop below.
+	/// @param [in] penalty_weight (seconds per Wh^2) How hard a shortfall is penalized.
+	RacetimeGradient calculate_racetime_gradient(const SolarCar& car, const Route& route, const Weather& weather,
+		const RaceSchedule& schedule, std::span<const double> speed_profile, double energy_reserve,
+		double penalty_weight);
+
+	/// @returns The progress at the very start of the race: a full battery at the start of the first race day.
+	RaceProgress start_race(const SolarCar& car, const RaceSchedule& schedule);
+
+	/// @brief Continues a race from @p progress until the car is about to drive segment @p end_segment, or finishes.
+	///
+	/// This follows the same day framework as calculate_racetime, so chaining calls over consecutive ranges of
+	/// segments gives exactly the same result as one call over the whole route. If the racing day ends right as the
+	/// car reaches @p end_segment, the overnight charging is left for the next call.
+	///
+	/// @param [in] speed_profile (m/s) The speed to drive each segment of @p route at, indexed by segment.
+	/// @param [in] end_segment The index of the first segment not to drive.
+	/// @param [in, out] progress The state of the race to continue from, updated in place.
+	/// @returns true if the car made it to @p end_segment (or the finish), false if it ran out of energy or schedule.
+	bool drive_segments(const SolarCar& car, const Route& route, const Weather& weather, const RaceSchedule& schedule,
+		std::span<const double> speed_profile, size_t end_segment, RaceProgress& progress);
+
+	/// @brief A race in progress that can be driven forward a piece at a time, and rewound to an earlier snapshot.
+	///
+	/// Stepping follows the same day framework as calculate_racetime, so stepping through the whole route gives exactly
+	/// the same racetime. A new race day (and the overnight charging before it) only starts when the next segment is
+	/// driven, so a snapshot taken at the end of a day can still be resumed with a different strategy.
+	///
+	/// Snapshots are plain RaceProgress values: a search that only changes the strategy after some segment can keep a
+	/// snapshot from there and restore it for every candidate, instead of simulating the shared prefix again.
+	class RaceState {
+	   public:
+		/// @brief Starts a new race, as in start_race. The references must outlive the RaceState.
+		RaceState(const SolarCar& car, const Route& route, const Weather& weather, const RaceSchedule& schedule);
+
+		/// @returns Everything needed to come back to the current point of the race with restore.
+		RaceProgress snapshot() const;
+
+		/// @brief Rewinds (or fast-forwards) the race to @p progress, as returned by snapshot.
+		void restore(const RaceProgress& progress);
+
+		/// @brief Drives the next route segment at @p speed, starting the next race day first if today's is over.
+		/// Does nothing once the race is over.
+		///
+		/// @returns false if the car has run out of energy or schedule.
+		bool step_segment(double speed);
+
+		/// @brief Drives segments at @p speed until the racing window of the day closes, or the race ends. If the
+		/// current day's window has already closed, this starts and drives the next day. The overnight charging at the
+		/// end is left for the next step.
+		///
+		/// @returns false if the car has run out of energy or schedule.
+		bool run_until_day_end(double speed);
+
+		/// @brief Drives segments until the car is about to drive segment @p end_segment, as in drive_segments.
+		///
+		/// @param [in] speed_profile (m/s) The speed to drive each segment of the route at, indexed by segment.
+		/// @returns false if the car has run out of energy or schedule.
+		bool run_until(size_t end_segment, std::span<const double> speed_profile);
+
+		/// @returns The race so far.
+		const RaceProgress& get_progress() const;
+
+	   private:
+		const SolarCar& car;
+		const Route& route;
+		const Weather& weather;
+		const RaceSchedule& schedule;
+		CarKernel kernel;
+		RaceProgress progress;
+	};
 };  // namespace RaceRunner
 
 #endif  // MINISIM_RACERUNNER_H
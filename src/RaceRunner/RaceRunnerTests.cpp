@@ -1,9 +1,26 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <limits>
 #include <numbers>
+#include <optional>
+#include <string>
+#include <typeinfo>
+#include <utility>
+#include <vector>
 
+#include "RaceEvents.h"
 #include "RaceRunner.h"
+#include "RaceSegmentRunner/CarKernel.h"
+#include "RaceTrace.h"
+#include "RacetimeCache.h"
 #include "Tools/RootDirectory.h"
 
 using Catch::Matchers::WithinAbs;
@@ -18,6 +35,7 @@ namespace {
 	const std::string weather_file = root_directory + "/data/Weather/Australia/August/2007.csv";
 	const std::string schedule_file = root_directory + "/data/Schedule/August/Schedule2007.toml";
 	const std::string weather_stations_file = root_directory + "/data/Stations/australia_stations.csv";
+	const std::string car_file = root_directory + "/data/Cars/mini-car.toml";
 }  // namespace
 
 TEST_CASE("RaceSegmentRunner: calculate_static_charging_gain", "[RaceSegmentRunner]") {
@@ -637,3 +655,661 @@ TEST_CASE("RaceSegmentRunner: calculate_racetime", "[RaceSegmentRunner]") {
 		REQUIRE_FALSE(result.has_value());
 	}
 }
+
+TEST_CASE("RaceRunner: calculate_racetime with a speed profile", "[RaceRunner]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	SECTION("A constant profile matches the constant speed race") {
+		for (const double speed : {12.0, 18.5, 21.7, 30.0}) {
+			const std::vector<double> speed_profile(route.get_num_segments(), speed);
+			const auto expected = RaceRunner::calculate_racetime(car, route, weather, schedule, speed);
+			const auto result = RaceRunner::calculate_racetime(car, route, weather, schedule, speed_profile);
+			REQUIRE(result.has_value() == expected.has_value());
+			if (expected.has_value()) {
+				REQUIRE(result.value() == expected.value());
+			}
+		}
+	}
+	SECTION("Driving the route in pieces matches driving it in one go") {
+		constexpr double speed = 18.5;
+		constexpr size_t piece_length = 500;
+		const std::vector<double> speed_profile(route.get_num_segments(), speed);
+		const auto expected = RaceRunner::calculate_racetime(car, route, weather, schedule, speed);
+
+		RaceRunner::RaceProgress progress = RaceRunner::start_race(car, schedule);
+		bool made_it = true;
+		for (size_t end = piece_length; made_it && !progress.finished; end += piece_length) {
+			const size_t end_segment = std::min(end, route.get_num_segments());
+			made_it = RaceRunner::drive_segments(car, route, weather, schedule, speed_profile, end_segment, progress);
+		}
+		REQUIRE(made_it == expected.has_value());
+		if (expected.has_value()) {
+			REQUIRE(progress.total_time == expected.value());
+		}
+	}
+}
+
+TEST_CASE("RaceRunner: calculate_racetime with a racetime bound", "[RaceRunner]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	const double no_bound = std::numeric_limits<double>::infinity();
+	SECTION("Without a bound the result matches the unbounded race") {
+		for (const double speed : {5.0, 12.0, 18.5, 21.7, 30.0, 50.0}) {
+			const auto expected = RaceRunner::calculate_racetime(car, route, weather, schedule, speed);
+			const auto result = RaceRunner::calculate_racetime(car, route, weather, schedule, speed, no_bound);
+			REQUIRE(result.racetime.has_value() == expected.has_value());
+			if (expected.has_value()) {
+				REQUIRE(result.racetime.value() == expected.value());
+				REQUIRE_FALSE(result.pruned);
+				REQUIRE(result.segments_skipped == 0);
+			}
+		}
+	}
+	SECTION("Races that cannot beat the bound are abandoned, races that tie it are not") {
+		constexpr double speed = 18.5;
+		const auto expected = RaceRunner::calculate_racetime(car, route, weather, schedule, speed);
+		if (expected.has_value()) {
+			const auto tied = RaceRunner::calculate_racetime(car, route, weather, schedule, speed, expected.value());
+			REQUIRE(tied.racetime == expected);
+
+			const auto beaten = RaceRunner::calculate_racetime(car, route, weather, schedule, speed, expected.value() - 1);
+			REQUIRE_FALSE(beaten.racetime.has_value());
+			REQUIRE(beaten.pruned);
+			REQUIRE(beaten.segments_skipped > 0);
+		}
+	}
+	SECTION("The pruning callback can abandon a race") {
+		constexpr size_t stop_at = 100;
+		const auto result = RaceRunner::calculate_racetime(car, route, weather, schedule, 21.7, no_bound,
+			[](const RaceRunner::RaceProgress& progress) { return progress.segment_idx >= stop_at; });
+		REQUIRE(result.pruned);
+		REQUIRE(result.segments_skipped <= route.get_num_segments() - stop_at);
+	}
+}
+
+TEST_CASE("RaceRunner: RaceState", "[RaceRunner]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	SECTION("Stepping segment by segment matches calculate_racetime") {
+		for (const double speed : {12.0, 18.5, 21.7, 30.0}) {
+			const auto expected = RaceRunner::calculate_racetime(car, route, weather, schedule, speed);
+			RaceRunner::RaceState state(car, route, weather, schedule);
+			while (!state.get_progress().finished && state.step_segment(speed)) {
+			}
+			REQUIRE(state.get_progress().finished == expected.has_value());
+			REQUIRE(state.get_progress().failed != expected.has_value());
+			if (expected.has_value()) {
+				REQUIRE(state.get_progress().total_time == expected.value());
+			}
+		}
+	}
+	SECTION("Restoring a snapshot replays the rest of the race exactly") {
+		constexpr double speed = 18.5;
+		const auto expected = RaceRunner::calculate_racetime(car, route, weather, schedule, speed);
+		RaceRunner::RaceState state(car, route, weather, schedule);
+		state.run_until_day_end(speed);
+		REQUIRE(state.get_progress().current_time >= schedule[0].race_end_time);
+		REQUIRE(state.get_progress().day == 0);
+		const RaceRunner::RaceProgress end_of_day = state.snapshot();
+
+		for (int attempt = 0; attempt < 2; ++attempt) {
+			state.restore(end_of_day);
+			while (!state.get_progress().finished && state.run_until_day_end(speed)) {
+			}
+			REQUIRE(state.get_progress().finished == expected.has_value());
+			if (expected.has_value()) {
+				REQUIRE(state.get_progress().total_time == expected.value());
+			}
+		}
+	}
+}
+
+TEST_CASE("RaceRunner: calculate_racetime_batch", "[RaceRunner]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	SECTION("Every race matches calculate_racetime") {
+		std::vector<double> speeds;
+		for (double speed = 5; speed <= 50; speed += 0.5) {
+			speeds.push_back(speed);
+		}
+		const auto result = RaceRunner::calculate_racetime_batch(car, route, weather, schedule, speeds);
+		REQUIRE(result.size() == speeds.size());
+		for (size_t i = 0; i < speeds.size(); ++i) {
+			REQUIRE(result[i] == RaceRunner::calculate_racetime(car, route, weather, schedule, speeds[i]));
+		}
+	}
+}
+
+TEST_CASE("RaceRunner: calculate_racetime_batch benchmark", "[.][benchmark]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+
+	// A linear search's sweep: 451 speeds, 0.05 m/s apart
+	std::vector<double> speeds;
+	for (size_t i = 0; i <= 450; ++i) {
+		speeds.push_back(10 + 0.05 * static_cast<double>(i));
+	}
+	BENCHMARK("One race per speed") {
+		std::vector<std::optional<double>> racetimes;
+		for (const double speed : speeds) {
+			racetimes.push_back(RaceRunner::calculate_racetime(car, route, weather, schedule, speed));
+		}
+		return racetimes;
+	};
+	BENCHMARK("Every speed in lock-step") {
+		return RaceRunner::calculate_racetime_batch(car, route, weather, schedule, speeds);
+	};
+}
+
+TEST_CASE("RaceRunner: calculate_racetime_gradient", "[RaceRunner]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	std::vector<double> profile(route.get_num_segments());
+	for (size_t i = 0; i < profile.size(); ++i) {
+		profile[i] = std::min(20.0, route.get_segment(i).speed_limit);
+	}
+
+	SECTION("Without a shortfall the objective is the racetime") {
+		const auto result = RaceRunner::calculate_racetime_gradient(car, route, weather, schedule, profile, 0, 1);
+		const auto racetime = RaceRunner::calculate_racetime(car, route, weather, schedule, profile);
+		REQUIRE(racetime.has_value());
+		REQUIRE(result.minimum_energy >= 0);
+		REQUIRE(result.objective == racetime.value());
+		REQUIRE(result.gradient.size() == profile.size());
+	}
+
+	SECTION("The gradient matches finite differences") {
+		const double energy_reserve = 0.5 * car.battery.get_capacity();
+		const double penalty_weight = 1e-3;
+		const auto result = RaceRunner::calculate_racetime_gradient(
+			car, route, weather, schedule, profile, energy_reserve, penalty_weight);
+		REQUIRE(std::isfinite(result.objective));
+
+		// Nudge a stretch of segments at a time, as the optimizers do
+		const std::vector<size_t> block_starts = route.split_into_blocks(20000);
+		for (const size_t block : {size_t{0}, block_starts.size() / 3, block_starts.size() - 2}) {
+			constexpr double step = 1e-4;
+			std::vector<double> faster = profile;
+			std::vector<double> slower = profile;
+			double gradient = 0;
+			for (size_t i = block_starts[block]; i < block_starts[block + 1]; ++i) {
+				faster[i] += step;
+				slower[i] -= step;
+				gradient += result.gradient[i];
+			}
+			const double difference = (RaceRunner::calculate_racetime_gradient(car, route, weather, schedule, faster,
+										   energy_reserve, penalty_weight)
+											  .objective -
+										  RaceRunner::calculate_racetime_gradient(car, route, weather, schedule,
+											  slower, energy_reserve, penalty_weight)
+											  .objective) /
+									  (2 * step);
+			REQUIRE_THAT(gradient, WithinRel(difference, 1e-3));
+		}
+	}
+}
+
+TEST_CASE("RaceRunner: RacetimeCache", "[RaceRunner]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	const double no_bound = std::numeric_limits<double>::infinity();
+	const std::vector<std::string> input_files = {car_file, weather_file, weather_stations_file, route_file,
+		schedule_file};
+	const uint64_t input_hash = RaceRunner::RacetimeCache::hash_files(input_files);
+	SECTION("Hits give exactly the racetime a simulation would") {
+		RaceRunner::RacetimeCache cache(input_hash);
+		for (int pass = 0; pass < 2; ++pass) {
+			for (const double speed : {5.0, 18.5, 21.7, 50.0}) {
+				const auto expected = RaceRunner::calculate_racetime(car, route, weather, schedule, speed);
+				const auto result = cache.calculate_racetime(car, route, weather, schedule, speed, no_bound);
+				REQUIRE(result.racetime == expected);
+			}
+		}
+		REQUIRE(cache.get_misses() == 4);
+		REQUIRE(cache.get_hits() == 4);
+	}
+	SECTION("Hits that cannot beat the bound are reported as abandoned") {
+		constexpr double speed = 18.5;
+		RaceRunner::RacetimeCache cache(input_hash);
+		const auto expected = cache.calculate_racetime(car, route, weather, schedule, speed, no_bound);
+		if (expected.racetime.has_value()) {
+			const auto beaten =
+				cache.calculate_racetime(car, route, weather, schedule, speed, expected.racetime.value() - 1);
+			REQUIRE_FALSE(beaten.racetime.has_value());
+			REQUIRE(beaten.pruned);
+			REQUIRE(cache.get_hits() == 1);
+		}
+	}
+	SECTION("Saved results are read back by the next cache on the same inputs") {
+		const std::filesystem::path directory = std::filesystem::temp_directory_path() / "minisim_racetime_cache_test";
+		std::filesystem::remove_all(directory);
+		{
+			RaceRunner::RacetimeCache cache(input_hash, directory);
+			cache.calculate_racetime(car, route, weather, schedule, 21.7, no_bound);
+			cache.save();
+		}
+		RaceRunner::RacetimeCache reopened(input_hash, directory);
+		const auto result = reopened.calculate_racetime(car, route, weather, schedule, 21.7, no_bound);
+		REQUIRE(result.racetime == RaceRunner::calculate_racetime(car, route, weather, schedule, 21.7));
+		REQUIRE(reopened.get_hits() == 1);
+		REQUIRE(reopened.get_misses() == 0);
+
+		RaceRunner::RacetimeCache other_inputs(input_hash + 1, directory);
+		other_inputs.calculate_racetime(car, route, weather, schedule, 21.7, no_bound);
+		REQUIRE(other_inputs.get_hits() == 0);
+		std::filesystem::remove_all(directory);
+	}
+	SECTION("Caches saving to the same file keep each other's results, and replace stale files") {
+		const std::filesystem::path directory = std::filesystem::temp_directory_path() / "minisim_racetime_cache_test";
+		std::filesystem::remove_all(directory);
+		{
+			RaceRunner::RacetimeCache first(input_hash, directory);
+			RaceRunner::RacetimeCache second(input_hash, directory);
+			first.calculate_racetime(car, route, weather, schedule, 21.7, no_bound);
+			second.calculate_racetime(car, route, weather, schedule, 18.5, no_bound);
+			first.save();
+			second.save();
+		}
+		{
+			RaceRunner::RacetimeCache reopened(input_hash, directory);
+			reopened.calculate_racetime(car, route, weather, schedule, 21.7, no_bound);
+			reopened.calculate_racetime(car, route, weather, schedule, 18.5, no_bound);
+			REQUIRE(reopened.get_hits() == 2);
+		}
+		// A file from another version is ignored until a save starts it again
+		for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+			std::ofstream(entry.path(), std::ios::binary | std::ios::trunc) << "written by another version";
+		}
+		{
+			RaceRunner::RacetimeCache stale(input_hash, directory);
+			stale.calculate_racetime(car, route, weather, schedule, 18.5, no_bound);
+			REQUIRE(stale.get_hits() == 0);
+			stale.save();
+		}
+		RaceRunner::RacetimeCache reopened(input_hash, directory);
+		reopened.calculate_racetime(car, route, weather, schedule, 18.5, no_bound);
+		REQUIRE(reopened.get_hits() == 1);
+		std::filesystem::remove_all(directory);
+	}
+	SECTION("Half a record left by a killed save is dropped before the next save") {
+		const std::filesystem::path directory = std::filesystem::temp_directory_path() / "minisim_racetime_cache_test";
+		std::filesystem::remove_all(directory);
+		{
+			RaceRunner::RacetimeCache cache(input_hash, directory);
+			cache.calculate_racetime(car, route, weather, schedule, 21.7, no_bound);
+			cache.save();
+		}
+		for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+			std::ofstream(entry.path(), std::ios::binary | std::ios::app) << "half";
+		}
+		{
+			RaceRunner::RacetimeCache cache(input_hash, directory);
+			cache.calculate_racetime(car, route, weather, schedule, 18.5, no_bound);
+			cache.save();
+		}
+		RaceRunner::RacetimeCache reopened(input_hash, directory);
+		reopened.calculate_racetime(car, route, weather, schedule, 21.7, no_bound);
+		reopened.calculate_racetime(car, route, weather, schedule, 18.5, no_bound);
+		REQUIRE(reopened.get_hits() == 2);
+		std::filesystem::remove_all(directory);
+	}
+}
+
+TEST_CASE("RaceRunner: calculate_racetime with a perturbed forecast", "[RaceRunner]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	SECTION("A perturbation that changes nothing gives exactly the same racetime") {
+		const Weather unchanged = weather.with_perturbation(WeatherPerturbation{});
+		for (const double speed : {12.0, 18.5, 21.7, 30.0}) {
+			REQUIRE(RaceRunner::calculate_racetime(car, route, unchanged, schedule, speed) ==
+					RaceRunner::calculate_racetime(car, route, weather, schedule, speed));
+		}
+	}
+	SECTION("Less sun never helps the car finish") {
+		const Weather overcast = weather.with_perturbation(WeatherPerturbation{.irradiance_scale = 0.5});
+		for (const double speed : {12.0, 18.5, 21.7, 30.0}) {
+			if (RaceRunner::calculate_racetime(car, route, overcast, schedule, speed).has_value()) {
+				REQUIRE(RaceRunner::calculate_racetime(car, route, weather, schedule, speed).has_value());
+			}
+		}
+	}
+}
+
+TEST_CASE("RaceRunner: calculate_race_summary", "[RaceRunner]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	SECTION("The racetime matches calculate_racetime, and the battery never ends below its lowest point") {
+		for (const double speed : {5.0, 12.0, 18.5, 21.7, 30.0, 50.0}) {
+			const auto expected = RaceRunner::calculate_racetime(car, route, weather, schedule, speed);
+			const auto summary = RaceRunner::calculate_race_summary(car, route, weather, schedule, speed);
+			REQUIRE(summary.has_value() == expected.has_value());
+			if (summary.has_value()) {
+				REQUIRE(summary->racetime == expected.value());
+				REQUIRE(summary->minimum_state_of_charge >= 0);
+				REQUIRE(summary->minimum_state_of_charge <= 1);
+				REQUIRE(summary->final_state_of_charge >= summary->minimum_state_of_charge);
+			}
+		}
+	}
+}
+
+TEST_CASE("RaceRunner: calculate_coarsening_error", "[RaceRunner]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	const Route coarse_route = route.coarsen(Route::CoarseningTolerance());
+	SECTION("The coarse route covers the same distance, in fewer segments, keeping every control stop") {
+		REQUIRE(coarse_route.get_num_segments() < route.get_num_segments());
+		REQUIRE_THAT(coarse_route.get_total_distance(), WithinAbs(route.get_total_distance(), 1e-6));
+
+		const auto source_segments = coarse_route.get_source_segments();
+		REQUIRE(source_segments.size() == coarse_route.get_num_segments() + 1);
+		REQUIRE(source_segments.front() == 0);
+		REQUIRE(source_segments.back() == route.get_num_segments());
+		const auto is_control_stop = [](const RouteSegment& segment) {
+			return segment.end_condition == SegmentEndCondition::CONTROL_STOP;
+		};
+		REQUIRE(std::ranges::count_if(coarse_route.get_segments_span(), is_control_stop) ==
+				std::ranges::count_if(route.get_segments_span(), is_control_stop));
+		for (size_t i = 0; i < coarse_route.get_num_segments(); ++i) {
+			REQUIRE(coarse_route[i].end_condition == route[source_segments[i + 1] - 1].end_condition);
+		}
+
+		const std::vector<double> speed_profile(coarse_route.get_num_segments(), 18.5);
+		REQUIRE(coarse_route.to_source_profile(speed_profile).size() == route.get_num_segments());
+	}
+	SECTION("A constant speed race on the coarse route stays close to the race on the full route") {
+		for (const double speed : {15.0, 18.5, 21.0}) {
+			const auto expected = RaceRunner::calculate_racetime(car, route, weather, schedule, speed);
+			const auto result = RaceRunner::calculate_racetime(car, coarse_route, weather, schedule, speed);
+			const auto error =
+				RaceRunner::calculate_coarsening_error(car, route, coarse_route, weather, schedule, speed);
+			REQUIRE(error.same_outcome);
+			REQUIRE(result.has_value() == expected.has_value());
+			if (expected.has_value()) {
+				REQUIRE_THAT(result.value(), WithinAbs(expected.value(), error.time + 1e-6));
+			}
+			REQUIRE(error.energy < 0.02 * car.battery.get_capacity());
+		}
+	}
+}
+
+TEST_CASE("RaceRunner: calculate_static_charging_gain from weather timelines", "[RaceRunner]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	const auto [start_time, end_time] = weather.get_time_range();
+	const Weather stepped = weather.with_timelines(start_time, end_time, RaceRunner::static_charging_increment);
+	const Weather exact = weather.with_timelines(
+		start_time, end_time, RaceRunner::static_charging_increment, WeatherTimelines::Integration::EXACT);
+
+	// The charging windows of the second day, and a control stop that starts off the timelines' samples
+	const SingleDaySchedule& day = schedule[1];
+	const std::vector<std::pair<double, double>> windows = {
+		{day.morning_charging_start_time, day.morning_charging_end_time},
+		{day.evening_charging_start_time, day.evening_charging_end_time},
+		{day.race_start_time + 12345.6, day.race_start_time + 12345.6 + 1800},
+	};
+	SECTION("Stepped timelines give the same gain as stepping through the forecast") {
+		for (const auto& [window_start, window_end] : windows) {
+			for (const double weather_station : {1.0, 3.25, 11.5}) {
+				REQUIRE(stepped.get_irradiance_integral(
+							weather_station, window_start, window_end, RaceRunner::static_charging_increment)
+							.has_value());
+				const double expected = RaceRunner::calculate_static_charging_gain<double>(
+					car, weather, weather_station, window_start, window_end);
+				const double result = RaceRunner::calculate_static_charging_gain(
+					car, stepped, weather_station, window_start, window_end);
+				REQUIRE_THAT(result, WithinAbs(expected, 1e-6));
+			}
+		}
+	}
+	SECTION("Exact timelines stay close to the stepped gain, and follow a perturbation") {
+		const Weather overcast = exact.with_perturbation(WeatherPerturbation{.irradiance_scale = 0.5});
+		for (const auto& [window_start, window_end] : windows) {
+			const double expected =
+				RaceRunner::calculate_static_charging_gain(car, stepped, 3.25, window_start, window_end);
+			const double result = RaceRunner::calculate_static_charging_gain(car, exact, 3.25, window_start, window_end);
+			REQUIRE_THAT(result, WithinRel(expected, 0.01));
+			REQUIRE_THAT(RaceRunner::calculate_static_charging_gain(car, overcast, 3.25, window_start, window_end),
+				WithinAbs(result / 2, 1e-6));
+		}
+	}
+}
+
+TEST_CASE("RaceRunner: RaceEventQueue", "[RaceRunner]") {
+	using RaceRunner::RaceEventType;
+	RaceRunner::RaceEventQueue events;
+	REQUIRE(events.empty());
+	REQUIRE(events.next_time() == std::numeric_limits<double>::infinity());
+
+	SECTION("Events come out earliest first, and in type order when they fall on the same time") {
+		events.push({.time = 300, .type = RaceEventType::RACE_DAY_START, .day = 1});
+		events.push({.time = 100, .type = RaceEventType::RACE_DAY_END, .day = 0});
+		events.push({.time = 300, .type = RaceEventType::CHARGING_END, .day = 1});
+		events.push({.time = 200, .type = RaceEventType::CHARGING_START, .day = 0});
+		events.push({.time = 300, .type = RaceEventType::CHARGING_START, .day = 1});
+		REQUIRE(events.next_time() == 100);
+
+		const std::vector<std::pair<double, RaceEventType>> expected = {
+			{100, RaceEventType::RACE_DAY_END},
+			{200, RaceEventType::CHARGING_START},
+			{300, RaceEventType::CHARGING_START},
+			{300, RaceEventType::CHARGING_END},
+			{300, RaceEventType::RACE_DAY_START},
+		};
+		for (const auto& [time, type] : expected) {
+			const RaceRunner::RaceEvent event = events.pop();
+			REQUIRE(event.time == time);
+			REQUIRE(event.type == type);
+		}
+		REQUIRE(events.empty());
+	}
+}
+
+TEST_CASE("RaceRunner: trace_race", "[RaceRunner]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	const std::filesystem::path trace_file = std::filesystem::temp_directory_path() / "minisim_race_trace_test.bin";
+	SECTION("The trace has every segment driven, in order, and reads back exactly") {
+		const std::vector<double> speed_profile(route.get_num_segments(), 18.5);
+		const auto expected = RaceRunner::calculate_racetime(car, route, weather, schedule, speed_profile);
+
+		// Small blocks, so that the race goes around the ring many times
+		RaceRunner::RaceTrace trace(trace_file, RaceRunner::RaceTrace::Detail::FULL, 100, 2);
+		REQUIRE(RaceRunner::trace_race(car, route, weather, schedule, speed_profile, trace) == expected);
+		trace.close();
+
+		const std::vector<RaceRunner::TraceRecord> records = RaceRunner::RaceTrace::read(trace_file);
+		REQUIRE(records.size() == trace.get_num_records());
+		REQUIRE(!records.empty());
+		for (size_t i = 0; i < records.size(); ++i) {
+			REQUIRE(records[i].segment == static_cast<double>(i));
+			REQUIRE(records[i].speed == 18.5);
+			REQUIRE_THAT(records[i].power_net,
+				WithinAbs(records[i].power_in - records[i].power_out - records[i].power_loss, 1e-9));
+			if (i > 0) {
+				REQUIRE(records[i].total_time > records[i - 1].total_time);
+			}
+		}
+		if (expected.has_value()) {
+			REQUIRE(records.back().total_time == expected.value());
+		}
+	}
+	SECTION("A progress trace keeps the same progress, and leaves the other columns out") {
+		const std::vector<double> speed_profile(route.get_num_segments(), 18.5);
+		{
+			RaceRunner::RaceTrace trace(trace_file, RaceRunner::RaceTrace::Detail::FULL, 100, 2);
+			RaceRunner::trace_race(car, route, weather, schedule, speed_profile, trace);
+		}
+		const std::vector<RaceRunner::TraceRecord> full = RaceRunner::RaceTrace::read(trace_file);
+		{
+			RaceRunner::RaceTrace trace(trace_file, RaceRunner::RaceTrace::Detail::PROGRESS, 100, 2);
+			REQUIRE(trace.get_detail() == RaceRunner::RaceTrace::Detail::PROGRESS);
+			RaceRunner::trace_race(car, route, weather, schedule, speed_profile, trace);
+		}
+		RaceRunner::RaceTrace::Detail detail = RaceRunner::RaceTrace::Detail::FULL;
+		const std::vector<RaceRunner::TraceRecord> progress = RaceRunner::RaceTrace::read(trace_file, detail);
+		REQUIRE(detail == RaceRunner::RaceTrace::Detail::PROGRESS);
+		REQUIRE(progress.size() == full.size());
+		for (size_t i = 0; i < progress.size(); ++i) {
+			REQUIRE(progress[i].segment == full[i].segment);
+			REQUIRE(progress[i].day == full[i].day);
+			REQUIRE(progress[i].time == full[i].time);
+			REQUIRE(progress[i].total_time == full[i].total_time);
+			REQUIRE(progress[i].speed == full[i].speed);
+			REQUIRE(progress[i].energy_remaining == full[i].energy_remaining);
+			REQUIRE(progress[i].power_net == full[i].power_net);
+			REQUIRE(std::isnan(progress[i].state_of_charge));
+			REQUIRE(std::isnan(progress[i].power_in));
+			REQUIRE(std::isnan(progress[i].air_density));
+		}
+	}
+	SECTION("A trace whose last block claims more records than the file holds is cut short") {
+		const std::vector<double> speed_profile(route.get_num_segments(), 18.5);
+		// A whole trace, then a block with nothing but its count
+		for (const uint64_t num_records : {uint64_t{1}, uint64_t{1} << 60}) {
+			{
+				RaceRunner::RaceTrace trace(trace_file, RaceRunner::RaceTrace::Detail::PROGRESS, 100, 2);
+				RaceRunner::trace_race(car, route, weather, schedule, speed_profile, trace);
+			}
+			{
+				std::ofstream stream(trace_file, std::ios::binary | std::ios::app);
+				stream.write(reinterpret_cast<const char*>(&num_records), sizeof(num_records));
+			}
+			bool cut_short = false;
+			try {
+				RaceRunner::RaceTrace::read(trace_file);
+			} catch (const std::exception& error) {
+				// The trace's own error, rather than running out of memory for the records the count claims
+				cut_short = typeid(error) == typeid(std::exception);
+			}
+			REQUIRE(cut_short);
+		}
+	}
+	std::filesystem::remove(trace_file);
+}
+
+TEST_CASE("RaceRunner: trace_race overhead benchmark", "[.][benchmark]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	const std::filesystem::path trace_file = std::filesystem::temp_directory_path() / "minisim_race_trace_bench.bin";
+	const std::vector<double> speed_profile(route.get_num_segments(), 18.5);
+
+	// The same race each run, so the difference is what tracing costs, written out to a real file
+	BENCHMARK("Untraced race") {
+		return RaceRunner::calculate_racetime(car, route, weather, schedule, speed_profile);
+	};
+	BENCHMARK("Traced race, progress") {
+		RaceRunner::RaceTrace trace(trace_file, RaceRunner::RaceTrace::Detail::PROGRESS);
+		return RaceRunner::trace_race(car, route, weather, schedule, speed_profile, trace);
+	};
+	BENCHMARK("Traced race, full") {
+		RaceRunner::RaceTrace trace(trace_file, RaceRunner::RaceTrace::Detail::FULL);
+		return RaceRunner::trace_race(car, route, weather, schedule, speed_profile, trace);
+	};
+	std::filesystem::remove(trace_file);
+}
+
+TEST_CASE("RaceSegmentRunner: CarKernel", "[RaceSegmentRunner]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	const CompiledRoute& compiled = route.get_compiled();
+	const RaceSegmentRunner runner(car);
+	const CarKernel kernel(car);
+
+	SECTION("Every segment of the route matches RaceSegmentRunner") {
+		// Spread the segments over the first day, for a spread of winds and headings
+		const double start_time = schedule[0].race_start_time;
+		const double time_step = (schedule[0].race_end_time - start_time) / static_cast<double>(compiled.size());
+		for (size_t i = 0; i < compiled.size(); ++i) {
+			const double time = start_time + time_step * static_cast<double>(i);
+			const WeatherDataPoint weather_data =
+				weather.get_weather_during(compiled.weather_station[i], time, time + 60);
+			for (const double speed : {0.0, 5.0, 20.0, 35.0}) {
+				const auto expected = runner.calculate_power_net(compiled, i, weather_data, 0.6, speed);
+				const auto result = kernel.calculate_power_net<double>(compiled, i, weather_data, 0.6, speed);
+				REQUIRE(result.has_value() == expected.has_value());
+				if (expected.has_value()) {
+					REQUIRE_THAT(
+						result.value(), WithinRel(expected.value(), 1e-9) || WithinAbs(expected.value(), 1e-6));
+				}
+			}
+		}
+	}
+
+	SECTION("The race loops all agree") {
+		const auto racetime = RaceRunner::calculate_racetime(car, route, weather, schedule, 20.0);
+		REQUIRE(racetime.has_value());
+		const auto batch =
+			RaceRunner::calculate_racetime_batch(car, route, weather, schedule, std::vector<double>{20.0});
+		REQUIRE(batch.at(0) == racetime);
+	}
+}
+
+TEST_CASE("RaceSegmentRunner: CarKernel per-segment benchmark", "[.][benchmark]") {
+	const WeatherStations weather_stations(weather_stations_file);
+	const RaceSchedule schedule((ConfigFile::from_path(schedule_file).value()));
+	const Route route(route_file, weather_stations);
+	const Weather weather(weather_file, weather_stations);
+	const SolarCar car(ConfigFile::from_path(car_file).value());
+	const CompiledRoute& compiled = route.get_compiled();
+	const RaceSegmentRunner runner(car);
+	const CarKernel kernel(car);
+
+	std::vector<WeatherDataPoint> weather_data;
+	for (size_t i = 0; i < compiled.size(); ++i) {
+		const double time = schedule[0].race_start_time + 60 * static_cast<double>(i % 480);
+		weather_data.push_back(weather.get_weather_during(compiled.weather_station[i], time, time + 60));
+	}
+
+	// Each run is a single segment, so the mean is the time per segment; the segments go round the route in turn
+	size_t segment_idx = 0;
+	BENCHMARK("RaceSegmentRunner per segment") {
+		segment_idx = segment_idx + 1 == compiled.size() ? 0 : segment_idx + 1;
+		return runner.calculate_power_net(compiled, segment_idx, weather_data[segment_idx], 0.6, 25.0);
+	};
+	BENCHMARK("CarKernel per segment") {
+		segment_idx = segment_idx + 1 == compiled.size() ? 0 : segment_idx + 1;
+		return kernel.calculate_power_net<double>(compiled, segment_idx, weather_data[segment_idx], 0.6, 25.0);
+	};
+}
@@ -0,0 +1,196 @@
+#include "RaceTrace.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+	/// The first bytes of every trace file.
+	constexpr uint64_t magic = 0x4d53494d54524143;  // "MSIMTRAC"
+	constexpr uint64_t version = 2;
+
+	template <typename T>
+	void write_value(std::ofstream& file, const T& value) {
+		file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	template <typename T>
+	bool read_value(std::ifstream& file, T& value) {
+		return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(value)));
+	}
+}  // namespace
+
+RaceRunner::RaceTrace::RaceTrace(
+	const std::filesystem::path& path, Detail detail, size_t block_size, size_t num_blocks)
+	: file(path, std::ios::binary | std::ios::trunc),
+	  detail(detail),
+	  block_size(block_size),
+	  num_blocks(num_blocks),
+	  ring(block_size * get_num_columns(detail) * num_blocks),
+	  block_sizes(num_blocks),
+	  block(ring.data()) {
+	static_assert(sizeof(TraceRecord) == columns.size() * sizeof(double));
+	assert(block_size > 0 && num_blocks > 1);
+	if (!file) {
+		throw std::exception();
+	}
+
+	const size_t num_columns = get_num_columns(detail);
+	write_value(file, magic);
+	write_value(file, version);
+	write_value(file, static_cast<uint64_t>(num_columns));
+	for (size_t col = 0; col < num_columns; ++col) {
+		const Column& column = columns[col];
+		write_value(file, static_cast<uint64_t>(column.name.size()));
+		file.write(column.name.data(), static_cast<std::streamsize>(column.name.size()));
+	}
+
+	writer = std::thread([this] { write_blocks(); });
+}
+
+RaceRunner::RaceTrace::~RaceTrace() {
+	try {
+		close();
+	} catch (const std::exception&) {
+		// Nowhere to report it from a destructor; call close() to find out
+	}
+}
+
+void RaceRunner::RaceTrace::close() {
+	if (!writer.joinable()) {
+		return;
+	}
+	if (block_records > 0) {
+		hand_off_block();
+	}
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		closing = true;
+	}
+	block_handed_off.notify_one();
+	writer.join();
+
+	file.close();
+	if (write_failed || !file) {
+		throw std::exception();
+	}
+}
+
+size_t RaceRunner::RaceTrace::get_num_records() const {
+	return handed_off_records + block_records;
+}
+
+void RaceRunner::RaceTrace::hand_off_block() {
+	std::unique_lock<std::mutex> lock(mutex);
+	block_sizes[blocks_handed_off % num_blocks] = block_records;
+	handed_off_records += block_records;
+	++blocks_handed_off;
+	block_handed_off.notify_one();
+
+	// The next block around the ring may still be waiting to be written
+	block_written.wait(lock, [this] { return blocks_handed_off - blocks_written < num_blocks; });
+	block = &ring[(blocks_handed_off % num_blocks) * get_num_columns(detail) * block_size];
+	block_records = 0;
+}
+
+void RaceRunner::RaceTrace::write_blocks() {
+	const size_t num_columns = get_num_columns(detail);
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		block_handed_off.wait(lock, [this] { return blocks_written < blocks_handed_off || closing; });
+		if (blocks_written == blocks_handed_off) {
+			return;  // Closing, and everything is written
+		}
+
+		// The race does not touch a handed off block until it is written, so it can be written without the lock
+		const size_t block_idx = blocks_written % num_blocks;
+		const size_t num_records = block_sizes[block_idx];
+		lock.unlock();
+
+		const double* columns = &ring[block_idx * num_columns * block_size];
+		write_value(file, static_cast<uint64_t>(num_records));
+		for (size_t col = 0; col < num_columns; ++col) {
+			file.write(reinterpret_cast<const char*>(&columns[col * block_size]),
+				static_cast<std::streamsize>(num_records * sizeof(double)));
+		}
+		const bool failed = !file;
+
+		lock.lock();
+		write_failed = write_failed || failed;
+		++blocks_written;
+		block_written.notify_one();
+	}
+}
+
+std::vector<RaceRunner::TraceRecord> RaceRunner::RaceTrace::read(const std::filesystem::path& path, Detail& detail) {
+	std::ifstream file(path, std::ios::binary);
+	uint64_t file_magic = 0;
+	uint64_t file_version = 0;
+	uint64_t file_columns = 0;
+	if (!read_value(file, file_magic) || file_magic != magic || !read_value(file, file_version) ||
+		file_version != version || !read_value(file, file_columns)) {
+		throw std::exception();
+	}
+	if (file_columns == get_num_columns(Detail::FULL)) {
+		detail = Detail::FULL;
+	} else if (file_columns == get_num_columns(Detail::PROGRESS)) {
+		detail = Detail::PROGRESS;
+	} else {
+		throw std::exception();
+	}
+	const std::span<const Column> kept_columns(columns.data(), file_columns);
+	for (const Column& column : kept_columns) {
+		uint64_t name_size = 0;
+		if (!read_value(file, name_size) || name_size != column.name.size()) {
+			throw std::exception();
+		}
+		std::string file_name(name_size, '\0');
+		if (!file.read(file_name.data(), static_cast<std::streamsize>(name_size)) || file_name != column.name) {
+			throw std::exception();
+		}
+	}
+
+	TraceRecord unknown{};
+	for (const Column& column : columns) {
+		unknown.*column.field = std::numeric_limits<double>::quiet_NaN();
+	}
+	std::vector<TraceRecord> records;
+	std::vector<double> values;
+	// Every record a block claims takes up file, so what is left of it bounds a count that may be corrupt
+	const uint64_t file_size = std::filesystem::file_size(path);
+	const uint64_t record_size = file_columns * sizeof(double);
+	uint64_t num_records = 0;
+	while (read_value(file, num_records)) {
+		if (num_records > (file_size - static_cast<uint64_t>(file.tellg())) / record_size) {
+			throw std::exception();  // Cut short
+		}
+		const size_t first = records.size();
+		records.resize(first + num_records, unknown);
+		values.resize(num_records);
+		for (const Column& column : kept_columns) {
+			if (!file.read(reinterpret_cast<char*>(values.data()),
+					static_cast<std::streamsize>(num_records * sizeof(double)))) {
+				throw std::exception();  // Cut short
+			}
+			for (size_t i = 0; i < num_records; ++i) {
+				records[first + i].*column.field = values[i];
+			}
+		}
+	}
+	return records;
+}
+
+std::vector<RaceRunner::TraceRecord> RaceRunner::RaceTrace::read(const std::filesystem::path& path) {
+	Detail detail = Detail::PROGRESS;
+	return read(path, detail);
+}
@@ -0,0 +1,224 @@
+#ifndef MINISIM_RACETRACE_H
+#define MINISIM_RACETRACE_H
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace RaceRunner {
+	/// @brief The state of a race right after the car drove a segment, and what went on while it did.
+	///
+	/// Every field is a double, so that a trace is a table of equally wide columns; the indices are exact as doubles.
+	struct TraceRecord {
+		/// The index of the route segment.
+		double segment;
+		/// The index of the schedule day.
+		double day;
+		/// (epoch seconds) The clock time at the end of the segment.
+		double time;
+		/// (seconds) The time spent racing so far.
+		double total_time;
+		/// (m/s) The speed the segment was driven at.
+		double speed;
+		/// (Wh) The energy left in the battery at the end of the segment.
+		double energy_remaining;
+		/// (W) The net power into the battery.
+		double power_net;
+		/// The state of charge of the battery at the end of the segment.
+		double state_of_charge;
+		/// (W) The power the array took in.
+		double power_in;
+		/// (W) The power the motor consumed.
+		double power_out;
+		/// (W) The power lost in the battery.
+		double power_loss;
+		/// (N) The aerodynamic drag.
+		double aero_force;
+		/// (N) The rolling resistance of the tires.
+		double rolling_force;
+		/// (N) The component of gravity along the road.
+		double grade_force;
+		/// (W/m^2) The irradiance during the segment.
+		double irradiance;
+		/// (m/s) The north-south wind during the segment.
+		double wind_north_south;
+		/// (m/s) The east-west wind during the segment.
+		double wind_east_west;
+		/// (°C) The air temperature during the segment.
+		double air_temperature;
+		/// (kg/m^3) The air density during the segment.
+		double air_density;
+	};
+
+	/// @brief A sink for TraceRecords, written to a compact columnar binary file.
+	///
+	/// Records go into a ring of preallocated blocks, already split up into columns. Once a block is full it is handed
+	/// to a writer thread, which writes its columns straight out while the race goes on in the next block, so
+	/// recording a segment is a few stores into memory. The race only waits if it fills every block before the writer
+	/// catches up.
+	///
+	/// By default a trace only keeps the progress of the race (see Detail::PROGRESS): the breakdown of the power and
+	/// the weather take the race extra work to find, and almost triple the bytes to write, so they are only kept when
+	/// asked for.
+	///
+	/// The file is a header, with the name of every column kept, then the blocks: the number of records in the block,
+	/// then every column of the block in turn. Numbers are stored in the machine's byte order.
+	class RaceTrace {
+	   public:
+		/// A column of a trace: one field of every record.
+		struct Column {
+			std::string_view name;
+			double TraceRecord::* field;
+		};
+
+		/// The columns of a trace, one for every field of a TraceRecord, in order.
+		static constexpr std::array<Column, sizeof(TraceRecord) / sizeof(double)> columns = {{
+			{"segment", &TraceRecord::segment},
+			{"day", &TraceRecord::day},
+			{"time", &TraceRecord::time},
+			{"total_time", &TraceRecord::total_time},
+			{"speed", &TraceRecord::speed},
+			{"energy_remaining", &TraceRecord::energy_remaining},
+			{"power_net", &TraceRecord::power_net},
+			{"state_of_charge", &TraceRecord::state_of_charge},
+			{"power_in", &TraceRecord::power_in},
+			{"power_out", &TraceRecord::power_out},
+			{"power_loss", &TraceRecord::power_loss},
+			{"aero_force", &TraceRecord::aero_force},
+			{"rolling_force", &TraceRecord::rolling_force},
+			{"grade_force", &TraceRecord::grade_force},
+			{"irradiance", &TraceRecord::irradiance},
+			{"wind_north_south", &TraceRecord::wind_north_south},
+			{"wind_east_west", &TraceRecord::wind_east_west},
+			{"air_temperature", &TraceRecord::air_temperature},
+			{"air_density", &TraceRecord::air_density},
+		}};
+
+		/// Which columns a trace keeps: always the first ones of columns.
+		enum class Detail : uint8_t {
+			/// Where the car is, the energy left and the net power: the columns up to power_net. The state of charge
+			/// is left out too, as it is just the energy left over the capacity.
+			PROGRESS,
+			/// Every column, including where the power went and the weather.
+			FULL,
+		};
+
+		/// @returns The number of columns a trace with @p detail keeps.
+		static constexpr size_t get_num_columns(Detail detail) {
+			constexpr size_t num_progress_columns = 7;
+			return detail == Detail::FULL ? columns.size() : num_progress_columns;
+		}
+
+		/// @brief Opens a trace file at @p path, replacing any file already there.
+		///
+		/// @param detail The columns to keep. The others are not written at all.
+		/// @param block_size The number of records in a block, > 0.
+		/// @param num_blocks The number of blocks in the ring, > 1.
+		///
+		/// @throws std::exception if the file cannot be opened.
+		explicit RaceTrace(const std::filesystem::path& path, Detail detail = Detail::PROGRESS, size_t block_size = 4096,
+			size_t num_blocks = 4);
+		/// Closes the trace, ignoring any error in writing it out.
+		~RaceTrace();
+
+		RaceTrace(const RaceTrace&) = delete;
+		RaceTrace(RaceTrace&&) = delete;
+		RaceTrace& operator=(const RaceTrace&) = delete;
+		RaceTrace& operator=(RaceTrace&&) = delete;
+
+		/// @brief Appends the columns of @p record the trace keeps to the trace.
+		void record(const TraceRecord& record) {
+			// One store per column, in the order of columns
+			// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+			double* const row = block + block_records;
+			row[0 * block_size] = record.segment;
+			row[1 * block_size] = record.day;
+			row[2 * block_size] = record.time;
+			row[3 * block_size] = record.total_time;
+			row[4 * block_size] = record.speed;
+			row[5 * block_size] = record.energy_remaining;
+			row[6 * block_size] = record.power_net;
+			if (detail == Detail::FULL) {
+				row[7 * block_size] = record.state_of_charge;
+				row[8 * block_size] = record.power_in;
+				row[9 * block_size] = record.power_out;
+				row[10 * block_size] = record.power_loss;
+				row[11 * block_size] = record.aero_force;
+				row[12 * block_size] = record.rolling_force;
+				row[13 * block_size] = record.grade_force;
+				row[14 * block_size] = record.irradiance;
+				row[15 * block_size] = record.wind_north_south;
+				row[16 * block_size] = record.wind_east_west;
+				row[17 * block_size] = record.air_temperature;
+				row[18 * block_size] = record.air_density;
+			}
+			// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+			++block_records;
+			if (block_records == block_size) {
+				hand_off_block();
+			}
+		}
+
+		/// @brief Writes out every record so far and closes the file. Nothing more may be recorded.
+		///
+		/// @throws std::exception if the file could not be written.
+		void close();
+
+		/// @returns The number of records so far.
+		size_t get_num_records() const;
+
+		// clang-format off
+		inline Detail get_detail() const { return detail; }
+		// clang-format on
+
+		/// @brief Reads back every record in the trace file at @p path.
+		///
+		/// @param [out] detail The columns the file keeps. The fields of the others are NaN in every record.
+		/// @throws std::exception if the file is not a trace, or not one with the columns of this version.
+		static std::vector<TraceRecord> read(const std::filesystem::path& path, Detail& detail);
+
+		/// @brief read, for a caller that does not need to know which columns the file keeps.
+		static std::vector<TraceRecord> read(const std::filesystem::path& path);
+
+	   private:
+		/// @brief Queues the current block for writing, and moves on to the next one once it is free.
+		void hand_off_block();
+
+		/// @brief The writer thread: writes out blocks as they are handed off, until the trace is closed.
+		void write_blocks();
+
+		std::ofstream file;
+		Detail detail;
+		size_t block_size;
+		size_t num_blocks;
+		/// Every block of the ring, one after another, each one every column of its records, one after another.
+		std::vector<double> ring;
+		/// The number of records in each block, once it is handed off.
+		std::vector<size_t> block_sizes;
+
+		/// The block being recorded into, and the number of records in it.
+		double* block;
+		size_t block_records = 0;
+		/// The number of records in the blocks handed off so far.
+		size_t handed_off_records = 0;
+
+		std::mutex mutex;
+		std::condition_variable block_handed_off;
+		std::condition_variable block_written;
+		/// The number of blocks handed off, and written out, so far. Blocks are used in turn around the ring.
+		size_t blocks_handed_off = 0;
+		size_t blocks_written = 0;
+		bool closing = false;
+		bool write_failed = false;
+		std::thread writer;
+	};
+}  // namespace RaceRunner
+
+#endif  // MINISIM_RACETRACE_H
@@ -0,0 +1,218 @@
+#include "RacetimeCache.h"
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "RaceRunner.h"
+#include "Tools/Hashing.h"
+
+namespace {
+	/// The first bytes of every cache file.
+	constexpr uint64_t magic = 0x4d53494d52414345;  // "MSIMRACE"
+
+	/// One cached race, as stored in the cache file.
+	struct Record {
+		uint64_t key;
+		/// (seconds) The racetime, or NaN if the car did not finish.
+		double racetime;
+	};
+
+	struct Header {
+		uint64_t magic;
+		uint64_t version;
+		uint64_t input_hash;
+	};
+
+	/// @returns Whether @p bytes start with the header of a cache file for @p input_hash, written by this version.
+	bool has_valid_header(std::span<const char> bytes, uint64_t input_hash) {
+		Header header{};
+		if (bytes.size() < sizeof(header)) {
+			return false;
+		}
+		std::memcpy(&header, bytes.data(), sizeof(header));
+		return header.magic == magic && header.version == RaceRunner::RacetimeCache::version &&
+			   header.input_hash == input_hash;
+	}
+}  // namespace
+
+RaceRunner::RacetimeCache::RacetimeCache(uint64_t input_hash, const std::filesystem::path& directory)
+	: input_hash(input_hash) {
+	if (directory.empty()) {
+		return;
+	}
+
+	std::ostringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0') << input_hash << ".bin";
+	file = directory / name.str();
+
+	// Shared with other readers, but not with a process that is in the middle of saving
+	const int descriptor = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor < 0) {
+		return;
+	}
+	flock(descriptor, LOCK_SH);
+	std::vector<char> bytes;
+	std::array<char, 1 << 16> buffer{};
+	ssize_t num_read = 0;
+	while ((num_read = read(descriptor, buffer.data(), buffer.size())) > 0) {
+		bytes.insert(bytes.end(), buffer.begin(), buffer.begin() + num_read);
+	}
+	close(descriptor);
+
+	// Written for other inputs or by another version: start from scratch, and leave the file for save() to replace
+	if (!has_valid_header(bytes, input_hash)) {
+		return;
+	}
+	// A run that was killed while saving may have left half a record at the end; it is ignored
+	for (size_t offset = sizeof(Header); offset + sizeof(Record) <= bytes.size(); offset += sizeof(Record)) {
+		Record record{};
+		std::memcpy(&record, bytes.data() + offset, sizeof(record));
+		entries.insert_or_assign(record.key, std::isnan(record.racetime) ? Entry() : Entry(record.racetime));
+	}
+}
+
+uint64_t RaceRunner::RacetimeCache::hash_files(std::span<const std::string> files) {
+	uint64_t hash = hashing::fnv_offset_basis;
+	hashing::hash_value(hash, version);
+	for (const std::string& path : files) {
+		hashing::hash_file(hash, path);
+	}
+	return hash;
+}
+
+RaceRunner::BoundedRacetime RaceRunner::RacetimeCache::calculate_racetime(const SolarCar& car, const Route& route,
+	const Weather& weather, const RaceSchedule& schedule, double speed, double racetime_bound,
+	const PruneCallback& should_prune) {
+	const uint64_t key = to_key(speed);
+	{
+		const std::lock_guard<std::mutex> lock(mutex);
+		const auto cached = entries.find(key);
+		if (cached != entries.end()) {
+			++hits;
+			const Entry& racetime = cached->second;
+			if (racetime.has_value() && racetime.value() > racetime_bound) {
+				return BoundedRacetime{.racetime = std::nullopt, .pruned = true};
+			}
+			return BoundedRacetime{.racetime = racetime};
+		}
+	}
+
+	// Simulate without holding the lock, so other threads can look up (and simulate) their own speeds meanwhile
+	++misses;
+	bool abandoned_by_caller = false;
+	PruneCallback watched_prune;
+	if (should_prune) {
+		watched_prune = [&](const RaceProgress& progress) { return abandoned_by_caller = should_prune(progress); };
+	}
+	const BoundedRacetime result =
+		RaceRunner::calculate_racetime(car, route, weather, schedule, speed, racetime_bound, watched_prune);
+
+	// Without a racetime bound, the simulation only abandons a race by itself once it can no longer finish
+	const bool conclusive = result.racetime.has_value() || !result.pruned ||
+							(std::isinf(racetime_bound) && !abandoned_by_caller);
+	if (conclusive) {
+		const std::lock_guard<std::mutex> lock(mutex);
+		if (entries.emplace(key, result.racetime).second) {
+			unsaved_keys.push_back(key);
+		}
+	}
+	return result;
+}
+
+void RaceRunner::RacetimeCache::save() {
+	const std::lock_guard<std::mutex> lock(mutex);
+	if (file.empty() || unsaved_keys.empty()) {
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::create_directories(file.parent_path(), error);
+	const int descriptor =
+		::open(file.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (descriptor < 0) {
+		return;
+	}
+	// Every process that saves to the file holds the lock until it is done, so the header is only ever written once
+	// and no records are interleaved
+	flock(descriptor, LOCK_EX);
+
+	std::vector<char> bytes;
+	struct stat status {};
+	Header header{};
+	if (fstat(descriptor, &status) == 0 && static_cast<size_t>(status.st_size) >= sizeof(header) &&
+		pread(descriptor, &header, sizeof(header), 0) == sizeof(header) &&
+		has_valid_header({reinterpret_cast<const char*>(&header), sizeof(header)}, input_hash)) {
+		// Drop half a record left by a run killed while saving, so the records appended now stay aligned
+		const size_t num_records = (static_cast<size_t>(status.st_size) - sizeof(header)) / sizeof(Record);
+		if (ftruncate(descriptor, static_cast<off_t>(sizeof(header) + num_records * sizeof(Record))) != 0) {
+			close(descriptor);
+			return;
+		}
+	} else {
+		// Missing, or written for other inputs or by another version: start the file again
+		if (ftruncate(descriptor, 0) != 0) {
+			close(descriptor);
+			return;
+		}
+		header = Header{.magic = magic, .version = version, .input_hash = input_hash};
+		const auto* header_bytes = reinterpret_cast<const char*>(&header);
+		bytes.insert(bytes.end(), header_bytes, header_bytes + sizeof(header));
+	}
+
+	for (const uint64_t key : unsaved_keys) {
+		const Entry& racetime = entries.at(key);
+		const Record record{
+			.key = key,
+			.racetime = racetime.value_or(std::numeric_limits<double>::quiet_NaN()),
+		};
+		const auto* record_bytes = reinterpret_cast<const char*>(&record);
+		bytes.insert(bytes.end(), record_bytes, record_bytes + sizeof(record));
+	}
+	// One write, so a failure leaves at most one half record behind
+	const bool written = write(descriptor, bytes.data(), bytes.size()) == static_cast<ssize_t>(bytes.size());
+	close(descriptor);
+	if (written) {
+		unsaved_keys.clear();
+	}
+}
+
+size_t RaceRunner::RacetimeCache::get_hits() const {
+	return hits.load();
+}
+
+size_t RaceRunner::RacetimeCache::get_misses() const {
+	return misses.load();
+}
+
+uint64_t RaceRunner::RacetimeCache::to_key(double speed) {
+	// +0 and -0 are the same speed; no valid speed is NaN
+	return std::bit_cast<uint64_t>(speed == 0 ? 0.0 : speed);
+}
+
+RaceRunner::BoundedRacetime RaceRunner::calculate_racetime(RacetimeCache* cache, const SolarCar& car,
+	const Route& route, const Weather& weather, const RaceSchedule& schedule, double speed, double racetime_bound,
+	const PruneCallback& should_prune) {
+	if (cache == nullptr) {
+		return calculate_racetime(car, route, weather, schedule, speed, racetime_bound, should_prune);
+	}
+	return cache->calculate_racetime(car, route, weather, schedule, speed, racetime_bound, should_prune);
+}
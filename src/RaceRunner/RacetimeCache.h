@@ -0,0 +1,97 @@
+#ifndef MINISIM_RACETIMECACHE_H
+#define MINISIM_RACETIMECACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "RaceConfig/RaceSchedule/RaceSchedule.h"
+#include "RaceConfig/Route/Route.h"
+#include "RaceConfig/Weather/Weather.h"
+#include "RaceRunner.h"
+#include "SolarCar/SolarCar.h"
+
+namespace RaceRunner {
+	/// @brief Remembers the racetimes of constant speed races, so that optimizer runs on the same inputs do not
+	/// simulate the same speed twice.
+	///
+	/// A cache only holds races on one combination of car, route, weather and schedule, identified by a content hash of
+	/// their files (see hash_files). Races are looked up by their exact speed: optimizers generate their candidates
+	/// deterministically, so repeated runs ask for bit-for-bit the same speeds, and a hit always gives exactly the
+	/// racetime a simulation would have.
+	///
+	/// Results live in memory, and optionally in a file named after the hash in a cache directory, so later runs on the
+	/// same inputs start out with them. Only conclusive results are kept: races that finished, and races where the car
+	/// ran out of energy or schedule. Abandoned races say nothing about the full race, so they are not kept.
+	///
+	/// Lookups may come from any number of threads at once.
+	class RacetimeCache {
+	   public:
+		/// @brief Opens the cache for the inputs hashed to @p input_hash, loading any results saved by earlier runs.
+		///
+		/// @param [in] input_hash The content hash of the car, route, weather and schedule, e.g. from hash_files.
+		/// @param [in] directory The directory the cache file is kept in. Empty keeps the cache in memory only.
+		RacetimeCache(uint64_t input_hash, const std::filesystem::path& directory = {});
+
+		RacetimeCache(const RacetimeCache&) = delete;
+		RacetimeCache& operator=(const RacetimeCache&) = delete;
+
+		/// @returns A hash of the contents of every file in @p files, in order, and of the simulation version.
+		static uint64_t hash_files(std::span<const std::string> files);
+
+		/// @brief Calculates the racetime at a constant speed like RaceRunner::calculate_racetime with a bound, but
+		/// looks the speed up first.
+		///
+		/// On a hit, a racetime over @p racetime_bound is reported as abandoned, just as the simulation would have
+		/// abandoned it. On a miss, the race is simulated and remembered if the result is conclusive.
+		BoundedRacetime calculate_racetime(const SolarCar& car, const Route& route, const Weather& weather,
+			const RaceSchedule& schedule, double speed, double racetime_bound,
+			const PruneCallback& should_prune = nullptr);
+
+		/// @brief Appends the results found since the cache was opened (or last saved) to the cache file, creating the
+		/// directory if needed. Does nothing for a cache kept in memory only.
+		///
+		/// Any number of processes may save to the same file at once: the file is locked while it is written. A file
+		/// written for other inputs or by another version is replaced.
+		void save();
+
+		/// @returns The number of lookups answered from the cache.
+		size_t get_hits() const;
+
+		/// @returns The number of lookups that had to be simulated.
+		size_t get_misses() const;
+
+		/// Bump this whenever a change to the simulation changes racetimes, so stale cache files are never read.
+		static constexpr uint64_t version = 2;
+
+	   private:
+		/// (seconds) The racetime of a race, or std::nullopt if the car did not finish.
+		using Entry = std::optional<double>;
+
+		/// @returns The key of @p speed: its bit pattern, so that only the exact same speed hits.
+		static uint64_t to_key(double speed);
+
+		uint64_t input_hash;
+		std::filesystem::path file;
+		mutable std::mutex mutex;
+		std::unordered_map<uint64_t, Entry> entries;
+		/// The keys of the entries found since the cache file was last written, in the order they were found.
+		std::vector<uint64_t> unsaved_keys;
+		std::atomic<size_t> hits = 0;
+		std::atomic<size_t> misses = 0;
+	};
+
+	/// @brief RaceRunner::calculate_racetime with a bound, through @p cache if there is one.
+	BoundedRacetime calculate_racetime(RacetimeCache* cache, const SolarCar& car, const Route& route,
+		const Weather& weather, const RaceSchedule& schedule, double speed, double racetime_bound,
+		const PruneCallback& should_prune = nullptr);
+}  // namespace RaceRunner
+
+#endif  // MINISIM_RACETIMECACHE_H
@@ -0,0 +1,8 @@
+#include "CarKernel.h"
+#include <optional>
+
+#include "SolarCar/SolarCar.h"
+
+template class BasicCarKernel<SolarCar>;
+template std::optional<double> CarKernel::calculate_power_net(
+	const CompiledRoute&, size_t, const WeatherDataPoint&, double, double) const;
@@ -0,0 +1,334 @@
+#ifndef MINISIM_CARKERNEL_H
+#define MINISIM_CARKERNEL_H
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <type_traits>
+
+#include "RaceConfig/Route/CompiledRoute.h"
+#include "RaceConfig/Weather/WeatherDataPoint.h"
+#include "RaceSegmentRunner.h"
+#include "SolarCar/Aerobody/Aerobody.h"
+#include "SolarCar/Aerobody/VelocityVector.h"
+#include "SolarCar/CarModels.h"
+#include "SolarCar/Motor/Motor.h"
+#include "SolarCar/SolarCar.h"
+#include "SolarCar/Tire/Tire.h"
+
+/// @brief The segment physics of one car, with everything that only depends on the car worked out up front.
+///
+/// RaceSegmentRunner follows the car's models step by step, and on every segment works out again the drag area, the
+/// tire's pressure and load terms, the km/h conversion and the wheel radius, and gets the apparent wind through
+/// hypot, atan2 and cos. Only the component of the apparent wind along the heading matters to the drag, and that is
+/// a dot product with the heading's cosine and sine, which a compiled route already has. The kernel agrees with
+/// RaceSegmentRunner to within rounding, but not to the last bit, so every race loop has to use one or the other.
+///
+/// @tparam Car The car, any CarModel. The default Aerobody, Tire and Motor models have their invariants worked out up
+/// front; any other model of those is worked out through its interface on every segment, as in
+/// BasicRaceSegmentRunner, so a yaw-dependent drag still sees the yaw. The array and the battery always go through
+/// their models.
+template <CarModel Car>
+class BasicCarKernel {
+   public:
+	using PowerBreakdown = typename BasicRaceSegmentRunner<Car>::PowerBreakdown;
+
+	/// @param car The car to simulate. The kernel only refers to it, so it must outlive the kernel.
+	explicit BasicCarKernel(const Car& car);
+	explicit BasicCarKernel(const Car&& car) = delete;
+
+	/// @brief RaceSegmentRunner::calculate_power_net for segment @p segment_idx of a compiled route.
+	///
+	/// @param route The compiled route the car is driving on.
+	/// @param segment_idx The index of the segment in @p route.
+	/// @param weather_data The Weather data at the time the car is driving.
+	/// @param state_of_charge The current state of charge of the battery.
+	/// @param speed (m/s) The requested speed for the car to drive at.
+	///
+	/// @returns (W) The net power that the car draws (or gains) over the segment, or std::nullopt if driving it at
+	/// @p speed is physically impossible.
+	template <typename Scalar>
+	std::optional<Scalar> calculate_power_net(const CompiledRoute& route, size_t segment_idx,
+		const BasicWeatherDataPoint<Scalar>& weather_data, std::type_identity_t<Scalar> state_of_charge,
+		std::type_identity_t<Scalar> speed) const;
+
+	/// @brief calculate_power_net, also giving where the power goes.
+	///
+	/// @param breakdown [out] The forces and powers the net power is made of. Only set if the net power is.
+	std::optional<double> calculate_power_net(const CompiledRoute& route, size_t segment_idx,
+		const WeatherDataPoint& weather_data, double state_of_charge, double speed, PowerBreakdown& breakdown) const;
+
+	/// @brief calculate_power_net for many cars driving segment @p segment_idx at once, each with its own weather,
+	/// state of charge and speed. Every lane gets exactly the same result as calculate_power_net would give it.
+	///
+	/// The segment's terms, the tire load's pow among them, are worked out once for every lane. Each stage then runs
+	/// over contiguous lanes, so the forces, the power out and the battery's losses (Battery::power_loss_batch)
+	/// vectorize.
+	///
+	/// @param net_power [out] (W) The net power of each lane, or NaN where calculate_power_net returns std::nullopt.
+	void calculate_power_net_batch(const CompiledRoute& route, size_t segment_idx,
+		std::span<const WeatherDataPoint> weather_data, std::span<const double> states_of_charge,
+		std::span<const double> speeds, std::span<double> net_power) const;
+
+   private:
+	/// Whether the car has the default model of a component, whose invariants the kernel works out up front.
+	static constexpr bool hoists_aero = std::same_as<decltype(Car::aerobody), Aerobody>;
+	static constexpr bool hoists_tire = std::same_as<decltype(Car::tire), Tire>;
+	static constexpr bool hoists_motor = std::same_as<decltype(Car::motor), Motor>;
+
+	/// (km/h per m/s) The SAE J2452 coefficients are tuned for speeds in km/h.
+	static constexpr double kph_per_mps = 3.6;
+
+	/// The number of lanes processed together, sized so the scratch arrays stay on the stack and in L1.
+	static constexpr size_t batch_chunk = 64;
+
+	/// @brief Both calculate_power_net, filling in @p breakdown only if @p with_breakdown.
+	template <bool with_breakdown, typename Scalar>
+	std::optional<Scalar> calculate(const CompiledRoute& route, size_t segment_idx,
+		const BasicWeatherDataPoint<Scalar>& weather_data, const Scalar& state_of_charge, const Scalar& speed,
+		PowerBreakdown* breakdown) const;
+
+	/// @returns (N) The drag on the car driving segment @p segment_idx at @p speed.
+	template <typename Scalar>
+	Scalar calculate_aero_force(const CompiledRoute& route, size_t segment_idx,
+		const BasicWeatherDataPoint<Scalar>& weather_data, const Scalar& speed) const;
+
+	/// @returns (N) The drag of the default Aerobody in a @p headwind along the heading.
+	template <typename Scalar>
+	Scalar calculate_headwind_drag(const Scalar& headwind, const Scalar& air_density) const {
+		return half_drag_area * air_density * (headwind * headwind);
+	}
+
+	/// @returns The tire's load term on segment @p segment_idx: the rolling resistance over the speed polynomial for
+	/// the default Tire, the load on the tire for any other model.
+	double calculate_tire_load(const CompiledRoute& route, size_t segment_idx) const;
+
+	/// @returns (N) The rolling resistance at @p speed under @p tire_load, from calculate_tire_load.
+	template <typename Scalar>
+	Scalar calculate_rolling_force(double tire_load, const Scalar& speed) const;
+
+	/// @returns (W) The power the motor consumes to drive at @p speed against @p resistive_force.
+	template <typename Scalar>
+	Scalar calculate_power_out(const Scalar& speed, const Scalar& resistive_force) const;
+
+	const Car& car;
+
+	/// (kg/m) Half the drag area: the drag is this times the air density and the square of the apparent wind.
+	double half_drag_area = 0;
+	/// The rolling resistance's pressure and mass terms, pow(pressure, alpha) * pow(mass, beta). The gravity term,
+	/// pow(gravity, beta), is all that is left to work out on each segment.
+	double rolling_load_coefficient = 0;
+	/// The SAE J2452 beta: the exponent of the tire load.
+	double rolling_load_exponent = 0;
+	/// The SAE J2452 speed polynomial's coefficients, converted from km/h to m/s.
+	double rolling_constant = 0;
+	double rolling_linear = 0;
+	double rolling_quadratic = 0;
+	/// (W) The motor's hysteresis loss.
+	double hysteresis_loss = 0;
+	/// (W/(m/s)) The motor's eddy current loss per unit of road speed, the coefficient over the wheel radius.
+	double eddy_current_loss_per_speed = 0;
+};
+
+/// The kernel of the default car, the one every race loop uses.
+using CarKernel = BasicCarKernel<SolarCar>;
+
+template <CarModel Car>
+BasicCarKernel<Car>::BasicCarKernel(const Car& car) : car(car) {
+	if constexpr (hoists_aero) {
+		half_drag_area = 0.5 * car.aerobody.get_drag_area();
+	}
+	if constexpr (hoists_tire) {
+		const SaeJ2452Coefficients tire = car.tire.get_coefficients();
+		rolling_load_coefficient =
+			std::pow(car.tire.get_pressure_at_stc(), tire.alpha) * std::pow(car.mass, tire.beta);
+		rolling_load_exponent = tire.beta;
+		rolling_constant = tire.a;
+		rolling_linear = tire.b * kph_per_mps;
+		rolling_quadratic = tire.c * (kph_per_mps * kph_per_mps);
+	}
+	if constexpr (hoists_motor) {
+		hysteresis_loss = car.motor.get_hysteresis_loss();
+		eddy_current_loss_per_speed = car.motor.get_eddy_current_loss_coefficient() / car.wheel_radius;
+	}
+}
+
+template <CarModel Car>
+template <typename Scalar>
+std::optional<Scalar> BasicCarKernel<Car>::calculate_power_net(const CompiledRoute& route, size_t segment_idx,
+	const BasicWeatherDataPoint<Scalar>& weather_data, std::type_identity_t<Scalar> state_of_charge,
+	std::type_identity_t<Scalar> speed) const {
+	return calculate<false, Scalar>(route, segment_idx, weather_data, state_of_charge, speed, nullptr);
+}
+
+template <CarModel Car>
+std::optional<double> BasicCarKernel<Car>::calculate_power_net(const CompiledRoute& route, size_t segment_idx,
+	const WeatherDataPoint& weather_data, double state_of_charge, double speed, PowerBreakdown& breakdown) const {
+	return calculate<true, double>(route, segment_idx, weather_data, state_of_charge, speed, &breakdown);
+}
+
+template <CarModel Car>
+template <typename Scalar>
+Scalar BasicCarKernel<Car>::calculate_aero_force(const CompiledRoute& route, size_t segment_idx,
+	const BasicWeatherDataPoint<Scalar>& weather_data, const Scalar& speed) const {
+	using std::abs;
+	using std::hypot;
+	if constexpr (hoists_aero) {
+		// The apparent wind is the reported wind plus the car's velocity. The drag only sees its component along the
+		// heading, the same as its speed times the cosine of its yaw, unless the car is standing still
+		const Scalar wind_north_south = weather_data.wind.get_north_south();
+		const Scalar wind_east_west = weather_data.wind.get_east_west();
+		const Scalar headwind = speed == 0 ? hypot(wind_north_south, wind_east_west)
+										   : abs(wind_north_south * route.cos_heading[segment_idx] +
+												 wind_east_west * route.sin_heading[segment_idx] + speed);
+		return calculate_headwind_drag(headwind, weather_data.air_density);
+	} else {
+		const auto car_velocity = BasicVelocityVector<Scalar>::from_cartesian_components(
+			speed * route.cos_heading[segment_idx], speed * route.sin_heading[segment_idx]);
+		const BasicApparentWindVector<Scalar> wind = Aerobody::get_wind(weather_data.wind, car_velocity);
+		return car.aerobody.aerodynamic_drag(wind, weather_data.air_density);
+	}
+}
+
+template <CarModel Car>
+double BasicCarKernel<Car>::calculate_tire_load(const CompiledRoute& route, size_t segment_idx) const {
+	if constexpr (hoists_tire) {
+		return rolling_load_coefficient * std::pow(route.gravity[segment_idx], rolling_load_exponent);
+	} else {
+		return car.mass * route.gravity[segment_idx];
+	}
+}
+
+template <CarModel Car>
+template <typename Scalar>
+Scalar BasicCarKernel<Car>::calculate_rolling_force(double tire_load, const Scalar& speed) const {
+	if constexpr (hoists_tire) {
+		return tire_load * (rolling_constant + rolling_linear * speed + rolling_quadratic * (speed * speed));
+	} else {
+		return car.tire.template rolling_resistance<Scalar>(tire_load, speed);
+	}
+}
+
+template <CarModel Car>
+template <typename Scalar>
+Scalar BasicCarKernel<Car>::calculate_power_out(const Scalar& speed, const Scalar& resistive_force) const {
+	if constexpr (hoists_motor) {
+		// The wheel radius cancels out of the angular speed times the torque
+		return eddy_current_loss_per_speed * speed + hysteresis_loss + speed * resistive_force;
+	} else {
+		const Scalar angular_speed = speed / car.wheel_radius;
+		const Scalar torque = car.wheel_radius * resistive_force;
+		return car.motor.template power_consumed<Scalar>(angular_speed, torque);
+	}
+}
+
+template <CarModel Car>
+template <bool with_breakdown, typename Scalar>
+std::optional<Scalar> BasicCarKernel<Car>::calculate(const CompiledRoute& route, size_t segment_idx,
+	const BasicWeatherDataPoint<Scalar>& weather_data, const Scalar& state_of_charge, const Scalar& speed,
+	PowerBreakdown* breakdown) const {
+	const Scalar aero_res_f = calculate_aero_force(route, segment_idx, weather_data, speed);
+	const Scalar tire_res_f = calculate_rolling_force(calculate_tire_load(route, segment_idx), speed);
+	const double grav_res_f = route.gravity_times_sine_road_incline_angle[segment_idx] * car.mass;
+	const Scalar resistive_force = aero_res_f + tire_res_f + grav_res_f;
+
+	const Scalar power_out = calculate_power_out(speed, resistive_force);
+	const Scalar power_in = car.array.template power_in<Scalar>(weather_data.irradiance);
+	const Scalar net_power = power_in - power_out;
+	const std::optional<Scalar> power_loss = car.battery.template power_loss<Scalar>(-net_power, state_of_charge);
+	if (!power_loss.has_value()) {
+		return std::nullopt;
+	}
+
+	if constexpr (with_breakdown) {
+		*breakdown = PowerBreakdown{
+			.aero_force = aero_res_f,
+			.rolling_force = tire_res_f,
+			.grade_force = grav_res_f,
+			.power_out = power_out,
+			.power_in = power_in,
+			.power_loss = *power_loss,
+		};
+	}
+	return net_power - *power_loss;
+}
+
+template <CarModel Car>
+void BasicCarKernel<Car>::calculate_power_net_batch(const CompiledRoute& route, size_t segment_idx,
+	std::span<const WeatherDataPoint> weather_data, std::span<const double> states_of_charge,
+	std::span<const double> speeds, std::span<double> net_power) const {
+	assert(weather_data.size() == speeds.size() && states_of_charge.size() == speeds.size() &&
+		   net_power.size() == speeds.size());
+
+	// Everything that only depends on the segment, shared by every lane: the tire load's pow above all
+	const double cos_heading = route.cos_heading[segment_idx];
+	const double sin_heading = route.sin_heading[segment_idx];
+	const double tire_load = calculate_tire_load(route, segment_idx);
+	const double grav_res_f = route.gravity_times_sine_road_incline_angle[segment_idx] * car.mass;
+
+	// The headwind along the heading with the default Aerobody, the drag itself with any other model
+	std::array<double, batch_chunk> aero;
+	std::array<double, batch_chunk> power_out;
+	std::array<double, batch_chunk> power_demanded;
+	std::array<double, batch_chunk> power_loss;
+
+	// The same operations, in the same order, as calculate, a stage at a time over contiguous lanes
+	for (size_t begin = 0; begin < speeds.size(); begin += batch_chunk) {
+		const size_t count = std::min(batch_chunk, speeds.size() - begin);
+		const std::span<const double> lane_speeds = speeds.subspan(begin, count);
+		const std::span<const WeatherDataPoint> lane_weather = weather_data.subspan(begin, count);
+
+		if constexpr (hoists_aero) {
+			for (size_t i = 0; i < count; ++i) {
+				aero[i] = std::abs(lane_weather[i].wind.get_north_south() * cos_heading +
+								   lane_weather[i].wind.get_east_west() * sin_heading + lane_speeds[i]);
+			}
+			// A car standing still has no heading to project the wind onto; it hardly ever happens, so it is patched
+			// up after the fact instead of branching in the loop above
+			for (size_t i = 0; i < count; ++i) {
+				if (lane_speeds[i] == 0) {
+					aero[i] = std::hypot(lane_weather[i].wind.get_north_south(), lane_weather[i].wind.get_east_west());
+				}
+			}
+		} else {
+			for (size_t i = 0; i < count; ++i) {
+				aero[i] = calculate_aero_force<double>(route, segment_idx, lane_weather[i], lane_speeds[i]);
+			}
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			const double speed = lane_speeds[i];
+			double aero_res_f = aero[i];
+			if constexpr (hoists_aero) {
+				aero_res_f = calculate_headwind_drag(aero[i], lane_weather[i].air_density);
+			}
+			const double tire_res_f = calculate_rolling_force(tire_load, speed);
+			const double resistive_force = aero_res_f + tire_res_f + grav_res_f;
+			power_out[i] = calculate_power_out(speed, resistive_force);
+		}
+
+		for (size_t i = 0; i < count; ++i) {
+			net_power[begin + i] = car.array.power_in(lane_weather[i].irradiance) - power_out[i];
+			power_demanded[i] = -net_power[begin + i];
+		}
+
+		car.battery.power_loss_batch(std::span(power_demanded).first(count),
+			states_of_charge.subspan(begin, count), std::span(power_loss).first(count));
+
+		// Impossible lanes have a NaN loss, so they come out NaN
+		for (size_t i = 0; i < count; ++i) {
+			net_power[begin + i] -= power_loss[i];
+		}
+	}
+}
+
+extern template class BasicCarKernel<SolarCar>;
+extern template std::optional<double> CarKernel::calculate_power_net(
+	const CompiledRoute&, size_t, const WeatherDataPoint&, double, double) const;
+
+#endif  // MINISIM_CARKERNEL_H
@@ -1,13 +1,45 @@
 #ifndef MINISIM_RACESEGMENTRUNNER_H
 #define MINISIM_RACESEGMENTRUNNER_H
 
+#include <cmath>
+#include <cstddef>
+#include <optional>
+#include <type_traits>
+
+#include "RaceConfig/Route/CompiledRoute.h"
 #include "RaceConfig/Route/RouteSegment.h"
 #include "RaceConfig/Weather/WeatherDataPoint.h"
+#include "SolarCar/Aerobody/Aerobody.h"
+#include "SolarCar/Aerobody/VelocityVector.h"
+#include "SolarCar/CarModels.h"
 #include "SolarCar/SolarCar.h"
 
-class RaceSegmentRunner {
+/// @brief The physics of a car driving a route segment.
+///
+/// @tparam Car The car, any CarModel. Everything is worked out through the car's component models directly, so
+/// different models are inlined into the race loop just like the default ones.
+template <CarModel Car>
+class BasicRaceSegmentRunner {
    public:
-	explicit RaceSegmentRunner(const SolarCar& solar_car) : car(solar_car) {};
+	/// Where the power of a segment goes, as worked out along the way by calculate_power_net.
+	struct PowerBreakdown {
+		/// (N) The aerodynamic drag.
+		double aero_force;
+		/// (N) The rolling resistance of the tires.
+		double rolling_force;
+		/// (N) The component of gravity along the road.
+		double grade_force;
+		/// (W) The power the motor consumes.
+		double power_out;
+		/// (W) The power the array takes in.
+		double power_in;
+		/// (W) The power lost in the battery.
+		double power_loss;
+	};
+
+	/// @param solar_car The car to simulate. The runner only refers to it, so it must outlive the runner.
+	explicit BasicRaceSegmentRunner(const Car& solar_car) : car(solar_car) {};
+	explicit BasicRaceSegmentRunner(const Car&& solar_car) = delete;
 
 	/// @brief Calculates the resistive force the car experiences over a certain stretch.
 	///
@@ -17,8 +49,9 @@ class RaceSegmentRunner {
 	/// @param speed (m/s) The requested speed for the car to drive at.
 	///
 	/// @returns (N) The resistive force the car experiences, in Newtons.
-	double calculate_resistive_force(
-		const RouteSegment& route_segment, const WeatherDataPoint& weather_data, double speed) const;
+	template <typename Scalar>
+	Scalar calculate_resistive_force(const RouteSegment& route_segment,
+		const BasicWeatherDataPoint<Scalar>& weather_data, std::type_identity_t<Scalar> speed) const;
 
 	/// @brief Calculate the power required to drive the given segment at the given speed.
 	///
@@ -27,8 +60,9 @@ class RaceSegmentRunner {
 	/// @param speed (m/s) The requested speed for the car to drive at.
 	///
 	/// @returns (W) The power out the car demands to travel the given speed over the route.
-	double calculate_power_out(
-		const RouteSegment& route_segment, const WeatherDataPoint& weather_data, double speed) const;
+	template <typename Scalar>
+	Scalar calculate_power_out(const RouteSegment& route_segment, const BasicWeatherDataPoint<Scalar>& weather_data,
+		std::type_identity_t<Scalar> speed) const;
 
 	/// @brief Calculate the power brought in by power-generating components of the car.
 	///
@@ -36,7 +70,9 @@ class RaceSegmentRunner {
 	/// @param weather_data The Weather data at the time the car is driving.
 	///
 	/// @returns (W) The power in the car generates while traveling over the given route segment.
-	double calculate_power_in(const RouteSegment& route_segment, const WeatherDataPoint& weather_data) const;
+	template <typename Scalar>
+	Scalar calculate_power_in(
+		const RouteSegment& route_segment, const BasicWeatherDataPoint<Scalar>& weather_data) const;
 
 	/// @brief Calculate the net power used during this segment.
 	///
@@ -53,11 +89,145 @@ class RaceSegmentRunner {
 	/// @returns (W) The net power that the car draws (or gains) over the given segment. A negative net power means the
 	/// car is demanding power, while a positive one represents gaining power. Returns std::nullopt if the speed
 	/// demanded puts the car in an impossible physical position (e.g. requires the square root of a negative number).
-	std::optional<double> calculate_power_net(const RouteSegment& route_segment, const WeatherDataPoint& weather_data,
-		double state_of_charge, double speed) const;
+	template <typename Scalar>
+	std::optional<Scalar> calculate_power_net(const RouteSegment& route_segment,
+		const BasicWeatherDataPoint<Scalar>& weather_data, std::type_identity_t<Scalar> state_of_charge,
+		std::type_identity_t<Scalar> speed) const;
+
+	/// @brief calculate_power_net for segment @p segment_idx of a compiled route. This is the race loop's version: it
+	/// reads only the segment fields the physics needs, and gives exactly the same result as calculate_power_net on
+	/// the RouteSegment it was compiled from.
+	///
+	/// @param route The compiled route the car is driving on.
+	/// @param segment_idx The index of the segment in @p route.
+	/// @param weather_data The Weather data at the time the car is driving.
+	/// @param state_of_charge The current state of charge of the battery.
+	/// @param speed (m/s) The requested speed for the car to drive at.
+	std::optional<double> calculate_power_net(const CompiledRoute& route, size_t segment_idx,
+		const WeatherDataPoint& weather_data, double state_of_charge, double speed) const;
+
+	/// @brief calculate_power_net for segment @p segment_idx of a compiled route, also giving where the power goes.
+	///
+	/// @param breakdown [out] The forces and powers the net power is made of. Only set if the net power is.
+	std::optional<double> calculate_power_net(const CompiledRoute& route, size_t segment_idx,
+		const WeatherDataPoint& weather_data, double state_of_charge, double speed, PowerBreakdown& breakdown) const;
 
    private:
-	SolarCar car;
+	/// @brief Both calculate_power_net on a compiled route, filling in @p breakdown only if @p with_breakdown.
+	template <bool with_breakdown>
+	std::optional<double> calculate_compiled_power_net(const CompiledRoute& route, size_t segment_idx,
+		const WeatherDataPoint& weather_data, double state_of_charge, double speed, PowerBreakdown* breakdown) const;
+
+	const Car& car;
 };
 
+/// The segment runner for the default car.
+using RaceSegmentRunner = BasicRaceSegmentRunner<SolarCar>;
+
+template <CarModel Car>
+template <typename Scalar>
+Scalar BasicRaceSegmentRunner<Car>::calculate_resistive_force(const RouteSegment& route_segment,
+	const BasicWeatherDataPoint<Scalar>& weather_data, std::type_identity_t<Scalar> speed) const {
+	const auto car_velocity = BasicVelocityVector<Scalar>::from_polar_components(speed, route_segment.heading);
+	const BasicApparentWindVector<Scalar> wind = Aerobody::get_wind(weather_data.wind, car_velocity);
+	const Scalar car_f_g = car.mass * route_segment.gravity;
+	const Scalar aero_res_f = car.aerobody.aerodynamic_drag(wind, weather_data.air_density);
+	const Scalar tire_res_f = car.tire.template rolling_resistance<Scalar>(car_f_g, speed);
+	const double grav_res_f = route_segment.gravity_times_sine_road_incline_angle * car.mass;
+	return aero_res_f + tire_res_f + grav_res_f;
+}
+
+template <CarModel Car>
+template <typename Scalar>
+Scalar BasicRaceSegmentRunner<Car>::calculate_power_out(const RouteSegment& route_segment,
+	const BasicWeatherDataPoint<Scalar>& weather_data, std::type_identity_t<Scalar> speed) const {
+	const Scalar angular_speed = speed / car.wheel_radius;
+	const Scalar torque = car.wheel_radius * calculate_resistive_force(route_segment, weather_data, speed);
+	return car.motor.template power_consumed<Scalar>(angular_speed, torque);
+}
+
+template <CarModel Car>
+template <typename Scalar>
+Scalar BasicRaceSegmentRunner<Car>::calculate_power_in(
+	const RouteSegment& route_segment, const BasicWeatherDataPoint<Scalar>& weather_data) const {
+	static_cast<void>(route_segment);
+	return car.array.template power_in<Scalar>(weather_data.irradiance);
+}
+
+template <CarModel Car>
+template <typename Scalar>
+std::optional<Scalar> BasicRaceSegmentRunner<Car>::calculate_power_net(const RouteSegment& route_segment,
+	const BasicWeatherDataPoint<Scalar>& weather_data, std::type_identity_t<Scalar> state_of_charge,
+	std::type_identity_t<Scalar> speed) const {
+	const Scalar power_out = calculate_power_out(route_segment, weather_data, speed);
+	const Scalar power_in = calculate_power_in(route_segment, weather_data);
+	const Scalar net_power = power_in - power_out;
+	const std::optional<Scalar> power_loss = car.battery.template power_loss<Scalar>(-net_power, state_of_charge);
+	if (!power_loss.has_value()) {
+		return std::nullopt;
+	}
+
+	return net_power - *power_loss;
+}
+
+template <CarModel Car>
+template <bool with_breakdown>
+std::optional<double> BasicRaceSegmentRunner<Car>::calculate_compiled_power_net(const CompiledRoute& route,
+	size_t segment_idx, const WeatherDataPoint& weather_data, double state_of_charge, double speed,
+	PowerBreakdown* breakdown) const {
+	// The same steps as calculate_resistive_force and calculate_power_out, with the heading's cosine and sine read
+	// from the route instead of worked out again
+	const VelocityVector car_velocity = VelocityVector::from_cartesian_components(
+		speed * route.cos_heading[segment_idx], speed * route.sin_heading[segment_idx]);
+	const ApparentWindVector wind = Aerobody::get_wind(weather_data.wind, car_velocity);
+	const double car_f_g = car.mass * route.gravity[segment_idx];
+	const double aero_res_f = car.aerobody.aerodynamic_drag(wind, weather_data.air_density);
+	const double tire_res_f = car.tire.rolling_resistance(car_f_g, speed);
+	const double grav_res_f = route.gravity_times_sine_road_incline_angle[segment_idx] * car.mass;
+	const double resistive_force = aero_res_f + tire_res_f + grav_res_f;
+
+	const double angular_speed = speed / car.wheel_radius;
+	const double torque = car.wheel_radius * resistive_force;
+	const double power_out = car.motor.power_consumed(angular_speed, torque);
+	const double power_in = car.array.power_in(weather_data.irradiance);
+	const double net_power = power_in - power_out;
+	const std::optional<double> power_loss = car.battery.power_loss(-net_power, state_of_charge);
+	if (!power_loss.has_value()) {
+		return std::nullopt;
+	}
+
+	if constexpr (with_breakdown) {
+		*breakdown = PowerBreakdown{
+			.aero_force = aero_res_f,
+			.rolling_force = tire_res_f,
+			.grade_force = grav_res_f,
+			.power_out = power_out,
+			.power_in = power_in,
+			.power_loss = *power_loss,
+		};
+	}
+	return net_power - *power_loss;
+}
+
+template <CarModel Car>
+std::optional<double> BasicRaceSegmentRunner<Car>::calculate_power_net(const CompiledRoute& route, size_t segment_idx,
+	const WeatherDataPoint& weather_data, double state_of_charge, double speed) const {
+	return calculate_compiled_power_net<false>(route, segment_idx, weather_data, state_of_charge, speed, nullptr);
+}
+
+template <CarModel Car>
+std::optional<double> BasicRaceSegmentRunner<Car>::calculate_power_net(const CompiledRoute& route, size_t segment_idx,
+	const WeatherDataPoint& weather_data, double state_of_charge, double speed, PowerBreakdown& breakdown) const {
+	return calculate_compiled_power_net<true>(route, segment_idx, weather_data, state_of_charge, speed, &breakdown);
+}
+
+extern template class BasicRaceSegmentRunner<SolarCar>;
+extern template double RaceSegmentRunner::calculate_resistive_force(
+	const RouteSegment&, const WeatherDataPoint&, double) const;
+extern template double RaceSegmentRunner::calculate_power_out(
+	const RouteSegment&, const WeatherDataPoint&, double) const;
+extern template double RaceSegmentRunner::calculate_power_in(const RouteSegment&, const WeatherDataPoint&) const;
+extern template std::optional<double> RaceSegmentRunner::calculate_power_net(
+	const RouteSegment&, const WeatherDataPoint&, double, double) const;
+
 #endif  // MINISIM_RACESEGMENTRUNNER_H
@@ -3,13 +3,18 @@
 
 #include <cmath>
 #include <numbers>
+#include <type_traits>
+#include <vector>
 
+#include "CarKernel.h"
 #include "RaceSegmentRunner.h"
 
+#include "RaceConfig/Route/CompiledRoute.h"
 #include "RaceConfig/Route/Route.h"
 #include "RaceConfig/Route/RouteSegment.h"
 #include "RaceConfig/Weather/WeatherDataPoint.h"
 #include "SolarCar/SolarCar.h"
+#include "SolarCar/CarModels.h"
 #include "SolarCar/Aerobody/Aerobody.h"
 #include "SolarCar/Array/Array.h"
 #include "SolarCar/Battery/Battery.h"
@@ -7477,3 +7482,241 @@ TEST_CASE("RaceSegmentRunner: calculate_power_net", "[RaceSegmentRunner]") {
 		}
 	}
 }
+
+TEST_CASE("CarKernel: calculate_power_net_batch", "[RaceSegmentRunner]") {
+	SECTION("Every lane matches calculate_power_net") {
+		const auto aerobody = Aerobody(0.00478134, 8.11634);
+		const auto array = Array(6.84089, 24.9139);
+		const auto battery = Battery(3541.06, 0.582171, 112.294, 152.167);
+		const auto motor = Motor(4.95928, 0.00141462);
+		const auto tire = Tire(SaeJ2452Coefficients{-6.61967, 8.82183, -9.43696, 7.8817e-06, 0.531821}, 139.279);
+		const SolarCar car(aerobody, array, battery, motor, tire, 503.682, 0.227503);
+		const CarKernel kernel(car);
+		const RouteSegment route_segment{
+			.coordinate_start = {11.8066, 162.276},
+			.coordinate_end = {87.6016, -138.646},
+			.end_condition = SegmentEndCondition::END_OF_RACE,
+			.type = SegmentType::RACE,
+			.speed_limit = 121.75,
+			.weather_station = 2.74769,
+			.distance = 7.32372,
+			.heading = 0.608135,
+			.elevation = 181.198,
+			.grade = 0.831763,
+			.road_incline_angle = 0.0204063,
+			.sine_road_incline_angle = 0.0204049,
+			.gravity = 9.7947,
+			.gravity_times_sine_road_incline_angle = 0.199859,
+		};
+
+		const CompiledRoute compiled(std::vector<RouteSegment>{route_segment});
+
+		// More lanes than one chunk, with different weather, charge and speed in each; some standing still, a few of
+		// those in more sun than the battery can take in
+		constexpr size_t num_lanes = 150;
+		std::vector<WeatherDataPoint> weather_data;
+		std::vector<double> states_of_charge;
+		std::vector<double> speeds;
+		for (size_t i = 0; i < num_lanes; ++i) {
+			const double lane = static_cast<double>(i);
+			weather_data.push_back(WeatherDataPoint{
+				.wind = VelocityVector::from_polar_components(0.2 * lane, 0.05 * lane),
+				.irradiance = i % 40 == 39 ? 1e5 : 5 * lane,
+				.air_temp = 20,
+				.pressure = 1000.05,
+				.air_density = 1.1028,
+				.reciprocal_speed_of_sound = 0.00290958,
+			});
+			states_of_charge.push_back(lane / num_lanes);
+			speeds.push_back(i % 40 == 0 || i % 40 == 39 ? 0 : 1 + 0.3 * lane);
+		}
+
+		std::vector<double> result(num_lanes);
+		kernel.calculate_power_net_batch(compiled, 0, weather_data, states_of_charge, speeds, result);
+		size_t num_impossible = 0;
+		for (size_t i = 0; i < num_lanes; ++i) {
+			const auto expected =
+				kernel.calculate_power_net<double>(compiled, 0, weather_data[i], states_of_charge[i], speeds[i]);
+			REQUIRE(expected.has_value() == !std::isnan(result[i]));
+			if (expected.has_value()) {
+				REQUIRE(result[i] == expected.value());
+			} else {
+				++num_impossible;
+			}
+		}
+		REQUIRE(num_impossible > 0);
+		REQUIRE(num_impossible < num_lanes);
+	}
+}
+
+TEST_CASE("RaceSegmentRunner: calculate_power_net on a compiled route", "[RaceSegmentRunner]") {
+	SECTION("Every segment matches calculate_power_net on the segment it was compiled from") {
+		const auto aerobody = Aerobody(0.00478134, 8.11634);
+		const auto array = Array(6.84089, 24.9139);
+		const auto battery = Battery(3541.06, 0.582171, 112.294, 152.167);
+		const auto motor = Motor(4.95928, 0.00141462);
+		const auto tire = Tire(SaeJ2452Coefficients{-6.61967, 8.82183, -9.43696, 7.8817e-06, 0.531821}, 139.279);
+		const SolarCar car(aerobody, array, battery, motor, tire, 503.682, 0.227503);
+		const auto runner = RaceSegmentRunner(car);
+
+		// Headings all the way around, uphill and downhill, with every end condition the race loop acts on
+		std::vector<RouteSegment> segments;
+		for (size_t i = 0; i < 24; ++i) {
+			const double segment = static_cast<double>(i);
+			const double sine_road_incline_angle = 0.01 * (segment - 12);
+			segments.push_back(RouteSegment{
+				.coordinate_start = {11.8066, 162.276},
+				.coordinate_end = {87.6016, -138.646},
+				.end_condition = i % 3 == 0 ? SegmentEndCondition::CONTROL_STOP
+							   : i % 3 == 1 ? SegmentEndCondition::END_OF_RACE
+											: SegmentEndCondition::MAX_LENGTH_REACHED,
+				.type = SegmentType::RACE,
+				.speed_limit = 121.75,
+				.weather_station = 0.5 * segment,
+				.distance = 7.32372 + segment,
+				.heading = 0.3 * segment - std::numbers::pi,
+				.elevation = 181.198,
+				.grade = std::tan(std::asin(sine_road_incline_angle)),
+				.road_incline_angle = std::asin(sine_road_incline_angle),
+				.sine_road_incline_angle = sine_road_incline_angle,
+				.gravity = 9.7947,
+				.gravity_times_sine_road_incline_angle = 9.7947 * sine_road_incline_angle,
+			});
+		}
+		const CompiledRoute compiled(segments);
+		REQUIRE(compiled.size() == segments.size());
+
+		const WeatherDataPoint weather_data{
+			.wind = VelocityVector::from_polar_components(3.1, 1.2),
+			.irradiance = 640,
+			.air_temp = 20,
+			.pressure = 1000.05,
+			.air_density = 1.1028,
+			.reciprocal_speed_of_sound = 0.00290958,
+		};
+		for (size_t i = 0; i < segments.size(); ++i) {
+			REQUIRE(compiled.distance[i] == segments[i].distance);
+			REQUIRE(compiled.weather_station[i] == segments[i].weather_station);
+			REQUIRE(((compiled.end_flags[i] & CompiledRoute::ENDS_IN_CONTROL_STOP) != 0) ==
+					(segments[i].end_condition == SegmentEndCondition::CONTROL_STOP));
+			REQUIRE(((compiled.end_flags[i] & CompiledRoute::ENDS_RACE) != 0) ==
+					(segments[i].end_condition == SegmentEndCondition::END_OF_RACE));
+
+			for (const double speed : {1.0, 14.5, 27.0}) {
+				const auto expected = runner.calculate_power_net(segments[i], weather_data, 0.6, speed);
+				const auto result = runner.calculate_power_net(compiled, i, weather_data, 0.6, speed);
+				REQUIRE(result.has_value() == expected.has_value());
+				if (expected.has_value()) {
+					REQUIRE(result.value() == expected.value());
+				}
+			}
+		}
+	}
+}
+
+namespace {
+	/// A drag model whose drag coefficient grows with the yaw of the apparent wind, to plug into a car.
+	class YawDependentAerobody {
+	   public:
+		YawDependentAerobody(double drag_area, double yaw_sensitivity)
+			: drag_area(drag_area), yaw_sensitivity(yaw_sensitivity) {}
+
+		template <typename Scalar>
+		Scalar aerodynamic_drag(const BasicApparentWindVector<Scalar>& apparent_wind,
+			const std::type_identity_t<Scalar>& air_density) const {
+			using std::cos;
+			const Scalar v = apparent_wind.speed * cos(apparent_wind.yaw);
+			const Scalar drag_coefficient_scale = 1 + yaw_sensitivity * apparent_wind.yaw * apparent_wind.yaw;
+			return 0.5 * air_density * v * v * drag_area * drag_coefficient_scale;
+		}
+
+	   private:
+		double drag_area;
+		double yaw_sensitivity;
+	};
+
+	using YawDependentCar = BasicSolarCar<YawDependentAerobody, Array, Battery, Motor, Tire>;
+}  // namespace
+
+TEST_CASE("RaceSegmentRunner: BasicRaceSegmentRunner with other component models", "[RaceSegmentRunner]") {
+	static_assert(CarModel<SolarCar>);
+	static_assert(AeroModel<Aerobody> && ArrayModel<Array> && BatteryModel<Battery> && MotorModel<Motor>);
+	static_assert(TireModel<Tire> && AeroModel<YawDependentAerobody>);
+	static_assert(!AeroModel<Tire> && !TireModel<Aerobody>);
+
+	const auto array = Array(6.84089, 24.9139);
+	const auto battery = Battery(3541.06, 0.582171, 112.294, 152.167);
+	const auto motor = Motor(4.95928, 0.00141462);
+	const auto tire = Tire(SaeJ2452Coefficients{-0.477792, 1.135541, 0.0100702, 4.3605e-05, 1.67047e-07}, 400);
+	constexpr double drag_coefficient = 0.10583;
+	constexpr double frontal_area = 0.6802;
+	const SolarCar car(Aerobody(drag_coefficient, frontal_area), array, battery, motor, tire, 243, 0.27635);
+	const auto runner = RaceSegmentRunner(car);
+
+	const RouteSegment segment{
+		.coordinate_start = {11.8066, 162.276},
+		.coordinate_end = {87.6016, -138.646},
+		.end_condition = SegmentEndCondition::MAX_LENGTH_REACHED,
+		.type = SegmentType::RACE,
+		.speed_limit = 121.75,
+		.weather_station = 0.5,
+		.distance = 1000,
+		.heading = 0.7,
+		.elevation = 181.198,
+		.grade = 0.01,
+		.road_incline_angle = std::atan(0.01),
+		.sine_road_incline_angle = std::sin(std::atan(0.01)),
+		.gravity = 9.7947,
+		.gravity_times_sine_road_incline_angle = 9.7947 * std::sin(std::atan(0.01)),
+	};
+	const WeatherDataPoint weather_data{
+		.wind = VelocityVector::from_polar_components(3.1, 1.2),
+		.irradiance = 640,
+		.air_temp = 20,
+		.pressure = 1000.05,
+		.air_density = 1.1028,
+		.reciprocal_speed_of_sound = 0.00290958,
+	};
+
+	SECTION("Without any yaw dependence the model drives like the default car") {
+		const YawDependentCar other_car(
+			YawDependentAerobody(drag_coefficient * frontal_area, 0), array, battery, motor, tire, 243, 0.27635);
+		const auto other_runner = BasicRaceSegmentRunner<YawDependentCar>(other_car);
+		for (const double speed : {5.0, 20.0, 35.0}) {
+			const auto expected = runner.calculate_power_net(segment, weather_data, 0.6, speed);
+			const auto result = other_runner.calculate_power_net(segment, weather_data, 0.6, speed);
+			REQUIRE(result.has_value() == expected.has_value());
+			REQUIRE_THAT(result.value(), WithinRel(expected.value(), 1e-12));
+		}
+	}
+
+	SECTION("The yaw dependent drag costs more power in a crosswind") {
+		const YawDependentCar other_car(
+			YawDependentAerobody(drag_coefficient * frontal_area, 0.5), array, battery, motor, tire, 243, 0.27635);
+		const auto other_runner = BasicRaceSegmentRunner<YawDependentCar>(other_car);
+		REQUIRE(other_runner.calculate_resistive_force(segment, weather_data, 20.0) >
+				runner.calculate_resistive_force(segment, weather_data, 20.0));
+	}
+	SECTION("The kernel drives the other car like its runner, without a copy of it") {
+		const YawDependentCar other_car(
+			YawDependentAerobody(drag_coefficient * frontal_area, 0.5), array, battery, motor, tire, 243, 0.27635);
+		const auto other_runner = BasicRaceSegmentRunner<YawDependentCar>(other_car);
+		const BasicCarKernel<YawDependentCar> kernel(other_car);
+		static_assert(sizeof(BasicCarKernel<YawDependentCar>) < sizeof(YawDependentCar));
+		static_assert(sizeof(CarKernel) < sizeof(SolarCar));
+
+		const CompiledRoute compiled(std::vector<RouteSegment>{segment});
+		const std::vector<WeatherDataPoint> weather(3, weather_data);
+		const std::vector<double> states_of_charge(3, 0.6);
+		const std::vector<double> speeds = {5.0, 20.0, 35.0};
+		std::vector<double> batch(speeds.size());
+		kernel.calculate_power_net_batch(compiled, 0, weather, states_of_charge, speeds, batch);
+		for (size_t i = 0; i < speeds.size(); ++i) {
+			const auto expected = other_runner.calculate_power_net(segment, weather_data, 0.6, speeds[i]);
+			const auto result = kernel.calculate_power_net<double>(compiled, 0, weather_data, 0.6, speeds[i]);
+			REQUIRE(result.has_value() == expected.has_value());
+			REQUIRE_THAT(result.value(), WithinRel(expected.value(), 1e-12));
+			REQUIRE(batch[i] == result.value());
+		}
+	}
+}
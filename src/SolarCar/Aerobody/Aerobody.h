@@ -1,6 +1,9 @@
 #ifndef MINISIM_AEROBODY_H
 #define MINISIM_AEROBODY_H
 
+#include <cmath>
+#include <type_traits>
+
 #include "VelocityVector.h"
 
 class Aerobody {
@@ -21,7 +24,9 @@ class Aerobody {
 	/// wind and true wind.
 	///
 	/// @return an apparent wind vector
-	static ApparentWindVector get_wind(const VelocityVector& reported_wind, const VelocityVector& car_velocity);
+	template <typename Scalar>
+	static BasicApparentWindVector<Scalar> get_wind(
+		const BasicVelocityVector<Scalar>& reported_wind, const BasicVelocityVector<Scalar>& car_velocity);
 
 	/// @brief Gets the drag on the aerobody at a given apparent wind vector
 	///
@@ -29,7 +34,14 @@ class Aerobody {
 	/// @param air_density (kg/m^3) The air density
 	///
 	/// @return the drag force, in Newtons.
-	double aerodynamic_drag(const ApparentWindVector& apparent_wind, double air_density) const;
+	template <typename Scalar>
+	Scalar aerodynamic_drag(
+		const BasicApparentWindVector<Scalar>& apparent_wind, const std::type_identity_t<Scalar>& air_density) const;
+
+	/// @returns (m^2) The drag area: the coefficient of drag times the frontal area
+	// clang-format off
+	inline double get_drag_area() const { return drag_coefficient * frontal_area; }
+	// clang-format on
 
    private:
 	/// @brief the coefficient of drag
@@ -47,4 +59,37 @@ class Aerobody {
 	double frontal_area;
 };
 
+// f_drag = 0.5 * density * (air speed of vehicle)^2 * Area * drag coefficient
+
+template <typename Scalar>
+BasicApparentWindVector<Scalar> Aerobody::get_wind(
+	const BasicVelocityVector<Scalar>& reported_wind, const BasicVelocityVector<Scalar>& car_velocity) {
+	const Scalar ns_sum = -reported_wind.get_north_south() - car_velocity.get_north_south();
+	const Scalar ew_sum = -reported_wind.get_east_west() - car_velocity.get_east_west();
+
+	const auto rel_vec = BasicVelocityVector<Scalar>::from_cartesian_components(-ns_sum, -ew_sum);
+
+	const Scalar yaw = car_velocity.angle_between(rel_vec);
+
+	const Scalar speed = rel_vec.get_magnitude();
+
+	return BasicApparentWindVector<Scalar>{speed, yaw};
+}
+
+template <typename Scalar>
+Scalar Aerobody::aerodynamic_drag(
+	const BasicApparentWindVector<Scalar>& apparent_wind, const std::type_identity_t<Scalar>& air_density) const {
+	using std::abs;
+	using std::cos;
+	using std::pow;
+	const Scalar v = apparent_wind.speed * abs(cos(apparent_wind.yaw));
+
+	const double CdA = drag_coefficient * frontal_area;
+
+	return 0.5 * air_density * pow(v, 2) * CdA;
+}
+
+extern template ApparentWindVector Aerobody::get_wind(const VelocityVector&, const VelocityVector&);
+extern template double Aerobody::aerodynamic_drag(const ApparentWindVector&, const double&) const;
+
 #endif  // MINISIM_AEROBODY_H
@@ -3,68 +3,76 @@
 
 #include <cmath>
 #include <numbers>
-#include <iostream>
 
-struct VelocityVector {
-public:
-    static VelocityVector from_cartesian_components(double north_south, double east_west){
-
-         return VelocityVector(north_south, east_west);
-    }
-    static VelocityVector from_polar_components(double speed, double heading){
-
-        return VelocityVector{
-        speed * std::cos(heading),  // north_south
-        speed * std::sin(heading) 
-        };
-    }
-
-    double get_north_south() const{
-
-        return north_south;
-    }
-    double get_east_west() const{
-        return east_west;
-    }
-    double get_magnitude() const{
-return std::hypot(east_west, north_south);
-
-    }
-    double get_heading() const{
-
-double pi = std::numbers::pi;
-    double range = std::atan2(east_west, north_south);
-
-    if (range < 0) {
-        range += 2 * pi;
-    }
-
-    return range;
-        
-    }
-    double angle_between(const VelocityVector& other) const{
-
-
-        if (this->get_magnitude() == 0 || other.get_magnitude() == 0) {
-        return 0;
-    }
-    const double dot_product = north_south * other.north_south + east_west * other.east_west;
-    const double cross_product = north_south * other.east_west - other.north_south * east_west;
-    return -atan2(cross_product, dot_product);
-    };
-
-private:
-    double north_south;
-    double east_west;
+/// @brief A horizontal velocity, stored as north-south and east-west components.
+///
+/// @tparam Scalar The number type: double, or a dual number to carry derivatives along.
+template <typename Scalar>
+struct BasicVelocityVector {
+   public:
+	static BasicVelocityVector from_cartesian_components(Scalar north_south, Scalar east_west) {
+		return BasicVelocityVector(north_south, east_west);
+	}
+
+	static BasicVelocityVector from_polar_components(Scalar speed, Scalar heading) {
+		using std::cos;
+		using std::sin;
+		return BasicVelocityVector{
+			speed * cos(heading),  // north_south
+			speed * sin(heading)   // east_west
+		};
+	}
+
+	Scalar get_north_south() const {
+		return north_south;
+	}
+
+	Scalar get_east_west() const {
+		return east_west;
+	}
+
+	Scalar get_magnitude() const {
+		using std::hypot;
+		return hypot(east_west, north_south);
+	}
+
+	Scalar get_heading() const {
+		using std::atan2;
+		const double pi = std::numbers::pi;
+		Scalar range = atan2(east_west, north_south);
+
+		if (range < 0) {
+			range += 2 * pi;
+		}
+
+		return range;
+	}
+
+	Scalar angle_between(const BasicVelocityVector& other) const {
+		using std::atan2;
+		if (this->get_magnitude() == 0 || other.get_magnitude() == 0) {
+			return 0;
+		}
+		const Scalar dot_product = north_south * other.north_south + east_west * other.east_west;
+		const Scalar cross_product = north_south * other.east_west - other.north_south * east_west;
+		return -atan2(cross_product, dot_product);
+	}
+
+   private:
+	Scalar north_south;
+	Scalar east_west;
+
+	BasicVelocityVector(Scalar north_south, Scalar east_west) : north_south(north_south), east_west(east_west) {}
+};
 
-    VelocityVector(double north_south, double east_west)
-    :north_south(north_south), east_west(east_west){}
+using VelocityVector = BasicVelocityVector<double>;
 
+template <typename Scalar>
+struct BasicApparentWindVector {
+	Scalar speed;
+	Scalar yaw;
 };
 
-struct ApparentWindVector {
-    double speed;
-    double yaw;
-};
+using ApparentWindVector = BasicApparentWindVector<double>;
 
 #endif  // MINISIM_VECTOR_H
@@ -1,8 +1,3 @@
 #include "Array.h"
-double Array::power_in(double irradiance) const{
 
-double array_effeciency_fraction = array_efficiency/100.0;
-return (irradiance * array_area * array_effeciency_fraction);
-
-
-}
+template double Array::power_in<double>(const double&) const;
@@ -1,6 +1,8 @@
 #ifndef MINISIM_ARRAY_H
 #define MINISIM_ARRAY_H
 
+#include <type_traits>
+
 class Array {
    public:
 	/// @param array_area (m^2) the area of the solar array
@@ -11,7 +13,8 @@ class Array {
 	/// @brief calculates the amount of power that the solar array is bringing in
 	///
 	/// @param irradiance (W/m^2) the irradiance that the array is experiencing
-	double power_in(double irradiance) const;
+	template <typename Scalar = double>
+	Scalar power_in(const std::type_identity_t<Scalar>& irradiance) const;
 
    private:
 	/// @brief (m^2) the exposed surface area of the solar array
@@ -21,4 +24,12 @@ class Array {
 	double array_efficiency;
 };
 
+template <typename Scalar>
+Scalar Array::power_in(const std::type_identity_t<Scalar>& irradiance) const {
+	const double array_efficiency_fraction = array_efficiency / 100.0;
+	return irradiance * array_area * array_efficiency_fraction;
+}
+
+extern template double Array::power_in<double>(const double&) const;
+
 #endif
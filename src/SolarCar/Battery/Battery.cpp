@@ -1,31 +1,22 @@
 #include "Battery.h"
 
+#include <cmath>
+#include <limits>
 #include <optional>
-using namespace std;
-double Battery::state_of_charge(double energy_remaining) const{
-return energy_remaining/ energy_capacity;
+#include <span>
+
+template double Battery::state_of_charge<double>(const double&) const;
+template double Battery::current_voltage<double>(const double&) const;
+template std::optional<double> Battery::power_loss<double>(const double&, const double&) const;
+
+void Battery::power_loss_batch(std::span<const double> net_power_demanded, std::span<const double> state_of_charge,
+	std::span<double> power_loss) const {
+	assert(net_power_demanded.size() == state_of_charge.size() && power_loss.size() == state_of_charge.size());
+	for (size_t i = 0; i < power_loss.size(); ++i) {
+		// Same operations, in the same order, as power_loss (pow(x, 2) is exactly x * x)
+		const double vol = current_voltage(state_of_charge[i]);
+		const double discriminant = vol * vol + 4 * pack_resistance * net_power_demanded[i];
+		const double cur = (-vol + std::sqrt(discriminant)) / (2 * pack_resistance);
+		power_loss[i] = discriminant < 0 ? std::numeric_limits<double>::quiet_NaN() : cur * cur * pack_resistance;
+	}
 }
-
-
-
-double Battery::current_voltage(double state_of_charge) const{
-    return ((max_voltage-min_voltage)*state_of_charge)+min_voltage;
-}
-
-	std::optional<double> Battery::power_loss(double net_power_demanded, double state_of_charge) const { //NOLINT
-    const double vol = current_voltage(state_of_charge);  
-
-   
-    if ((std::pow(vol, 2)) + 4 * pack_resistance * net_power_demanded < 0) {
-        return std::nullopt;
-    }
-
-    
-    const double cur = (-vol + std::sqrt(std::pow(vol, 2) + (4 * pack_resistance * net_power_demanded))) / (2 * pack_resistance);
-
-    return optional<double>(std::pow(cur, 2) * pack_resistance);
-}
-
-
-
-
@@ -2,7 +2,10 @@
 #define MINISIM_BATTERY_H
 
 #include <cassert>
+#include <cmath>
 #include <optional>
+#include <span>
+#include <type_traits>
 
 class Battery {
    public:
@@ -18,13 +21,15 @@ class Battery {
 	/// @brief Calculates the state of charge of the battery, given its current stored energy
 	///
 	/// @param energy_remaining (Wh) the energy remaining in the battery
-	double state_of_charge(double energy_remaining) const;
+	template <typename Scalar = double>
+	Scalar state_of_charge(const std::type_identity_t<Scalar>& energy_remaining) const;
 
 	/// @brief Calculates the current voltage of the battery, given its state of charge
 	///
 	/// @param state_of_charge (fraction [0, 1]) the remaining energy in the battery, relative to
 	/// its maximum capacity
-	double current_voltage(double state_of_charge) const;
+	template <typename Scalar = double>
+	Scalar current_voltage(const std::type_identity_t<Scalar>& state_of_charge) const;
 
 	/// @brief Calculates the power loss due to battery resistance given the power demanded, as well
 	/// as the current state of charge of the battery.
@@ -35,7 +40,18 @@ class Battery {
 	/// its maximum capacity
 	/// @returns (W) Power Loss due to battery resistance. If the situation is physically impossible,
 	/// returns an std::nullopt instead (e.g. the square root of a negative number).
-	std::optional<double> power_loss(double net_power_demanded, double state_of_charge) const;
+	template <typename Scalar = double>
+	std::optional<Scalar> power_loss(const std::type_identity_t<Scalar>& net_power_demanded,
+		const std::type_identity_t<Scalar>& state_of_charge) const;
+
+	/// @brief power_loss for many independent lanes at once, laid out so the loop vectorizes.
+	///
+	/// @param net_power_demanded the power demanded from the battery by each lane
+	/// @param state_of_charge (fraction [0, 1]) the state of charge of each lane
+	/// @param power_loss [out] (W) the power loss of each lane, exactly as power_loss computes it. Lanes in a
+	/// physically impossible situation get NaN instead of std::nullopt.
+	void power_loss_batch(std::span<const double> net_power_demanded, std::span<const double> state_of_charge,
+		std::span<double> power_loss) const;
 
 	/// @returns (Wh) The energy capacity of the battery
 	// clang-format off
@@ -56,4 +72,34 @@ class Battery {
 	double max_voltage;
 };
 
+template <typename Scalar>
+Scalar Battery::state_of_charge(const std::type_identity_t<Scalar>& energy_remaining) const {
+	return energy_remaining / energy_capacity;
+}
+
+template <typename Scalar>
+Scalar Battery::current_voltage(const std::type_identity_t<Scalar>& state_of_charge) const {
+	return ((max_voltage - min_voltage) * state_of_charge) + min_voltage;
+}
+
+template <typename Scalar>
+std::optional<Scalar> Battery::power_loss(const std::type_identity_t<Scalar>& net_power_demanded,
+	const std::type_identity_t<Scalar>& state_of_charge) const {
+	using std::pow;
+	using std::sqrt;
+	const Scalar vol = current_voltage<Scalar>(state_of_charge);
+
+	if ((pow(vol, 2)) + 4 * pack_resistance * net_power_demanded < 0) {
+		return std::nullopt;
+	}
+
+	const Scalar cur = (-vol + sqrt(pow(vol, 2) + (4 * pack_resistance * net_power_demanded))) / (2 * pack_resistance);
+
+	return pow(cur, 2) * pack_resistance;
+}
+
+extern template double Battery::state_of_charge<double>(const double&) const;
+extern template double Battery::current_voltage<double>(const double&) const;
+extern template std::optional<double> Battery::power_loss<double>(const double&, const double&) const;
+
 #endif  // MINISIM_BATTERY_H
@@ -3,6 +3,7 @@
 
 #include <cmath>
 #include <numbers>
+#include <vector>
 
 #include "Battery.h"
 #include "BatteryState.h"
@@ -2305,3 +2306,19 @@ TEST_CASE("Battery: power_loss", "[Battery]") {
 
 }
 
+TEST_CASE("Battery: power_loss_batch", "[Battery]") {
+	SECTION("Every lane matches power_loss") {
+		const auto a = Battery(5093.31, 0.502807, 73.582, 158.624);
+		const std::vector<double> net_power_demanded = {1217.48, -2470.31, 3460.86, 0, -1e6, 25000};
+		const std::vector<double> states_of_charge = {0.958833, 0.1, 0.5, 0.75, 0.3, 0};
+		std::vector<double> result(net_power_demanded.size());
+		a.power_loss_batch(net_power_demanded, states_of_charge, result);
+		for (size_t i = 0; i < result.size(); ++i) {
+			const auto expected = a.power_loss(net_power_demanded[i], states_of_charge[i]);
+			REQUIRE(expected.has_value() == !std::isnan(result[i]));
+			if (expected.has_value()) {
+				REQUIRE(result[i] == expected.value());
+			}
+		}
+	}
+}
@@ -0,0 +1,66 @@
+#ifndef MINISIM_CARMODELS_H
+#define MINISIM_CARMODELS_H
+
+#include <concepts>
+#include <optional>
+#include <span>
+
+#include "SolarCar/Aerobody/VelocityVector.h"
+
+/// @file
+/// @brief What the simulation needs of each component of a car.
+///
+/// A car is put together from one model of each component, fixed at compile time, so the race loop can inline
+/// whichever models it is given. The models in SolarCar/ are the defaults. Each concept takes the scalar type it
+/// must work with: double for the race loop, or a dual number for the racetime gradient.
+
+/// @brief A model of the drag on the car's body.
+///
+/// The drag is given the apparent wind with its yaw, so a model may make its drag coefficient depend on the yaw.
+template <typename T, typename Scalar = double>
+concept AeroModel =
+	requires(const T& aerobody, const BasicApparentWindVector<Scalar>& apparent_wind, const Scalar& air_density) {
+		{ aerobody.aerodynamic_drag(apparent_wind, air_density) } -> std::convertible_to<Scalar>;
+	};
+
+/// @brief A model of the power the solar array takes in.
+template <typename T, typename Scalar = double>
+concept ArrayModel = requires(const T& array, const Scalar& irradiance) {
+	{ array.template power_in<Scalar>(irradiance) } -> std::convertible_to<Scalar>;
+};
+
+/// @brief A model of the battery: its state of charge, and the power lost in it when power is drawn from it.
+template <typename T, typename Scalar = double>
+concept BatteryModel = requires(const T& battery, const Scalar& energy, const Scalar& power, const Scalar& soc,
+	std::span<const double> values, std::span<double> results) {
+	{ battery.template state_of_charge<Scalar>(energy) } -> std::convertible_to<Scalar>;
+	{ battery.template power_loss<Scalar>(power, soc) } -> std::convertible_to<std::optional<Scalar>>;
+	{ battery.power_loss_batch(values, values, results) };
+	{ battery.get_capacity() } -> std::convertible_to<double>;
+};
+
+/// @brief A model of the power the motor consumes to turn the wheels.
+template <typename T, typename Scalar = double>
+concept MotorModel = requires(const T& motor, const Scalar& angular_speed, const Scalar& torque) {
+	{ motor.template power_consumed<Scalar>(angular_speed, torque) } -> std::convertible_to<Scalar>;
+};
+
+/// @brief A model of the rolling resistance of the tires.
+template <typename T, typename Scalar = double>
+concept TireModel = requires(const T& tire, const Scalar& tire_load, const Scalar& vehicle_speed) {
+	{ tire.template rolling_resistance<Scalar>(tire_load, vehicle_speed) } -> std::convertible_to<Scalar>;
+};
+
+/// @brief A whole car: a model of every component, and its mass and wheel radius.
+template <typename T, typename Scalar = double>
+concept CarModel = requires(const T& car) {
+	requires AeroModel<decltype(car.aerobody), Scalar>;
+	requires ArrayModel<decltype(car.array), Scalar>;
+	requires BatteryModel<decltype(car.battery), Scalar>;
+	requires MotorModel<decltype(car.motor), Scalar>;
+	requires TireModel<decltype(car.tire), Scalar>;
+	{ car.mass } -> std::convertible_to<double>;
+	{ car.wheel_radius } -> std::convertible_to<double>;
+};
+
+#endif  // MINISIM_CARMODELS_H
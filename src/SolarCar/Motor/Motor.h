@@ -1,6 +1,8 @@
 #ifndef MINISIM_MOTOR_H
 #define MINISIM_MOTOR_H
 
+#include <type_traits>
+
 class Motor {
    public:
 	Motor(double hysteresis_loss, double eddy_current_loss_coefficient)
@@ -13,7 +15,19 @@ class Motor {
 	/// @param torque (Nm) the torque that the motor is operating with.
 	///
 	/// @note negative torque means regenerative braking.
-	double power_consumed(double angular_speed, double torque) const;
+	template <typename Scalar = double>
+	Scalar power_consumed(
+		const std::type_identity_t<Scalar>& angular_speed, const std::type_identity_t<Scalar>& torque) const;
+
+	/// @returns (W) The losses associated with the hysteresis of the motor
+	// clang-format off
+	inline double get_hysteresis_loss() const { return hysteresis_loss; }
+	// clang-format on
+
+	/// @returns The coefficient of the losses associated with the eddy currents in the motor
+	// clang-format off
+	inline double get_eddy_current_loss_coefficient() const { return eddy_current_loss_coefficient; }
+	// clang-format on
 
    private:
 	/// @brief (W) the losses associated with the hysteresis of the motor.
@@ -28,4 +42,12 @@ class Motor {
 	double eddy_current_loss_coefficient;
 };
 
+template <typename Scalar>
+Scalar Motor::power_consumed(
+	const std::type_identity_t<Scalar>& angular_speed, const std::type_identity_t<Scalar>& torque) const {
+	return ((eddy_current_loss_coefficient * angular_speed) + hysteresis_loss) + (angular_speed * torque);
+}
+
+extern template double Motor::power_consumed<double>(const double&, const double&) const;
+
 #endif  // MINISIM_MOTOR_H
@@ -38,7 +38,7 @@
 // c = 1.67047322589584e-7
 
 SolarCar::SolarCar(const ConfigFile& car_config)
-	: aerobody(0, 0), array(0, 0), battery(0, 0, 0, 0), motor(0, 0), tire({}, 0), mass(0), wheel_radius(0) {
+	: BasicSolarCar(Aerobody(0, 0), Array(0, 0), Battery(0, 0, 0, 0), Motor(0, 0), Tire({}, 0), 0, 0) {
 	mass = car_config.get_force<double>("mass");                       // NOLINT
 	wheel_radius = car_config.get_force<double>("tire.wheel-radius");  // NOLINT
 
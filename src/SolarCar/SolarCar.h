@@ -4,6 +4,7 @@
 #include <string>
 
 #include "ConfigFile/ConfigFile.h"
+#include "SolarCar/CarModels.h"
 
 // Car Components
 #include "SolarCar/Aerobody/Aerobody.h"
@@ -12,18 +13,22 @@
 #include "SolarCar/Motor/Motor.h"
 #include "SolarCar/Tire/Tire.h"
 
-class SolarCar {
+/// @brief A solar car, put together from a model of each of its components.
+///
+/// @tparam AeroT, ArrayT, BatteryT, MotorT, TireT The component models; see CarModels.h.
+template <AeroModel AeroT, ArrayModel ArrayT, BatteryModel BatteryT, MotorModel MotorT, TireModel TireT>
+class BasicSolarCar {
    public:
-	Aerobody aerobody;
-	Array array;
-	Battery battery;
-	Motor motor;
-	Tire tire;
+	AeroT aerobody;
+	ArrayT array;
+	BatteryT battery;
+	MotorT motor;
+	TireT tire;
 	double mass;
 	double wheel_radius;
 
-	SolarCar(const Aerobody& aerobody, const Array& array, const Battery& battery, const Motor& motor, const Tire& tire,
-		const double mass, const double wheel_radius)
+	BasicSolarCar(const AeroT& aerobody, const ArrayT& array, const BatteryT& battery, const MotorT& motor,
+		const TireT& tire, const double mass, const double wheel_radius)
 		: aerobody(aerobody),
 		  array(array),
 		  battery(battery),
@@ -31,6 +36,12 @@ class SolarCar {
 		  tire(tire),
 		  mass(mass),
 		  wheel_radius(wheel_radius) {}
+};
+
+/// @brief The solar car built from the default component models, the one the race runners simulate.
+class SolarCar : public BasicSolarCar<Aerobody, Array, Battery, Motor, Tire> {
+   public:
+	using BasicSolarCar::BasicSolarCar;
 	explicit SolarCar(const ConfigFile& car_config);
 };
 
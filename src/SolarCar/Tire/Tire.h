@@ -1,7 +1,9 @@
 #ifndef MINISIM_TIRE_H
 #define MINISIM_TIRE_H
 
+#include <cmath>
 #include <optional>
+#include <type_traits>
 
 /// @brief A struct containing the SAE J2452 Coefficients for Tire Model
 /// construction.
@@ -47,9 +49,20 @@ class Tire {
 	///
 	/// [Hint]: While we operate with SI units whenever possible and reasonable, there are
 	/// situations in which we don't.
-	double rolling_resistance(double tire_load, double vehicle_speed,
+	template <typename Scalar = double>
+	Scalar rolling_resistance(const std::type_identity_t<Scalar>& tire_load, std::type_identity_t<Scalar> vehicle_speed,
 		std::optional<double> tire_pressure = std::nullopt) const;
 
+	/// @returns The SAE J2452 Coefficients of the tire
+	inline SaeJ2452Coefficients get_coefficients() const {
+		return SaeJ2452Coefficients{.alpha = alpha, .beta = beta, .a = a, .b = b, .c = c};
+	}
+
+	/// @returns The tire pressure under standard conditions
+	// clang-format off
+	inline double get_pressure_at_stc() const { return tire_pressure_at_stc; }
+	// clang-format on
+
    private:
 	/// @brief one of the SAE J2452 Coefficients
 	double alpha;
@@ -67,4 +80,18 @@ class Tire {
 	double tire_pressure_at_stc;
 };
 
-#endif
\ No newline at end of file
+template <typename Scalar>
+Scalar Tire::rolling_resistance(
+	const std::type_identity_t<Scalar>& tire_load, std::type_identity_t<Scalar> vehicle_speed,
+	std::optional<double> tire_pressure) const {
+	using std::pow;
+	vehicle_speed *= 3.6;
+
+	const double pressure = tire_pressure.value_or(tire_pressure_at_stc);
+
+	return pow(pressure, alpha) * pow(tire_load, beta) * (a + b * vehicle_speed + c * pow(vehicle_speed, 2));
+}
+
+extern template double Tire::rolling_resistance<double>(const double&, double, std::optional<double>) const;
+
+#endif  // MINISIM_TIRE_H
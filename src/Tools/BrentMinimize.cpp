@@ -0,0 +1,103 @@
+#include "BrentMinimize.h"
+
+#include <cmath>
+#include <limits>
+
+double brent_minimize(const std::function<double(double)>& objective_function, double lower_bound, double upper_bound,
+	double tolerance) {
+	// (3 - sqrt(5)) / 2, the fraction of the interval a golden-section step moves by
+	constexpr double golden_section = 0.3819660112501051;
+	const double relative_epsilon = std::sqrt(std::numeric_limits<double>::epsilon());
+	// Brent's method converges to within ~3 * step_tolerance of the minimum
+	const double absolute_tolerance = tolerance / 3;
+
+	double left = lower_bound;
+	double right = upper_bound;
+
+	// best is the lowest point seen so far, second_best the second lowest, previous_second_best its previous value
+	double best = left + golden_section * (right - left);
+	double second_best = best;
+	double previous_second_best = best;
+	double f_best = objective_function(best);
+	double f_second_best = f_best;
+	double f_previous_second_best = f_best;
+
+	double step = 0;
+	double previous_step = 0;
+
+	while (true) {
+		const double midpoint = (left + right) / 2;
+		const double step_tolerance = relative_epsilon * std::abs(best) + absolute_tolerance;
+		const double double_step_tolerance = 2 * step_tolerance;
+
+		if (std::abs(best - midpoint) <= double_step_tolerance - (right - left) / 2) {
+			return best;
+		}
+
+		bool use_golden_section = true;
+		if (std::abs(previous_step) > step_tolerance) {
+			// Fit a parabola through the three best points
+			double r = (best - second_best) * (f_best - f_previous_second_best);
+			double q = (best - previous_second_best) * (f_best - f_second_best);
+			double p = (best - previous_second_best) * q - (best - second_best) * r;
+			q = 2 * (q - r);
+			if (q > 0) {
+				p = -p;
+			} else {
+				q = -q;
+			}
+			r = previous_step;
+			previous_step = step;
+
+			// Only accept the parabolic step if it falls inside the interval and is shrinking fast enough
+			if (std::abs(p) < std::abs(q * r / 2) && p > q * (left - best) && p < q * (right - best)) {
+				step = p / q;
+				const double candidate = best + step;
+				if (candidate - left < double_step_tolerance || right - candidate < double_step_tolerance) {
+					step = best < midpoint ? step_tolerance : -step_tolerance;
+				}
+				use_golden_section = false;
+			}
+		}
+
+		if (use_golden_section) {
+			previous_step = best < midpoint ? right - best : left - best;
+			step = golden_section * previous_step;
+		}
+
+		// Never evaluate closer than the tolerance to the current best point
+		const double candidate =
+			best + (std::abs(step) >= step_tolerance ? step : (step > 0 ? step_tolerance : -step_tolerance));
+		const double f_candidate = objective_function(candidate);
+
+		if (f_candidate <= f_best) {
+			if (candidate < best) {
+				right = best;
+			} else {
+				left = best;
+			}
+			previous_second_best = second_best;
+			f_previous_second_best = f_second_best;
+			second_best = best;
+			f_second_best = f_best;
+			best = candidate;
+			f_best = f_candidate;
+		} else {
+			if (candidate < best) {
+				left = candidate;
+			} else {
+				right = candidate;
+			}
+			if (f_candidate <= f_second_best || second_best == best) {
+				previous_second_best = second_best;
+				f_previous_second_best = f_second_best;
+				second_best = candidate;
+				f_second_best = f_candidate;
+			} else if (f_candidate <= f_previous_second_best || previous_second_best == best ||
+					   previous_second_best == second_best) {
+				previous_second_best = candidate;
+				f_previous_second_best = f_candidate;
+			}
+		}
+	}
+}
@@ -0,0 +1,18 @@
+#ifndef MINISIM_BRENTMINIMIZE_H
+#define MINISIM_BRENTMINIMIZE_H
+
+#include <functional>
+
+/// @brief Finds a local minimum of a function on an interval using Brent's method (parabolic interpolation with a
+/// golden-section fallback).
+///
+/// @param objective_function the function to minimize. Points where it is undefined should return a very large value
+/// (e.g. std::numeric_limits<double>::max()) so that the search moves away from them.
+/// @param lower_bound the left end of the search interval
+/// @param upper_bound the right end of the search interval, must be greater than @p lower_bound
+/// @param tolerance (absolute) the search stops once the minimum is known to within roughly this distance
+/// @return the x value of the minimum found. The endpoints themselves are never evaluated.
+double brent_minimize(const std::function<double(double)>& objective_function, double lower_bound, double upper_bound,
+	double tolerance);
+
+#endif  // MINISIM_BRENTMINIMIZE_H
@@ -0,0 +1,38 @@
+#ifndef MINISIM_COUNTERRANDOM_H
+#define MINISIM_COUNTERRANDOM_H
+
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+
+/// @brief A counter-based random number generator: the @p counter th random number of the stream @p seed, computed
+/// directly from the pair with no state in between.
+///
+/// Any thread can draw any number of the stream in any order and always gets the same value, so results that depend
+/// on random draws are reproducible regardless of how the work is split up. The pair is mixed with the SplitMix64
+/// finalizer, which passes BigCrush on consecutive counters.
+///
+/// @returns 64 uniformly distributed random bits.
+inline constexpr uint64_t counter_random_bits(uint64_t seed, uint64_t counter) {
+	uint64_t bits = seed + (counter + 1) * 0x9e3779b97f4a7c15;
+	bits = (bits ^ (bits >> 30U)) * 0xbf58476d1ce4e5b9;
+	bits = (bits ^ (bits >> 27U)) * 0x94d049bb133111eb;
+	return bits ^ (bits >> 31U);
+}
+
+/// @returns The @p counter th number of the stream @p seed, uniformly distributed in [0, 1).
+inline constexpr double counter_random_uniform(uint64_t seed, uint64_t counter) {
+	// The top 53 bits fill a double's mantissa exactly
+	return static_cast<double>(counter_random_bits(seed, counter) >> 11U) * 0x1.0p-53;
+}
+
+/// @returns The @p counter th number of the stream @p seed, normally distributed with mean 0 and standard deviation 1.
+/// Draws counters 2 * @p counter and 2 * @p counter + 1 of the uniform stream (Box-Muller).
+inline double counter_random_normal(uint64_t seed, uint64_t counter) {
+	// 1 - u is in (0, 1], so the logarithm is always finite
+	const double radius = std::sqrt(-2 * std::log(1 - counter_random_uniform(seed, 2 * counter)));
+	const double angle = 2 * std::numbers::pi * counter_random_uniform(seed, 2 * counter + 1);
+	return radius * std::cos(angle);
+}
+
+#endif  // MINISIM_COUNTERRANDOM_H
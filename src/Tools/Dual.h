@@ -0,0 +1,175 @@
+#ifndef MINISIM_DUAL_H
+#define MINISIM_DUAL_H
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+/// @brief A forward-mode dual number: a value together with its partial derivatives with respect to @p N independent
+/// variables.
+///
+/// The physics models are templated on their scalar type. Running them on Dual<N> instead of double gives the exact
+/// derivatives of every result alongside the result itself, with no step size to tune. The value part goes through
+/// exactly the same operations as it would as a double, so it matches the double result bit for bit.
+///
+/// Comparisons only look at the value, so branches in the models follow the same path they would for a double.
+template <size_t N>
+class Dual {
+   public:
+	/// The value of the number.
+	double value = 0;
+	/// The partial derivative of the value with respect to each independent variable.
+	std::array<double, N> derivatives{};
+
+	Dual() = default;
+
+	/// @brief A constant: every derivative is zero.
+	Dual(double value) : value(value) {}  // NOLINT(google-explicit-constructor)
+
+	/// @returns Independent variable @p index, with the given @p value.
+	static Dual variable(double value, size_t index) {
+		Dual result(value);
+		result.derivatives[index] = 1;
+		return result;
+	}
+
+	Dual& operator+=(const Dual& rhs) {
+		value += rhs.value;
+		for (size_t i = 0; i < N; ++i) {
+			derivatives[i] += rhs.derivatives[i];
+		}
+		return *this;
+	}
+
+	Dual& operator-=(const Dual& rhs) {
+		value -= rhs.value;
+		for (size_t i = 0; i < N; ++i) {
+			derivatives[i] -= rhs.derivatives[i];
+		}
+		return *this;
+	}
+
+	Dual& operator*=(const Dual& rhs) {
+		for (size_t i = 0; i < N; ++i) {
+			derivatives[i] = derivatives[i] * rhs.value + value * rhs.derivatives[i];
+		}
+		value *= rhs.value;
+		return *this;
+	}
+
+	Dual& operator/=(const Dual& rhs) {
+		value /= rhs.value;
+		for (size_t i = 0; i < N; ++i) {
+			derivatives[i] = (derivatives[i] - value * rhs.derivatives[i]) / rhs.value;
+		}
+		return *this;
+	}
+
+	friend Dual operator+(Dual lhs, const Dual& rhs) {
+		return lhs += rhs;
+	}
+
+	friend Dual operator-(Dual lhs, const Dual& rhs) {
+		return lhs -= rhs;
+	}
+
+	friend Dual operator*(Dual lhs, const Dual& rhs) {
+		return lhs *= rhs;
+	}
+
+	friend Dual operator/(Dual lhs, const Dual& rhs) {
+		return lhs /= rhs;
+	}
+
+	friend Dual operator-(const Dual& x) {
+		return chain(x, -x.value, -1);
+	}
+
+	friend bool operator==(const Dual& lhs, const Dual& rhs) {
+		return lhs.value == rhs.value;
+	}
+
+	friend bool operator!=(const Dual& lhs, const Dual& rhs) {
+		return lhs.value != rhs.value;
+	}
+
+	friend bool operator<(const Dual& lhs, const Dual& rhs) {
+		return lhs.value < rhs.value;
+	}
+
+	friend bool operator<=(const Dual& lhs, const Dual& rhs) {
+		return lhs.value <= rhs.value;
+	}
+
+	friend bool operator>(const Dual& lhs, const Dual& rhs) {
+		return lhs.value > rhs.value;
+	}
+
+	friend bool operator>=(const Dual& lhs, const Dual& rhs) {
+		return lhs.value >= rhs.value;
+	}
+
+	/// @returns The value of @p x, without its derivatives.
+	friend double value_of(const Dual& x) {
+		return x.value;
+	}
+
+	friend Dual sqrt(const Dual& x) {
+		const double root = std::sqrt(x.value);
+		return chain(x, root, 0.5 / root);
+	}
+
+	friend Dual cos(const Dual& x) {
+		return chain(x, std::cos(x.value), -std::sin(x.value));
+	}
+
+	friend Dual sin(const Dual& x) {
+		return chain(x, std::sin(x.value), std::cos(x.value));
+	}
+
+	friend Dual abs(const Dual& x) {
+		return chain(x, std::abs(x.value), x.value < 0 ? -1 : 1);
+	}
+
+	friend Dual pow(const Dual& x, double exponent) {
+		return chain(x, std::pow(x.value, exponent), exponent * std::pow(x.value, exponent - 1));
+	}
+
+	friend Dual hypot(const Dual& x, const Dual& y) {
+		Dual result(std::hypot(x.value, y.value));
+		if (result.value != 0) {
+			for (size_t i = 0; i < N; ++i) {
+				result.derivatives[i] = (x.value * x.derivatives[i] + y.value * y.derivatives[i]) / result.value;
+			}
+		}
+		return result;
+	}
+
+	friend Dual atan2(const Dual& y, const Dual& x) {
+		Dual result(std::atan2(y.value, x.value));
+		const double squared_norm = x.value * x.value + y.value * y.value;
+		if (squared_norm != 0) {
+			for (size_t i = 0; i < N; ++i) {
+				result.derivatives[i] = (x.value * y.derivatives[i] - y.value * x.derivatives[i]) / squared_norm;
+			}
+		}
+		return result;
+	}
+
+   private:
+	/// @returns f(@p x), given f's value @p fx and derivative @p dfdx at x.
+	static Dual chain(const Dual& x, double fx, double dfdx) {
+		Dual result(fx);
+		for (size_t i = 0; i < N; ++i) {
+			result.derivatives[i] = dfdx * x.derivatives[i];
+		}
+		return result;
+	}
+};
+
+/// @returns @p x itself, so generic code can call value_of on doubles and dual numbers alike.
+inline double value_of(double x) {
+	return x;
+}
+
+#endif  // MINISIM_DUAL_H
@@ -0,0 +1,32 @@
+#include "Hashing.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <ios>
+#include <iterator>
+#include <span>
+#include <string>
+#include <vector>
+
+void hashing::hash_bytes(uint64_t& hash, std::span<const char> bytes) {
+	for (const char byte : bytes) {
+		hash ^= static_cast<unsigned char>(byte);
+		hash *= fnv_prime;
+	}
+}
+
+void hashing::hash_value(uint64_t& hash, uint64_t value) {
+	for (size_t i = 0; i < sizeof(value); ++i) {
+		hash ^= (value >> (8 * i)) & 0xff;
+		hash *= fnv_prime;
+	}
+}
+
+void hashing::hash_file(uint64_t& hash, const std::string& path) {
+	std::ifstream stream(path, std::ios::binary);
+	const std::vector<char> contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	// The size separates the files, so moving bytes from one file to the next changes the hash
+	hash_value(hash, contents.size());
+	hash_bytes(hash, contents);
+}
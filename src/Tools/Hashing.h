@@ -0,0 +1,24 @@
+#ifndef MINISIM_HASHING_H
+#define MINISIM_HASHING_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+/// The 64-bit FNV-1a hash, to tell whether files cached results were worked out from have changed.
+namespace hashing {
+	constexpr uint64_t fnv_offset_basis = 0xcbf29ce484222325;
+	constexpr uint64_t fnv_prime = 0x100000001b3;
+
+	/// @brief Hashes @p bytes into @p hash.
+	void hash_bytes(uint64_t& hash, std::span<const char> bytes);
+
+	/// @brief Hashes the 8 bytes of @p value into @p hash, least significant first.
+	void hash_value(uint64_t& hash, uint64_t value);
+
+	/// @brief Hashes the size and then the contents of the file at @p path into @p hash. A file that cannot be read
+	/// hashes like an empty one.
+	void hash_file(uint64_t& hash, const std::string& path);
+}  // namespace hashing
+
+#endif  // MINISIM_HASHING_H
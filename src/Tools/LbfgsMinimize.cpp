@@ -0,0 +1,137 @@
+#include "LbfgsMinimize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace {
+	/// One step of the search: the change in position and the change in gradient it caused.
+	struct Correction {
+		std::vector<double> position_change;
+		std::vector<double> gradient_change;
+		/// 1 / (position_change . gradient_change)
+		double rho;
+	};
+
+	double dot(const std::vector<double>& lhs, const std::vector<double>& rhs) {
+		return std::inner_product(lhs.begin(), lhs.end(), rhs.begin(), 0.0);
+	}
+}  // namespace
+
+double lbfgs_minimize(const std::function<double(std::span<const double>, std::span<double>)>& objective_function,
+	std::vector<double>& x, size_t history, double tolerance, size_t max_iterations) {
+	// Sufficient decrease (Armijo) constant, and the most times a step is halved before giving up
+	constexpr double sufficient_decrease = 1e-4;
+	constexpr size_t max_backtracks = 40;
+
+	const size_t n = x.size();
+	std::vector<double> gradient(n);
+	double value = objective_function(x, gradient);
+	if (!std::isfinite(value)) {
+		return value;
+	}
+
+	std::deque<Correction> corrections;
+	std::vector<double> direction(n);
+	std::vector<double> alphas;
+	std::vector<double> candidate(n);
+	std::vector<double> candidate_gradient(n);
+
+	for (size_t iteration = 0; iteration < max_iterations; ++iteration) {
+		const double gradient_norm = std::sqrt(dot(gradient, gradient));
+		if (gradient_norm == 0) {
+			break;
+		}
+
+		// Two-loop recursion: direction = -H * gradient, with H built from the stored corrections
+		direction = gradient;
+		alphas.resize(corrections.size());
+		for (size_t i = corrections.size(); i-- > 0;) {
+			const Correction& correction = corrections[i];
+			alphas[i] = correction.rho * dot(correction.position_change, direction);
+			for (size_t j = 0; j < n; ++j) {
+				direction[j] -= alphas[i] * correction.gradient_change[j];
+			}
+		}
+		// Scale the initial Hessian by the most recent curvature, or take a unit-length first step
+		const double scale = corrections.empty()
+								 ? 1 / gradient_norm
+								 : 1 / (corrections.back().rho * dot(corrections.back().gradient_change,
+																	  corrections.back().gradient_change));
+		for (double& component : direction) {
+			component *= scale;
+		}
+		for (size_t i = 0; i < corrections.size(); ++i) {
+			const Correction& correction = corrections[i];
+			const double beta = correction.rho * dot(correction.gradient_change, direction);
+			for (size_t j = 0; j < n; ++j) {
+				direction[j] += (alphas[i] - beta) * correction.position_change[j];
+			}
+		}
+		for (double& component : direction) {
+			component = -component;
+		}
+
+		double slope = dot(gradient, direction);
+		if (slope >= 0) {
+			// The curvature estimate has gone bad: forget it and fall back to steepest descent
+			corrections.clear();
+			for (size_t j = 0; j < n; ++j) {
+				direction[j] = -gradient[j] / gradient_norm;
+			}
+			slope = -gradient_norm;
+		}
+
+		// Backtrack until the step decreases the value enough (undefined points never do)
+		double step = 1;
+		double candidate_value = 0;
+		bool accepted = false;
+		for (size_t backtrack = 0; backtrack < max_backtracks; ++backtrack, step /= 2) {
+			for (size_t j = 0; j < n; ++j) {
+				candidate[j] = x[j] + step * direction[j];
+			}
+			candidate_value = objective_function(candidate, candidate_gradient);
+			if (std::isfinite(candidate_value) && candidate_value <= value + sufficient_decrease * step * slope) {
+				accepted = true;
+				break;
+			}
+		}
+		if (!accepted) {
+			break;
+		}
+
+		Correction correction{
+			.position_change = std::vector<double>(n),
+			.gradient_change = std::vector<double>(n),
+			.rho = 0,
+		};
+		for (size_t j = 0; j < n; ++j) {
+			correction.position_change[j] = candidate[j] - x[j];
+			correction.gradient_change[j] = candidate_gradient[j] - gradient[j];
+		}
+		// Only keep steps with positive curvature, so the inverse Hessian estimate stays positive definite
+		const double curvature = dot(correction.position_change, correction.gradient_change);
+		if (curvature > 0) {
+			correction.rho = 1 / curvature;
+			corrections.push_back(std::move(correction));
+			if (corrections.size() > history) {
+				corrections.pop_front();
+			}
+		}
+
+		const double improvement = value - candidate_value;
+		std::swap(x, candidate);
+		std::swap(gradient, candidate_gradient);
+		value = candidate_value;
+
+		if (improvement <= tolerance * std::max(1.0, std::abs(value))) {
+			break;
+		}
+	}
+
+	return value;
+}
@@ -0,0 +1,23 @@
+#ifndef MINISIM_LBFGSMINIMIZE_H
+#define MINISIM_LBFGSMINIMIZE_H
+
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <vector>
+
+/// @brief Finds a local minimum of a smooth function of many variables using L-BFGS (a quasi-Newton method that
+/// approximates the inverse Hessian from the last few steps) with a backtracking line search.
+///
+/// @param objective_function the function to minimize. It is called with a point and must write the gradient at that
+/// point into its second argument, then return the value. Points where it is undefined should return +infinity; the
+/// line search then backs off towards the last good point.
+/// @param x [in, out] the starting point, which must be defined. Overwritten with the best point found.
+/// @param history the number of recent steps kept to approximate the curvature
+/// @param tolerance (relative) the search stops once an iteration improves the value by less than this fraction
+/// @param max_iterations the search stops after this many iterations
+/// @return the value at @p x.
+double lbfgs_minimize(const std::function<double(std::span<const double>, std::span<double>)>& objective_function,
+	std::vector<double>& x, size_t history, double tolerance, size_t max_iterations);
+
+#endif  // MINISIM_LBFGSMINIMIZE_H
@@ -0,0 +1,102 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+ThreadPool::ThreadPool(size_t num_threads) {
+	if (num_threads > max_threads) {
+		throw std::exception();
+	}
+	const size_t total_threads = resolve_thread_count(num_threads);
+	// The calling thread is the first worker
+	workers.reserve(total_threads - 1);
+	for (size_t i = 1; i < total_threads; ++i) {
+		workers.emplace_back([this] { worker_loop(); });
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		const std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	work_available.notify_all();
+	for (auto& worker : workers) {
+		worker.join();
+	}
+}
+
+size_t ThreadPool::size() const {
+	return workers.size() + 1;
+}
+
+size_t ThreadPool::resolve_thread_count(size_t requested_threads) {
+	if (requested_threads != 0) {
+		return requested_threads;
+	}
+	return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::parallel_for(size_t task_count, const std::function<void(size_t)>& task) {
+	if (task_count == 0) {
+		return;
+	}
+
+	{
+		const std::lock_guard lock(mutex);
+		current_task = &task;
+		num_tasks = task_count;
+		next_task = 0;
+		busy_workers = workers.size();
+		first_exception = nullptr;
+		++generation;
+	}
+	work_available.notify_all();
+
+	run_tasks();
+
+	std::unique_lock lock(mutex);
+	work_finished.wait(lock, [this] { return busy_workers == 0; });
+	current_task = nullptr;
+
+	if (first_exception) {
+		std::rethrow_exception(first_exception);
+	}
+}
+
+void ThreadPool::run_tasks() {
+	for (size_t i = next_task.fetch_add(1); i < num_tasks; i = next_task.fetch_add(1)) {
+		try {
+			(*current_task)(i);
+		} catch (...) {
+			const std::lock_guard lock(mutex);
+			if (!first_exception) {
+				first_exception = std::current_exception();
+			}
+		}
+	}
+}
+
+void ThreadPool::worker_loop() {
+	uint64_t last_generation = 0;
+	while (true) {
+		{
+			std::unique_lock lock(mutex);
+			work_available.wait(lock, [&] { return stopping || generation != last_generation; });
+			if (stopping) {
+				return;
+			}
+			last_generation = generation;
+		}
+
+		run_tasks();
+
+		{
+			const std::lock_guard lock(mutex);
+			--busy_workers;
+		}
+		work_finished.notify_one();
+	}
+}
@@ -0,0 +1,73 @@
+#ifndef MINISIM_THREADPOOL_H
+#define MINISIM_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief A fixed-size pool of worker threads used to fan independent work items (e.g. candidate simulations) out
+/// over multiple cores.
+///
+/// The calling thread takes part in the work, so a pool of size 1 spawns no threads at all and runs every task
+/// inline, in order.
+class ThreadPool {
+   public:
+	/// @param num_threads The total number of threads doing work, including the calling thread. 0 means "use every
+	/// hardware thread".
+	///
+	/// @throws std::exception if @p num_threads is over max_threads.
+	explicit ThreadPool(size_t num_threads);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool(ThreadPool&&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	ThreadPool& operator=(ThreadPool&&) = delete;
+
+	/// @returns The total number of threads doing work, including the calling thread.
+	size_t size() const;
+
+	/// @brief Runs @p task(i) for every i in [0, @p num_tasks), spread over the pool, and blocks until all of them
+	/// are done.
+	///
+	/// Tasks are claimed in increasing index order, but may finish in any order. Callers that need deterministic
+	/// results should write into a slot indexed by i and reduce afterwards.
+	///
+	/// @note Not reentrant: @p task must not call parallel_for on the same pool.
+	/// @note If any task throws, the first exception is rethrown here once every task has finished.
+	void parallel_for(size_t num_tasks, const std::function<void(size_t)>& task);
+
+	/// @returns The number of threads to use when the user asks for @p requested_threads (0 means "all of them").
+	static size_t resolve_thread_count(size_t requested_threads);
+
+	/// The most threads a pool may be asked for; more than this is taken to be a mistake.
+	static constexpr size_t max_threads = 1024;
+
+   private:
+	void worker_loop();
+	void run_tasks();
+
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable work_available;
+	std::condition_variable work_finished;
+
+	/// The job currently being run. Only valid while a parallel_for call is in flight.
+	const std::function<void(size_t)>* current_task = nullptr;
+	size_t num_tasks = 0;
+	std::atomic<size_t> next_task = 0;
+	size_t busy_workers = 0;
+	/// Incremented for every parallel_for call, so workers can tell a new job from a spurious wakeup.
+	uint64_t generation = 0;
+	bool stopping = false;
+	std::exception_ptr first_exception;
+};
+
+#endif  // MINISIM_THREADPOOL_H
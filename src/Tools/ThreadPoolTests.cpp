@@ -0,0 +1,101 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "ThreadPool.h"
+
+TEST_CASE("ThreadPool: parallel_for runs every task exactly once", "[ThreadPool]") {
+	ThreadPool pool(4);
+	REQUIRE(pool.size() == 4);
+
+	SECTION("More tasks than threads") {
+		std::vector<std::atomic<int>> runs(1000);
+		pool.parallel_for(runs.size(), [&](size_t i) { ++runs[i]; });
+		for (const auto& run : runs) {
+			REQUIRE(run.load() == 1);
+		}
+	}
+
+	SECTION("Fewer tasks than threads") {
+		std::vector<std::atomic<int>> runs(2);
+		pool.parallel_for(runs.size(), [&](size_t i) { ++runs[i]; });
+		REQUIRE(runs[0].load() == 1);
+		REQUIRE(runs[1].load() == 1);
+	}
+
+	SECTION("No tasks") {
+		bool ran = false;
+		pool.parallel_for(0, [&](size_t) { ran = true; });
+		REQUIRE_FALSE(ran);
+	}
+}
+
+TEST_CASE("ThreadPool: the pool can be reused across parallel_for calls", "[ThreadPool]") {
+	ThreadPool pool(3);
+	std::atomic<size_t> total = 0;
+	for (size_t call = 1; call <= 50; ++call) {
+		pool.parallel_for(call, [&](size_t i) { total += i + 1; });
+	}
+	// Call c adds 1 + ... + c
+	size_t expected = 0;
+	for (size_t call = 1; call <= 50; ++call) {
+		expected += call * (call + 1) / 2;
+	}
+	REQUIRE(total.load() == expected);
+}
+
+TEST_CASE("ThreadPool: exceptions are rethrown once every task is done", "[ThreadPool]") {
+	ThreadPool pool(4);
+	std::vector<std::atomic<int>> runs(100);
+	bool caught = false;
+	try {
+		pool.parallel_for(runs.size(), [&](size_t i) {
+			++runs[i];
+			if (i % 10 == 3) {
+				throw std::runtime_error("task failed");
+			}
+		});
+	} catch (const std::runtime_error&) {
+		caught = true;
+	}
+	REQUIRE(caught);
+	for (const auto& run : runs) {
+		REQUIRE(run.load() == 1);
+	}
+
+	// A failed call leaves the pool usable
+	std::atomic<size_t> count = 0;
+	pool.parallel_for(10, [&](size_t) { ++count; });
+	REQUIRE(count.load() == 10);
+}
+
+TEST_CASE("ThreadPool: a pool of one runs every task inline, in order", "[ThreadPool]") {
+	ThreadPool pool(1);
+	REQUIRE(pool.size() == 1);
+	const std::thread::id caller = std::this_thread::get_id();
+	std::vector<size_t> order;
+	pool.parallel_for(5, [&](size_t i) {
+		REQUIRE(std::this_thread::get_id() == caller);
+		order.push_back(i);
+	});
+	const std::vector<size_t> expected = {0, 1, 2, 3, 4};
+	REQUIRE(order == expected);
+}
+
+TEST_CASE("ThreadPool: thread counts", "[ThreadPool]") {
+	REQUIRE(ThreadPool::resolve_thread_count(3) == 3);
+	REQUIRE(ThreadPool::resolve_thread_count(0) >= 1);
+
+	bool rejected = false;
+	try {
+		const ThreadPool pool(ThreadPool::max_threads + 1);
+	} catch (const std::exception&) {
+		rejected = true;
+	}
+	REQUIRE(rejected);
+}
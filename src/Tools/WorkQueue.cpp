@@ -0,0 +1,218 @@
+#include "WorkQueue.h"
+
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace {
+	std::string read_file(const std::filesystem::path& path) {
+		std::ifstream stream(path, std::ios::binary);
+		return {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+	}
+
+	/// @returns The names of the files in @p directory, sorted.
+	std::vector<std::string> list_directory(const std::filesystem::path& directory) {
+		std::vector<std::string> names;
+		std::error_code error;
+		for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+			names.push_back(entry.path().filename().string());
+		}
+		std::sort(names.begin(), names.end());
+		return names;
+	}
+
+	/// The parts of a claim's file name: <id>.<attempt>.<host>.<pid>. The host name may contain dots itself.
+	struct ClaimName {
+		std::string id;
+		size_t attempt;
+		std::string host;
+		long pid;
+	};
+
+	std::optional<ClaimName> parse_claim_name(const std::string& name) {
+		const size_t id_end = name.find('.');
+		const size_t attempt_end = name.find('.', id_end + 1);
+		const size_t host_end = name.rfind('.');
+		if (id_end == std::string::npos || attempt_end == std::string::npos || host_end <= attempt_end) {
+			return std::nullopt;
+		}
+		try {
+			return ClaimName{
+				.id = name.substr(0, id_end),
+				.attempt = std::stoul(name.substr(id_end + 1, attempt_end - id_end - 1)),
+				.host = name.substr(attempt_end + 1, host_end - attempt_end - 1),
+				.pid = std::stol(name.substr(host_end + 1)),
+			};
+		} catch (const std::exception&) {
+			return std::nullopt;
+		}
+	}
+}  // namespace
+
+WorkQueue::WorkQueue(const std::filesystem::path& spool_directory)
+	: queue_directory(spool_directory / "queue"),
+	  claimed_directory(spool_directory / "claimed"),
+	  results_directory(spool_directory / "results"),
+	  failed_directory(spool_directory / "failed"),
+	  tmp_directory(spool_directory / "tmp") {
+	for (const auto& directory :
+		{queue_directory, claimed_directory, results_directory, failed_directory, tmp_directory}) {
+		std::filesystem::create_directories(directory);
+	}
+}
+
+std::string WorkQueue::get_host_name() {
+	constexpr size_t max_host_name = 256;
+	std::string host_name(max_host_name, '\0');
+	if (gethostname(host_name.data(), host_name.size()) != 0) {
+		return "unknown";
+	}
+	host_name.resize(host_name.find('\0'));
+	return host_name;
+}
+
+void WorkQueue::write_atomically(const std::filesystem::path& destination, std::string_view contents) const {
+	// Unique across processes and hosts, so two writers never share a temporary file
+	std::ostringstream tmp_name;
+	tmp_name << destination.filename().string() << "." << get_host_name() << "." << getpid();
+	const std::filesystem::path tmp_path = tmp_directory / tmp_name.str();
+	std::error_code error;
+	{
+		std::ofstream stream(tmp_path, std::ios::binary | std::ios::trunc);
+		stream << contents;
+		if (!stream.flush()) {
+			stream.close();
+			std::filesystem::remove(tmp_path, error);
+			throw std::exception();
+		}
+	}
+	std::filesystem::rename(tmp_path, destination, error);
+	if (error) {
+		std::filesystem::remove(tmp_path, error);
+		throw std::exception();
+	}
+}
+
+void WorkQueue::add(std::string_view id, std::string_view contents) const {
+	write_atomically(queue_directory / (std::string(id) + ".1"), contents);
+}
+
+void WorkQueue::clear() const {
+	for (const auto& directory : {queue_directory, claimed_directory, results_directory, failed_directory}) {
+		for (const std::string& name : list_directory(directory)) {
+			std::error_code error;
+			std::filesystem::remove(directory / name, error);
+		}
+	}
+}
+
+std::optional<WorkQueue::Claim> WorkQueue::claim() const {
+	const std::string owner = get_host_name() + "." + std::to_string(getpid());
+	for (const std::string& name : list_directory(queue_directory)) {
+		const size_t id_end = name.find('.');
+		if (id_end == std::string::npos) {
+			continue;
+		}
+		const std::filesystem::path claimed_path = claimed_directory / (name + "." + owner);
+		std::error_code error;
+		std::filesystem::rename(queue_directory / name, claimed_path, error);
+		if (error) {
+			// Another worker got there first
+			continue;
+		}
+		// Renaming keeps the modification time from when the item was queued, which may be long past the lease
+		std::filesystem::last_write_time(claimed_path, std::filesystem::file_time_type::clock::now(), error);
+		return Claim{
+			.id = name.substr(0, id_end),
+			.attempt = std::stoul(name.substr(id_end + 1)),
+			.path = claimed_path,
+			.contents = read_file(claimed_path),
+		};
+	}
+	return std::nullopt;
+}
+
+void WorkQueue::heartbeat(const Claim& claim) const {
+	std::error_code error;
+	std::filesystem::last_write_time(claim.path, std::filesystem::file_time_type::clock::now(), error);
+}
+
+void WorkQueue::complete(const Claim& claim, std::string_view result) const {
+	write_atomically(results_directory / claim.id, result);
+	std::error_code error;
+	std::filesystem::remove(claim.path, error);
+}
+
+size_t WorkQueue::requeue_stale(std::chrono::seconds lease) const {
+	const std::string host_name = get_host_name();
+	const auto now = std::filesystem::file_time_type::clock::now();
+	size_t num_requeued = 0;
+	for (const std::string& name : list_directory(claimed_directory)) {
+		const std::optional<ClaimName> claim_name = parse_claim_name(name);
+		if (!claim_name.has_value()) {
+			continue;
+		}
+		const std::filesystem::path path = claimed_directory / name;
+
+		// Only a process on this host can be asked whether it is still alive; elsewhere the heartbeat has to do
+		const bool process_gone = claim_name->host == host_name &&
+								  kill(static_cast<pid_t>(claim_name->pid), 0) != 0 && errno == ESRCH;
+		std::error_code error;
+		const auto last_heartbeat = std::filesystem::last_write_time(path, error);
+		if (error) {
+			continue;  // Completed in the meantime
+		}
+		if (!process_gone && now - last_heartbeat < lease) {
+			continue;
+		}
+
+		const size_t next_attempt = claim_name->attempt + 1;
+		if (next_attempt > max_attempts) {
+			std::filesystem::rename(path, failed_directory / claim_name->id, error);
+			continue;
+		}
+		std::filesystem::rename(path, queue_directory / (claim_name->id + "." + std::to_string(next_attempt)), error);
+		if (!error) {
+			++num_requeued;
+		}
+	}
+	return num_requeued;
+}
+
+size_t WorkQueue::num_queued() const {
+	return list_directory(queue_directory).size();
+}
+
+size_t WorkQueue::num_claimed() const {
+	return list_directory(claimed_directory).size();
+}
+
+std::vector<std::string> WorkQueue::get_results() const {
+	std::vector<std::string> results;
+	for (const std::string& name : list_directory(results_directory)) {
+		results.push_back(read_file(results_directory / name));
+	}
+	return results;
+}
+
+std::vector<std::string> WorkQueue::get_failed() const {
+	std::vector<std::string> items;
+	for (const std::string& name : list_directory(failed_directory)) {
+		items.push_back(read_file(failed_directory / name));
+	}
+	return items;
+}
@@ -0,0 +1,102 @@
+#ifndef MINISIM_WORKQUEUE_H
+#define MINISIM_WORKQUEUE_H
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief A queue of work items kept as files in a spool directory, shared by any number of worker processes on
+/// any number of machines that can see the directory. No server is needed.
+///
+/// An item moves between subdirectories of the spool directory by renaming, which is atomic on one filesystem:
+///
+///   queue/<id>.<attempt>                    waiting to be claimed
+///   claimed/<id>.<attempt>.<host>.<pid>     being worked on by process <pid> on <host>
+///   results/<id>                            done; holds the item's result
+///   failed/<id>                             given up on after max_attempts claims
+///
+/// Claiming is a rename from queue/ to claimed/: of several workers racing for one item, exactly one rename succeeds.
+/// Results are written to tmp/ first and renamed into place, so a result is never seen half written.
+///
+/// A claim whose worker died must go back in the queue. A worker refreshes its claim's modification time (heartbeat)
+/// while it works; requeue_stale puts a claim back if its process is gone (for processes on this host) or if it has
+/// not been refreshed for longer than the lease (for any host).
+class WorkQueue {
+   public:
+	/// @brief Opens the queue in @p spool_directory, creating it if needed.
+	explicit WorkQueue(const std::filesystem::path& spool_directory);
+
+	/// An item claimed by this process.
+	struct Claim {
+		/// The item's name, as given to add.
+		std::string id;
+		/// How many times the item has been claimed, including this time.
+		size_t attempt;
+		/// Where the claimed item is.
+		std::filesystem::path path;
+		/// What the item says to do.
+		std::string contents;
+	};
+
+	/// @brief Adds an item to the queue.
+	/// @param id The item's name. Must be unique in the queue, and must not contain '.' or '/'.
+	/// @param contents What the item says to do.
+	/// @throws std::exception if the item cannot be written.
+	void add(std::string_view id, std::string_view contents) const;
+
+	/// @brief Removes every item, whether queued, claimed, completed or given up on, so that a new set of items
+	/// starts from scratch. No worker may be working on the queue meanwhile.
+	void clear() const;
+
+	/// @brief Claims the first item in the queue, by id.
+	/// @returns The claimed item, or std::nullopt if the queue is empty.
+	std::optional<Claim> claim() const;
+
+	/// @brief Marks @p claim as still being worked on, so requeue_stale leaves it alone.
+	void heartbeat(const Claim& claim) const;
+
+	/// @brief Stores @p result as the result of @p claim, and releases the claim.
+	/// @throws std::exception if the result cannot be written. The claim is kept, so it is requeued once stale.
+	void complete(const Claim& claim, std::string_view result) const;
+
+	/// @brief Puts claims whose worker has died back in the queue, or gives up on them after max_attempts claims.
+	/// @param lease A claim that has not had a heartbeat for this long is considered dead, wherever its worker is.
+	/// @returns The number of claims put back in the queue.
+	size_t requeue_stale(std::chrono::seconds lease) const;
+
+	/// @returns The number of items waiting in the queue.
+	size_t num_queued() const;
+
+	/// @returns The number of items currently claimed by some worker.
+	size_t num_claimed() const;
+
+	/// @returns The result of every completed item, in order of id.
+	std::vector<std::string> get_results() const;
+
+	/// @returns What every item that was given up on says to do, in order of id.
+	std::vector<std::string> get_failed() const;
+
+	/// @returns The name of this machine, as used in claim names.
+	static std::string get_host_name();
+
+	/// The most times an item is claimed before it is given up on; an item that crashes every worker would otherwise
+	/// be retried forever.
+	static constexpr size_t max_attempts = 3;
+
+   private:
+	std::filesystem::path queue_directory;
+	std::filesystem::path claimed_directory;
+	std::filesystem::path results_directory;
+	std::filesystem::path failed_directory;
+	std::filesystem::path tmp_directory;
+
+	/// @brief Writes @p contents to a temporary file, then renames it to @p destination.
+	/// @throws std::exception if the temporary file cannot be written or renamed.
+	void write_atomically(const std::filesystem::path& destination, std::string_view contents) const;
+};
+
+#endif  // MINISIM_WORKQUEUE_H
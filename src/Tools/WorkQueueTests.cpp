@@ -0,0 +1,167 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "WorkQueue.h"
+
+namespace {
+	/// A spool directory of its own for every test, removed again afterwards.
+	class SpoolDirectory {
+	   public:
+		SpoolDirectory() : path(std::filesystem::temp_directory_path() / "minisim_work_queue_test") {
+			std::filesystem::remove_all(path);
+		}
+		SpoolDirectory(const SpoolDirectory&) = delete;
+		SpoolDirectory& operator=(const SpoolDirectory&) = delete;
+		~SpoolDirectory() {
+			std::error_code error;
+			std::filesystem::remove_all(path, error);
+		}
+
+		std::filesystem::path path;
+	};
+
+	constexpr std::chrono::seconds lease = std::chrono::hours(1);
+
+	/// @brief Makes @p path look like it was last touched twice the lease ago.
+	void backdate(const std::filesystem::path& path) {
+		std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now() - 2 * lease);
+	}
+
+	/// @returns The id of a process that has exited.
+	pid_t get_dead_pid() {
+		const pid_t pid = fork();
+		if (pid == 0) {
+			_exit(0);
+		}
+		waitpid(pid, nullptr, 0);
+		return pid;
+	}
+
+	std::string get_host_name() {
+		constexpr size_t max_host_name = 256;
+		std::string host_name(max_host_name, '\0');
+		gethostname(host_name.data(), host_name.size());
+		host_name.resize(host_name.find('\0'));
+		return host_name;
+	}
+}  // namespace
+
+TEST_CASE("WorkQueue: items are claimed once each, in order of id, and their results kept", "[WorkQueue]") {
+	const SpoolDirectory spool;
+	const WorkQueue queue(spool.path);
+	queue.add("000001", "second");
+	queue.add("000000", "first");
+	REQUIRE(queue.num_queued() == 2);
+
+	const std::optional<WorkQueue::Claim> first = queue.claim();
+	REQUIRE(first.has_value());
+	REQUIRE(first->id == "000000");
+	REQUIRE(first->attempt == 1);
+	REQUIRE(first->contents == "first");
+	const std::optional<WorkQueue::Claim> second = queue.claim();
+	REQUIRE(second.has_value());
+	REQUIRE(second->id == "000001");
+	REQUIRE_FALSE(queue.claim().has_value());
+	REQUIRE(queue.num_queued() == 0);
+	REQUIRE(queue.num_claimed() == 2);
+
+	queue.complete(second.value(), "result 1");
+	queue.complete(first.value(), "result 0");
+	REQUIRE(queue.num_claimed() == 0);
+	const std::vector<std::string> expected = {"result 0", "result 1"};
+	REQUIRE(queue.get_results() == expected);
+}
+
+TEST_CASE("WorkQueue: a live claim is only requeued once its lease expires", "[WorkQueue]") {
+	const SpoolDirectory spool;
+	const WorkQueue queue(spool.path);
+	queue.add("000000", "item");
+	// Queued long ago: claiming it must still start a fresh lease
+	for (const auto& entry : std::filesystem::directory_iterator(spool.path / "queue")) {
+		backdate(entry.path());
+	}
+
+	const std::optional<WorkQueue::Claim> claim = queue.claim();
+	REQUIRE(claim.has_value());
+	REQUIRE(queue.requeue_stale(lease) == 0);
+	REQUIRE(queue.num_claimed() == 1);
+
+	backdate(claim->path);
+	queue.heartbeat(claim.value());
+	REQUIRE(queue.requeue_stale(lease) == 0);
+
+	backdate(claim->path);
+	REQUIRE(queue.requeue_stale(lease) == 1);
+	REQUIRE(queue.num_claimed() == 0);
+	const std::optional<WorkQueue::Claim> retry = queue.claim();
+	REQUIRE(retry.has_value());
+	REQUIRE(retry->id == "000000");
+	REQUIRE(retry->attempt == 2);
+	REQUIRE(retry->contents == "item");
+}
+
+TEST_CASE("WorkQueue: a claim whose process is gone is requeued without waiting for the lease", "[WorkQueue]") {
+	const SpoolDirectory spool;
+	const WorkQueue queue(spool.path);
+	queue.add("000000", "item");
+	// Claimed by a process on this host that has since died
+	const std::string claim_name = "000000.1." + get_host_name() + "." + std::to_string(get_dead_pid());
+	std::filesystem::rename(spool.path / "queue" / "000000.1", spool.path / "claimed" / claim_name);
+
+	REQUIRE(queue.requeue_stale(lease) == 1);
+	REQUIRE(queue.num_queued() == 1);
+	const std::optional<WorkQueue::Claim> retry = queue.claim();
+	REQUIRE(retry.has_value());
+	REQUIRE(retry->attempt == 2);
+
+	// A live process keeps its claim
+	REQUIRE(queue.requeue_stale(lease) == 0);
+}
+
+TEST_CASE("WorkQueue: an item is given up on after max_attempts claims", "[WorkQueue]") {
+	const SpoolDirectory spool;
+	const WorkQueue queue(spool.path);
+	queue.add("000000", "crashes every worker");
+	for (size_t attempt = 1; attempt <= WorkQueue::max_attempts; ++attempt) {
+		const std::optional<WorkQueue::Claim> claim = queue.claim();
+		REQUIRE(claim.has_value());
+		REQUIRE(claim->attempt == attempt);
+		backdate(claim->path);
+		REQUIRE(queue.requeue_stale(lease) == (attempt < WorkQueue::max_attempts ? 1 : 0));
+	}
+	REQUIRE(queue.num_queued() == 0);
+	REQUIRE(queue.num_claimed() == 0);
+	REQUIRE_FALSE(queue.claim().has_value());
+	const std::vector<std::string> expected = {"crashes every worker"};
+	REQUIRE(queue.get_failed() == expected);
+}
+
+TEST_CASE("WorkQueue: clear removes every item and result", "[WorkQueue]") {
+	const SpoolDirectory spool;
+	const WorkQueue queue(spool.path);
+	queue.add("000000", "done");
+	queue.add("000001", "claimed");
+	queue.add("000002", "queued");
+	queue.complete(queue.claim().value(), "result");
+	REQUIRE(queue.claim().has_value());
+
+	queue.clear();
+	REQUIRE(queue.num_queued() == 0);
+	REQUIRE(queue.num_claimed() == 0);
+	REQUIRE(queue.get_results().empty());
+	REQUIRE(queue.get_failed().empty());
+
+	// The queue still works afterwards
+	queue.add("000000", "again");
+	REQUIRE(queue.claim().value().contents == "again");
+}
@@ -1,11 +1,23 @@
 #include <getopt.h>
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
 
 #include "ConfigFile/ConfigFile.h"
 #include "Optimizer/Optimizer.h"
@@ -13,31 +25,80 @@
 #include "RaceConfig/Route/Route.h"
 #include "RaceConfig/Weather/Weather.h"
 #include "RaceConfig/WeatherStations/WeatherStations.h"
+#include "RaceRunner/RaceRunner.h"
+#include "RaceRunner/RaceTrace.h"
+#include "RaceRunner/RacetimeCache.h"
 #include "SolarCar/SolarCar.h"
 #include "Tools/Conversions.h"
+#include "Tools/RootDirectory.h"
+#include "Tools/ThreadPool.h"
 
 namespace {
 	struct CommandLine {
 		std::string car_file;
-		std::string weather_file;
+		/// Merged into one forecast, so a sweep can cover schedules in different years.
+		std::vector<std::string> weather_files;
 		std::string weather_stations_file;
 		std::string route_file;
 		std::string schedule_file;
+		/// If set, every schedule in this directory is optimized instead of schedule_file.
+		std::string schedule_dir;
 		std::string optimizer_type;
+		size_t num_threads = 1;
+		/// (seconds) How long the optimizer may search for, if limited.
+		std::optional<double> time_budget;
+		/// Whether to look races up in (and save them to) the racetime cache.
+		bool use_cache = true;
+		/// If set, the optimizer searches a coarsened route, with the default tolerances scaled by this factor, and
+		/// the result is verified on the full route.
+		std::optional<double> coarsen_factor;
+		/// (seconds) If set, the weather is resampled into timelines with this time between samples.
+		std::optional<double> weather_resolution;
+		/// Whether static charging integrates the weather timelines exactly, instead of in increments.
+		bool exact_charging = false;
+		/// If set, the optimized race is traced segment by segment into this file.
+		std::string trace_file;
+		/// Whether the trace also keeps where the power went and the weather.
+		bool full_trace = false;
 	};
 
 	void print_help() {
 		std::cout << "Usage: Simulator -o <optimizer-type> -c <car.toml> -w <weather.csv> -r <route.csv> -t "
-					 "<weather_stations.csv> -s <schedule.toml>\n\n"
+					 "<weather_stations.csv> (-s <schedule.toml> | --schedule-dir <dir>) [-j <threads>] [-b <seconds>] "
+					 "[--no-cache] [--coarsen <factor>] [--weather-resolution <seconds>] "
+					 "[--exact-charging] [--trace <trace.bin> [--full-trace]]\n\n"
 				  << "Run the simulator to optimize your car!\n\n"
 				  << "Options:\n"
-				  << "  -h, --help        display this help and exit\n"
-				  << "  -o, --optimizer   the optimizer to use (e.g. linear, binary)\n"
-				  << "  -c, --car         the car config file to use (TOML)\n"
-				  << "  -w, --weather     the weather file to use (CSV)\n"
-				  << "  -r, --route       the route file to use (CSV)\n"
-				  << "  -t, --stations    the weather stations being used (CSV)\n"
-				  << "  -s, --schedule    the schedule file to use (TOML)\n";
+				  << "  -h, --help         display this help and exit\n"
+				  << "  -o, --optimizer    the optimizer to use (e.g. linear, binary, brent, dp, lbfgs,\n"
+				  << "                     ensemble-mean, ensemble-p90, ensemble-finish, pareto,\n"
+				  << "                     surrogate)\n"
+				  << "  -c, --car          the car config file to use (TOML)\n"
+				  << "  -w, --weather      the weather file to use (CSV); repeat to merge several files\n"
+				  << "  -r, --route        the route file to use (CSV)\n"
+				  << "  -t, --stations     the weather stations being used (CSV)\n"
+				  << "  -s, --schedule     the schedule file to use (TOML)\n"
+				  << "      --schedule-dir optimize every schedule (TOML) in this directory, in parallel, and write\n"
+				  << "                     one results table to output/schedule_sweep.csv\n"
+				  << "  -j, --threads      the number of threads to optimize with (default 1, 0 uses every core); a\n"
+				  << "                     schedule sweep runs one schedule per thread\n"
+				  << "  -b, --time-budget  the seconds the optimizer may search for (per schedule); prints every\n"
+				  << "                     improvement and returns the best one found in time\n"
+				  << "      --no-cache     simulate every race, instead of reusing the races earlier runs saved in\n"
+				  << "                     output/racetime_cache\n"
+				  << "      --coarsen      search on a coarsened route, merging runs of similar segments (tolerances\n"
+				  << "                     scaled by this factor, 1 for the defaults), then verify on the full route;\n"
+				  << "                     single schedule only, and turns off the racetime cache\n"
+				  << "      --weather-resolution\n"
+				  << "                     look the weather up in timelines resampled every this many seconds,\n"
+				  << "                     instead of in the splines; turns off the racetime cache\n"
+				  << "      --exact-charging\n"
+				  << "                     integrate the irradiance while static charging exactly, instead of every\n"
+				  << "                     5 minutes; needs --weather-resolution\n"
+				  << "      --trace        record the state of the optimized race after every segment into this\n"
+				  << "                     file (see minisim-trace); single schedule only\n"
+				  << "      --full-trace   also record where the power went and the weather in the trace, which\n"
+				  << "                     makes the traced race several times as costly; needs --trace\n";
 	}
 
 	CommandLine read_args(const int argc, char** argv) {
@@ -47,13 +108,23 @@ namespace {
 
 		// NOLINTNEXTLINE
 		static struct option long_options[] = {
-			{"car",      required_argument, nullptr, 'c'},
-			{"weather",  required_argument, nullptr, 'w'},
-			{"route",    required_argument, nullptr, 'r'},
-			{"schedule", required_argument, nullptr, 's'},
-			{"stations", required_argument, nullptr, 't'},
-			{"help",     no_argument,       nullptr, 'h'},
-			{nullptr,    0,                 nullptr, 0  },
+			{"car",                required_argument, nullptr, 'c'},
+			{"weather",            required_argument, nullptr, 'w'},
+			{"route",              required_argument, nullptr, 'r'},
+			{"schedule",           required_argument, nullptr, 's'},
+			{"schedule-dir",       required_argument, nullptr, 'd'},
+			{"stations",           required_argument, nullptr, 't'},
+			{"optimizer",          required_argument, nullptr, 'o'},
+			{"threads",            required_argument, nullptr, 'j'},
+			{"time-budget",        required_argument, nullptr, 'b'},
+			{"no-cache",           no_argument,       nullptr, 'n'},
+			{"coarsen",            required_argument, nullptr, 'k'},
+			{"weather-resolution", required_argument, nullptr, 'e'},
+			{"exact-charging",     no_argument,       nullptr, 'x'},
+			{"trace",              required_argument, nullptr, 'T'},
+			{"full-trace",         no_argument,       nullptr, 'F'},
+			{"help",               no_argument,       nullptr, 'h'},
+			{nullptr,              0,                 nullptr, 0  },
 		};
 
 		CommandLine config = {};
@@ -73,7 +144,7 @@ namespace {
 		uint8_t params_received = 0;
 
 		// NOLINTNEXTLINE
-		while ((choice = getopt_long(argc, argv, "hc:w:r:s:t:o:", long_options, &index)) != -1) {
+		while ((choice = getopt_long(argc, argv, "hc:w:r:s:t:o:j:b:", long_options, &index)) != -1) {
 			switch (choice) {
 				case 'h': {
 					print_help();
@@ -86,8 +157,8 @@ namespace {
 					break;
 				}
 				case 'w': {
-					config.weather_file = std::string(optarg);
-					std::cout << "[CONFIG] Weather File: " << config.weather_file << "\n";
+					config.weather_files.emplace_back(optarg);
+					std::cout << "[CONFIG] Weather File: " << config.weather_files.back() << "\n";
 					params_received |= Params::Weather;
 					break;
 				}
@@ -103,6 +174,12 @@ namespace {
 					params_received |= Params::Schedule;
 					break;
 				}
+				case 'd': {
+					config.schedule_dir = std::string(optarg);
+					std::cout << "[CONFIG] Schedule Directory: " << config.schedule_dir << "\n";
+					params_received |= Params::Schedule;
+					break;
+				}
 				case 't': {
 					config.weather_stations_file = std::string(optarg);
 					std::cout << "[CONFIG] Weather Stations File: " << config.weather_stations_file << "\n";
@@ -115,6 +192,82 @@ namespace {
 					params_received |= Params::Optimizer;
 					break;
 				}
+				case 'j': {
+					// The whole argument must be the count: no sign, no trailing characters
+					const std::string_view argument(optarg);
+					const auto [end, error] =
+						std::from_chars(argument.data(), argument.data() + argument.size(), config.num_threads);
+					if (error != std::errc() || end != argument.data() + argument.size() ||
+						config.num_threads > ThreadPool::max_threads) {
+						std::cerr << "Invalid thread count: " << optarg << "\n\n";
+						print_help();
+						exit(1);  // NOLINT
+					}
+					std::cout << "[CONFIG] Threads: " << config.num_threads << "\n";
+					break;
+				}
+				case 'b': {
+					try {
+						config.time_budget = std::stod(optarg);
+					} catch (const std::exception&) {
+						std::cerr << "Invalid time budget: " << optarg << "\n\n";
+						print_help();
+						exit(1);  // NOLINT
+					}
+					std::cout << "[CONFIG] Time Budget: " << config.time_budget.value() << " seconds\n";
+					break;
+				}
+				case 'n': {
+					config.use_cache = false;
+					std::cout << "[CONFIG] Racetime Cache: off\n";
+					break;
+				}
+				case 'k': {
+					try {
+						config.coarsen_factor = std::stod(optarg);
+					} catch (const std::exception&) {
+						std::cerr << "Invalid coarsening factor: " << optarg << "\n\n";
+						print_help();
+						exit(1);  // NOLINT
+					}
+					// Races on the coarse route must not be mistaken for races on the full route
+					config.use_cache = false;
+					std::cout << "[CONFIG] Coarsening Factor: " << config.coarsen_factor.value() << "\n";
+					break;
+				}
+				case 'e': {
+					try {
+						config.weather_resolution = std::stod(optarg);
+					} catch (const std::exception&) {
+						config.weather_resolution = std::nullopt;
+					}
+					if (!config.weather_resolution.has_value() || config.weather_resolution.value() <= 0) {
+						std::cerr << "Invalid weather resolution: " << optarg << "\n\n";
+						print_help();
+						exit(1);  // NOLINT
+					}
+					// Resampled weather can differ slightly from the splines the cached races were run on
+					config.use_cache = false;
+					std::cout << "[CONFIG] Weather Resolution: " << config.weather_resolution.value() << " seconds\n";
+					break;
+				}
+				case 'x': {
+					config.exact_charging = true;
+					// Exact charging gains differ slightly from the stepped ones the cached races were run on
+					config.use_cache = false;
+					std::cout << "[CONFIG] Static Charging: exact\n";
+					break;
+				}
+				case 'T': {
+					config.trace_file = std::string(optarg);
+					std::cout << "[CONFIG] Trace File: " << config.trace_file << "\n";
+					break;
+				}
+				case 'F': {
+					config.full_trace = true;
+					std::cout << "[CONFIG] Trace Detail: full\n";
+					break;
+				}
 				default: {
 					std::cerr << "Invalid option: " << static_cast<char>(choice) << "\n\n";
 					print_help();
@@ -127,9 +280,247 @@ namespace {
 			print_help();
 			exit(2);  // NOLINT
 		}
+		if (!config.schedule_file.empty() && !config.schedule_dir.empty()) {
+			std::cerr << "\n[ERROR] Conflicting Options: pass either a schedule or a schedule directory.\n\n";
+			print_help();
+			exit(2);  // NOLINT
+		}
+		if (config.coarsen_factor.has_value() && !config.schedule_dir.empty()) {
+			std::cerr << "\n[ERROR] Conflicting Options: only a single schedule can be coarsened.\n\n";
+			print_help();
+			exit(2);  // NOLINT
+		}
+		if (!config.trace_file.empty() && !config.schedule_dir.empty()) {
+			std::cerr << "\n[ERROR] Conflicting Options: only a single schedule can be traced.\n\n";
+			print_help();
+			exit(2);  // NOLINT
+		}
+		if (config.full_trace && config.trace_file.empty()) {
+			std::cerr << "\n[ERROR] Missing Option: a full trace needs a trace file; pass --trace.\n\n";
+			print_help();
+			exit(2);  // NOLINT
+		}
+		if (config.exact_charging && !config.weather_resolution.has_value()) {
+			std::cerr << "\n[ERROR] Missing Option: exact charging integrates weather timelines; pass a weather "
+						 "resolution.\n\n";
+			print_help();
+			exit(2);  // NOLINT
+		}
 		std::cout << std::flush;
 		return config;
 	}
+
+	/// @returns The directory racetime caches are kept in.
+	std::filesystem::path racetime_cache_directory() {
+		return std::filesystem::path(get_root_directory()) / "output" / "racetime_cache";
+	}
+
+	/// @returns The content hash of every input file, for the racetime cache. Races depend on nothing but these files,
+	/// so runs on the same files can share their results.
+	uint64_t hash_inputs(const CommandLine& config, const std::string& schedule_file) {
+		std::vector<std::string> input_files = {
+			config.car_file, config.weather_stations_file, config.route_file, schedule_file};
+		input_files.insert(input_files.end(), config.weather_files.begin(), config.weather_files.end());
+		return RaceRunner::RacetimeCache::hash_files(input_files);
+	}
+
+	/// @returns The deadline @p time_budget from now, or Clock::time_point::max() if there is no budget.
+	Optimizer::Clock::time_point deadline_after(std::optional<double> time_budget) {
+		if (!time_budget.has_value()) {
+			return Optimizer::Clock::time_point::max();
+		}
+		return Optimizer::Clock::now() + std::chrono::duration_cast<Optimizer::Clock::duration>(
+											 std::chrono::duration<double>(time_budget.value()));
+	}
+
+	/// @returns The forecast in config.weather_files, resampled into timelines over all of it if
+	/// config.weather_resolution is set. The timelines integrate static charging exactly if config.exact_charging is
+	/// set, and in the usual increments otherwise.
+	Weather load_weather(const CommandLine& config, const WeatherStations& weather_stations) {
+		const Weather weather(config.weather_files, weather_stations);
+		if (!config.weather_resolution.has_value()) {
+			return weather;
+		}
+
+		const auto [start_time, end_time] = weather.get_time_range();
+		const WeatherTimelines::Integration integration =
+			config.exact_charging ? WeatherTimelines::Integration::EXACT : WeatherTimelines::Integration::STEPPED;
+		Weather resampled =
+			weather.with_timelines(start_time, end_time, config.weather_resolution.value(), integration);
+		const WeatherTimelines& timelines = *resampled.get_timelines();
+		const WeatherTimelines::Sample& deviation = timelines.get_max_deviation();
+		const double wind_deviation =
+			std::max(deviation[WeatherTimelines::WIND_NORTH_SOUTH], deviation[WeatherTimelines::WIND_EAST_WEST]);
+		constexpr double bytes_per_megabyte = 1024.0 * 1024.0;
+		std::cout << "[WEATHER] Timelines: " << timelines.get_num_stations() << " stations x "
+				  << timelines.get_num_samples() << " samples, "
+				  << static_cast<double>(timelines.get_memory_use()) / bytes_per_megabyte << " MB\n"
+				  << "[WEATHER] Max Deviation: " << deviation[WeatherTimelines::GHI] << " W/m^2 irradiance, "
+				  << wind_deviation << " m/s wind, " << deviation[WeatherTimelines::AIR_DENSITY]
+				  << " kg/m^3 air density\n";
+		return resampled;
+	}
+
+	/// @returns The state of charge the car crosses the finish with, driving @p solution.
+	double final_state_of_charge(const SolarCar& car, const Route& route, const Weather& weather,
+		const RaceSchedule& schedule, const Optimizer::OptimizationOutput& solution) {
+		const std::vector<double> speed_profile = solution.speed_profile.empty()
+													  ? std::vector<double>(route.get_num_segments(), solution.speed)
+													  : solution.speed_profile;
+		RaceRunner::RaceProgress progress = RaceRunner::start_race(car, schedule);
+		RaceRunner::drive_segments(car, route, weather, schedule, speed_profile, route.get_num_segments(), progress);
+		return car.battery.state_of_charge(progress.energy_remaining);
+	}
+
+	/// @brief Races @p solution again, recording the state of the race after every segment into @p trace_file, with
+	/// the columns of @p detail.
+	void write_trace(const std::string& trace_file, RaceRunner::RaceTrace::Detail detail, const SolarCar& car,
+		const Route& route, const Weather& weather, const RaceSchedule& schedule,
+		const Optimizer::OptimizationOutput& solution) {
+		const std::vector<double> speed_profile = solution.speed_profile.empty()
+													  ? std::vector<double>(route.get_num_segments(), solution.speed)
+													  : solution.speed_profile;
+		try {
+			RaceRunner::RaceTrace trace(trace_file, detail);
+			RaceRunner::trace_race(car, route, weather, schedule, speed_profile, trace);
+			trace.close();
+			std::cout << "[OUTPUT] Trace: " << trace.get_num_records() << " segments written to " << trace_file
+					  << "\n";
+		} catch (const std::exception&) {
+			std::cerr << "[ERROR] Could not Write Trace: " << trace_file << "\n";
+		}
+	}
+
+	/// @brief Races @p solution, found on @p coarse_route, on the full @p route instead, and updates it to match.
+	///
+	/// The coarse route only checks the battery at the end of its longer segments, so the fastest strategy on it can
+	/// run the battery flat part way through a merged run. If it does not finish the full route, the whole strategy is
+	/// slowed down a step at a time until it does.
+	///
+	/// @returns Whether the strategy, possibly slowed down, finishes the full route.
+	bool verify_on_full_route(const SolarCar& solarcar, const Route& route, const Route& coarse_route,
+		const Weather& weather, const RaceSchedule& schedule, Optimizer::OptimizationOutput& solution) {
+		constexpr double slow_down_step = 0.001;
+		constexpr size_t max_slow_down_steps = 100;
+		const std::vector<double> speed_profile =
+			solution.speed_profile.empty() ? std::vector<double>(route.get_num_segments(), solution.speed)
+										   : coarse_route.to_source_profile(solution.speed_profile);
+		for (size_t step = 0; step <= max_slow_down_steps; ++step) {
+			const double scale = 1 - slow_down_step * static_cast<double>(step);
+			std::vector<double> scaled_profile(speed_profile.size());
+			std::transform(speed_profile.begin(), speed_profile.end(), scaled_profile.begin(),
+				[scale](double speed) { return speed * scale; });
+			const std::optional<double> racetime =
+				RaceRunner::calculate_racetime(solarcar, route, weather, schedule, scaled_profile);
+			++solution.evaluations;
+			if (!racetime.has_value()) {
+				continue;
+			}
+			if (step > 0) {
+				std::cout << "[COARSEN] Slowed Down By: " << decimal_to_percent(1 - scale) << "%\n";
+			}
+			solution.racetime = racetime.value();
+			solution.speed *= scale;
+			if (!solution.speed_profile.empty()) {
+				solution.speed_profile = std::move(scaled_profile);
+			}
+			return true;
+		}
+		return false;
+	}
+
+	/// One row of the schedule sweep's results table.
+	struct SweepResult {
+		std::string schedule_name;
+		/// The best solution, or std::nullopt if the car could not finish.
+		std::optional<Optimizer::OptimizationOutput> solution;
+		/// The state of charge the car finishes with.
+		double final_soc = 0;
+		/// Why the schedule could not be optimized at all (e.g. it is not valid, or the weather does not cover it).
+		std::string error;
+	};
+
+	/// @brief Optimizes every schedule in config.schedule_dir, spread over config.num_threads threads, sharing the car,
+	/// route and weather between them. Prints the results table and writes it to output/schedule_sweep.csv.
+	int run_schedule_sweep(
+		const CommandLine& config, const SolarCar& solarcar, const Weather& weather, const Route& route) {
+		std::vector<std::filesystem::path> schedule_files;
+		for (const auto& entry : std::filesystem::directory_iterator(config.schedule_dir)) {
+			if (entry.is_regular_file() && entry.path().extension() == ".toml") {
+				schedule_files.push_back(entry.path());
+			}
+		}
+		std::sort(schedule_files.begin(), schedule_files.end());
+
+		std::vector<SweepResult> results(schedule_files.size());
+		std::atomic<size_t> cache_hits = 0;
+		std::atomic<size_t> cache_misses = 0;
+		ThreadPool pool(config.num_threads);
+		pool.parallel_for(schedule_files.size(), [&](size_t i) {
+			SweepResult& result = results[i];
+			result.schedule_name = schedule_files[i].stem().string();
+			const auto schedule_config = ConfigFile::from_path(schedule_files[i].string());
+			if (!schedule_config.has_value()) {
+				result.error = "invalid schedule";
+				return;
+			}
+
+			try {
+				const RaceSchedule schedule(schedule_config.value());
+				// Weather lookups before the forecast starts throw
+				if (schedule.size() == 0 || schedule[0].race_start_time < weather.get_time_range().first) {
+					result.error = "no weather";
+					return;
+				}
+				RaceRunner::RacetimeCache racetime_cache(hash_inputs(config, schedule_files[i].string()),
+					config.use_cache ? racetime_cache_directory() : std::filesystem::path());
+				// The schedules already keep every thread busy
+				const std::unique_ptr<const Optimizer> optimizer = Optimizer::create_optimizer(config.optimizer_type,
+					solarcar, weather, route, schedule, 1, config.use_cache ? &racetime_cache : nullptr);
+				result.solution = optimizer->optimize_race(deadline_after(config.time_budget), nullptr);
+				if (result.solution.has_value()) {
+					result.final_soc =
+						final_state_of_charge(solarcar, route, weather, schedule, result.solution.value());
+				}
+				racetime_cache.save();
+				cache_hits += racetime_cache.get_hits();
+				cache_misses += racetime_cache.get_misses();
+			} catch (const std::exception& error) {
+				result.error = std::string("failed: ") + error.what();
+			}
+		});
+
+		const std::filesystem::path results_file =
+			std::filesystem::path(get_root_directory()) / "output" / "schedule_sweep.csv";
+		std::filesystem::create_directories(results_file.parent_path());
+		std::ofstream csv(results_file);
+		csv << "schedule,optimal_speed,racetime,final_soc,status\n";
+
+		constexpr int precision = 5;
+		std::cout << std::fixed << std::setprecision(precision) << "\n";
+		csv << std::fixed << std::setprecision(precision);
+		for (const SweepResult& result : results) {
+			std::cout << "[OUTPUT] " << result.schedule_name << ": ";
+			csv << result.schedule_name << ",";
+			if (!result.error.empty()) {
+				std::cout << result.error << "\n";
+				csv << ",,," << result.error << "\n";
+			} else if (!result.solution.has_value()) {
+				std::cout << "did not finish\n";
+				csv << ",,,did not finish\n";
+			} else {
+				const auto& solution = result.solution.value();
+				std::cout << solution.speed << " mps, " << solution.racetime << " seconds, final SOC "
+						  << result.final_soc << "\n";
+				csv << solution.speed << "," << solution.racetime << "," << result.final_soc << ",finished\n";
+			}
+		}
+		std::cout << "[OUTPUT] Results Table: " << results_file.string() << "\n";
+		if (config.use_cache) {
+			std::cout << "[CACHE] Hits: " << cache_hits.load() << ", Misses: " << cache_misses.load() << "\n";
+		}
+		return 0;
+	}
 }  // namespace
 
 int main(int argc, char** argv) {
@@ -144,6 +535,16 @@ int main(int argc, char** argv) {
 		}
 		car_config = car_config_opt.value();
 	}
+
+	const auto solarcar = SolarCar(car_config);
+	const auto weather_stations = WeatherStations(config.weather_stations_file);
+	const auto weather = load_weather(config, weather_stations);
+	const auto route = Route(config.route_file, weather_stations);
+
+	if (!config.schedule_dir.empty()) {
+		return run_schedule_sweep(config, solarcar, weather, route);
+	}
+
 	ConfigFile schedule_config;
 	{  // Schedule Config
 		const auto schedule_config_opt = ConfigFile::from_path(config.schedule_file);
@@ -153,29 +554,115 @@ int main(int argc, char** argv) {
 		}
 		schedule_config = schedule_config_opt.value();
 	}
-
-	const auto solarcar = SolarCar(car_config);
-	const auto weather_stations = WeatherStations(config.weather_stations_file);
-	const auto weather = Weather(config.weather_file, weather_stations);
-	const auto route = Route(config.route_file, weather_stations);
 	const auto schedule = RaceSchedule(schedule_config);
 
-	const std::unique_ptr<const Optimizer> optimizer =
-		Optimizer::create_optimizer(config.optimizer_type, solarcar, weather, route, schedule);
+	RaceRunner::RacetimeCache racetime_cache(hash_inputs(config, config.schedule_file),
+		config.use_cache ? racetime_cache_directory() : std::filesystem::path());
+
+	std::optional<Route> coarse_route;
+	if (config.coarsen_factor.has_value()) {
+		Route::CoarseningTolerance tolerance;
+		tolerance.heading *= config.coarsen_factor.value();
+		tolerance.grade *= config.coarsen_factor.value();
+		tolerance.weather_station *= config.coarsen_factor.value();
+		coarse_route = route.coarsen(tolerance);
+		std::cout << "[COARSEN] Segments: " << route.get_num_segments() << " -> " << coarse_route->get_num_segments()
+				  << "\n";
+	}
+	const Route& search_route = coarse_route.has_value() ? coarse_route.value() : route;
+
+	const std::unique_ptr<const Optimizer> optimizer = Optimizer::create_optimizer(config.optimizer_type, solarcar,
+		weather, search_route, schedule, config.num_threads, config.use_cache ? &racetime_cache : nullptr);
 
-	const auto solution_opt = optimizer->optimize_race();
 	constexpr int precision = 5;
 	std::cout << std::fixed << std::setprecision(precision) << std::setfill('0');
 
+	std::optional<Optimizer::OptimizationOutput> solution_opt;
+	if (config.time_budget.has_value()) {
+		const auto start = Optimizer::Clock::now();
+		const auto deadline = deadline_after(config.time_budget);
+		std::cout << "\n";
+		solution_opt = optimizer->optimize_race(deadline, [start](const Optimizer::OptimizationOutput& solution) {
+			const std::chrono::duration<double> elapsed = Optimizer::Clock::now() - start;
+			std::cout << "[PROGRESS] " << elapsed.count() << " s: Race Time: " << solution.racetime << " seconds\n"
+					  << std::flush;
+		});
+	} else {
+		solution_opt = optimizer->optimize_race();
+	}
+
+	const auto report_cache = [&]() {
+		if (!config.use_cache) {
+			return;
+		}
+		racetime_cache.save();
+		std::cout << "[CACHE] Hits: " << racetime_cache.get_hits() << ", Misses: " << racetime_cache.get_misses()
+				  << "\n";
+	};
+
 	if (!solution_opt.has_value()) {
-		std::cout << "\n"  //
-				  << "[OUTPUT] The Car was not able to finish the race.\n\n";
+		std::cout << "\n";
+		if (config.time_budget.has_value()) {
+			std::cout << "[OUTPUT] No finishing race was found within the time budget.\n\n";
+		} else {
+			std::cout << "[OUTPUT] The Car was not able to finish the race.\n\n";
+		}
+		report_cache();
 		return 0;
 	};
 
-	const auto solution = solution_opt.value();
+	auto solution = solution_opt.value();
+	if (coarse_route.has_value()) {
+		std::cout << "\n[COARSEN] Coarse Race Time: " << solution.racetime << " seconds\n";
+		const RaceRunner::CoarseningError error = RaceRunner::calculate_coarsening_error(
+			solarcar, route, coarse_route.value(), weather, schedule, solution.speed);
+		std::cout << "[COARSEN] Worst Error at " << solution.speed << " mps: " << error.energy << " Wh, " << error.time
+				  << " seconds\n";
+		if (!verify_on_full_route(solarcar, route, coarse_route.value(), weather, schedule, solution)) {
+			std::cout << "[OUTPUT] The strategy found on the coarse route does not finish the full route.\n\n";
+			return 0;
+		}
+	}
 	std::cout << "\n"  //
 			  << "[OUTPUT] Race Time: " << solution.racetime << " seconds = " << seconds_to_hours(solution.racetime)
-			  << " hours\n"
-			  << "[OUTPUT] Optimal Speed: " << solution.speed << " mps = " << mps_to_kph(solution.speed) << " kph\n";
+			  << " hours\n";
+	if (solution.speed_profile.empty()) {
+		std::cout << "[OUTPUT] Optimal Speed: " << solution.speed << " mps = " << mps_to_kph(solution.speed) << " kph\n";
+	} else {
+		const auto [slowest, fastest] = std::minmax_element(solution.speed_profile.begin(), solution.speed_profile.end());
+		std::cout << "[OUTPUT] Average Speed: " << solution.speed << " mps = " << mps_to_kph(solution.speed) << " kph\n"
+				  << "[OUTPUT] Speed Profile: " << solution.speed_profile.size() << " segments, " << *slowest << " to "
+				  << *fastest << " mps\n";
+	}
+	if (solution.ensemble_risk.has_value()) {
+		const auto& risk = solution.ensemble_risk.value();
+		std::cout << "[OUTPUT] Forecast Ensemble: " << risk.ensemble_size << " members\n"
+				  << "[OUTPUT] Mean Race Time: " << risk.mean_racetime << " seconds\n"
+				  << "[OUTPUT] P90 Race Time: " << risk.p90_racetime << " seconds\n"
+				  << "[OUTPUT] Probability of Finishing: " << risk.finish_probability << "\n";
+	}
+	if (solution.minimum_state_of_charge.has_value()) {
+		std::cout << "[OUTPUT] Minimum SOC: " << solution.minimum_state_of_charge.value() << "\n";
+	}
+	if (solution.final_state_of_charge.has_value()) {
+		std::cout << "[OUTPUT] Final SOC: " << solution.final_state_of_charge.value() << "\n";
+	}
+	if (!solution.pareto_front.empty()) {
+		std::cout << "[OUTPUT] Pareto Front: " << solution.pareto_front.size() << " solutions\n";
+		for (const auto& trade_off : solution.pareto_front) {
+			std::cout << "[PARETO] Speed: " << trade_off.speed << " mps, Race Time: " << trade_off.racetime
+					  << " seconds, Minimum SOC: " << trade_off.minimum_state_of_charge.value_or(0)
+					  << ", Final SOC: " << trade_off.final_state_of_charge.value_or(0) << "\n";
+		}
+	}
+	std::cout << "[OUTPUT] Race Simulations: " << solution.evaluations << "\n";
+	if (solution.segments_skipped > 0) {
+		std::cout << "[OUTPUT] Segments Skipped: " << solution.segments_skipped << "\n";
+	}
+	if (!config.trace_file.empty()) {
+		const RaceRunner::RaceTrace::Detail detail =
+			config.full_trace ? RaceRunner::RaceTrace::Detail::FULL : RaceRunner::RaceTrace::Detail::PROGRESS;
+		write_trace(config.trace_file, detail, solarcar, route, weather, schedule, solution);
+	}
+	report_cache();
 }
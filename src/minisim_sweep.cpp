@@ -0,0 +1,460 @@
+#include <getopt.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ConfigFile/ConfigFile.h"
+#include "Optimizer/Optimizer.h"
+#include "RaceConfig/RaceSchedule/RaceSchedule.h"
+#include "RaceConfig/Route/Route.h"
+#include "RaceConfig/Weather/Weather.h"
+#include "RaceConfig/WeatherStations/WeatherStations.h"
+#include "RaceRunner/RacetimeCache.h"
+#include "SolarCar/SolarCar.h"
+#include "Tools/WorkQueue.h"
+
+namespace {
+	struct CommandLine {
+		/// One of plan, work, merge or run.
+		std::string command;
+		std::string manifest_file;
+		std::string spool_dir;
+		std::string output_file;
+		size_t num_workers = 1;
+		/// How long a claim may go without a heartbeat before another worker takes it over.
+		std::chrono::seconds lease = std::chrono::seconds(60);  // NOLINT
+	};
+
+	void print_help() {
+		std::cout << "Usage: minisim-sweep plan -m <manifest.toml> -d <spool-dir>\n"
+				  << "       minisim-sweep work -d <spool-dir> [-l <seconds>]\n"
+				  << "       minisim-sweep merge -d <spool-dir> -o <results.csv>\n"
+				  << "       minisim-sweep run -m <manifest.toml> -d <spool-dir> -o <results.csv> [-n <workers>] "
+					 "[-l <seconds>]\n\n"
+				  << "Optimize every combination of the cars, schedules and optimizers in a manifest, spread over\n"
+				  << "worker processes that share a spool directory. Workers can run on any machine that sees the\n"
+				  << "directory; a worker that dies has its work taken over by the others.\n\n"
+				  << "Commands:\n"
+				  << "  plan               split the manifest into work items in the spool directory, replacing any\n"
+				  << "                     earlier ones and their results\n"
+				  << "  work               optimize work items until none are left\n"
+				  << "  merge              collect the results of every work item into one CSV table\n"
+				  << "  run                plan, start workers on this machine, wait for them, then merge\n\n"
+				  << "Options:\n"
+				  << "  -h, --help         display this help and exit\n"
+				  << "  -m, --manifest     the sweep to run (TOML): route, stations, weather, cars, schedules (files\n"
+				  << "                     or directories of them) and optimizers; paths are relative to it\n"
+				  << "  -d, --spool        the directory the work items, their results and each machine's racetime\n"
+				  << "                     caches are kept in\n"
+				  << "  -o, --output       the results table to write (CSV)\n"
+				  << "  -n, --workers      the number of worker processes to run (default 1)\n"
+				  << "  -l, --lease        the seconds a work item may go without a heartbeat before it is given to\n"
+				  << "                     another worker (default 60)\n";
+	}
+
+	CommandLine read_args(const int argc, char** argv) {
+		CommandLine config = {};
+		if (argc < 2) {
+			print_help();
+			exit(2);  // NOLINT
+		}
+		config.command = argv[1];  // NOLINT
+		if (config.command == "-h" || config.command == "--help") {
+			print_help();
+			exit(0);  // NOLINT
+		}
+
+		opterr = 0;
+		int choice = 0;
+		int index = 0;
+
+		// NOLINTNEXTLINE
+		static struct option long_options[] = {
+			{"manifest", required_argument, nullptr, 'm'},
+			{"spool",    required_argument, nullptr, 'd'},
+			{"output",   required_argument, nullptr, 'o'},
+			{"workers",  required_argument, nullptr, 'n'},
+			{"lease",    required_argument, nullptr, 'l'},
+			{"help",     no_argument,       nullptr, 'h'},
+			{nullptr,    0,                 nullptr, 0  },
+		};
+
+		// Skip the command
+		// NOLINTNEXTLINE
+		while ((choice = getopt_long(argc - 1, argv + 1, "hm:d:o:n:l:", long_options, &index)) != -1) {
+			switch (choice) {
+				case 'h': {
+					print_help();
+					exit(0);  // NOLINT
+				}
+				case 'm': {
+					config.manifest_file = std::string(optarg);
+					break;
+				}
+				case 'd': {
+					config.spool_dir = std::string(optarg);
+					break;
+				}
+				case 'o': {
+					config.output_file = std::string(optarg);
+					break;
+				}
+				case 'n':
+				case 'l': {
+					std::optional<size_t> value;
+					try {
+						// stoul would take "-1" as the largest size_t
+						if (optarg[0] != '-') {
+							value = std::stoul(optarg);
+						}
+					} catch (const std::exception&) {
+						// Not a number, so value stays empty
+					}
+					if (!value.has_value()) {
+						std::cerr << "Invalid number: " << optarg << "\n\n";
+						print_help();
+						exit(1);  // NOLINT
+					}
+					if (choice == 'n') {
+						config.num_workers = value.value();
+					} else {
+						config.lease = std::chrono::seconds(value.value());
+					}
+					break;
+				}
+				default: {
+					std::cerr << "Invalid option: " << static_cast<char>(choice) << "\n\n";
+					print_help();
+					exit(1);  // NOLINT
+				}
+			}
+		}
+
+		const bool needs_manifest = config.command == "plan" || config.command == "run";
+		const bool needs_output = config.command == "merge" || config.command == "run";
+		if (!needs_manifest && !needs_output && config.command != "work") {
+			std::cerr << "\n[ERROR] Unknown Command: " << config.command << "\n\n";
+			print_help();
+			exit(2);  // NOLINT
+		}
+		if (config.spool_dir.empty() || (needs_manifest && config.manifest_file.empty()) ||
+			(needs_output && config.output_file.empty()) || config.num_workers == 0) {
+			std::cerr << "\n[ERROR] Missing Option: Not all required options were passed.\n\n";
+			print_help();
+			exit(2);  // NOLINT
+		}
+		return config;
+	}
+
+	/// @returns @p path made absolute, taking relative paths relative to @p base, so that work items make sense to
+	/// workers started from any directory.
+	std::string resolve(const std::filesystem::path& base, const std::string& path) {
+		return std::filesystem::absolute(base / path).lexically_normal().string();
+	}
+
+	/// @brief Splits the manifest into one work item per car, schedule and optimizer, and replaces everything in the
+	/// queue with them.
+	/// @returns The number of work items added, or std::nullopt if the manifest is invalid.
+	std::optional<size_t> plan(const std::string& manifest_file, const WorkQueue& queue) {
+		const auto manifest_opt = ConfigFile::from_path(manifest_file);
+		if (!manifest_opt.has_value()) {
+			return std::nullopt;
+		}
+		const ConfigFile& manifest = manifest_opt.value();
+		const std::filesystem::path base = std::filesystem::path(manifest_file).parent_path();
+
+		const auto route_file = manifest.get<std::string>("route");
+		const auto stations_file = manifest.get<std::string>("stations");
+		const auto weather_files = manifest.get_array<std::string>("weather");
+		const auto car_files = manifest.get_array<std::string>("cars");
+		const auto schedule_paths = manifest.get_array<std::string>("schedules");
+		const auto optimizer_types = manifest.get_array<std::string>("optimizers");
+		if (!route_file || !stations_file || !weather_files || !car_files || !schedule_paths || !optimizer_types) {
+			return std::nullopt;
+		}
+
+		std::vector<std::string> resolved_weather_files;
+		for (const std::string& weather_file : weather_files.value()) {
+			resolved_weather_files.push_back(resolve(base, weather_file));
+		}
+		// A directory stands for every schedule in it, in order
+		std::vector<std::string> schedule_files;
+		for (const std::string& schedule_path : schedule_paths.value()) {
+			const std::string resolved = resolve(base, schedule_path);
+			if (!std::filesystem::is_directory(resolved)) {
+				schedule_files.push_back(resolved);
+				continue;
+			}
+			std::vector<std::string> directory_files;
+			for (const auto& entry : std::filesystem::directory_iterator(resolved)) {
+				if (entry.is_regular_file() && entry.path().extension() == ".toml") {
+					directory_files.push_back(entry.path().string());
+				}
+			}
+			std::sort(directory_files.begin(), directory_files.end());
+			schedule_files.insert(schedule_files.end(), directory_files.begin(), directory_files.end());
+		}
+
+		// Results of an earlier plan would otherwise be merged with this one's
+		queue.clear();
+		constexpr int id_width = 6;
+		size_t num_items = 0;
+		for (const std::string& car_file : car_files.value()) {
+			for (const std::string& schedule_file : schedule_files) {
+				for (const std::string& optimizer_type : optimizer_types.value()) {
+					std::ostringstream id;
+					id << std::setw(id_width) << std::setfill('0') << num_items;
+					ConfigFile item;
+					item.set("id", id.str());
+					item.set("car", resolve(base, car_file));
+					item.set("schedule", schedule_file);
+					item.set("optimizer", optimizer_type);
+					item.set("route", resolve(base, route_file.value()));
+					item.set("stations", resolve(base, stations_file.value()));
+					item.set_array<std::string>("weather", resolved_weather_files);
+					queue.add(id.str(), item.to_string());
+					++num_items;
+				}
+			}
+		}
+		return num_items;
+	}
+
+	/// The route, stations and forecast a worker last loaded. Every item of a sweep shares them, and the forecast
+	/// takes far longer to load than most races take to optimize, so a worker loads them only when they change.
+	struct LoadedCourse {
+		std::string stations_file;
+		std::string route_file;
+		std::vector<std::string> weather_files;
+		std::unique_ptr<const Route> route;
+		std::unique_ptr<const Weather> weather;
+	};
+
+	/// @returns The directory in @p spool_directory that this machine's racetime caches are kept in. Only the workers
+	/// on one machine share a cache: the cache file is locked with flock, which network file systems do not reliably
+	/// honour between machines.
+	std::filesystem::path racetime_cache_directory(const std::string& spool_directory) {
+		return std::filesystem::path(spool_directory) / "racetime_cache" / WorkQueue::get_host_name();
+	}
+
+	/// @brief Optimizes the work item @p item, looking races up in the caches in @p cache_directory.
+	/// @returns The item's row of the results table.
+	std::string process(const ConfigFile& item, LoadedCourse& course, const std::filesystem::path& cache_directory) {
+		const auto id = item.get<std::string>("id").value_or("");
+		const auto car_file = item.get<std::string>("car").value_or("");
+		const auto schedule_file = item.get<std::string>("schedule").value_or("");
+		const auto optimizer_type = item.get<std::string>("optimizer").value_or("");
+		const auto stations_file = item.get<std::string>("stations").value_or("");
+		const auto route_file = item.get<std::string>("route").value_or("");
+		const auto weather_files = item.get_array<std::string>("weather").value_or(std::vector<std::string>());
+
+		std::ostringstream row;
+		row << id << "," << std::filesystem::path(car_file).stem().string() << ","
+			<< std::filesystem::path(schedule_file).stem().string() << "," << optimizer_type << ",";
+
+		const auto car_config = ConfigFile::from_path(car_file);
+		if (!car_config.has_value()) {
+			row << "invalid car,,,\n";
+			return row.str();
+		}
+		const auto schedule_config = ConfigFile::from_path(schedule_file);
+		if (!schedule_config.has_value()) {
+			row << "invalid schedule,,,\n";
+			return row.str();
+		}
+
+		try {
+			if (!course.weather || course.stations_file != stations_file || course.route_file != route_file ||
+				course.weather_files != weather_files) {
+				const auto weather_stations = WeatherStations(stations_file);
+				course.route = std::make_unique<const Route>(route_file, weather_stations);
+				course.weather = std::make_unique<const Weather>(weather_files, weather_stations);
+				course.stations_file = stations_file;
+				course.route_file = route_file;
+				course.weather_files = weather_files;
+			}
+
+			const auto solarcar = SolarCar(car_config.value());
+			const auto schedule = RaceSchedule(schedule_config.value());
+			// Weather lookups before the forecast starts throw
+			if (schedule.size() == 0 || schedule[0].race_start_time < course.weather->get_time_range().first) {
+				row << "no weather,,,\n";
+				return row.str();
+			}
+			std::vector<std::string> input_files = {car_file, stations_file, route_file, schedule_file};
+			input_files.insert(input_files.end(), weather_files.begin(), weather_files.end());
+			const uint64_t input_hash = RaceRunner::RacetimeCache::hash_files(input_files);
+			RaceRunner::RacetimeCache racetime_cache(input_hash, cache_directory);
+			// Workers are the unit of parallelism, so each optimizes on one thread
+			const std::unique_ptr<const Optimizer> optimizer = Optimizer::create_optimizer(
+				optimizer_type, solarcar, *course.weather, *course.route, schedule, 1, &racetime_cache);
+			const std::optional<Optimizer::OptimizationOutput> solution = optimizer->optimize_race();
+			racetime_cache.save();
+
+			constexpr int precision = 5;
+			row << std::fixed << std::setprecision(precision);
+			if (solution.has_value()) {
+				row << "finished," << solution->speed << "," << solution->racetime << "," << solution->evaluations
+					<< "\n";
+			} else {
+				row << "did not finish,,,\n";
+			}
+		} catch (const std::exception& error) {
+			row << "failed: " << error.what() << ",,,\n";
+		}
+		return row.str();
+	}
+
+	/// @brief Claims and optimizes work items until the queue is empty and no other worker is busy, taking over the
+	/// items of workers that died.
+	/// @returns The number of work items this worker completed.
+	size_t work(const WorkQueue& queue, std::chrono::seconds lease, const std::filesystem::path& cache_directory) {
+		LoadedCourse course;
+		size_t num_completed = 0;
+		while (true) {
+			const std::optional<WorkQueue::Claim> claim = queue.claim();
+			if (!claim.has_value()) {
+				// Nothing left to claim: take over what dead workers left behind, or wait for the live ones in case
+				// they die too
+				if (queue.requeue_stale(lease) > 0) {
+					continue;
+				}
+				if (queue.num_queued() == 0 && queue.num_claimed() == 0) {
+					return num_completed;
+				}
+				std::this_thread::sleep_for(std::chrono::seconds(1));
+				continue;
+			}
+
+			std::cout << "[WORK] " << getpid() << ": item " << claim->id << " (attempt " << claim->attempt << ")\n"
+					  << std::flush;
+
+			// Keeps the claim fresh for as long as the optimizer runs, however long that is
+			std::mutex mutex;
+			std::condition_variable_any stopped;
+			const auto heartbeat_period = std::max<std::chrono::seconds>(lease / 4, std::chrono::seconds(1));
+			std::jthread heartbeat([&](const std::stop_token& stop_token) {
+				std::unique_lock lock(mutex);
+				while (!stop_token.stop_requested()) {
+					queue.heartbeat(claim.value());
+					stopped.wait_for(lock, stop_token, heartbeat_period, [] { return false; });
+				}
+			});
+
+			const auto item = ConfigFile::from_toml(claim->contents);
+			const std::string row =
+				item.has_value() ? process(item.value(), course, cache_directory) : claim->id + ",,,,invalid item,,,\n";
+
+			heartbeat.request_stop();
+			heartbeat.join();
+			queue.complete(claim.value(), row);
+			++num_completed;
+		}
+	}
+
+	/// @brief Writes the results of every work item to @p output_file, in order of id. Items that were given up on get
+	/// a row saying so.
+	/// @returns The number of rows written.
+	size_t merge(const WorkQueue& queue, const std::string& output_file) {
+		std::vector<std::string> rows = queue.get_results();
+		for (const std::string& failed_item : queue.get_failed()) {
+			const auto item = ConfigFile::from_toml(failed_item).value_or(ConfigFile());
+			rows.push_back(item.get<std::string>("id").value_or("") + "," +
+						   std::filesystem::path(item.get<std::string>("car").value_or("")).stem().string() + "," +
+						   std::filesystem::path(item.get<std::string>("schedule").value_or("")).stem().string() +
+						   "," + item.get<std::string>("optimizer").value_or("") + ",failed,,,\n");
+		}
+		// Ids are zero padded, so their text order is their order
+		std::sort(rows.begin(), rows.end());
+
+		const std::filesystem::path output_path(output_file);
+		if (output_path.has_parent_path()) {
+			std::filesystem::create_directories(output_path.parent_path());
+		}
+		std::ofstream csv(output_path);
+		csv << "id,car,schedule,optimizer,status,speed,racetime,evaluations\n";
+		for (const std::string& row : rows) {
+			csv << row;
+		}
+		return rows.size();
+	}
+
+	/// @brief Starts @p num_workers workers on this machine and waits for all of them. Starts them again while work
+	/// is left, in case every worker died before the queue was empty.
+	void run_workers(const WorkQueue& queue, size_t num_workers, std::chrono::seconds lease,
+		const std::filesystem::path& cache_directory) {
+		// Anything still buffered would be printed again by every worker
+		std::cout << std::flush;
+		while (queue.num_queued() > 0) {
+			std::vector<pid_t> workers;
+			for (size_t i = 0; i < num_workers; ++i) {
+				const pid_t pid = fork();
+				if (pid == 0) {
+					work(queue, lease, cache_directory);
+					std::cout << std::flush;
+					_exit(0);
+				}
+				if (pid > 0) {
+					workers.push_back(pid);
+				}
+			}
+			if (workers.empty()) {
+				std::cerr << "[ERROR] Could not start any workers\n";
+				return;
+			}
+			for (const pid_t pid : workers) {
+				int status = 0;
+				waitpid(pid, &status, 0);
+				if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+					std::cerr << "[WORK] " << pid << ": died\n";
+				}
+			}
+			// Every worker is gone, so everything still claimed was left behind
+			queue.requeue_stale(lease);
+		}
+	}
+}  // namespace
+
+int main(int argc, char** argv) {
+	const auto config = read_args(argc, argv);
+	const WorkQueue queue(config.spool_dir);
+
+	if (config.command == "plan" || config.command == "run") {
+		const std::optional<size_t> num_items = plan(config.manifest_file, queue);
+		if (!num_items.has_value()) {
+			std::cerr << "[ERROR] Manifest is Invalid\n";
+			return 2;
+		}
+		std::cout << "[PLAN] Work Items: " << num_items.value() << "\n" << std::flush;
+	}
+	if (config.command == "work") {
+		const size_t num_completed = work(queue, config.lease, racetime_cache_directory(config.spool_dir));
+		std::cout << "[WORK] Items Completed: " << num_completed << "\n";
+	}
+	if (config.command == "run") {
+		run_workers(queue, config.num_workers, config.lease, racetime_cache_directory(config.spool_dir));
+	}
+	if (config.command == "merge" || config.command == "run") {
+		std::cout << "[MERGE] Results: " << merge(queue, config.output_file) << " rows written to "
+				  << config.output_file << "\n";
+	}
+}
@@ -0,0 +1,114 @@
+#include <getopt.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "RaceRunner/RaceTrace.h"
+
+namespace {
+	struct CommandLine {
+		std::string trace_file;
+		/// The CSV file to write, or empty to write to standard output.
+		std::string output_file;
+	};
+
+	void print_help() {
+		std::cout << "Usage: minisim-trace <trace.bin> [-o <trace.csv>]\n\n"
+				  << "Export a race trace recorded by minisim --trace to CSV, one row per route segment.\n\n"
+				  << "Options:\n"
+				  << "  -h, --help         display this help and exit\n"
+				  << "  -o, --output       the CSV file to write (default: standard output)\n";
+	}
+
+	CommandLine read_args(const int argc, char** argv) {
+		opterr = 0;
+		int choice = 0;
+		int index = 0;
+
+		// NOLINTNEXTLINE
+		static struct option long_options[] = {
+			{"output", required_argument, nullptr, 'o'},
+			{"help",   no_argument,       nullptr, 'h'},
+			{nullptr,  0,                 nullptr, 0  },
+		};
+
+		CommandLine config = {};
+		// NOLINTNEXTLINE
+		while ((choice = getopt_long(argc, argv, "ho:", long_options, &index)) != -1) {
+			switch (choice) {
+				case 'h': {
+					print_help();
+					exit(0);  // NOLINT
+				}
+				case 'o': {
+					config.output_file = std::string(optarg);
+					break;
+				}
+				default: {
+					std::cerr << "Invalid option: " << static_cast<char>(optopt) << "\n\n";
+					print_help();
+					exit(1);  // NOLINT
+				}
+			}
+		}
+		if (optind != argc - 1) {
+			std::cerr << "[ERROR] Missing Option: pass exactly one trace file.\n\n";
+			print_help();
+			exit(2);  // NOLINT
+		}
+		config.trace_file = argv[optind];  // NOLINT
+		return config;
+	}
+
+	/// @brief Writes the columns the trace kept (see RaceTrace::Detail) of every record to @p csv.
+	void write_csv(std::ostream& csv, const std::vector<RaceRunner::TraceRecord>& records,
+		RaceRunner::RaceTrace::Detail detail) {
+		const auto& columns = RaceRunner::RaceTrace::columns;
+		const size_t num_columns = RaceRunner::RaceTrace::get_num_columns(detail);
+		for (size_t col = 0; col < num_columns; ++col) {
+			csv << (col == 0 ? "" : ",") << columns[col].name;
+		}
+		csv << "\n";
+
+		// Enough digits to read every value back exactly
+		csv.precision(std::numeric_limits<double>::max_digits10);
+		for (const RaceRunner::TraceRecord& record : records) {
+			for (size_t col = 0; col < num_columns; ++col) {
+				csv << (col == 0 ? "" : ",") << record.*columns[col].field;
+			}
+			csv << "\n";
+		}
+	}
+}  // namespace
+
+int main(int argc, char** argv) {
+	const auto config = read_args(argc, argv);
+
+	std::vector<RaceRunner::TraceRecord> records;
+	RaceRunner::RaceTrace::Detail detail = RaceRunner::RaceTrace::Detail::PROGRESS;
+	try {
+		records = RaceRunner::RaceTrace::read(config.trace_file, detail);
+	} catch (const std::exception&) {
+		std::cerr << "[ERROR] Not a Race Trace: " << config.trace_file << "\n";
+		return 2;
+	}
+
+	if (config.output_file.empty()) {
+		write_csv(std::cout, records, detail);
+		return 0;
+	}
+	std::ofstream csv(config.output_file);
+	write_csv(csv, records, detail);
+	if (!csv) {
+		std::cerr << "[ERROR] Could not Write: " << config.output_file << "\n";
+		return 1;
+	}
+	std::cout << "[OUTPUT] Trace: " << records.size() << " rows written to " << config.output_file << "\n";
+	return 0;
+}